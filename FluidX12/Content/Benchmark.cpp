@@ -0,0 +1,1335 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Benchmark.h"
+#include "BlockCompressor.h"
+#include "FluidCPU.h"
+#include "ParticleSoA.h"
+#include "Philox.h"
+#include "RayCasterCPU.h"
+#include "VolumeSampler.h"
+#include "WaveletTurbulence.h"
+#include <fstream>
+
+using namespace std;
+using namespace DirectX;
+
+Benchmark::Benchmark(ostream& os, uint32_t numSteps) :
+	m_os(os),
+	m_numSteps(numSteps),
+	m_numFailures(0)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+void Benchmark::Emitters(const XMUINT3& gridSize, uint32_t numEmitters)
+{
+	const auto maxEmitters = EmitterBins::MaxEmittersPerBrick;
+
+	m_os << "Emitter binning: " << numEmitters << " emitters in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	// Emitters spread over the volume, followed by a crowd of them at the default emitter that
+	// overflows its bricks
+	mt19937 rng(26);
+	uniform_real_distribution<float> posDist(0.0f, 1.0f), radiusDist(1.0f / 64.0f, 1.0f / 16.0f);
+	vector<Emitter> emitters(numEmitters + maxEmitters * 2, Emitter::Default());
+	for (auto i = 0u; i < numEmitters; ++i)
+	{
+		auto& emitter = emitters[i];
+		emitter.Pos = XMFLOAT3(posDist(rng), posDist(rng), gridSize.z > 1 ? posDist(rng) : 0.5f);
+		emitter.Radius = radiusDist(rng);
+	}
+
+	EmitterBins bins;
+	bins.Init(gridSize);
+	const auto numTotal = static_cast<uint32_t>(emitters.size());
+	measure("  Binning", [&]() { bins.Bin(numTotal, emitters.data()); });
+
+	// Every brick against all emitters, of which the overlapped cell ranges on each axis are
+	// those of the cell centers within the radius
+	const auto& brickGridSize = bins.GetBrickGridSize();
+	const auto pBrickRanges = bins.GetBrickRanges();
+	const auto pIndices = bins.GetIndices();
+	const uint32_t gridSizes[] = { gridSize.x, gridSize.y, gridSize.z };
+	auto numMismatches = 0u;
+	auto numDropped = 0u;
+	for (auto brick = 0u; brick < bins.GetNumBricks(); ++brick)
+	{
+		const uint32_t bricks[] = { brick % brickGridSize.x, brick / brickGridSize.x % brickGridSize.y,
+			brick / (brickGridSize.x * brickGridSize.y) };
+		auto count = 0u;
+		for (auto i = 0u; i < numTotal; ++i)
+		{
+			const float pos[] = { emitters[i].Pos.x, emitters[i].Pos.y, emitters[i].Pos.z };
+			auto isOverlapped = true;
+			for (uint8_t j = 0; j < 3; ++j)
+			{
+				const auto center = pos[j] * gridSizes[j] - 0.5f;
+				const auto r = emitters[i].Radius * gridSizes[j] + 0.01f;
+				const auto lo = max(ceil(center - r), static_cast<float>(bricks[j] * EmitterBins::BrickSize));
+				const auto hi = min(floor(center + r),
+					static_cast<float>(min((bricks[j] + 1) * EmitterBins::BrickSize, gridSizes[j]) - 1));
+				isOverlapped = isOverlapped && lo <= hi;
+			}
+			if (!isOverlapped) continue;
+
+			// The brick lists keep the first emitters in emitter order
+			const auto& range = pBrickRanges[brick];
+			if (count < maxEmitters) numMismatches += count < range.y && pIndices[range.x + count] == i ? 0 : 1;
+			++count;
+		}
+		numMismatches += pBrickRanges[brick].y == min(count, maxEmitters) ? 0 : 1;
+		numDropped += count > maxEmitters ? count - maxEmitters : 0;
+	}
+
+	m_os << "  " << bins.GetNumIndices() << " emitter-brick overlaps binned, "
+		<< bins.GetNumDropped() << " dropped beyond " << maxEmitters << " per brick" << endl;
+	check(numMismatches == 0, "emitter bins vs. brute-force overlaps");
+	check(bins.GetNumDropped() == numDropped && numDropped >= maxEmitters, "dropped emitters reported");
+}
+
+void Benchmark::Vorticity(const XMUINT3& gridSize)
+{
+	const XMUINT3 gridSize2D(gridSize.x, gridSize.y, 1);
+	const auto numCells = gridSize.x * gridSize.y;
+
+	m_os << "Vorticity confinement: " << gridSize2D.x << "x" << gridSize2D.y << endl;
+
+	// An emitter pushing out of the plane as well, which the 2D confinement must ignore
+	auto emitter = Emitter::Default();
+	emitter.Force.z = 24.0f;
+
+	FluidCPU fluid;
+	fluid.Init(gridSize2D);
+	fluid.SetEmitters(1, &emitter);
+	measure("  Simulation (2D)", [&]() { fluid.Simulate(1.0f / 800.0f); });
+
+	// Only the scalar curl out of the plane, with its magnitude for the confinement gradient
+	// (up to the tiny curls, of which the squares underflow in the length)
+	auto numMismatches = 0u;
+	const auto pVorticity = fluid.GetVorticity();
+	for (auto i = 0u; i < numCells; ++i)
+	{
+		const auto& w = pVorticity[i];
+		numMismatches += w.x != 0.0f || w.y != 0.0f || abs(w.w - abs(w.z)) > 1e-6f ? 1 : 0;
+	}
+	check(numMismatches == 0, "2D scalar curl");
+}
+
+void Benchmark::Turbulence(const XMUINT3& gridSize, uint32_t upsample)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+	const XMUINT3 hiResGridSize(gridSize.x * upsample, gridSize.y * upsample,
+		gridSize.z > 1 ? gridSize.z * upsample : 1);
+
+	m_os << "Wavelet turbulence: " << gridSize.x << "x" << gridSize.y << "x" << gridSize.z << " -> "
+		<< hiResGridSize.x << "x" << hiResGridSize.y << "x" << hiResGridSize.z << endl;
+
+	// Low-resolution simulation plus turbulence upsampling
+	FluidCPU fluid;
+	WaveletTurbulence turbulence;
+	fluid.Init(gridSize);
+	turbulence.Init(gridSize, upsample);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep); // Warm up with some density
+
+	auto time = 0.0f;
+	const auto simTime = measure("  Simulation (low-res)", [&]() { fluid.Simulate(timeStep); });
+	const auto upTime = measure("  Turbulence upsampling", [&]()
+	{
+		time += timeStep;
+		turbulence.Synthesize(fluid.GetVelocity(), fluid.GetColor(), time);
+	});
+
+	// Equivalent high-resolution simulation
+	FluidCPU fluidHiRes;
+	fluidHiRes.Init(hiResGridSize);
+	for (auto i = 0u; i < m_numSteps; ++i) fluidHiRes.Simulate(timeStep);
+	const auto hiResTime = measure("  Simulation (high-res)", [&]() { fluidHiRes.Simulate(timeStep); });
+
+	m_os << "  Speedup: " << setprecision(2) << fixed << hiResTime / (simTime + upTime) << "x" << endl;
+
+	// The noise tile at unit variance, with its energy in the top octave: the means over 4^3 blocks
+	// keep a quarter of the energy that they keep of white noise, whose share is 1/64
+	vector<XMFLOAT4> noise;
+	WaveletTurbulence::GenerateNoiseTile(noise);
+	const auto n = WaveletTurbulence::NoiseTileSize;
+	const XMUINT3 noiseSize(n, n, n);
+	const auto numTexels = n * n * n;
+	const auto blockSize = 4u;
+	auto isBandLimited = true;
+	for (uint8_t c = 0; c < 3; ++c)
+	{
+		auto energy = 0.0, coarseEnergy = 0.0;
+		for (const auto& texel : noise) energy += (&texel.x)[c] * (&texel.x)[c];
+		for (auto z = 0u; z < n; z += blockSize)
+			for (auto y = 0u; y < n; y += blockSize)
+				for (auto x = 0u; x < n; x += blockSize)
+				{
+					auto mean = 0.0;
+					for (auto k = 0u; k < blockSize * blockSize * blockSize; ++k)
+						mean += (&noise[VolumeSampler::Index(x + k % blockSize, y + k / blockSize % blockSize,
+							z + k / (blockSize * blockSize), noiseSize)].x)[c];
+					mean /= blockSize * blockSize * blockSize;
+					coarseEnergy += mean * mean;
+				}
+		const auto variance = energy / numTexels;
+		const auto coarseShare = coarseEnergy * blockSize * blockSize * blockSize / numTexels;
+		m_os << "    Noise channel " << static_cast<uint32_t>(c) << ": variance " << setprecision(4) << variance
+			<< ", energy share of the 4^3 means " << coarseShare << " (white noise " << 1.0 / 64.0 << ")" << endl;
+		isBandLimited = isBandLimited && abs(variance - 1.0) < 1e-3 && coarseShare < 0.5 / 64.0;
+	}
+	check(isBandLimited, "wavelet noise band energy");
+
+	// Without velocity, no displacement: the plain trilinear upsampling of the simulated color
+	const auto numCells = gridSize.x * gridSize.y * gridSize.z;
+	const auto numHiResCells = hiResGridSize.x * hiResGridSize.y * hiResGridSize.z;
+	const vector<XMFLOAT4> still(numCells, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	turbulence.Synthesize(still.data(), fluid.GetColor(), time);
+	vector<XMFLOAT4> upsampled(numHiResCells);
+	auto numIdentical = 0u;
+	for (auto z = 0u; z < hiResGridSize.z; ++z)
+		for (auto y = 0u; y < hiResGridSize.y; ++y)
+			for (auto x = 0u; x < hiResGridSize.x; ++x)
+			{
+				const auto i = VolumeSampler::Index(x, y, z, hiResGridSize);
+				const auto tex = XMVectorDivide(XMVectorSet(x + 0.5f, y + 0.5f, z + 0.5f, 0.0f),
+					XMVectorSet(static_cast<float>(hiResGridSize.x), static_cast<float>(hiResGridSize.y),
+					static_cast<float>(hiResGridSize.z), 1.0f));
+				XMStoreFloat4(&upsampled[i], VolumeSampler::SampleLinear(fluid.GetColor(), gridSize, tex, VolumeSampler::CLAMP));
+				numIdentical += memcmp(&upsampled[i], &turbulence.GetColor()[i], sizeof(XMFLOAT4)) ? 0 : 1;
+			}
+	check(numIdentical == numHiResCells, "still turbulence identical to trilinear upsampling");
+
+	// With the simulated velocity, detail added over the upsampling, while the density is only
+	// moved around: its total stays within a few percent
+	turbulence.Synthesize(fluid.GetVelocity(), fluid.GetColor(), time);
+	auto detailEnergy = 0.0, density = 0.0, upsampledDensity = 0.0;
+	for (auto i = 0u; i < numHiResCells; ++i)
+	{
+		const auto detail = turbulence.GetColor()[i].w - upsampled[i].w;
+		detailEnergy += detail * detail;
+		density += turbulence.GetColor()[i].w;
+		upsampledDensity += upsampled[i].w;
+	}
+	const auto densityError = abs(density - upsampledDensity) / max(upsampledDensity, 1e-6);
+	m_os << "    Detail RMS " << setprecision(4) << sqrt(detailEnergy / numHiResCells)
+		<< " in density, total density off by " << setprecision(2) << 100.0 * densityError << "%" << endl;
+	check(detailEnergy > 0.0 && densityError < 0.05, "turbulence detail and density bound");
+}
+
+void Benchmark::Particles(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+
+	m_os << "Particle update: " << numParticles << " particles in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	FluidCPU fluid;
+	ParticleCPU particles;
+	fluid.Init(gridSize);
+	particles.Init(numParticles);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep);
+
+	// Emit all at once, then sustain the capacity over the average lifetime
+	auto step = 0u;
+	particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, numParticles);
+	const auto budget = static_cast<uint32_t>(numParticles / (ParticleCPU::FullLife + 0.5f) * timeStep);
+	const auto time = measure("  Integration, compaction and emission", [&]()
+	{
+		particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, budget);
+	});
+
+	m_os << "  Alive: " << particles.GetNumAlive() << endl;
+	m_os << "  Throughput: " << setprecision(2) << fixed << particles.GetNumAlive() / (time * 1000.0) << " M particles/s" << endl;
+
+	// The same steps after sorting the particles by the Morton codes of their cells
+	measure("  Spatial reorder", [&]() { particles.Reorder(gridSize); });
+	const auto reorderedTime = measure("  Integration, compaction and emission after reorder", [&]()
+	{
+		particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, budget);
+	});
+	m_os << "  Throughput: " << setprecision(2) << fixed << particles.GetNumAlive() / (reorderedTime * 1000.0)
+		<< " M particles/s, " << time / reorderedTime << "x" << endl;
+}
+
+void Benchmark::Checkpoint(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+	const auto fileName = "Benchmark.fxpc";
+	const auto corruptFileName = "BenchmarkCorrupt.fxpc";
+
+	m_os << "Particle checkpoint: " << numParticles << " particles in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	FluidCPU fluid;
+	ParticleCPU particles;
+	fluid.Init(gridSize);
+	particles.Init(numParticles, 1);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep);
+
+	// Emit all at once, then sustain the capacity over the average lifetime, as in Particles
+	auto step = 0u;
+	const auto budget = static_cast<uint32_t>(numParticles / (ParticleCPU::FullLife + 0.5f) * timeStep);
+	particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, numParticles);
+	for (auto i = 0u; i < m_numSteps; ++i) particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, budget);
+
+	auto isSaved = true;
+	auto isLoaded = true;
+	ParticleCPU restored;
+	measure("  Save", [&]() { isSaved = particles.SaveCheckpoint(fileName) && isSaved; });
+	measure("  Load", [&]() { isLoaded = restored.LoadCheckpoint(fileName) && isLoaded; });
+	check(isSaved && isLoaded, "save and load");
+
+	// The restored particles must carry on exactly as the original ones
+	const auto matches = [&]()
+	{
+		const auto numAlive = particles.GetNumAlive();
+
+		return restored.GetNumAlive() == numAlive &&
+			!memcmp(restored.GetParticles(), particles.GetParticles(), sizeof(PackedParticle) * numParticles) &&
+			!memcmp(restored.GetAliveList(), particles.GetAliveList(), sizeof(uint32_t) * numAlive);
+	};
+	auto isMatched = matches();
+	for (auto i = 0u; i < m_numSteps; ++i, ++step)
+	{
+		particles.Update(fluid.GetVelocity(), gridSize, timeStep, step, budget);
+		restored.Update(fluid.GetVelocity(), gridSize, timeStep, step, budget);
+	}
+	check(isMatched && matches(), "round trip");
+
+	// A particle ID listed twice, and a truncated file, must both be rejected
+	vector<char> bytes;
+	{
+		ifstream file(fileName, ios::binary);
+		bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	}
+	const auto aliveListOffset = sizeof(uint32_t[6]) + sizeof(PackedParticle) * numParticles;
+	auto isRejected = bytes.size() >= aliveListOffset + sizeof(uint32_t[2]);
+	if (isRejected)
+	{
+		memcpy(&bytes[aliveListOffset + sizeof(uint32_t)], &bytes[aliveListOffset], sizeof(uint32_t));
+		ofstream(corruptFileName, ios::binary).write(bytes.data(), bytes.size());
+		isRejected = !restored.LoadCheckpoint(corruptFileName);
+		ofstream(corruptFileName, ios::binary).write(bytes.data(), bytes.size() / 2);
+		isRejected = !restored.LoadCheckpoint(corruptFileName) && isRejected;
+	}
+	check(isRejected && matches(), "malformed checkpoints rejected");
+
+	remove(fileName);
+	remove(corruptFileName);
+}
+
+void Benchmark::ParticlesSoA(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+	const char* kernelNames[] = { "Scalar", "AVX2", "AVX-512" };
+
+	m_os << "SoA particle update: " << numParticles << " particles in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	FluidCPU fluid;
+	fluid.Init(gridSize);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep);
+
+	// Emit all at once, then sustain the capacity over the average lifetime, as in Particles
+	const auto budget = static_cast<uint32_t>(numParticles / (ParticleCPU::FullLife + 0.5f) * timeStep);
+	const auto budgetAt = [&](uint32_t step) { return step > 0 ? budget : numParticles; };
+
+	// Scalar reference after the same steps, for checking the SIMD kernels
+	ParticleSoA reference;
+	reference.Init(numParticles);
+	reference.SetKernel(ParticleSoA::SCALAR);
+	for (auto i = 0u; i <= m_numSteps; ++i) reference.Update(fluid.GetVelocity(), gridSize, timeStep, i, budgetAt(i));
+
+	ParticleSoA particles;
+	const auto bestKernel = ParticleSoA::GetBestKernel();
+	for (uint8_t k = ParticleSoA::SCALAR; k <= bestKernel; ++k)
+	{
+		particles.Init(numParticles);
+		particles.SetKernel(static_cast<ParticleSoA::Kernel>(k));
+		particles.Update(fluid.GetVelocity(), gridSize, timeStep, 0, numParticles, false);
+
+		auto step = 1u;
+		const auto label = string("  ") + kernelNames[k] + " (single core)";
+		const auto time = measure(label.c_str(), [&]()
+		{
+			particles.Update(fluid.GetVelocity(), gridSize, timeStep, step, budgetAt(step), false);
+			++step;
+		});
+		m_os << "    " << setprecision(2) << fixed << particles.GetNumAlive() / (time * 1000.0) << " M particles/s" << endl;
+
+		// The kernels share the unfused operations, so that they must match the scalar reference exactly
+		const auto numAlive = particles.GetNumAlive();
+		auto isMatched = numAlive == reference.GetNumAlive();
+		for (uint8_t c = 0; c < ParticleSoA::NUM_COMPONENT && isMatched; ++c)
+			isMatched = memcmp(particles.GetComponent(static_cast<ParticleSoA::Component>(c)),
+				reference.GetComponent(static_cast<ParticleSoA::Component>(c)), sizeof(float) * numAlive) == 0;
+		check(isMatched, (string(kernelNames[k]) + " vs. scalar reference").c_str());
+	}
+
+	auto step = m_numSteps + 1;
+	particles.SetKernel(bestKernel);
+	const auto time = measure("  All cores", [&]()
+	{
+		particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, budget);
+	});
+	m_os << "    " << setprecision(2) << fixed << particles.GetNumAlive() / (time * 1000.0) << " M particles/s" << endl;
+
+	// The batches are packed in order, so that the thread layout does not change the results
+	ParticleSoA serial;
+	serial.Init(numParticles);
+	serial.SetKernel(bestKernel);
+	for (auto i = 0u; i <= m_numSteps; ++i) serial.Update(fluid.GetVelocity(), gridSize, timeStep, i, budgetAt(i), false);
+	particles.Init(numParticles);
+	for (auto i = 0u; i <= m_numSteps; ++i) particles.Update(fluid.GetVelocity(), gridSize, timeStep, i, budgetAt(i));
+	auto isMatched = particles.GetNumAlive() == serial.GetNumAlive();
+	for (uint8_t c = 0; c < ParticleSoA::NUM_COMPONENT && isMatched; ++c)
+		isMatched = memcmp(particles.GetComponent(static_cast<ParticleSoA::Component>(c)),
+			serial.GetComponent(static_cast<ParticleSoA::Component>(c)), sizeof(float) * serial.GetNumAlive()) == 0;
+	check(isMatched, "all cores vs. single core");
+
+	// The packed export, within the quantization of the positions, with the remaining slots dead
+	vector<PackedParticle> packed(numParticles);
+	particles.Export(packed.data());
+	auto numMismatches = 0u;
+	for (auto i = 0u; i < numParticles; ++i)
+	{
+		const auto particle = UnpackParticle(packed[i]);
+		if (i >= particles.GetNumAlive())
+		{
+			numMismatches += particle.LifeTime > 0.0f ? 1 : 0;
+			continue;
+		}
+
+		const float pos[] = { particle.Pos.x, particle.Pos.y, particle.Pos.z };
+		auto isMatched = particle.LifeTime > 0.0f;
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			const auto ref = min(max(particles.GetComponent(static_cast<ParticleSoA::Component>(ParticleSoA::POS_X + c))[i], 0.0f), 1.0f);
+			isMatched = isMatched && abs(pos[c] - ref) <= 1.0f / 2097151.0f;
+		}
+		numMismatches += isMatched ? 0 : 1;
+	}
+	check(numMismatches == 0, "packed export");
+}
+
+void Benchmark::Random(uint32_t numBlocks)
+{
+	m_os << "Philox4x32-10: " << numBlocks << " blocks" << endl;
+
+	// Known-answer vectors of the Random123 reference implementation
+	const XMUINT4 counters[] =
+	{
+		XMUINT4(0, 0, 0, 0),
+		XMUINT4(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff),
+		XMUINT4(0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344)
+	};
+	const XMUINT2 keys[] = { XMUINT2(0, 0), XMUINT2(0xffffffff, 0xffffffff), XMUINT2(0xa4093822, 0x299f31d0) };
+	const XMUINT4 answers[] =
+	{
+		XMUINT4(0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8),
+		XMUINT4(0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd),
+		XMUINT4(0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1)
+	};
+	auto numMismatches = 0u;
+	for (uint8_t i = 0; i < size(answers); ++i)
+	{
+		const auto result = Philox::Generate(counters[i], keys[i]);
+		numMismatches += memcmp(&result, &answers[i], sizeof(XMUINT4)) ? 1 : 0;
+	}
+	check(numMismatches == 0, "known answers");
+
+	const XMUINT2 key(0, 0);
+	vector<XMUINT4> results(numBlocks);
+	const auto scalarTime = measure("  Scalar", [&]()
+	{
+		for (auto i = 0u; i < numBlocks; ++i)
+			results[i] = Philox::Generate(XMUINT4(i, 0, 0, Philox::EMISSION), key);
+	});
+	m_os << "    " << setprecision(2) << fixed << numBlocks / (scalarTime * 1000.0) << " M blocks/s" << endl;
+
+	if (ParticleSoA::GetBestKernel() < ParticleSoA::AVX2) return;
+
+	// Batches of 8, kept for checking against the scalar blocks after the timing
+	const auto numBatches = numBlocks / 8;
+	vector<uint32_t> batches(numBatches * 32);
+	const auto time = measure("  AVX2", [&]()
+	{
+		for (auto i = 0u; i < numBatches; ++i)
+			Philox::GenerateAVX2(reinterpret_cast<uint32_t(*)[8]>(&batches[i * 32]), i * 8, 0, 0, Philox::EMISSION, key);
+	});
+	m_os << "    " << setprecision(2) << fixed << numBlocks / (time * 1000.0) << " M blocks/s" << endl;
+
+	numMismatches = 0;
+	for (auto i = 0u; i < numBatches * 8; ++i)
+	{
+		const auto pBatch = &batches[i / 8 * 32 + i % 8];
+		const auto& result = results[i];
+		numMismatches += pBatch[0] != result.x || pBatch[8] != result.y || pBatch[16] != result.z || pBatch[24] != result.w ? 1 : 0;
+	}
+	check(numMismatches == 0, "AVX2 vs. scalar");
+}
+
+void Benchmark::ParticleQuads(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+
+	m_os << "Particle quads: " << numParticles << " particles" << endl;
+
+	FluidCPU fluid;
+	ParticleCPU particles;
+	fluid.Init(gridSize);
+	particles.Init(numParticles);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep);
+	particles.Update(fluid.GetVelocity(), gridSize, timeStep, 0, numParticles);
+
+	// Perspective camera looking at the scaled simulation cube
+	const auto world = XMMatrixScaling(10.0f, 10.0f, 10.0f);
+	const auto view = XMMatrixLookAtLH(XMVectorSet(0.0f, 4.0f, -32.0f, 1.0f), XMVectorZero(),
+		XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	const auto proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 1.0f, 1000.0f);
+	const auto worldView = XMMatrixMultiply(world, view);
+
+	const auto numAlive = particles.GetNumAlive();
+	const auto pParticles = particles.GetParticles();
+	const auto pAliveList = particles.GetAliveList();
+	vector<XMFLOAT4> corners(static_cast<size_t>(numAlive) * 4);
+	vector<XMFLOAT2> texcoords(corners.size());
+	const auto time = measure("  Quad expansion", [&]()
+	{
+		concurrency::parallel_for(0u, numAlive, [&](uint32_t i)
+		{
+			const auto particle = UnpackParticle(pParticles[pAliveList[i]]);
+			ParticleCPU::ExpandQuad(&corners[i * 4], &texcoords[i * 4], particle, timeStep * 0.5f, worldView, proj);
+		});
+	});
+
+	// The former tessellated patch (integer partitioning of 4 per edge) offset the view-space particle
+	// position by the domain point; its 25 points must lie on the bilinear surface of the strip corners,
+	// with the texture coordinates at the domain corners and both strip triangles facing the same way
+	auto maxError = 0.0f;
+	auto numMismatches = 0u;
+	for (auto i = 0u; i < numAlive; ++i)
+	{
+		const auto particle = UnpackParticle(pParticles[pAliveList[i]]);
+		auto pos = XMVectorAdd(XMLoadFloat3(&particle.Pos), XMVectorScale(XMLoadFloat3(&particle.Velocity), timeStep * 0.5f));
+		pos = XMVectorSubtract(XMVectorScale(pos, 2.0f), XMVectorReplicate(1.0f));
+		pos = XMVector4Transform(XMVectorSet(XMVectorGetX(pos), -XMVectorGetY(pos), XMVectorGetZ(pos), 1.0f), worldView);
+
+		const auto pCorners = &corners[i * 4];
+		const auto pTexcoords = &texcoords[i * 4];
+		for (uint8_t j = 0; j <= 4; ++j)
+		{
+			for (uint8_t k = 0; k <= 4; ++k)
+			{
+				const auto u = k / 4.0f;
+				const auto v = j / 4.0f;
+				const auto offset = XMVectorSet((u * 2.0f - 1.0f) * ParticleCPU::ParticleRadius,
+					(1.0f - v * 2.0f) * ParticleCPU::ParticleRadius, 0.0f, 0.0f);
+				const auto point = XMVector4Transform(XMVectorSetW(XMVectorAdd(pos, offset), 1.0f), proj);
+				const auto surface = XMVectorLerp(XMVectorLerp(XMLoadFloat4(&pCorners[0]), XMLoadFloat4(&pCorners[1]), u),
+					XMVectorLerp(XMLoadFloat4(&pCorners[2]), XMLoadFloat4(&pCorners[3]), u), v);
+				const auto error = XMVectorGetX(XMVector4Length(XMVectorSubtract(surface, point))) / XMVectorGetW(point);
+				maxError = max(maxError, error);
+			}
+		}
+
+		XMFLOAT2 ndc[4];
+		for (uint8_t j = 0; j < 4; ++j)
+		{
+			ndc[j] = XMFLOAT2(pCorners[j].x / pCorners[j].w, pCorners[j].y / pCorners[j].w);
+			numMismatches += pTexcoords[j].x != (j & 1) || pTexcoords[j].y != (j >> 1) ? 1 : 0;
+		}
+		const auto area = [&](uint8_t a, uint8_t b, uint8_t c)
+		{
+			return (ndc[b].x - ndc[a].x) * (ndc[c].y - ndc[a].y) - (ndc[b].y - ndc[a].y) * (ndc[c].x - ndc[a].x);
+		};
+		const auto area0 = area(0, 1, 2);
+		const auto area1 = area(1, 3, 2);	// Reversed as the odd triangles of a strip are
+		numMismatches += area0 * area1 > 0.0f ? 0 : 1;
+	}
+
+	m_os << "  " << setprecision(2) << fixed << numAlive / (time * 1000.0) << " M quads/s, "
+		<< numAlive * 4 << " vertices (" << numAlive * 25 << " domain points tessellated formerly)" << endl;
+	check(maxError < 1e-5f, "tessellated patch on the quads");
+	check(numMismatches == 0, "strip texture coordinates and winding");
+}
+
+void Benchmark::Normals(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+	const auto is3D = gridSize.z > 1;
+
+	m_os << "Particle shading normals: " << numParticles << " particles in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	FluidCPU fluid;
+	ParticleCPU particles;
+	fluid.Init(gridSize);
+	particles.Init(numParticles);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep);
+	particles.Update(fluid.GetVelocity(), gridSize, timeStep, 0, numParticles);
+
+	const auto numAlive = particles.GetNumAlive();
+	const auto pParticles = particles.GetParticles();
+	const auto pAliveList = particles.GetAliveList();
+	const auto pColor = fluid.GetColor();
+	vector<XMFLOAT3> directNormals(numAlive), volumeNormals(numAlive);
+	vector<float> magnitudes(numAlive);
+
+	// Six half-texel taps of the color per particle, as the former DSParticle::GetNormal did
+	const XMFLOAT3 halfTexel(0.5f / gridSize.x, 0.5f / gridSize.y, 0.5f / gridSize.z);
+	const auto directTime = measure("  Six-tap gradient per particle", [&]()
+	{
+		concurrency::parallel_for(0u, numAlive, [&](uint32_t i)
+		{
+			const auto tex = XMLoadFloat3(&UnpackParticle(pParticles[pAliveList[i]]).Pos);
+			const auto sample = [&](float x, float y, float z)
+			{
+				const auto offset = XMVectorSet(x, y, z, 0.0f);
+				return XMVectorGetW(VolumeSampler::SampleLinear(pColor, gridSize, XMVectorAdd(tex, offset), VolumeSampler::CLAMP));
+			};
+
+			const auto rhoL = sample(-halfTexel.x, 0.0f, 0.0f);
+			const auto rhoR = sample(halfTexel.x, 0.0f, 0.0f);
+			const auto rhoU = sample(0.0f, -halfTexel.y, 0.0f);
+			const auto rhoD = sample(0.0f, halfTexel.y, 0.0f);
+			const auto rhoF = sample(0.0f, 0.0f, -halfTexel.z);
+			const auto rhoB = sample(0.0f, 0.0f, halfTexel.z);
+			const auto gradient = XMVectorSet(rhoR - rhoL, rhoD - rhoU, is3D ? rhoB - rhoF : -1.0f, 0.0f);
+			magnitudes[i] = XMVectorGetX(XMVector3Length(XMVectorSetZ(gradient, is3D ? rhoB - rhoF : 0.0f)));
+			XMStoreFloat3(&directNormals[i], XMVector3Normalize(XMVectorNegate(gradient)));
+		});
+	});
+
+	// One pass over the rendered volume per frame, then one tap per particle
+	const auto volumeTime = measure("  Normal volume per frame", [&]() { fluid.ComputeNormals(); });
+	const auto lookupTime = measure("  One-tap normal per particle", [&]()
+	{
+		concurrency::parallel_for(0u, numAlive, [&](uint32_t i)
+		{
+			const auto tex = XMLoadFloat3(&UnpackParticle(pParticles[pAliveList[i]]).Pos);
+			const auto normal = VolumeSampler::SampleLinear(fluid.GetNormals(), gridSize, tex, VolumeSampler::CLAMP);
+			XMStoreFloat3(&volumeNormals[i], XMVector3Normalize(normal));
+		});
+	});
+
+	// Unquantized normals from central differences of trilinear taps one texel apart, clamped at
+	// the boundaries as the volume is, so only the SNORM packing parts them from the volume
+	const XMFLOAT3 texel(1.0f / gridSize.x, 1.0f / gridSize.y, 1.0f / gridSize.z);
+	vector<XMFLOAT4> referenceNormals(static_cast<size_t>(gridSize.x) * gridSize.y * gridSize.z);
+	auto maxTexelDeviation = 0.0;
+	auto numTexels = 0u;
+	for (auto z = 0u; z < gridSize.z; ++z)
+		for (auto y = 0u; y < gridSize.y; ++y)
+			for (auto x = 0u; x < gridSize.x; ++x)
+			{
+				const auto tex = XMVectorSet((x + 0.5f) * texel.x, (y + 0.5f) * texel.y, (z + 0.5f) * texel.z, 0.0f);
+				const auto sample = [&](float dx, float dy, float dz)
+				{
+					const auto offset = XMVectorSet(dx, dy, dz, 0.0f);
+					return XMVectorGetW(VolumeSampler::SampleLinear(pColor, gridSize, XMVectorAdd(tex, offset), VolumeSampler::CLAMP));
+				};
+
+				const auto gradient = XMVectorScale(XMVectorSet(sample(texel.x, 0.0f, 0.0f) - sample(-texel.x, 0.0f, 0.0f),
+					sample(0.0f, texel.y, 0.0f) - sample(0.0f, -texel.y, 0.0f),
+					is3D ? sample(0.0f, 0.0f, texel.z) - sample(0.0f, 0.0f, -texel.z) : 0.0f, 0.0f), 0.5f);
+				const auto magnitude = XMVectorGetX(XMVector3Length(gradient));
+				const auto normal = XMVectorNegate(is3D ? gradient : XMVectorSetZ(gradient, -1.0f));
+				const auto reference = XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f ? XMVector3Normalize(normal) : XMVectorZero();
+				const auto i = VolumeSampler::Index(x, y, z, gridSize);
+				XMStoreFloat4(&referenceNormals[i], XMVectorSetW(reference, min(magnitude, 1.0f)));
+				if (!(magnitude >= 1.0f / 127.0f)) continue;
+
+				const auto packed = XMVector3Normalize(PackedVector::XMLoadByteN4(&fluid.GetNormals()[i]));
+				const auto cosAngle = min(XMVectorGetX(XMVector3Dot(reference, packed)), 1.0f);
+				maxTexelDeviation = max<double>(maxTexelDeviation, XMConvertToDegrees(acos(cosAngle)));
+				++numTexels;
+			}
+
+	// Angular deviation per particle where the gradient is above the 8-bit SNORM step, since the
+	// directions of vanishing gradients are noise either way; against the six-tap gradient it is
+	// only reported, as half-texel differences resolve finer detail than the volume can hold
+	vector<double> deviations;
+	deviations.reserve(numAlive);
+	auto sumDirectDeviation = 0.0;
+	for (auto i = 0u; i < numAlive; ++i)
+	{
+		if (!(magnitudes[i] >= 1.0f / 127.0f) || isnan(volumeNormals[i].x)) continue;
+		const auto tex = XMLoadFloat3(&UnpackParticle(pParticles[pAliveList[i]]).Pos);
+		const auto reference = XMVector3Normalize(VolumeSampler::SampleLinear(referenceNormals.data(),
+			gridSize, tex, VolumeSampler::CLAMP));
+		if (XMVector3IsNaN(reference)) continue;
+
+		const auto packed = XMLoadFloat3(&volumeNormals[i]);
+		const auto cosAngle = min(XMVectorGetX(XMVector3Dot(reference, packed)), 1.0f);
+		const auto cosDirect = min(XMVectorGetX(XMVector3Dot(XMLoadFloat3(&directNormals[i]), packed)), 1.0f);
+		deviations.push_back(XMConvertToDegrees(acos(cosAngle)));
+		sumDirectDeviation += XMConvertToDegrees(acos(cosDirect));
+	}
+	const auto numCompared = static_cast<uint32_t>(deviations.size());
+	auto meanDeviation = 0.0;
+	for (const auto& deviation : deviations) meanDeviation += deviation;
+	meanDeviation /= max(numCompared, 1u);
+	sort(deviations.begin(), deviations.end());
+	const auto percentileDeviation = numCompared > 0 ? deviations[numCompared * 99 / 100] : 0.0;
+
+	m_os << "  Speedup: " << setprecision(2) << fixed << directTime / (volumeTime + lookupTime) << "x" << endl;
+	m_os << "  Deviation over " << numTexels << " texels: max " << maxTexelDeviation << " degrees" << endl;
+	m_os << "  Deviation over " << numCompared << " particles: mean " << meanDeviation << ", 99th percentile "
+		<< percentileDeviation << ", max " << (numCompared > 0 ? deviations.back() : 0.0) << " degrees (six-tap mean "
+		<< sumDirectDeviation / max(numCompared, 1u) << ")" << endl;
+	check(numTexels > 0 && maxTexelDeviation < 1.0, "packed normals per texel");
+
+	// Single particles may sit where the interpolated normals cancel, so the bulk of the
+	// distribution is bounded rather than its maximum
+	check(numCompared > 0 && meanDeviation < 0.5 && percentileDeviation < 1.0, "normal deviation");
+}
+
+void Benchmark::ParticleCulling(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+
+	m_os << "Particle culling and LOD: " << numParticles << " particles" << endl;
+
+	FluidCPU fluid;
+	ParticleCPU particles;
+	fluid.Init(gridSize);
+	particles.Init(numParticles);
+	for (auto i = 0u; i < m_numSteps; ++i) fluid.Simulate(timeStep);
+	particles.Update(fluid.GetVelocity(), gridSize, timeStep, 0, numParticles);
+	const auto numAlive = particles.GetNumAlive();
+
+	// Camera path orbiting the scaled simulation cube, from inside the cube to far away,
+	// with the LOD distance of a 2-pixel radius at 720p
+	const auto world = XMMatrixScaling(10.0f, 10.0f, 10.0f);
+	const auto proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 1.0f, 1000.0f);
+	const auto lodDistance = ParticleCPU::ParticleRadius * XMVectorGetY(proj.r[1]) * 0.5f * 720.0f / 2.0f;
+	const float distances[] = { 4.0f, 16.0f, 32.0f, 128.0f, 256.0f, 512.0f };
+	auto numMismatches = 0u;
+	for (auto i = 0u; i < size(distances); ++i)
+	{
+		const auto angle = XM_2PI * i / size(distances);
+		const auto eyePt = XMVectorSet(sin(angle) * distances[i], 4.0f, -cos(angle) * distances[i], 1.0f);
+		const auto view = XMMatrixLookAtLH(eyePt, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		const auto worldView = XMMatrixMultiply(world, view);
+
+		// Frustum culling only, as the reference of the covered area
+		const auto numInFrustum = particles.Cull(0.0f, worldView, proj, FLT_MAX);
+
+		auto numVisible = 0u;
+		const auto label = "  Distance " + to_string(static_cast<uint32_t>(distances[i]));
+		const auto time = measure(label.c_str(), [&]()
+		{
+			numVisible = particles.Cull(0.0f, worldView, proj, lodDistance);
+		});
+
+		// The enlarged survivors should cover the area of the thinned ones
+		auto coverage = 0.0, coverageSq = 0.0;
+		const auto pVisibleList = particles.GetVisibleList();
+		for (auto j = 0u; j < numVisible; ++j)
+		{
+			const auto area = static_cast<double>(pVisibleList[j].RadiusScale) * pVisibleList[j].RadiusScale;
+			coverage += area;
+			coverageSq += area * area;
+		}
+
+		const auto n = max(numInFrustum, 1u);
+		const auto ratio = coverage / n;
+		m_os << "    " << numVisible << " of " << numAlive << " drawn (" << numInFrustum << " in the frustum), "
+			<< setprecision(2) << fixed << numAlive / (time * 1000.0) << " M particles/s, area ratio "
+			<< ratio << endl;
+
+		// Each particle in the frustum contributes its enlarged area if kept, so that the ratio is a mean
+		// of which the expectation is 1; allow for 4 standard errors of the thinning
+		const auto standardError = sqrt(max(coverageSq / n - ratio * ratio, 0.0) / n);
+		numMismatches += numInFrustum > 0 && abs(ratio - 1.0) > max(4.0 * standardError, 1e-3) ? 1 : 0;
+	}
+	check(numMismatches == 0, "area ratio");
+}
+
+void Benchmark::HybridSolver(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto timeStep = gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
+	const auto numCells = gridSize.x * gridSize.y * gridSize.z;
+	const auto numSteps = m_numSteps * 8;
+	const float flipRatios[] = { -1.0f, 0.0f, 0.95f };
+	const char* modeNames[] = { "Passive tracers", "PIC", "FLIP 0.95" };
+
+	m_os << "Hybrid solver: " << numParticles << " particles in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	const auto kineticEnergy = [&](const FluidCPU& fluid)
+	{
+		const auto pVelocity = fluid.GetVelocity();
+		auto energy = 0.0;
+		for (auto i = 0u; i < numCells; ++i)
+			energy += pVelocity[i].x * pVelocity[i].x + pVelocity[i].y * pVelocity[i].y + pVelocity[i].z * pVelocity[i].z;
+
+		return 0.5 * energy / numCells;
+	};
+
+	const auto budget = static_cast<uint32_t>(numParticles / (ParticleCPU::FullLife + 0.5f) * timeStep);
+	for (uint8_t m = 0; m < size(flipRatios); ++m)
+	{
+		const auto isHybrid = flipRatios[m] >= 0.0f;
+		m_os << "  " << modeNames[m] << endl;
+
+		FluidCPU fluid;
+		ParticleCPU particles;
+		fluid.Init(gridSize);
+		particles.Init(numParticles);
+
+		auto step = 0u;
+		const auto advance = [&](uint32_t numEmitted)
+		{
+			if (isHybrid) fluid.TransferToGrid(particles.GetParticles(), particles.GetAliveList(), particles.GetNumAlive());
+			fluid.Simulate(timeStep);
+			particles.Update(fluid.GetVelocity(), gridSize, timeStep, step++, numEmitted,
+				isHybrid ? fluid.GetGridVelocity() : nullptr, max(flipRatios[m], 0.0f));
+		};
+
+		// Drive the flow with the emitters, emitting all at once first
+		advance(numParticles);
+		for (auto i = 1u + m_numSteps; i < numSteps; ++i) advance(budget);
+		measure("    Simulation and particle step", [&]() { advance(budget); });
+
+		if (isHybrid)
+		{
+			const auto time = measure("    Particle-to-grid transfer", [&]()
+			{
+				fluid.TransferToGrid(particles.GetParticles(), particles.GetAliveList(), particles.GetNumAlive());
+			});
+			m_os << "    Throughput: " << setprecision(2) << fixed << particles.GetNumAlive() / (time * 1000.0)
+				<< " M particles/s" << endl;
+
+			// The fixed-point sums are independent of the order of the particles, so the transfer
+			// on a single core must match the one on all cores bit for bit
+			const vector<XMFLOAT4> transfer(fluid.GetTransfer(), fluid.GetTransfer() + numCells);
+			fluid.TransferToGrid(particles.GetParticles(), particles.GetAliveList(), particles.GetNumAlive(), false);
+			check(!memcmp(transfer.data(), fluid.GetTransfer(), sizeof(XMFLOAT4) * numCells),
+				(string(modeNames[m]) + " transfer on all cores vs. single core").c_str());
+		}
+
+		// Then let it decay freely, reporting the kinetic energy on the grid at the quarters
+		fluid.SetEmitters(0, nullptr);
+		particles.SetEmitters(0, nullptr);
+		m_os << "    Kinetic energy over " << numSteps << " steps without emission: " << setprecision(3) << scientific
+			<< kineticEnergy(fluid);
+		for (auto i = 0u; i < numSteps; ++i)
+		{
+			advance(0);
+			if ((i + 1) % (numSteps / 4) == 0) m_os << " -> " << kineticEnergy(fluid);
+		}
+		m_os << endl;
+	}
+}
+
+void Benchmark::ParticleIntegration(const XMUINT3& gridSize, uint32_t numParticles)
+{
+	const auto duration = 1.0f;
+	const auto angularSpeed = XM_PI;
+	const uint32_t stepRates[] = { 240, 120, 60, 30 };
+	const char* integratorNames[] = { "Euler", "RK2", "RK3" };
+
+	m_os << "Particle integration: " << numParticles << " particles over half a turn of a vortex in "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	// Solid-body rotation around the z axis through the center, which the trilinear interpolation
+	// reproduces exactly, so that the errors are of the integration alone
+	vector<XMFLOAT4> velocity(gridSize.x * gridSize.y * gridSize.z);
+	for (auto z = 0u; z < gridSize.z; ++z)
+		for (auto y = 0u; y < gridSize.y; ++y)
+			for (auto x = 0u; x < gridSize.x; ++x)
+				velocity[VolumeSampler::Index(x, y, z, gridSize)] = XMFLOAT4(-angularSpeed * ((y + 0.5f) / gridSize.y - 0.5f),
+					angularSpeed * ((x + 0.5f) / gridSize.x - 0.5f), 0.0f, 0.0f);
+
+	auto emitter = Emitter::Default();
+	emitter.Pos = XMFLOAT3(0.5f, 0.75f, 0.5f);
+	emitter.Radius = 0.1f;
+
+	vector<XMFLOAT3> starts(numParticles);
+	double errors[ParticleCPU::NUM_INTEGRATOR][size(stepRates)];
+	for (uint8_t i = 0; i < ParticleCPU::NUM_INTEGRATOR; ++i)
+	{
+		for (uint8_t k = 0; k < size(stepRates); ++k)
+		{
+			const auto stepRate = stepRates[k];
+			ParticleCPU particles;
+			particles.Init(numParticles);
+			particles.SetEmitters(1, &emitter);
+			particles.SetIntegrator(static_cast<ParticleCPU::Integrator>(i));
+
+			// Emit all at once, and keep the starting positions by the particle IDs
+			const auto timeStep = duration / stepRate;
+			particles.Update(velocity.data(), gridSize, timeStep, 0, numParticles);
+			for (auto j = 0u; j < particles.GetNumAlive(); ++j)
+			{
+				const auto particleId = particles.GetAliveList()[j];
+				starts[particleId] = UnpackParticle(particles.GetParticles()[particleId]).Pos;
+			}
+
+			const auto start = chrono::high_resolution_clock::now();
+			for (auto j = 1u; j <= stepRate; ++j) particles.Update(velocity.data(), gridSize, timeStep, j, 0);
+			const auto end = chrono::high_resolution_clock::now();
+			const auto ms = chrono::duration<double, milli>(end - start).count();
+
+			// Distances in cells to the exact positions after the rotation
+			const auto angle = angularSpeed * duration;
+			const auto numAlive = particles.GetNumAlive();
+			auto error = 0.0;
+			for (auto j = 0u; j < numAlive; ++j)
+			{
+				const auto particleId = particles.GetAliveList()[j];
+				const auto pos = UnpackParticle(particles.GetParticles()[particleId]).Pos;
+				const auto x = starts[particleId].x - 0.5f;
+				const auto y = starts[particleId].y - 0.5f;
+				const auto dx = (pos.x - 0.5f - (x * cos(angle) - y * sin(angle))) * gridSize.x;
+				const auto dy = (pos.y - 0.5f - (x * sin(angle) + y * cos(angle))) * gridSize.y;
+				error += sqrt(dx * dx + dy * dy);
+			}
+
+			m_os << "  " << integratorNames[i] << ", 1/" << stepRate << " s: " << setprecision(3) << fixed
+				<< ms / stepRate << " ms/step, " << ms / duration << " ms per simulated second, mean error "
+				<< setprecision(4) << error / max(numAlive, 1u) << " cells" << endl;
+			errors[i][k] = error / max(numAlive, 1u);
+		}
+	}
+
+	// The Runge-Kutta integrators must beat Euler at every step rate, and every integrator must
+	// converge from the coarsest to the finest steps
+	auto isBelowEuler = true;
+	auto isConverging = true;
+	for (uint8_t i = 0; i < ParticleCPU::NUM_INTEGRATOR; ++i)
+	{
+		for (uint8_t k = 0; k < size(stepRates); ++k)
+			isBelowEuler = isBelowEuler && (i == ParticleCPU::EULER || errors[i][k] < errors[ParticleCPU::EULER][k]);
+		isConverging = isConverging && errors[i][0] < errors[i][size(stepRates) - 1];
+	}
+	check(isBelowEuler, "Runge-Kutta errors below Euler");
+	check(isConverging, "errors decreasing with the step rate");
+}
+
+void Benchmark::RayCasting(const XMUINT3& gridSize, uint32_t width, uint32_t height)
+{
+	if (gridSize.z <= 1) return;
+
+	m_os << "Ray casting: " << width << "x" << height << " of " << gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	// The plume after a few seconds of emission, seen from the default camera
+	FluidCPU fluid;
+	fluid.Init(gridSize);
+	for (auto i = 0u; i < m_numSteps * 32; ++i) fluid.Simulate(1.0f / 60.0f);
+	const auto pColor = fluid.GetColor();
+
+	const XMFLOAT3 eyePt(4.0f, 16.0f, -40.0f);
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMLoadFloat3(&eyePt), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(XM_PIDIV4, static_cast<float>(width) / height, 1.0f, 1000.0f));
+
+	// Scalar rays throughout, with the packets timed in RayPackets
+	RayCasterCPU rayCaster;
+	rayCaster.Init(width, height);
+	rayCaster.SetKernel(RayCasterCPU::SCALAR);
+	rayCaster.UpdateFrame(view, proj, eyePt);
+	measure("  Occupancy update", [&]() { rayCaster.UpdateOccupancy(pColor, gridSize); });
+
+	const auto& occupancySize = rayCaster.GetOccupancySize();
+	const auto numMacroCells = occupancySize.x * occupancySize.y * occupancySize.z;
+	auto numOccupied = 0u;
+	for (auto i = 0u; i < numMacroCells; ++i) numOccupied += rayCaster.GetOccupancy()[i] * 24.0f > 0.01f ? 1 : 0;
+	m_os << "    " << numOccupied << " of " << numMacroCells << " macro-cells occupied" << endl;
+
+	// Full marching as the reference, then with the empty macro-cells skipped
+	const auto numPixels = width * height;
+	const auto fullTime = measure("  Full marching", [&]() { rayCaster.Render(pColor, gridSize, false); });
+	const auto numFullSamples = rayCaster.GetNumSamples();
+	const vector<XMFLOAT4> reference(rayCaster.GetImage(), rayCaster.GetImage() + numPixels);
+
+	const auto skipTime = measure("  Empty-space skipping", [&]() { rayCaster.Render(pColor, gridSize, true); });
+	auto numIdentical = 0u;
+	for (auto i = 0u; i < numPixels; ++i)
+		numIdentical += memcmp(&reference[i], &rayCaster.GetImage()[i], sizeof(XMFLOAT4)) ? 0 : 1;
+
+	m_os << "    Speedup " << setprecision(2) << fixed << fullTime / skipTime << "x, view-ray samples per pixel "
+		<< static_cast<double>(numFullSamples) / numPixels << " -> " << static_cast<double>(rayCaster.GetNumSamples()) / numPixels
+		<< ", " << numIdentical << " of " << numPixels << " pixels identical" << endl;
+
+	// The skipping is checked on this CPU reference only; PSRayCast skips by the same threshold of
+	// Occupancy.hlsli over the same maximum densities, kept in full precision on the GPU as well
+	check(numIdentical == numPixels, "empty-space skipping identical to full marching");
+
+	// Light transmittance swept once per step in place of the light rays of every sample
+	const auto numCells = gridSize.x * gridSize.y * gridSize.z;
+	measure("  Light sweep", [&]() { rayCaster.UpdateLightTrans(pColor, gridSize, false); });
+	const auto sweepTime = measure("  Ray casting with swept light", [&]() { rayCaster.Render(pColor, gridSize, true, true); });
+
+	auto meanError = 0.0, maxError = 0.0;
+	for (auto i = 0u; i < numPixels; ++i)
+	{
+		const auto& a = reference[i];
+		const auto& b = rayCaster.GetImage()[i];
+		const auto error = max(max(abs(a.x - b.x), abs(a.y - b.y)), max(abs(a.z - b.z), abs(a.w - b.w)));
+		meanError += error;
+		maxError = max<double>(maxError, error);
+	}
+	m_os << "    Speedup " << setprecision(2) << fixed << skipTime / sweepTime << "x over marching the light rays, "
+		<< "pixel error mean " << setprecision(4) << meanError / numPixels << ", max " << maxError << endl;
+	// The sweep diffuses the light over the bilinear footprints, so single pixels at the sharp
+	// shadow edges may stray further than the mean
+	check(meanError / numPixels < 1e-3 && maxError < 0.25, "swept light error bound");
+
+	// Rays cast only over the pixels covered by the bound of the occupied macro-cells, and sampled within it;
+	// the rays missing it carry no opacity, so the premultiplied colors are compared
+	const vector<XMFLOAT4> swept(rayCaster.GetImage(), rayCaster.GetImage() + numPixels);
+	const auto boundTime = measure("  Bounded ray casting", [&]() { rayCaster.Render(pColor, gridSize, true, true, true); });
+	const auto& rect = rayCaster.GetBoundRect();
+	numIdentical = 0;
+	for (auto i = 0u; i < numPixels; ++i)
+	{
+		const auto& a = swept[i];
+		const auto& b = rayCaster.GetImage()[i];
+		numIdentical += a.w == b.w && a.x * a.w == b.x * b.w && a.y * a.w == b.y * b.w && a.z * a.w == b.z * b.w ? 1 : 0;
+	}
+	m_os << "    Speedup " << setprecision(2) << sweepTime / boundTime << "x, " << setprecision(1)
+		<< 100.0 * (rect.z - rect.x) * (rect.w - rect.y) / numPixels << "% of pixels covered, "
+		<< numIdentical << " of " << numPixels << " pixels identical" << endl;
+	check(numIdentical == numPixels, "bounded ray casting identical");
+
+	// Adaptive sampling over the mip chain, against the fixed steps at the same render scale;
+	// the footprint reaches the coarser levels at the reduced scale
+	measure("  Mip update", [&]() { rayCaster.UpdateMips(pColor, gridSize); });
+	auto isAdaptiveBounded = true;
+	for (const auto renderScale : { 1.0f, 0.5f })
+	{
+		rayCaster.UpdateFrame(view, proj, eyePt, renderScale);
+		const auto& renderSize = rayCaster.GetRenderSize();
+		const auto numRenderPixels = renderSize.x * renderSize.y;
+		m_os << "  Adaptive sampling at scale " << setprecision(2) << renderScale << endl;
+		const auto fixedTime = measure("    Fixed steps", [&]() { rayCaster.Render(pColor, gridSize, true, true, true); });
+		const auto numFixedSamples = rayCaster.GetNumSamples();
+		const vector<XMFLOAT4> fixedImage(rayCaster.GetImage(), rayCaster.GetImage() + numRenderPixels);
+
+		const auto adaptiveTime = measure("    Adaptive steps", [&]() { rayCaster.Render(pColor, gridSize, true, true, true, true); });
+		meanError = maxError = 0.0;
+		for (auto i = 0u; i < numRenderPixels; ++i)
+		{
+			const auto& a = fixedImage[i];
+			const auto& b = rayCaster.GetImage()[i];
+			const auto error = max(max(abs(a.x * a.w - b.x * b.w), abs(a.y * a.w - b.y * b.w)),
+				max(abs(a.z * a.w - b.z * b.w), abs(a.w - b.w)));
+			meanError += error;
+			maxError = max<double>(maxError, error);
+		}
+		m_os << "      Speedup " << setprecision(2) << fixedTime / adaptiveTime << "x, view-ray samples per pixel "
+			<< static_cast<double>(numFixedSamples) / numRenderPixels << " -> "
+			<< static_cast<double>(rayCaster.GetNumSamples()) / numRenderPixels << ", pixel error mean "
+			<< setprecision(4) << meanError / numRenderPixels << ", max " << maxError << endl;
+		isAdaptiveBounded = isAdaptiveBounded && meanError / numRenderPixels < 2e-3;
+	}
+	check(isAdaptiveBounded, "adaptive sampling error bound");
+	rayCaster.UpdateFrame(view, proj, eyePt);
+
+	// Incremental updates over the cells downstream of the density changes of the following steps,
+	// against the full sweeps
+	auto numUpdated = 0ull;
+	auto incrementalTime = 0.0, fullSweepTime = 0.0, maxTransError = 0.0;
+	RayCasterCPU fullRayCaster;
+	fullRayCaster.Init(width, height);
+	fullRayCaster.UpdateFrame(view, proj, eyePt);
+	for (auto i = 0u; i < m_numSteps * 8; ++i)
+	{
+		fluid.Simulate(1.0f / 60.0f);
+
+		auto start = chrono::high_resolution_clock::now();
+		numUpdated += rayCaster.UpdateLightTrans(fluid.GetColor(), gridSize);
+		incrementalTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+		start = chrono::high_resolution_clock::now();
+		fullRayCaster.UpdateLightTrans(fluid.GetColor(), gridSize, false);
+		fullSweepTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count();
+
+		for (auto j = 0u; j < numCells; ++j)
+			maxTransError = max<double>(maxTransError, abs(rayCaster.GetLightTrans()[j] - fullRayCaster.GetLightTrans()[j]));
+	}
+	m_os << "  Incremental light sweep: " << setprecision(3) << incrementalTime / (m_numSteps * 8) << " ms/step against "
+		<< fullSweepTime / (m_numSteps * 8) << " ms/step in full" << endl;
+	m_os << "    " << setprecision(1) << 100.0 * numUpdated / (static_cast<uint64_t>(numCells) * m_numSteps * 8)
+		<< "% of cells recomputed per step, transmittance error max " << setprecision(4) << maxTransError << endl;
+
+	// Each slice keeps attenuation changes within the tolerance, which may add up along the sweep
+	const auto numSlices = max(max(gridSize.x, gridSize.y), gridSize.z);
+	check(maxTransError <= numSlices * RayCasterCPU::LightTolerance, "incremental light sweep error bound");
+}
+
+void Benchmark::ReducedResolution(const XMUINT3& gridSize, uint32_t width, uint32_t height)
+{
+	if (gridSize.z <= 1) return;
+
+	m_os << "Reduced-resolution ray casting: " << width << "x" << height << " of "
+		<< gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	// The same plume and camera as for the ray casting
+	FluidCPU fluid;
+	fluid.Init(gridSize);
+	for (auto i = 0u; i < m_numSteps * 32; ++i) fluid.Simulate(1.0f / 60.0f);
+	const auto pColor = fluid.GetColor();
+
+	const XMFLOAT3 eyePt(4.0f, 16.0f, -40.0f);
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMLoadFloat3(&eyePt), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(XM_PIDIV4, static_cast<float>(width) / height, 1.0f, 1000.0f));
+
+	RayCasterCPU rayCaster;
+	rayCaster.Init(width, height);
+	rayCaster.UpdateFrame(view, proj, eyePt);
+	rayCaster.UpdateOccupancy(pColor, gridSize);
+	rayCaster.UpdateLightTrans(pColor, gridSize, false);
+
+	// Full resolution without jitter as the reference
+	const auto numPixels = width * height;
+	const auto fullTime = measure("  Full resolution", [&]() { rayCaster.Render(pColor, gridSize, true, true); });
+	const vector<XMFLOAT4> reference(rayCaster.GetImage(), rayCaster.GetImage() + numPixels);
+
+	// The resolved images are premultiplied
+	const auto computeError = [&](const XMFLOAT4* pImage)
+	{
+		auto error = 0.0;
+		for (auto i = 0u; i < numPixels; ++i)
+		{
+			const auto& a = reference[i];
+			const auto& b = pImage[i];
+			error += max(max(abs(a.x * a.w - b.x), abs(a.y * a.w - b.y)), max(abs(a.z * a.w - b.z), abs(a.w - b.w)));
+		}
+
+		return error / numPixels;
+	};
+
+	const float renderScales[] = { 1.0f, 0.75f, 0.5f };
+	auto isBounded = true;
+	for (const auto& renderScale : renderScales)
+	{
+		const auto renderSize = RayCasterCPU::GetRenderSize(XMUINT2(width, height), renderScale);
+		m_os << "  Render scale " << setprecision(2) << fixed << renderScale << " ("
+			<< renderSize.x << "x" << renderSize.y << ")" << endl;
+
+		// Single frame, upsampled without history
+		rayCaster.Init(width, height);
+		rayCaster.UpdateFrame(view, proj, eyePt, renderScale);
+		const auto renderTime = measure("    Ray casting", [&]() { rayCaster.Render(pColor, gridSize, true, true); });
+		const auto resolveTime = measure("    Resolve", [&]() { rayCaster.Resolve(); });
+		rayCaster.Init(width, height);
+		rayCaster.UpdateFrame(view, proj, eyePt, renderScale);
+		rayCaster.Render(pColor, gridSize, true, true);
+		rayCaster.Resolve();
+		const auto singleError = computeError(rayCaster.GetResolved());
+
+		// Jittered frames accumulated with the camera at rest
+		const auto numFrames = RayCasterCPU::NumJitters * 2;
+		for (auto i = 1u; i < numFrames; ++i)
+		{
+			rayCaster.UpdateFrame(view, proj, eyePt, renderScale, RayCasterCPU::GetJitter(i));
+			rayCaster.Render(pColor, gridSize, true, true);
+			rayCaster.Resolve();
+		}
+
+		const auto accumulatedError = computeError(rayCaster.GetResolved());
+		m_os << "    Speedup " << setprecision(2) << fullTime / (renderTime + resolveTime)
+			<< "x, pixel error mean " << setprecision(4) << singleError << " in a single frame, "
+			<< accumulatedError << " over " << numFrames << " frames" << endl;
+
+		// The full scale must resolve to the reference, and the reduced ones stay close to it
+		isBounded = isBounded && singleError < (renderScale < 1.0f ? 2e-3 : 1e-4) && accumulatedError < 2e-3;
+	}
+	check(isBounded, "upsampling error bound");
+}
+
+void Benchmark::RayPackets(const XMUINT3& gridSize, uint32_t width, uint32_t height)
+{
+	if (gridSize.z <= 1) return;
+
+	m_os << "Ray packets: " << width << "x" << height << " of " << gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	// The plume simulated at up to 64 cells per axis, resampled to the grid, so that the large grids
+	// are rendered without simulating them on the CPU
+	const XMUINT3 simSize(min(gridSize.x, 64u), min(gridSize.y, 64u), min(gridSize.z, 64u));
+	FluidCPU fluid;
+	fluid.Init(simSize);
+	for (auto i = 0u; i < m_numSteps * 32; ++i) fluid.Simulate(1.0f / 60.0f);
+
+	vector<XMFLOAT4> color(static_cast<size_t>(gridSize.x) * gridSize.y * gridSize.z);
+	for (auto z = 0u; z < gridSize.z; ++z)
+	{
+		for (auto y = 0u; y < gridSize.y; ++y)
+		{
+			for (auto x = 0u; x < gridSize.x; ++x)
+			{
+				const auto tex = XMVectorSet((x + 0.5f) / gridSize.x, (y + 0.5f) / gridSize.y, (z + 0.5f) / gridSize.z, 0.0f);
+				XMStoreFloat4(&color[VolumeSampler::Index(x, y, z, gridSize)],
+					VolumeSampler::SampleLinear(fluid.GetColor(), simSize, tex, VolumeSampler::CLAMP));
+			}
+		}
+	}
+	const auto pColor = color.data();
+
+	const XMFLOAT3 eyePt(4.0f, 16.0f, -40.0f);
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMLoadFloat3(&eyePt), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(XM_PIDIV4, static_cast<float>(width) / height, 1.0f, 1000.0f));
+
+	RayCasterCPU rayCaster;
+	rayCaster.Init(width, height);
+	rayCaster.UpdateFrame(view, proj, eyePt);
+	rayCaster.UpdateOccupancy(pColor, gridSize);
+	rayCaster.UpdateLightTrans(pColor, gridSize, false);
+	rayCaster.UpdateMips(pColor, gridSize);
+
+	// Bounded ray casting with the swept light, as PSRayCast does, in fixed and adaptive steps
+	// against the scalar rays
+	const auto numPixels = width * height;
+	const char* labels[] = { "Scalar", "AVX2 (8 rays)", "AVX-512 (16 rays)" };
+	for (const auto adaptive : { false, true })
+	{
+		m_os << (adaptive ? "  Adaptive steps" : "  Fixed steps") << endl;
+		vector<XMFLOAT4> reference;
+		for (uint8_t i = 0; i <= RayCasterCPU::GetBestKernel(); ++i)
+		{
+			rayCaster.SetKernel(static_cast<RayCasterCPU::Kernel>(i));
+			const auto time = measure((string("    ") + labels[i]).c_str(),
+				[&]() { rayCaster.Render(pColor, gridSize, true, true, true, adaptive); });
+			if (reference.empty()) reference.assign(rayCaster.GetImage(), rayCaster.GetImage() + numPixels);
+
+			auto numIdentical = 0u;
+			auto maxError = 0.0;
+			for (auto j = 0u; j < numPixels; ++j)
+			{
+				const auto& a = reference[j];
+				const auto& b = rayCaster.GetImage()[j];
+				numIdentical += memcmp(&a, &b, sizeof(XMFLOAT4)) ? 0 : 1;
+				maxError = max<double>(maxError, max(max(abs(a.x - b.x), abs(a.y - b.y)), max(abs(a.z - b.z), abs(a.w - b.w))));
+			}
+			m_os << "      " << setprecision(2) << 1000.0 / time << " frames/s, " << numIdentical << " of " << numPixels
+				<< " pixels identical, max error " << setprecision(4) << maxError << endl;
+
+			// The packets take the same operations in the same order as the scalar rays
+			if (i > 0) check(numIdentical == numPixels, (string(labels[i]) + (adaptive ?
+				" adaptive" : " fixed") + " steps vs. scalar").c_str());
+		}
+	}
+}
+
+void Benchmark::Compression(const XMUINT3& gridSize, uint32_t width, uint32_t height)
+{
+	if (gridSize.z <= 1 || !BlockCompressor::IsCompressible(gridSize)) return;
+
+	m_os << "Block compression: " << gridSize.x << "x" << gridSize.y << "x" << gridSize.z << endl;
+
+	FluidCPU fluid;
+	fluid.Init(gridSize);
+	for (auto i = 0u; i < m_numSteps * 32; ++i) fluid.Simulate(1.0f / 60.0f);
+	const auto pColor = fluid.GetColor();
+
+	// BC6H color and BC4 density blocks, as CSEncodeBC writes them per frame
+	const auto numBlocks = BlockCompressor::GetNumBlocks(gridSize);
+	const auto numBlocksTotal = numBlocks.x * numBlocks.y * numBlocks.z;
+	vector<XMUINT4> colorBlocks(numBlocksTotal);
+	vector<XMUINT2> densityBlocks(numBlocksTotal);
+	const auto encodeTime = measure("  Encoding", [&]()
+	{
+		BlockCompressor::Encode(pColor, gridSize, colorBlocks.data(), densityBlocks.data());
+	});
+
+	const auto numCells = gridSize.x * gridSize.y * gridSize.z;
+	const auto srcBytesPerTexel = 8.0;	// R16G16B16A16_FLOAT
+	const auto bytesPerTexel = static_cast<double>(sizeof(XMUINT4) + sizeof(XMUINT2)) / BlockCompressor::BlockTexels;
+	m_os << "    Throughput: " << setprecision(2) << fixed << numCells / (encodeTime * 1000.0)
+		<< " M texels/s, " << srcBytesPerTexel << " -> " << bytesPerTexel << " bytes per sampled texel ("
+		<< srcBytesPerTexel / bytesPerTexel << "x)" << endl;
+
+	// Errors of the samples as the ray casting takes them, and of the images cast from either volume
+	// with the same occupancy and light transmittance, built from the uncompressed volume
+	vector<XMFLOAT4> decoded(numCells);
+	BlockCompressor::Decode(colorBlocks.data(), densityBlocks.data(), gridSize, decoded.data());
+
+	auto meanError = 0.0, maxError = 0.0;
+	for (auto i = 0u; i < numCells; ++i)
+	{
+		const auto toSample = [](const XMFLOAT4& color)
+		{
+			const auto density = color.w * 24.0f;
+
+			return XMFLOAT4(min(color.x * density, 24.0f), min(color.y * density, 24.0f),
+				min(color.z * density, 24.0f), min(density, 24.0f));
+		};
+
+		const auto a = toSample(pColor[i]);
+		const auto b = toSample(decoded[i]);
+		const auto error = max(max(abs(a.x - b.x), abs(a.y - b.y)), max(abs(a.z - b.z), abs(a.w - b.w)));
+		meanError += error;
+		maxError = max<double>(maxError, error);
+	}
+	m_os << "    Sample error mean " << setprecision(4) << meanError / numCells << ", max " << maxError
+		<< " of the density scale 24" << endl;
+	// Single samples may stray at the sharp edges of dense color, which one BC6H region
+	// spans with a single line of endpoints
+	check(meanError / numCells < 0.02, "compressed sample error bound");
+
+	const XMFLOAT3 eyePt(4.0f, 16.0f, -40.0f);
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMLoadFloat3(&eyePt), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(XM_PIDIV4, static_cast<float>(width) / height, 1.0f, 1000.0f));
+
+	RayCasterCPU rayCaster;
+	rayCaster.Init(width, height);
+	rayCaster.UpdateFrame(view, proj, eyePt);
+	rayCaster.UpdateOccupancy(pColor, gridSize);
+	rayCaster.UpdateLightTrans(pColor, gridSize, false);
+
+	const auto numPixels = width * height;
+	rayCaster.Render(pColor, gridSize, true, true, true);
+	const vector<XMFLOAT4> reference(rayCaster.GetImage(), rayCaster.GetImage() + numPixels);
+	rayCaster.Render(decoded.data(), gridSize, true, true, true);
+
+	meanError = maxError = 0.0;
+	for (auto i = 0u; i < numPixels; ++i)
+	{
+		const auto& a = reference[i];
+		const auto& b = rayCaster.GetImage()[i];
+		const auto error = max(max(abs(a.x - b.x), abs(a.y - b.y)), max(abs(a.z - b.z), abs(a.w - b.w)));
+		meanError += error;
+		maxError = max<double>(maxError, error);
+	}
+	m_os << "    Ray casting at " << width << "x" << height << ", pixel error mean " << setprecision(4)
+		<< meanError / numPixels << ", max " << maxError << endl;
+	check(meanError / numPixels < 2e-3 && maxError < 0.1, "compressed ray casting error bound");
+}
+
+uint32_t Benchmark::GetNumFailures() const
+{
+	return m_numFailures;
+}
+
+double Benchmark::measure(const char* label, const function<void()>& func)
+{
+	const auto start = chrono::high_resolution_clock::now();
+	for (auto i = 0u; i < m_numSteps; ++i) func();
+	const auto end = chrono::high_resolution_clock::now();
+
+	const auto ms = chrono::duration<double, milli>(end - start).count() / m_numSteps;
+	m_os << label << ": " << setprecision(3) << fixed << ms << " ms/step" << endl;
+
+	return ms;
+}
+
+bool Benchmark::check(bool isPassed, const char* label)
+{
+	m_os << "  Check " << label << ": " << (isPassed ? "passed" : "FAILED") << endl;
+	m_numFailures += isPassed ? 0 : 1;
+
+	return isPassed;
+}
@@ -0,0 +1,41 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Timings of the CPU paths, reported per step to the given stream, along with
+// the checks of their results, of which the failures are counted
+class Benchmark
+{
+public:
+	Benchmark(std::ostream& os, uint32_t numSteps = 8);
+	virtual ~Benchmark();
+
+	void Emitters(const DirectX::XMUINT3& gridSize, uint32_t numEmitters);
+	void Vorticity(const DirectX::XMUINT3& gridSize);
+	void Turbulence(const DirectX::XMUINT3& gridSize, uint32_t upsample);
+	void Particles(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void Checkpoint(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void ParticlesSoA(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void Random(uint32_t numBlocks);
+	void ParticleQuads(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void Normals(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void ParticleCulling(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void HybridSolver(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void ParticleIntegration(const DirectX::XMUINT3& gridSize, uint32_t numParticles);
+	void RayCasting(const DirectX::XMUINT3& gridSize, uint32_t width, uint32_t height);
+	void ReducedResolution(const DirectX::XMUINT3& gridSize, uint32_t width, uint32_t height);
+	void RayPackets(const DirectX::XMUINT3& gridSize, uint32_t width, uint32_t height);
+	void Compression(const DirectX::XMUINT3& gridSize, uint32_t width, uint32_t height);
+
+	uint32_t GetNumFailures() const;
+
+protected:
+	double measure(const char* label, const std::function<void()>& func);
+	bool check(bool isPassed, const char* label);
+
+	std::ostream&	m_os;
+	uint32_t		m_numSteps;
+	uint32_t		m_numFailures;
+};
@@ -0,0 +1,284 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "BlockCompressor.h"
+#include "VolumeSampler.h"
+
+using namespace std;
+using namespace concurrency;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Matching CSEncodeBC
+static const uint32_t g_bc6hMode = 0x03;	// Single region with 10-bit endpoints and 4-bit indices
+static const uint32_t g_bc6hWeights[] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+static const float g_maxHalf = 65504.0f;
+
+// Half-float bits of the unsigned values, which are ordered as the values are
+static int32_t toHalfBits(float value)
+{
+	return XMConvertFloatToHalf(min(max(value, 0.0f), g_maxHalf));
+}
+
+// BC6H endpoint quantization to 10 bits, and back to the 16-bit interpolation domain
+static int32_t quantizeBC6H(int32_t halfBits)
+{
+	return min(halfBits / 31, 1023);
+}
+
+static int32_t unquantizeBC6H(int32_t comp)
+{
+	return comp == 0 ? 0 : (comp == 1023 ? 0xffff : ((comp << 16) + 0x8000) >> 10);
+}
+
+static int32_t finishBC6H(int32_t comp)
+{
+	return (comp * 31) >> 6;
+}
+
+static float interpolateBC6H(int32_t comp0, int32_t comp1, uint32_t weight)
+{
+	return XMConvertHalfToFloat(static_cast<HALF>(finishBC6H((comp0 * (64 - weight) + comp1 * weight + 32) >> 6)));
+}
+
+static void writeBits(uint64_t* pBits, uint32_t& offset, uint32_t value, uint32_t numBits)
+{
+	for (auto i = 0u; i < numBits; ++i, ++offset)
+		pBits[offset >> 6] |= static_cast<uint64_t>((value >> i) & 1) << (offset & 63);
+}
+
+static uint32_t readBits(const uint64_t* pBits, uint32_t& offset, uint32_t numBits)
+{
+	auto value = 0u;
+	for (auto i = 0u; i < numBits; ++i, ++offset)
+		value |= static_cast<uint32_t>((pBits[offset >> 6] >> (offset & 63)) & 1) << i;
+
+	return value;
+}
+
+void BlockCompressor::Encode(const XMFLOAT4* pVolume, const XMUINT3& size,
+	XMUINT4* pColorBlocks, XMUINT2* pDensityBlocks, bool parallel)
+{
+	const auto numBlocks = GetNumBlocks(size);
+	const auto encodeRow = [&](uint32_t row)
+	{
+		const auto by = row % numBlocks.y;
+		const auto z = row / numBlocks.y;
+		for (auto bx = 0u; bx < numBlocks.x; ++bx)
+		{
+			// Texels beyond the edges are clamped, as for partial blocks
+			XMFLOAT3 colors[BlockTexels];
+			float densities[BlockTexels];
+			for (auto i = 0u; i < BlockTexels; ++i)
+			{
+				const auto x = min(bx * BlockSize + i % BlockSize, size.x - 1);
+				const auto y = min(by * BlockSize + i / BlockSize, size.y - 1);
+				const auto& texel = pVolume[VolumeSampler::Index(x, y, z, size)];
+				colors[i] = XMFLOAT3(texel.x, texel.y, texel.z);
+				densities[i] = texel.w;
+			}
+
+			const auto block = (z * numBlocks.y + by) * numBlocks.x + bx;
+			pColorBlocks[block] = EncodeBC6H(colors);
+			pDensityBlocks[block] = EncodeBC4(densities);
+		}
+	};
+
+	const auto numRows = numBlocks.y * numBlocks.z;
+	if (parallel) parallel_for(0u, numRows, encodeRow);
+	else for (auto i = 0u; i < numRows; ++i) encodeRow(i);
+}
+
+void BlockCompressor::Decode(const XMUINT4* pColorBlocks, const XMUINT2* pDensityBlocks,
+	const XMUINT3& size, XMFLOAT4* pVolume, bool parallel)
+{
+	const auto numBlocks = GetNumBlocks(size);
+	const auto decodeRow = [&](uint32_t row)
+	{
+		const auto by = row % numBlocks.y;
+		const auto z = row / numBlocks.y;
+		for (auto bx = 0u; bx < numBlocks.x; ++bx)
+		{
+			XMFLOAT3 colors[BlockTexels];
+			float densities[BlockTexels];
+			const auto block = (z * numBlocks.y + by) * numBlocks.x + bx;
+			DecodeBC6H(pColorBlocks[block], colors);
+			DecodeBC4(pDensityBlocks[block], densities);
+
+			for (auto i = 0u; i < BlockTexels; ++i)
+			{
+				const auto x = bx * BlockSize + i % BlockSize;
+				const auto y = by * BlockSize + i / BlockSize;
+				if (x < size.x && y < size.y)
+					pVolume[VolumeSampler::Index(x, y, z, size)] = XMFLOAT4(colors[i].x, colors[i].y, colors[i].z, densities[i]);
+			}
+		}
+	};
+
+	const auto numRows = numBlocks.y * numBlocks.z;
+	if (parallel) parallel_for(0u, numRows, decodeRow);
+	else for (auto i = 0u; i < numRows; ++i) decodeRow(i);
+}
+
+XMUINT4 BlockCompressor::EncodeBC6H(const XMFLOAT3* pTexels)
+{
+	// Bounding box in the half-float bits, which are interpolated linearly; its diagonal runs along
+	// the channel of the widest range, with each other channel reversed if it decreases along it
+	int32_t texels[BlockTexels][3];
+	int32_t bounds[2][3] = { { INT32_MAX, INT32_MAX, INT32_MAX }, { 0, 0, 0 } };
+	float means[3] = {};
+	for (auto i = 0u; i < BlockTexels; ++i)
+	{
+		const float values[] = { pTexels[i].x, pTexels[i].y, pTexels[i].z };
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			texels[i][c] = toHalfBits(values[c]);
+			bounds[0][c] = min(bounds[0][c], texels[i][c]);
+			bounds[1][c] = max(bounds[1][c], texels[i][c]);
+			means[c] += texels[i][c] / static_cast<float>(BlockTexels);
+		}
+	}
+
+	uint8_t axis = 0;
+	for (uint8_t c = 1; c < 3; ++c)
+		if (bounds[1][c] - bounds[0][c] > bounds[1][axis] - bounds[0][axis]) axis = c;
+
+	bool isReversed[3] = {};
+	for (uint8_t c = 0; c < 3; ++c)
+	{
+		auto covariance = 0.0f;
+		for (auto i = 0u; i < BlockTexels; ++i)
+			covariance += (texels[i][c] - means[c]) * (texels[i][axis] - means[axis]);
+		isReversed[c] = covariance < 0.0f;
+	}
+
+	// Quantize the endpoints, and project the texels onto the line between them for their indices
+	int32_t comps[2][3];
+	float line[2][3];
+	for (uint8_t c = 0; c < 3; ++c)
+	{
+		comps[isReversed[c] ? 1 : 0][c] = quantizeBC6H(bounds[0][c]);
+		comps[isReversed[c] ? 0 : 1][c] = quantizeBC6H(bounds[1][c]);
+		for (uint8_t j = 0; j < 2; ++j) line[j][c] = static_cast<float>(finishBC6H(unquantizeBC6H(comps[j][c])));
+	}
+
+	const float dir[] = { line[1][0] - line[0][0], line[1][1] - line[0][1], line[1][2] - line[0][2] };
+	const auto lengthSq = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+	uint32_t indices[BlockTexels];
+	for (auto i = 0u; i < BlockTexels; ++i)
+	{
+		auto t = 0.0f;
+		for (uint8_t c = 0; c < 3; ++c) t += (texels[i][c] - line[0][c]) * dir[c];
+		t = lengthSq > 0.0f ? t / lengthSq : 0.0f;
+		indices[i] = static_cast<uint32_t>(min(max(t * 15.0f + 0.5f, 0.0f), 15.0f));
+	}
+
+	// The anchor index of the first texel has its top bit implied as zero
+	if (indices[0] >= 8)
+	{
+		swap(comps[0], comps[1]);
+		for (auto& index : indices) index = 15 - index;
+	}
+
+	uint64_t bits[2] = {};
+	auto offset = 0u;
+	writeBits(bits, offset, g_bc6hMode, 5);
+	for (uint8_t j = 0; j < 2; ++j)
+		for (uint8_t c = 0; c < 3; ++c) writeBits(bits, offset, comps[j][c], 10);
+	writeBits(bits, offset, indices[0], 3);
+	for (auto i = 1u; i < BlockTexels; ++i) writeBits(bits, offset, indices[i], 4);
+
+	return XMUINT4(static_cast<uint32_t>(bits[0]), static_cast<uint32_t>(bits[0] >> 32),
+		static_cast<uint32_t>(bits[1]), static_cast<uint32_t>(bits[1] >> 32));
+}
+
+XMUINT2 BlockCompressor::EncodeBC4(const float* pTexels)
+{
+	// The maximum as the first endpoint for the 8-value palette, unless the block is uniform
+	auto minValue = 1.0f, maxValue = 0.0f;
+	for (auto i = 0u; i < BlockTexels; ++i)
+	{
+		const auto value = min(max(pTexels[i], 0.0f), 1.0f);
+		minValue = min(minValue, value);
+		maxValue = max(maxValue, value);
+	}
+
+	const auto red0 = static_cast<uint32_t>(maxValue * 255.0f + 0.5f);
+	const auto red1 = static_cast<uint32_t>(minValue * 255.0f + 0.5f);
+	uint64_t bits = red0 | (red1 << 8);
+	if (red0 > red1)
+	{
+		// Steps from the first endpoint, where the palette holds the second endpoint at 1
+		for (auto i = 0u; i < BlockTexels; ++i)
+		{
+			const auto value = min(max(pTexels[i], 0.0f), 1.0f) * 255.0f;
+			const auto t = min(max((value - red1) / (red0 - red1), 0.0f), 1.0f);
+			const auto step = static_cast<uint32_t>((1.0f - t) * 7.0f + 0.5f);
+			const auto index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+			bits |= static_cast<uint64_t>(index) << (16 + 3 * i);
+		}
+	}
+
+	return XMUINT2(static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32));
+}
+
+void BlockCompressor::DecodeBC6H(const XMUINT4& block, XMFLOAT3* pTexels)
+{
+	const uint64_t bits[] =
+	{
+		block.x | (static_cast<uint64_t>(block.y) << 32),
+		block.z | (static_cast<uint64_t>(block.w) << 32)
+	};
+
+	// Only the mode written by EncodeBC6H
+	assert((bits[0] & 0x1f) == g_bc6hMode);
+	auto offset = 5u;
+	int32_t endpoints[2][3];
+	for (uint8_t j = 0; j < 2; ++j)
+		for (uint8_t c = 0; c < 3; ++c) endpoints[j][c] = unquantizeBC6H(readBits(bits, offset, 10));
+
+	for (auto i = 0u; i < BlockTexels; ++i)
+	{
+		const auto weight = g_bc6hWeights[readBits(bits, offset, i ? 4 : 3)];
+		pTexels[i].x = interpolateBC6H(endpoints[0][0], endpoints[1][0], weight);
+		pTexels[i].y = interpolateBC6H(endpoints[0][1], endpoints[1][1], weight);
+		pTexels[i].z = interpolateBC6H(endpoints[0][2], endpoints[1][2], weight);
+	}
+}
+
+void BlockCompressor::DecodeBC4(const XMUINT2& block, float* pTexels)
+{
+	const auto bits = block.x | (static_cast<uint64_t>(block.y) << 32);
+	const auto red0 = static_cast<float>(bits & 0xff);
+	const auto red1 = static_cast<float>((bits >> 8) & 0xff);
+
+	float palette[8] = { red0, red1 };
+	if (red0 > red1) for (uint8_t i = 2; i < 8; ++i) palette[i] = ((8 - i) * red0 + (i - 1) * red1) / 7.0f;
+	else
+	{
+		for (uint8_t i = 2; i < 6; ++i) palette[i] = ((6 - i) * red0 + (i - 1) * red1) / 5.0f;
+		palette[6] = 0.0f;
+		palette[7] = 255.0f;
+	}
+
+	for (auto i = 0u; i < BlockTexels; ++i) pTexels[i] = palette[(bits >> (16 + 3 * i)) & 7] / 255.0f;
+}
+
+XMUINT3 BlockCompressor::GetNumBlocks(const XMUINT3& size)
+{
+	return XMUINT3((size.x + BlockSize - 1) / BlockSize, (size.y + BlockSize - 1) / BlockSize, size.z);
+}
+
+bool BlockCompressor::IsCompressible(const XMUINT3& size)
+{
+	return size.x % BlockSize == 0 && size.y % BlockSize == 0;
+}
+
+uint8_t BlockCompressor::GetNumMips(const XMUINT3& size, uint8_t numMips)
+{
+	uint8_t i = 0;
+	while (i < numMips && IsCompressible(XMUINT3(max(size.x >> i, 1u), max(size.y >> i, 1u), 1))) ++i;
+
+	return i;
+}
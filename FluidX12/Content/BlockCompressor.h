@@ -0,0 +1,29 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Block compression of the rendered volume, CPU counterpart of CSEncodeBC: 4x4 blocks per slice,
+// the color in BC6H as unsigned half floats, in its single-region mode of 10-bit endpoints, and
+// the density in BC4, saturated as the ray casting does; 1.5 bytes per texel in place of 8
+class BlockCompressor
+{
+public:
+	static void Encode(const DirectX::XMFLOAT4* pVolume, const DirectX::XMUINT3& size,
+		DirectX::XMUINT4* pColorBlocks, DirectX::XMUINT2* pDensityBlocks, bool parallel = true);
+	static void Decode(const DirectX::XMUINT4* pColorBlocks, const DirectX::XMUINT2* pDensityBlocks,
+		const DirectX::XMUINT3& size, DirectX::XMFLOAT4* pVolume, bool parallel = true);
+
+	static DirectX::XMUINT4 EncodeBC6H(const DirectX::XMFLOAT3* pTexels);	// 16 texels in the row order
+	static DirectX::XMUINT2 EncodeBC4(const float* pTexels);
+	static void DecodeBC6H(const DirectX::XMUINT4& block, DirectX::XMFLOAT3* pTexels);
+	static void DecodeBC4(const DirectX::XMUINT2& block, float* pTexels);
+
+	static DirectX::XMUINT3 GetNumBlocks(const DirectX::XMUINT3& size);
+	static bool IsCompressible(const DirectX::XMUINT3& size);	// Whole blocks per slice
+	static uint8_t GetNumMips(const DirectX::XMUINT3& size, uint8_t numMips);	// Leading levels of whole blocks
+
+	static const uint32_t BlockSize = 4;
+	static const uint32_t BlockTexels = BlockSize * BlockSize;
+};
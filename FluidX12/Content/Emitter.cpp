@@ -0,0 +1,163 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Emitter.h"
+
+using namespace std;
+using namespace DirectX;
+
+Emitter Emitter::Default()
+{
+	Emitter emitter;
+	emitter.Pos = XMFLOAT3(0.5f, 0.9f, 0.5f);
+	emitter.Radius = 1.0f / 28.0f;
+	emitter.Force = XMFLOAT3(0.0f, -48.0f, 0.0f);
+	emitter.Swirl = 200.0f;
+	emitter.Color = XMFLOAT4(0.0f, 40.0f, 100.0f, 64.0f);
+
+	return emitter;
+}
+
+//--------------------------------------------------------------------------------------
+// Emitter bins
+//--------------------------------------------------------------------------------------
+EmitterBins::EmitterBins() :
+	m_gridSize(0, 0, 0),
+	m_brickGridSize(0, 0, 0),
+	m_numIndices(0),
+	m_numDropped(0)
+{
+}
+
+EmitterBins::~EmitterBins()
+{
+}
+
+void EmitterBins::Init(const XMUINT3& gridSize)
+{
+	m_gridSize = gridSize;
+	m_brickGridSize.x = (gridSize.x - 1) / BrickSize + 1;
+	m_brickGridSize.y = (gridSize.y - 1) / BrickSize + 1;
+	m_brickGridSize.z = (gridSize.z - 1) / BrickSize + 1;
+
+	const auto numBricks = GetNumBricks();
+	m_brickRanges.assign(numBricks, XMUINT2(0, 0));
+	m_brickCounts.assign(numBricks, 0);
+	m_indices.resize(GetMaxIndices());
+	m_numIndices = 0;
+	m_numDropped = 0;
+}
+
+uint32_t EmitterBins::Bin(uint32_t numEmitters, const Emitter* pEmitters)
+{
+	// Count the emitters overlapping each brick
+	fill(m_brickCounts.begin(), m_brickCounts.end(), 0);
+	m_brickBounds.resize(numEmitters * 2);
+	for (auto i = 0u; i < numEmitters; ++i)
+	{
+		auto& brickMin = m_brickBounds[i * 2];
+		auto& brickMax = m_brickBounds[i * 2 + 1];
+		if (!getBrickBound(pEmitters[i], brickMin, brickMax))
+		{
+			// Mark as empty
+			brickMin = XMUINT3(1, 1, 1);
+			brickMax = XMUINT3(0, 0, 0);
+			continue;
+		}
+
+		for (auto z = brickMin.z; z <= brickMax.z; ++z)
+			for (auto y = brickMin.y; y <= brickMax.y; ++y)
+				for (auto x = brickMin.x; x <= brickMax.x; ++x)
+					++m_brickCounts[(z * m_brickGridSize.y + y) * m_brickGridSize.x + x];
+	}
+
+	// Exclusive prefix sum of the (clamped) counts gives the offset of each brick list; the
+	// overlaps beyond the cap keep only the lowest emitter indices and are counted as dropped
+	m_numIndices = 0;
+	m_numDropped = 0;
+	for (size_t i = 0; i < m_brickRanges.size(); ++i)
+	{
+		m_numDropped += m_brickCounts[i] > MaxEmittersPerBrick ? m_brickCounts[i] - MaxEmittersPerBrick : 0;
+		m_brickCounts[i] = min(m_brickCounts[i], MaxEmittersPerBrick);
+		m_brickRanges[i] = XMUINT2(m_numIndices, 0);
+		m_numIndices += m_brickCounts[i];
+	}
+
+	// Scatter the emitter indices into the brick lists in emitter order
+	for (auto i = 0u; i < numEmitters; ++i)
+	{
+		const auto& brickMin = m_brickBounds[i * 2];
+		const auto& brickMax = m_brickBounds[i * 2 + 1];
+		for (auto z = brickMin.z; z <= brickMax.z; ++z)
+			for (auto y = brickMin.y; y <= brickMax.y; ++y)
+				for (auto x = brickMin.x; x <= brickMax.x; ++x)
+				{
+					const auto brick = (z * m_brickGridSize.y + y) * m_brickGridSize.x + x;
+					auto& range = m_brickRanges[brick];
+					if (range.y < m_brickCounts[brick]) m_indices[range.x + range.y++] = i;
+				}
+	}
+
+	return m_numIndices;
+}
+
+const XMUINT3& EmitterBins::GetBrickGridSize() const
+{
+	return m_brickGridSize;
+}
+
+const XMUINT2* EmitterBins::GetBrickRanges() const
+{
+	return m_brickRanges.data();
+}
+
+const uint32_t* EmitterBins::GetIndices() const
+{
+	return m_indices.data();
+}
+
+uint32_t EmitterBins::GetNumBricks() const
+{
+	return m_brickGridSize.x * m_brickGridSize.y * m_brickGridSize.z;
+}
+
+uint32_t EmitterBins::GetNumIndices() const
+{
+	return m_numIndices;
+}
+
+uint32_t EmitterBins::GetMaxIndices() const
+{
+	return GetNumBricks() * MaxEmittersPerBrick;
+}
+
+uint32_t EmitterBins::GetNumDropped() const
+{
+	return m_numDropped;
+}
+
+bool EmitterBins::getBrickBound(const Emitter& emitter, XMUINT3& brickMin, XMUINT3& brickMax) const
+{
+	const float pos[] = { emitter.Pos.x, emitter.Pos.y, emitter.Pos.z };
+	const uint32_t gridSize[] = { m_gridSize.x, m_gridSize.y, m_gridSize.z };
+
+	uint32_t bMin[3], bMax[3];
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		// Cells whose centers are within the emitter radius (with a small margin)
+		const auto center = pos[i] * gridSize[i] - 0.5f;
+		const auto r = emitter.Radius * gridSize[i] + 0.01f;
+		const auto lo = max(ceil(center - r), 0.0f);
+		const auto hi = min(floor(center + r), gridSize[i] - 1.0f);
+		if (lo > hi) return false;
+
+		bMin[i] = static_cast<uint32_t>(lo) / BrickSize;
+		bMax[i] = static_cast<uint32_t>(hi) / BrickSize;
+	}
+
+	brickMin = XMUINT3(bMin[0], bMin[1], bMin[2]);
+	brickMax = XMUINT3(bMax[0], bMax[1], bMax[2]);
+
+	return true;
+}
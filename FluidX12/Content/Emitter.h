@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Layout matches the Emitter structure in Impulse.hlsli
+struct Emitter
+{
+	DirectX::XMFLOAT3 Pos;		// Center in simulation space
+	float Radius;				// Radius in simulation space
+	DirectX::XMFLOAT3 Force;
+	float Swirl;
+	DirectX::XMFLOAT4 Color;
+
+	static Emitter Default();
+};
+
+class EmitterBins
+{
+public:
+	EmitterBins();
+	virtual ~EmitterBins();
+
+	void Init(const DirectX::XMUINT3& gridSize);
+	uint32_t Bin(uint32_t numEmitters, const Emitter* pEmitters);
+
+	const DirectX::XMUINT3& GetBrickGridSize() const;
+	const DirectX::XMUINT2* GetBrickRanges() const;
+	const uint32_t* GetIndices() const;
+	uint32_t GetNumBricks() const;
+	uint32_t GetNumIndices() const;
+	uint32_t GetMaxIndices() const;
+	uint32_t GetNumDropped() const;
+
+	static const uint32_t BrickSize = 8;
+	static const uint32_t MaxEmittersPerBrick = 64;
+
+protected:
+	bool getBrickBound(const Emitter& emitter, DirectX::XMUINT3& brickMin, DirectX::XMUINT3& brickMax) const;
+
+	DirectX::XMUINT3 m_gridSize;
+	DirectX::XMUINT3 m_brickGridSize;
+
+	std::vector<DirectX::XMUINT2> m_brickRanges;	// (offset, count) into m_indices per brick
+	std::vector<uint32_t> m_brickCounts;
+	std::vector<uint32_t> m_indices;
+	std::vector<DirectX::XMUINT3> m_brickBounds;	// (min, max) pairs per emitter
+
+	uint32_t m_numIndices;
+	uint32_t m_numDropped;	// Emitter-brick overlaps beyond MaxEmittersPerBrick
+};
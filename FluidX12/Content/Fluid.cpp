@@ -11,9 +11,30 @@ using namespace XUSG;
 struct CBPerFrame
 {
 	float TimeStep;
-	uint32_t BaseSeed;
+	uint32_t Step;
+	uint32_t NumEmitters;
+	float RenderTimeOffset;
+	uint32_t Seed;
+	float FlipRatio;
+	uint32_t Integrator;
+	float FullLife;
 };
 
+// Matching Reorder.hlsli
+static const uint32_t g_sortGroupSize = 1024;
+static const uint32_t g_sortChunkSize = g_sortGroupSize * 2;
+
+// Projected particle radius in pixels, below which the distant particles are thinned
+static const float g_minParticlePixels = 2.0f;
+
+// Dynamic resolution of the ray casting: scale steps over the frame-time budget, with
+// a lower band before stepping up again and a number of frames to settle after each step
+static const float g_minRenderScale = 0.25f;
+static const float g_renderScaleStep = 0.125f;
+static const float g_frameTimeHigh = 1.05f;
+static const float g_frameTimeLow = 0.8f;
+static const uint32_t g_renderScaleHold = 30;
+
 struct CBPerObjectParticle
 {
 	XMFLOAT3X4 WorldView;
@@ -27,17 +48,56 @@ struct CBPerObjectGrid3D
 	XMVECTOR LocalSpaceEyePt;
 	XMMATRIX ScreenToLocal;
 	XMMATRIX WorldViewProj;
+	XMMATRIX PrevWorldViewProj;
+	XMMATRIX ResolveToLocal;
+	XMFLOAT2 Jitter;
+	float RenderScale;
+	float HistoryBlend;
+	XMFLOAT2 RenderViewport;
 };
 
 Fluid::Fluid(const Device::sptr& device) :
 	m_device(device),
+	m_grid(nullptr),
+	m_srcGrid(nullptr),
+	m_gridStamp(0),
 	m_timeInterval(0.0f),
-	m_frameParity(0)
+	m_time(0.0f),
+	m_simStep(0.0f),
+	m_interpFactor(1.0f),
+	m_emissionRate(0.0f),
+	m_emissionBudget(0.0f),
+	m_lodDistance(FLT_MAX),
+	m_flipRatio(-1.0f),
+	m_integrator(ParticleCPU::EULER),
+	m_frameBudget(1.0f / 60.0f),
+	m_frameTime(0.0f),
+	m_renderScale(1.0f),
+	m_lightSweep(),
+	m_frameParity(0),
+	m_numSubsteps(0),
+	m_substep(0),
+	m_particleParity(0),
+	m_historyParity(0),
+	m_blockCompression(false),
+	m_isVolumeChanged(false),
+	m_isEncoded(false),
+	m_upsample(1),
+	m_seed(0),
+	m_step(0),
+	m_reorderInterval(0),
+	m_sortCapacity(0),
+	m_lightStamp(0),
+	m_numResolved(0),
+	m_renderScaleHold(0),
+	m_numDroppedEmitters(0)
 {
 	m_shaderPool = ShaderPool::MakeUnique();
 	m_graphicsPipelineCache = Graphics::PipelineCache::MakeUnique(device.get());
 	m_computePipelineCache = Compute::PipelineCache::MakeUnique(device.get());
 	m_pipelineLayoutCache = PipelineLayoutCache::MakeUnique(device.get());
+
+	m_emitters.emplace_back(Emitter::Default());
 }
 
 Fluid::~Fluid()
@@ -46,36 +106,57 @@ Fluid::~Fluid()
 
 bool Fluid::Init(CommandList* pCommandList, uint32_t width, uint32_t height,
 	const DescriptorTableCache::sptr& descriptorTableCache, vector<Resource::uptr>& uploaders,
-	Format rtFormat, Format dsFormat, const XMUINT3& gridSize, uint32_t numParticles)
+	Format rtFormat, Format dsFormat, const XMUINT3& gridSize, uint32_t numParticles, uint32_t upsample)
 {
 	m_viewport = XMUINT2(width, height);
 	m_descriptorTableCache = descriptorTableCache;
 	m_gridSize = gridSize;
 	m_numParticles = numParticles;
+	m_upsample = max(upsample, 1u);
+	m_simStep = m_simStep > 0.0f ? m_simStep : (gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f);
+
+	// Block compression only for the ray casting, over whole blocks per slice
+	const XMUINT3 renderGridSize(gridSize.x * m_upsample, gridSize.y * m_upsample, gridSize.z * m_upsample);
+	m_blockCompression = m_blockCompression && m_numParticles == 0 && gridSize.z > 1 &&
+		BlockCompressor::IsCompressible(renderGridSize);
 
 	// Create resources
-	for (uint8_t i = 0; i < 2; ++i)
-	{
-		m_velocities[i] = Texture3D::MakeUnique();
-		N_RETURN(m_velocities[i]->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
-			i ? ResourceFlag::ALLOW_UNORDERED_ACCESS : (ResourceFlag::ALLOW_UNORDERED_ACCESS |
-				ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS), 1, MemoryType::DEFAULT,
-				(L"Velocity" + to_wstring(i)).c_str()), false);
+	N_RETURN(createGridResources(gridSize), false);
+	m_emitterBins.Init(gridSize);
 
-		m_colors[i] = Texture3D::MakeUnique();
-		N_RETURN(m_colors[i]->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
-			ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT,
-			(L"Color" + to_wstring(i)).c_str()), false);
+	// Create the wavelet noise tile for turbulence upsampling
+	if (m_upsample > 1)
+	{
+		const auto tileSize = WaveletTurbulence::NoiseTileSize;
+		m_noise = Texture3D::MakeUnique();
+		N_RETURN(m_noise->Create(m_device.get(), tileSize, tileSize, tileSize, Format::R32G32B32A32_FLOAT,
+			ResourceFlag::NONE, 1, MemoryType::DEFAULT, L"WaveletNoise"), false);
+
+		vector<XMFLOAT4> noise;
+		WaveletTurbulence::GenerateNoiseTile(noise);
+
+		SubresourceData subresourceData;
+		subresourceData.pData = noise.data();
+		subresourceData.RowPitch = sizeof(XMFLOAT4) * tileSize;
+		subresourceData.SlicePitch = subresourceData.RowPitch * tileSize;
+		uploaders.emplace_back(Resource::MakeUnique());
+		N_RETURN(m_noise->Upload(pCommandList, uploaders.back().get(), &subresourceData,
+			1, ResourceState::NON_PIXEL_SHADER_RESOURCE), false);
 	}
 
-	m_incompress = Texture3D::MakeUnique();
-	N_RETURN(m_incompress->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R32_FLOAT,
-		ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT,
-		L"Incompressibility"), false);
+	// Create emitter buffer, which is updated by the CPU for every frame
+	{
+		uint32_t firstElements[FrameCount];
+		for (uint8_t i = 0; i < FrameCount; ++i) firstElements[i] = MaxEmitters * i;
+		m_emitterBuffer = StructuredBuffer::MakeUnique();
+		N_RETURN(m_emitterBuffer->Create(m_device.get(), MaxEmitters * FrameCount, sizeof(Emitter),
+			ResourceFlag::NONE, MemoryType::UPLOAD, FrameCount, firstElements, 0, nullptr,
+			L"EmitterBuffer"), false);
+	}
 
 	// Create constant buffers
 	m_cbPerFrame = ConstantBuffer::MakeUnique();
-	N_RETURN(m_cbPerFrame->Create(m_device.get(), sizeof(CBPerFrame[FrameCount]), FrameCount,
+	N_RETURN(m_cbPerFrame->Create(m_device.get(), sizeof(CBPerFrame[FrameCount * MaxSubsteps]), FrameCount * MaxSubsteps,
 		nullptr, MemoryType::UPLOAD, L"CBPerFrame"), false);
 
 	if (m_numParticles > 0)
@@ -89,6 +170,29 @@ bool Fluid::Init(CommandList* pCommandList, uint32_t width, uint32_t height,
 		m_cbPerObject = ConstantBuffer::MakeUnique();
 		N_RETURN(m_cbPerObject->Create(m_device.get(), sizeof(CBPerObjectGrid3D[FrameCount]), FrameCount,
 			nullptr, MemoryType::UPLOAD, L"CBPerObject"), false);
+
+		// Full-size targets of the ray casting, rendered in the top-left at the render scale,
+		// and the resolved histories of the temporal accumulation
+		m_rayCastColor = RenderTarget::MakeUnique();
+		N_RETURN(m_rayCastColor->Create(m_device.get(), width, height, Format::R16G16B16A16_FLOAT,
+			1, ResourceFlag::NONE, 1, 1, nullptr, false, L"RayCastColor"), false);
+
+		m_rayCastDepth = RenderTarget::MakeUnique();
+		N_RETURN(m_rayCastDepth->Create(m_device.get(), width, height, Format::R16_FLOAT,
+			1, ResourceFlag::NONE, 1, 1, nullptr, false, L"RayCastDepth"), false);
+
+		// Bound of the occupied macro-cells, for the screen rectangle and the ray extents
+		m_boundBuffer = RawBuffer::MakeUnique();
+		N_RETURN(m_boundBuffer->Create(m_device.get(), sizeof(XMFLOAT4[2]), ResourceFlag::ALLOW_UNORDERED_ACCESS,
+			MemoryType::DEFAULT, 1, nullptr, 1, nullptr, L"BoundBuffer"), false);
+
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			m_histories[i] = Texture2D::MakeUnique();
+			N_RETURN(m_histories[i]->Create(m_device.get(), width, height, Format::R16G16B16A16_FLOAT,
+				1, ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, 1, MemoryType::DEFAULT, false,
+				(L"History" + to_wstring(i)).c_str()), false);
+		}
 	}
 
 	ResourceBarrier barrier;
@@ -98,39 +202,213 @@ bool Fluid::Init(CommandList* pCommandList, uint32_t width, uint32_t height,
 	if (numParticles > 0)
 	{
 		m_particleBuffer = StructuredBuffer::MakeUnique();
-		N_RETURN(m_particleBuffer->Create(m_device.get(), numParticles, sizeof(ParticleInfo),
+		N_RETURN(m_particleBuffer->Create(m_device.get(), numParticles, sizeof(PackedParticle),
 			ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 1, nullptr, 1,
 			nullptr, L"ParticleBuffer"), false);
 
-		vector<ParticleInfo> particles(numParticles);
-		for (auto& particle : particles)
+		m_deadListBuffer = StructuredBuffer::MakeUnique();
+		N_RETURN(m_deadListBuffer->Create(m_device.get(), numParticles, sizeof(uint32_t),
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 0, nullptr, 1,
+			nullptr, L"DeadList"), false);
+
+		for (uint8_t i = 0; i < 2; ++i)
 		{
-			particle = {};
-			particle.Pos.y = FLT_MAX;
-			particle.LifeTime = rand() % numParticles / 10000.0f;
+			m_aliveListBuffers[i] = StructuredBuffer::MakeUnique();
+			N_RETURN(m_aliveListBuffers[i]->Create(m_device.get(), numParticles, sizeof(uint32_t),
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 1, nullptr, 1,
+				nullptr, (L"AliveList" + to_wstring(i)).c_str()), false);
 		}
+
+		m_counterBuffer = RawBuffer::MakeUnique();
+		N_RETURN(m_counterBuffer->Create(m_device.get(), sizeof(uint32_t[4]), ResourceFlag::ALLOW_UNORDERED_ACCESS,
+			MemoryType::DEFAULT, 0, nullptr, 1, nullptr, L"ParticleCounters"), false);
+
+		m_argumentBuffer = RawBuffer::MakeUnique();
+		N_RETURN(m_argumentBuffer->Create(m_device.get(), sizeof(uint32_t[7]), ResourceFlag::ALLOW_UNORDERED_ACCESS,
+			MemoryType::DEFAULT, 0, nullptr, 1, nullptr, L"ParticleArguments"), false);
+
+		// The dead list and the counters are initialized by CSInitParticles, without host staging
+		const uint32_t arguments[7] = {};
 		uploaders.emplace_back(Resource::MakeUnique());
-		m_particleBuffer->Upload(pCommandList, uploaders.back().get(), particles.data(),
-			sizeof(ParticleInfo) * numParticles);
+		N_RETURN(m_argumentBuffer->Upload(pCommandList, uploaders.back().get(), arguments, sizeof(arguments)), false);
+
+		// Sort and gather buffers of the spatial reorder, with the sort padded to a power of 2
+		if (m_reorderInterval > 0)
+		{
+			for (m_sortCapacity = g_sortChunkSize; m_sortCapacity < numParticles;) m_sortCapacity <<= 1;
+			m_sortBuffer = StructuredBuffer::MakeUnique();
+			N_RETURN(m_sortBuffer->Create(m_device.get(), m_sortCapacity, sizeof(XMUINT2),
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 0, nullptr, 1,
+				nullptr, L"ParticleSortBuffer"), false);
+
+			m_reorderBuffer = StructuredBuffer::MakeUnique();
+			N_RETURN(m_reorderBuffer->Create(m_device.get(), numParticles, sizeof(PackedParticle),
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 0, nullptr, 1,
+				nullptr, L"ParticleReorderBuffer"), false);
+		}
+
+		// Visible list of the per-frame culling, drawn instead of the alive list
+		m_visibleListBuffer = StructuredBuffer::MakeUnique();
+		N_RETURN(m_visibleListBuffer->Create(m_device.get(), numParticles, sizeof(VisibleParticle),
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 1, nullptr, 1,
+			nullptr, L"ParticleVisibleList"), false);
+
+		// Particle IDs binned by brick for the transfer of the hybrid solver, for up to 8 bricks
+		// overlapped by the trilinear support of each particle
+		if (m_flipRatio >= 0.0f)
+		{
+			m_binnedBuffer = StructuredBuffer::MakeUnique();
+			N_RETURN(m_binnedBuffer->Create(m_device.get(), numParticles * 8, sizeof(uint32_t),
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 0, nullptr, 1,
+				nullptr, L"ParticleBinnedList"), false);
+		}
+
+		// Sustain the capacity over the average lifetime
+		m_emissionRate = numParticles / (ParticleCPU::FullLife + 0.5f);
 	}
 
 	// Create pipelines
 	N_RETURN(createPipelineLayouts(), false);
 	N_RETURN(createPipelines(rtFormat, dsFormat), false);
 	N_RETURN(createDescriptorTables(), false);
+	if (m_numParticles > 0)
+	{
+		N_RETURN(createCommandLayouts(), false);
+
+		const DescriptorPool descriptorPool = m_descriptorTableCache->GetDescriptorPool(CBV_SRV_UAV_POOL);
+		pCommandList->SetDescriptorPools(1, &descriptorPool);
+		initParticles(pCommandList);
+	}
+
+	return true;
+}
+
+bool Fluid::Resize(const XMUINT3& gridSize)
+{
+	// The pipelines are specialized for 2D or 3D
+	if ((gridSize.z > 1) != (m_gridSize.z > 1)) return false;
+	if (m_blockCompression && !BlockCompressor::IsCompressible(XMUINT3(gridSize.x * m_upsample,
+		gridSize.y * m_upsample, gridSize.z * m_upsample))) return false;
+	if (gridSize.x == m_gridSize.x && gridSize.y == m_gridSize.y && gridSize.z == m_gridSize.z) return true;
+
+	// Keep the grid holding the latest state if the previous resize has not been resampled yet
+	const auto pGrid = m_grid;
+	if (!m_srcGrid)
+	{
+		m_srcGrid = m_grid;
+		m_srcGridSize = m_gridSize;
+	}
+
+	// Switch to the pooled resources of the new size, and rebuild only the grid descriptor tables
+	if (!createGridResources(gridSize) || !createGridDescriptorTables())
+	{
+		if (m_srcGrid == pGrid) m_srcGrid = nullptr;
+		createGridResources(m_gridSize);
+		createGridDescriptorTables();
+
+		return false;
+	}
+	m_gridSize = gridSize;
+	m_emitterBins.Init(gridSize);
+	if (m_srcGrid == m_grid) m_srcGrid = nullptr;
+	m_isEncoded = false;
 
 	return true;
 }
 
+void Fluid::SetEmitters(uint32_t numEmitters, const Emitter* pEmitters)
+{
+	numEmitters = min(numEmitters, MaxEmitters);
+	m_emitters.assign(pEmitters, pEmitters + numEmitters);
+}
+
+void Fluid::SetSimulationRate(float rate)
+{
+	m_simStep = rate > 0.0f ? 1.0f / rate : 0.0f;
+}
+
+void Fluid::SetSeed(uint32_t seed)
+{
+	m_seed = seed;
+}
+
+void Fluid::SetReorderInterval(uint32_t interval)
+{
+	m_reorderInterval = interval;
+}
+
+void Fluid::SetFlipRatio(float ratio)
+{
+	m_flipRatio = ratio;
+}
+
+void Fluid::SetIntegrator(ParticleCPU::Integrator integrator)
+{
+	m_integrator = integrator;
+}
+
+void Fluid::SetFrameBudget(float budget)
+{
+	m_frameBudget = budget;
+	m_renderScale = budget > 0.0f ? m_renderScale : 1.0f;
+}
+
+void Fluid::SetBlockCompression(bool compress)
+{
+	m_blockCompression = compress;
+}
+
 void Fluid::UpdateFrame(float timeStep, uint8_t frameIndex,
 	const XMFLOAT4X4& view, const XMFLOAT4X4& proj, const XMFLOAT3& eyePt)
 {
-	// Per-frame
+	// Fixed-rate simulation: as many steps as the accumulated time covers, up to MaxSubsteps
+	// per frame with only the backlog beyond dropped, and render in between the last two states
+	m_timeInterval += timeStep;
+	m_numSubsteps = static_cast<uint8_t>(min(m_timeInterval / m_simStep, static_cast<float>(MaxSubsteps)));
+	m_timeStep = m_numSubsteps > 0 ? m_simStep : 0.0f;
+	m_timeInterval = min(m_timeInterval - m_simStep * m_numSubsteps, m_simStep);
+	m_interpFactor = m_timeInterval / m_simStep;
+	m_time += timeStep;
+
+	// The rendered volume only changes with the steps, the interpolation and the turbulence over time
+	m_isVolumeChanged = m_numSubsteps > 0 || timeStep > 0.0f;
+	if (m_isVolumeChanged) m_isEncoded = false;
+
+	// Emitters binned into bricks, so that each cell only evaluates the emitters overlapping it
+	const auto numEmitters = static_cast<uint32_t>(m_emitters.size());
 	{
-		const auto pCbData = reinterpret_cast<CBPerFrame*>(m_cbPerFrame->Map(frameIndex));
-		pCbData->TimeStep = timeStep;
-		pCbData->BaseSeed = rand();
+		const auto numIndices = m_emitterBins.Bin(numEmitters, m_emitters.data());
+		memcpy(m_emitterBuffer->Map(frameIndex), m_emitters.data(), sizeof(Emitter) * numEmitters);
+		memcpy(m_brickRangeBuffer->Map(frameIndex), m_emitterBins.GetBrickRanges(),
+			sizeof(XMUINT2) * m_emitterBins.GetNumBricks());
+		memcpy(m_emitterIndexBuffer->Map(frameIndex), m_emitterBins.GetIndices(), sizeof(uint32_t) * numIndices);
+
+		// Crowded bricks keep only their first emitters, so report whenever that changes
+		const auto numDropped = m_emitterBins.GetNumDropped();
+		if (numDropped != m_numDroppedEmitters && numDropped > 0)
+		{
+			stringstream warning;
+			warning << "Warning: " << numDropped << " emitter-brick overlaps beyond "
+				<< EmitterBins::MaxEmittersPerBrick << " emitters per brick are dropped" << endl;
+			OutputDebugStringA(warning.str().c_str());
+		}
+		m_numDroppedEmitters = numDropped;
+	}
+
+	// Per-frame, one set per simulation step of the frame
+	for (uint8_t i = 0; i < max<uint8_t>(m_numSubsteps, 1); ++i)
+	{
+		const auto pCbData = reinterpret_cast<CBPerFrame*>(m_cbPerFrame->Map(frameIndex * MaxSubsteps + i));
+		pCbData->TimeStep = m_timeStep;
+		pCbData->Step = m_step + i;
+		pCbData->NumEmitters = numEmitters;
+		pCbData->RenderTimeOffset = (m_interpFactor - 1.0f) * m_simStep;
+		pCbData->Seed = m_seed;
+		pCbData->FlipRatio = m_flipRatio;
+		pCbData->Integrator = m_integrator;
+		pCbData->FullLife = ParticleCPU::FullLife;
 	}
+	m_substep = 0;
 
 	// Per-object
 	const auto world = XMMatrixScaling(10.0f, 10.0f, 10.0f);
@@ -149,6 +427,10 @@ void Fluid::UpdateFrame(float timeStep, uint8_t frameIndex,
 			XMStoreFloat4x4(&pCbData->Proj, XMMatrixScaling(0.1f, 0.1f, 0.1f));
 		}
 
+		// The projected radius in pixels is the radius times the vertical projection scale over the view depth
+		const auto projScale = m_gridSize.z > 1 ? proj._22 : 0.1f;
+		m_lodDistance = ParticleCPU::ParticleRadius * projScale * 0.5f * m_viewport.y / g_minParticlePixels;
+
 		XMStoreFloat3x4(&pCbData->WorldView, worldView);
 		XMStoreFloat3x4(&pCbData->WorldViewI, XMMatrixInverse(nullptr, worldView));
 	}
@@ -160,100 +442,311 @@ void Fluid::UpdateFrame(float timeStep, uint8_t frameIndex,
 
 		// Screen space matrices
 		const auto pCbData = reinterpret_cast<CBPerObjectGrid3D*>(m_cbPerObject->Map(frameIndex));
-		pCbData->LocalSpaceLightPt = XMVector3TransformCoord(XMVectorSet(75.0f, 75.0f, -75.0f, 0.0f), worldI);
+		const auto localSpaceLightPt = XMVector3TransformCoord(XMVectorSet(75.0f, 75.0f, -75.0f, 0.0f), worldI);
+		pCbData->LocalSpaceLightPt = localSpaceLightPt;
+
+		// Recompute all cells of the light transmittance if the sweep has changed
+		XMFLOAT3 lightPt;
+		XMStoreFloat3(&lightPt, localSpaceLightPt);
+		const auto lightSweep = RayCasterCPU::GetLightSweep(lightPt, XMUINT3(m_gridSize.x * m_upsample,
+			m_gridSize.y * m_upsample, m_gridSize.z * m_upsample));
+		if (memcmp(&lightSweep, &m_lightSweep, sizeof(lightSweep)))
+		{
+			m_lightSweep = lightSweep;
+			m_lightStamp = 0;
+		}
 		pCbData->LocalSpaceEyePt = XMVector3TransformCoord(XMLoadFloat3(&eyePt), worldI);
 
-		const auto mToScreen = XMMATRIX
-		(
-			0.5f * m_viewport.x, 0.0f, 0.0f, 0.0f,
-			0.0f, -0.5f * m_viewport.y, 0.0f, 0.0f,
-			0.0f, 0.0f, 1.0f, 0.0f,
-			0.5f * m_viewport.x, 0.5f * m_viewport.y, 0.0f, 1.0f
-		);
-		const auto localToScreen = XMMatrixMultiply(worldViewProj, mToScreen);
-		const auto screenToLocal = XMMatrixInverse(nullptr, localToScreen);
-		pCbData->ScreenToLocal = XMMatrixTranspose(screenToLocal);
+		const auto toScreen = [&worldViewProj](float width, float height)
+		{
+			const auto mToScreen = XMMATRIX
+			(
+				0.5f * width, 0.0f, 0.0f, 0.0f,
+				0.0f, -0.5f * height, 0.0f, 0.0f,
+				0.0f, 0.0f, 1.0f, 0.0f,
+				0.5f * width, 0.5f * height, 0.0f, 1.0f
+			);
+
+			return XMMatrixInverse(nullptr, XMMatrixMultiply(worldViewProj, mToScreen));
+		};
+
+		// Ray casting at the render scale with the jittered pixels, resolved to the viewport
+		// over the history reprojected with the last frame
+		if (timeStep > 0.0f) updateRenderScale(timeStep);
+		const auto jitter = RayCasterCPU::GetJitter(m_numResolved);
+		if (m_numResolved == 0) XMStoreFloat4x4(&m_prevWorldViewProj, worldViewProj);
+		pCbData->ScreenToLocal = XMMatrixTranspose(XMMatrixTranslation(jitter.x, jitter.y, 0.0f) *
+			toScreen(m_viewport.x * m_renderScale, m_viewport.y * m_renderScale));
 		pCbData->WorldViewProj = XMMatrixTranspose(worldViewProj);
+		pCbData->PrevWorldViewProj = XMMatrixTranspose(XMLoadFloat4x4(&m_prevWorldViewProj));
+		pCbData->ResolveToLocal = XMMatrixTranspose(toScreen(static_cast<float>(m_viewport.x),
+			static_cast<float>(m_viewport.y)));
+		pCbData->Jitter = jitter;
+		pCbData->RenderScale = m_renderScale;
+		pCbData->HistoryBlend = m_numResolved > 0 ? RayCasterCPU::HistoryBlend : 1.0f;
+		pCbData->RenderViewport = XMFLOAT2(m_viewport.x * m_renderScale, m_viewport.y * m_renderScale);
+		XMStoreFloat4x4(&m_prevWorldViewProj, worldViewProj);
+		++m_numResolved;
+	}
+}
+
+void Fluid::Simulate(CommandList* pCommandList, uint8_t frameIndex)
+{
+	// Carry the simulation state over from the grid before resize
+	const auto isResampled = m_srcGrid != nullptr;
+	if (isResampled) resample(pCommandList);
+
+	// Fixed-rate simulation steps, each with its own per-frame constants; the passes
+	// after them take the constants of the last
+	for (m_substep = 0; m_substep < m_numSubsteps; ++m_substep)
+	{
+		m_frameParity = !m_frameParity;
+		++m_step;
+
+		// Hybrid solver: the particles carry their velocities onto the grid before the step
+		if (m_transfer) transferToGrid(pCommandList);
+		advance(pCommandList, frameIndex);
+		if (m_numParticles > 0) updateParticles(pCommandList, frameIndex);
+
+		// Periodic spatial reorder, so that neighboring particles sample neighboring cells
+		if (m_sortBuffer && m_step % m_reorderInterval == 0) reorderParticles(pCommandList);
 	}
+	m_substep = m_numSubsteps > 0 ? m_numSubsteps - 1 : 0;
+
+	// Temporal interpolation of the simulated states for rendering
+	interpolate(pCommandList);
 
-	m_timeStep = timeStep;
-	if (timeStep > 0.0) m_frameParity = !m_frameParity;
+	// Render-resolution detail
+	if (m_upsample > 1) synthesizeTurbulence(pCommandList);
+
+	// Light transmittance of the rendered volume, updated with every change of the volume, which is
+	// interpolated in between the steps, or of the light; the stamps limit it to the cells downstream
+	const auto isLightForced = isResampled || m_lightStamp == 0;
+	if (m_lightTrans && (m_isVolumeChanged || isLightForced)) updateLightTrans(pCommandList, isLightForced);
+
+	// Particle shading normals of the rendered volume, so that they stay consistent with the
+	// colors, which are interpolated every frame
+	if (m_numParticles > 0) computeGradient(pCommandList);
 }
 
-void Fluid::Simulate(const CommandList* pCommandList, uint8_t frameIndex)
+void Fluid::Render(CommandList* pCommandList, uint8_t frameIndex, const Descriptor& rtv)
 {
-	ResourceBarrier barriers[3];
+	if (m_numParticles > 0) renderParticles(pCommandList, frameIndex);
+	else if (m_gridSize.z > 1) rayCast(pCommandList, frameIndex, rtv);
+	else visualizeColor(pCommandList);
+}
 
-	auto timeStep = m_gridSize.z > 1 ? 1.0f / 60.0f : 1.0f / 800.0f;
-	m_timeInterval = m_timeInterval > timeStep ? 0.0f : m_timeInterval;
-	m_timeInterval += m_timeStep;
-	timeStep = m_timeInterval < timeStep ? 0.0f : timeStep;
+bool Fluid::createGridResources(const XMUINT3& gridSize)
+{
+	const auto key = (static_cast<uint64_t>(gridSize.z) << 42) | (static_cast<uint64_t>(gridSize.y) << 21) | gridSize.x;
+	auto found = m_gridPool.find(key);
 
-	// Advection
+	// Reuse the pooled allocations if the grid size has been used before
+	if (found == m_gridPool.end())
 	{
-		// Set barriers (promotions)
-		m_velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
-		auto numBarriers = m_velocities[1]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
-		numBarriers = m_colors[m_frameParity]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
-		pCommandList->Barrier(numBarriers, barriers);
+		GridResources grid;
+		for (uint8_t i = 0; i < 2; ++i)
+		{
+			grid.Velocities[i] = Texture3D::MakeUnique();
+			N_RETURN(grid.Velocities[i]->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
+				i ? ResourceFlag::ALLOW_UNORDERED_ACCESS : (ResourceFlag::ALLOW_UNORDERED_ACCESS |
+					ResourceFlag::ALLOW_SIMULTANEOUS_ACCESS), 1, MemoryType::DEFAULT,
+				(L"Velocity" + to_wstring(i)).c_str()), false);
 
-		// Set pipeline state
-		pCommandList->SetComputePipelineLayout(m_pipelineLayouts[ADVECT]);
-		pCommandList->SetPipelineState(m_pipelines[ADVECT]);
+			grid.Colors[i] = Texture3D::MakeUnique();
+			N_RETURN(grid.Colors[i]->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT,
+				(L"Color" + to_wstring(i)).c_str()), false);
+		}
 
-		// Set descriptor tables
-		pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(), m_cbPerFrame->GetCBVOffset(frameIndex));
-		pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_VECOLITY]);
-		pCommandList->SetComputeDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_MIRROR]);
-		pCommandList->SetComputeDescriptorTable(3, m_srvUavTables[SRV_UAV_TABLE_COLOR + m_frameParity]);
+		grid.Incompress = Texture3D::MakeUnique();
+		N_RETURN(grid.Incompress->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R32_FLOAT,
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT,
+			L"Incompressibility"), false);
+
+		grid.Vorticity = Texture3D::MakeUnique();
+		N_RETURN(grid.Vorticity->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"Vorticity"), false);
+
+		// Create the color blended between the last two simulated states for rendering, with the mip chain
+		// of the adaptive sampling if ray cast directly
+		const auto isRayCast = m_numParticles == 0 && gridSize.z > 1;
+		const auto renderGridSize = XMUINT3(gridSize.x * m_upsample, gridSize.y * m_upsample, gridSize.z * m_upsample);
+		uint8_t numMips = isRayCast && m_upsample <= 1 ? RayCasterCPU::GetNumMips(gridSize) : 1;
+		grid.ColorInterp = Texture3D::MakeUnique();
+		N_RETURN(grid.ColorInterp->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
+			ResourceFlag::ALLOW_UNORDERED_ACCESS, numMips, MemoryType::DEFAULT, L"ColorInterp"), false);
+		if (numMips > 1) N_RETURN(grid.ColorInterp->CreateSRVLevels(numMips), false);
+
+		// Create the render-resolution color for turbulence upsampling
+		if (m_upsample > 1)
+		{
+			numMips = isRayCast ? RayCasterCPU::GetNumMips(renderGridSize) : 1;
+			grid.ColorHiRes = Texture3D::MakeUnique();
+			N_RETURN(grid.ColorHiRes->Create(m_device.get(), renderGridSize.x, renderGridSize.y,
+				gridSize.z > 1 ? renderGridSize.z : 1, Format::R16G16B16A16_FLOAT,
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, numMips, MemoryType::DEFAULT, L"ColorHiRes"), false);
+			if (numMips > 1) N_RETURN(grid.ColorHiRes->CreateSRVLevels(numMips), false);
+		}
 
-		pCommandList->Dispatch(DIV_UP(m_gridSize.x, 8), DIV_UP(m_gridSize.y, 8), m_gridSize.z);
-	}
+		// Create the packed density-gradient normals of the rendered volume for particle shading,
+		// at the same resolution as the colors the particles are shaded with
+		if (m_numParticles > 0)
+		{
+			const auto pVolume = m_upsample > 1 ? grid.ColorHiRes.get() : grid.ColorInterp.get();
+			grid.Normal = Texture3D::MakeUnique();
+			N_RETURN(grid.Normal->Create(m_device.get(), pVolume->GetWidth(), pVolume->GetHeight(), pVolume->GetDepth(),
+				Format::R8G8B8A8_SNORM, ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"Normal"), false);
+		}
 
-	// Projection
-	{
-		// Set barriers
-		auto numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
-		numBarriers = m_velocities[1]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
-		numBarriers = m_colors[m_frameParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
-			ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
-		pCommandList->Barrier(numBarriers, barriers);
+		// Create the particle-to-grid transfer of the hybrid solver
+		if (m_numParticles > 0 && m_flipRatio >= 0.0f)
+		{
+			grid.Transfer = Texture3D::MakeUnique();
+			N_RETURN(grid.Transfer->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"Transfer"), false);
 
-		// Set pipeline state
-		pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PROJECT]);
-		pCommandList->SetPipelineState(m_pipelines[PROJECT]);
+			grid.GridVelocity = Texture3D::MakeUnique();
+			N_RETURN(grid.GridVelocity->Create(m_device.get(), gridSize.x, gridSize.y, gridSize.z, Format::R16G16B16A16_FLOAT,
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"GridVelocity"), false);
+		}
 
-		// Set descriptor tables
-		pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(), m_cbPerFrame->GetCBVOffset(frameIndex));
-		pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_VECOLITY1]);
-		
-		XMUINT3 numGroups;
-		if (m_gridSize.z > 1) // optimized for 3D
+		// Create the block-compressed levels of the rendered volume for ray casting, and the blocks
+		// encoded for them, which are copied in as the same bits
+		if (isRayCast && m_blockCompression)
 		{
-			numGroups.x = DIV_UP(m_gridSize.x, 4);
-			numGroups.y = DIV_UP(m_gridSize.y, 4);
-			numGroups.z = DIV_UP(m_gridSize.z, 4);
+			const auto pVolume = m_upsample > 1 ? grid.ColorHiRes.get() : grid.ColorInterp.get();
+			numMips = BlockCompressor::GetNumMips(renderGridSize, pVolume->GetNumMips());
+			grid.CompressedColor = Texture3D::MakeUnique();
+			N_RETURN(grid.CompressedColor->Create(m_device.get(), renderGridSize.x, renderGridSize.y, renderGridSize.z,
+				Format::BC6H_UF16, ResourceFlag::NONE, numMips, MemoryType::DEFAULT, L"CompressedColor"), false);
+
+			grid.CompressedDensity = Texture3D::MakeUnique();
+			N_RETURN(grid.CompressedDensity->Create(m_device.get(), renderGridSize.x, renderGridSize.y, renderGridSize.z,
+				Format::BC4_UNORM, ResourceFlag::NONE, numMips, MemoryType::DEFAULT, L"CompressedDensity"), false);
+
+			const auto numBlocks = BlockCompressor::GetNumBlocks(renderGridSize);
+			grid.ColorBlocks = Texture3D::MakeUnique();
+			N_RETURN(grid.ColorBlocks->Create(m_device.get(), numBlocks.x, numBlocks.y, numBlocks.z,
+				Format::R32G32B32A32_UINT, ResourceFlag::ALLOW_UNORDERED_ACCESS, numMips, MemoryType::DEFAULT,
+				L"ColorBlocks"), false);
+
+			grid.DensityBlocks = Texture3D::MakeUnique();
+			N_RETURN(grid.DensityBlocks->Create(m_device.get(), numBlocks.x, numBlocks.y, numBlocks.z,
+				Format::R32G32_UINT, ResourceFlag::ALLOW_UNORDERED_ACCESS, numMips, MemoryType::DEFAULT,
+				L"DensityBlocks"), false);
 		}
-		else
+
+		// Create the occupancy grid of the rendered volume for empty-space skipping in ray casting, in full
+		// precision, so that the maximum densities are never rounded down below the threshold
+		if (isRayCast)
 		{
-			numGroups.x = DIV_UP(m_gridSize.x, 8);
-			numGroups.y = DIV_UP(m_gridSize.y, 8);
-			numGroups.z = m_gridSize.z;
+			const auto occupancySize = RayCasterCPU::GetOccupancySize(renderGridSize);
+			grid.Occupancy = Texture3D::MakeUnique();
+			N_RETURN(grid.Occupancy->Create(m_device.get(), occupancySize.x, occupancySize.y, occupancySize.z,
+				Format::R32_FLOAT, ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"Occupancy"), false);
+
+			// Create the light transmittance swept from the rendered volume, with the densities and the update
+			// indices of the incremental updates; all are read back as UAVs in the sweep, hence 32-bit
+			grid.LightTrans = Texture3D::MakeUnique();
+			N_RETURN(grid.LightTrans->Create(m_device.get(), renderGridSize.x, renderGridSize.y, renderGridSize.z,
+				Format::R32_FLOAT, ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"LightTransmittance"), false);
+
+			grid.LightDensity = Texture3D::MakeUnique();
+			N_RETURN(grid.LightDensity->Create(m_device.get(), renderGridSize.x, renderGridSize.y, renderGridSize.z,
+				Format::R32_FLOAT, ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"LightDensity"), false);
+
+			grid.LightStamps = Texture3D::MakeUnique();
+			N_RETURN(grid.LightStamps->Create(m_device.get(), renderGridSize.x, renderGridSize.y, renderGridSize.z,
+				Format::R32_UINT, ResourceFlag::ALLOW_UNORDERED_ACCESS, 1, MemoryType::DEFAULT, L"LightStamps"), false);
 		}
 
-		pCommandList->Dispatch(numGroups.x, numGroups.y, numGroups.z);
+		// Create emitter brick buffers, which are updated by the CPU for every frame
+		EmitterBins emitterBins;
+		emitterBins.Init(gridSize);
+
+		uint32_t firstElements[FrameCount];
+		const auto numBricks = emitterBins.GetNumBricks();
+		for (uint8_t i = 0; i < FrameCount; ++i) firstElements[i] = numBricks * i;
+		grid.BrickRangeBuffer = StructuredBuffer::MakeUnique();
+		N_RETURN(grid.BrickRangeBuffer->Create(m_device.get(), numBricks * FrameCount, sizeof(XMUINT2),
+			ResourceFlag::NONE, MemoryType::UPLOAD, FrameCount, firstElements, 0, nullptr,
+			L"BrickRangeBuffer"), false);
+
+		const auto maxIndices = emitterBins.GetMaxIndices();
+		for (uint8_t i = 0; i < FrameCount; ++i) firstElements[i] = maxIndices * i;
+		grid.EmitterIndexBuffer = StructuredBuffer::MakeUnique();
+		N_RETURN(grid.EmitterIndexBuffer->Create(m_device.get(), maxIndices * FrameCount, sizeof(uint32_t),
+			ResourceFlag::NONE, MemoryType::UPLOAD, FrameCount, firstElements, 0, nullptr,
+			L"EmitterIndexBuffer"), false);
+
+		// Create the particle bins of the transfer over the same bricks, with the counts followed by the
+		// offsets and the total; the counts start zeroed as committed resources, and the binning counts
+		// them back down to zero
+		if (grid.Transfer)
+		{
+			grid.BinBuffer = RawBuffer::MakeUnique();
+			N_RETURN(grid.BinBuffer->Create(m_device.get(), sizeof(uint32_t) * (numBricks * 2 + 1),
+				ResourceFlag::ALLOW_UNORDERED_ACCESS, MemoryType::DEFAULT, 0, nullptr, 1, nullptr, L"BinBuffer"), false);
+		}
+
+		found = m_gridPool.emplace(key, move(grid)).first;
 	}
-}
 
-void Fluid::Render(const CommandList* pCommandList, uint8_t frameIndex)
-{
-	if (m_numParticles > 0) renderParticles(pCommandList, frameIndex);
-	else if (m_gridSize.z > 1) rayCast(pCommandList, frameIndex);
-	else visualizeColor(pCommandList);
+	auto& grid = found->second;
+	grid.LastUsed = ++m_gridStamp;
+	m_grid = &grid;
+
+	// Evict the least recently used grids beyond the cap, other than the grid to resample from;
+	// the GPU has finished with them, as the resizes wait for it
+	while (m_gridPool.size() > MaxPooledGrids)
+	{
+		auto evicted = m_gridPool.end();
+		for (auto it = m_gridPool.begin(); it != m_gridPool.end(); ++it)
+			if (&it->second != m_grid && &it->second != m_srcGrid &&
+				(evicted == m_gridPool.end() || it->second.LastUsed < evicted->second.LastUsed)) evicted = it;
+		if (evicted == m_gridPool.end()) break;
+		m_gridPool.erase(evicted);
+	}
+
+	for (uint8_t i = 0; i < 2; ++i)
+	{
+		m_velocities[i] = grid.Velocities[i].get();
+		m_colors[i] = grid.Colors[i].get();
+	}
+	m_incompress = grid.Incompress.get();
+	m_vorticity = grid.Vorticity.get();
+	m_colorInterp = grid.ColorInterp.get();
+	m_colorHiRes = grid.ColorHiRes.get();
+	m_normal = grid.Normal.get();
+	m_transfer = grid.Transfer.get();
+	m_gridVelocity = grid.GridVelocity.get();
+	m_compressedColor = grid.CompressedColor.get();
+	m_compressedDensity = grid.CompressedDensity.get();
+	m_colorBlocks = grid.ColorBlocks.get();
+	m_densityBlocks = grid.DensityBlocks.get();
+	m_occupancy = grid.Occupancy.get();
+	m_lightTrans = grid.LightTrans.get();
+	m_lightDensity = grid.LightDensity.get();
+	m_lightStamps = grid.LightStamps.get();
+	m_binBuffer = grid.BinBuffer.get();
+	m_brickRangeBuffer = grid.BrickRangeBuffer.get();
+	m_emitterIndexBuffer = grid.EmitterIndexBuffer.get();
+
+	return true;
 }
 
 bool Fluid::createPipelineLayouts()
 {
+	// Vorticity
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(0, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[VORTICITY], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"VorticityLayout"), false);
+	}
+
 	// Advection
 	{
 		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
@@ -263,6 +756,13 @@ bool Fluid::createPipelineLayouts()
 		pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
 		pipelineLayout->SetRange(3, DescriptorType::SRV, 1, 1);
 		pipelineLayout->SetRange(3, DescriptorType::UAV, 1, 1, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(4, DescriptorType::SRV, 3, 2);
+		pipelineLayout->SetRange(5, DescriptorType::SRV, 1, 5);
+		if (m_transfer)
+		{
+			pipelineLayout->SetRange(6, DescriptorType::SRV, 1, 6);
+			pipelineLayout->SetRange(6, DescriptorType::UAV, 1, 2, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		}
 		X_RETURN(m_pipelineLayouts[ADVECT], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
 			PipelineLayoutFlag::NONE, L"AdvectionLayout"), false);
 	}
@@ -277,94 +777,505 @@ bool Fluid::createPipelineLayouts()
 			PipelineLayoutFlag::NONE, L"ProjectionLayout"), false);
 	}
 
-	if (m_numParticles > 0)
+	// Resampling for resize
 	{
-		// Particle rendering
 		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
-		pipelineLayout->SetRootCBV(0, 0, 0, Shader::Stage::VS);
-		pipelineLayout->SetRootCBV(1, 1);
-		pipelineLayout->SetRange(2, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
-		pipelineLayout->SetRange(2, DescriptorType::SRV, 1, 0);
-		pipelineLayout->SetRange(3, DescriptorType::SRV, 1, 0);
-		pipelineLayout->SetRange(4, DescriptorType::SAMPLER, 1, 0);
-		pipelineLayout->SetShaderStage(2, Shader::Stage::VS);
-		pipelineLayout->SetShaderStage(3, Shader::Stage::DS);
-		X_RETURN(m_pipelineLayouts[VISUALIZE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
-			PipelineLayoutFlag::NONE, L"ParticleLayout"), false);
+		pipelineLayout->SetConstants(0, 1, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 4, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 4, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
+		X_RETURN(m_pipelineLayouts[RESAMPLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ResamplingLayout"), false);
 	}
-	else if (m_gridSize.z > 1)
+
+	if (m_numParticles > 0)
 	{
-		// Ray casting
+		// Density gradient for particle shading
 		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
-		pipelineLayout->SetRootCBV(0, 0, 0, Shader::Stage::PS);
-		pipelineLayout->SetRange(1, DescriptorType::SRV, 1, 0);
-		pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
-		pipelineLayout->SetShaderStage(0, Shader::Stage::PS);
-		pipelineLayout->SetShaderStage(1, Shader::Stage::PS);
-		pipelineLayout->SetShaderStage(2, Shader::Stage::PS);
-		X_RETURN(m_pipelineLayouts[VISUALIZE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
-			PipelineLayoutFlag::NONE, L"RayCastingLayout"), false);
+		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(0, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[GRADIENT], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"GradientLayout"), false);
 	}
-	else
+
+	if (m_transfer)
 	{
-		// Visualization
+		// Particle-to-grid transfer of the hybrid solver, sharing the layout among the binning passes
 		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
-		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
-		pipelineLayout->SetRange(1, DescriptorType::SAMPLER, 1, 0);
-		pipelineLayout->SetShaderStage(0, Shader::PS);
-		pipelineLayout->SetShaderStage(1, Shader::PS);
-		X_RETURN(m_pipelineLayouts[VISUALIZE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
-			PipelineLayoutFlag::NONE, L"VisualizationLayout"), false);
+		pipelineLayout->SetConstants(0, 4, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 2, 0);
+		pipelineLayout->SetRange(2, DescriptorType::UAV, 4, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[COUNT_PARTICLE_BIN], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleToGridLayout"), false);
+		for (uint8_t i = SCAN_PARTICLE_BIN; i <= PARTICLE_TO_GRID; ++i) m_pipelineLayouts[i] = m_pipelineLayouts[COUNT_PARTICLE_BIN];
 	}
 
-	return true;
-}
+	if (m_numParticles > 0)
+	{
+		// Particle list initialization
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 1, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 4, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[INIT_PARTICLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleInitLayout"), false);
+	}
 
-bool Fluid::createPipelines(Format rtFormat, Format dsFormat)
-{
-	auto vsIndex = 0u;
-	auto hsIndex = 0u;
-	auto dsIndex = 0u;
-	auto psIndex = 0u;
-	auto csIndex = 0u;
+	if (m_numParticles > 0)
+	{
+		// Particle integration over the alive list
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRootCBV(0, 0);
+		pipelineLayout->SetConstants(1, 1, 1);
+		pipelineLayout->SetRange(2, DescriptorType::UAV, 4, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(2, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(3, DescriptorType::SRV, 1, 1);
+		pipelineLayout->SetRange(4, DescriptorType::SAMPLER, 1, 0);
+		if (m_transfer) pipelineLayout->SetRange(5, DescriptorType::SRV, 1, 6);
+		X_RETURN(m_pipelineLayouts[UPDATE_PARTICLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleUpdateLayout"), false);
+	}
 
-	// Advection
+	if (m_numParticles > 0)
 	{
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSAdvect.cso"), false);
+		// Budgeted particle emission
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRootCBV(0, 0);
+		pipelineLayout->SetConstants(1, 3, 1);
+		pipelineLayout->SetRange(2, DescriptorType::UAV, 4, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(3, DescriptorType::SRV, 3, 2);
+		X_RETURN(m_pipelineLayouts[EMIT_PARTICLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleEmissionLayout"), false);
+	}
 
-		const auto state = Compute::State::MakeUnique();
-		state->SetPipelineLayout(m_pipelineLayouts[ADVECT]);
-		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
-		X_RETURN(m_pipelines[ADVECT], state->GetPipeline(m_computePipelineCache.get(), L"Advection"), false);
+	if (m_numParticles > 0)
+	{
+		// Indirect argument preparation
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 1, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 2, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[PREPARE_ARGS], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ArgumentPreparationLayout"), false);
 	}
 
-	// Projection
+	if (m_numParticles > 0)
 	{
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, m_gridSize.z > 1 ?
-			L"CSProject3D.cso" : L"CSProject2D.cso"), false);
+		// Particle culling and LOD per frame
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRootCBV(0, 0);
+		pipelineLayout->SetRootCBV(1, 1);
+		pipelineLayout->SetConstants(2, 2, 2);
+		pipelineLayout->SetRange(3, DescriptorType::SRV, 2, 0);
+		pipelineLayout->SetRange(4, DescriptorType::UAV, 2, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[CULL_PARTICLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleCullingLayout"), false);
+
+		// The draw arguments are prepared with the same layout as the dispatch arguments
+		m_pipelineLayouts[PREPARE_DRAW_ARGS] = m_pipelineLayouts[PREPARE_ARGS];
+	}
 
-		const auto state = Compute::State::MakeUnique();
-		state->SetPipelineLayout(m_pipelineLayouts[PROJECT]);
-		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
-		X_RETURN(m_pipelines[PROJECT], state->GetPipeline(m_computePipelineCache.get(), L"Projection"), false);
+	if (m_sortBuffer)
+	{
+		// Spatial reorder, sharing the layout among the key generation, sort and gather
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 4, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 4, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(2, DescriptorType::UAV, 2, 4, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[PRESORT_PARTICLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleReorderLayout"), false);
+		for (uint8_t i = MERGE_PARTICLE; i <= REORDER_PARTICLE; ++i) m_pipelineLayouts[i] = m_pipelineLayouts[PRESORT_PARTICLE];
 	}
 
-	// Visualization
-	if (m_numParticles > 0)
+	// Temporal interpolation
 	{
-		// Particle rendering
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSParticle.cso"), false);
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::HS, hsIndex, L"HSParticle.cso"), false);
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::DS, dsIndex, L"DSParticle.cso"), false);
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, L"PSParticle.cso"), false);
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 2, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 3, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
+		X_RETURN(m_pipelineLayouts[INTERPOLATE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"InterpolationLayout"), false);
+	}
+
+	// Wavelet turbulence
+	if (m_upsample > 1)
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 2, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 3, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
+		pipelineLayout->SetRange(3, DescriptorType::SAMPLER, 1, 1);
+		X_RETURN(m_pipelineLayouts[TURBULENCE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"TurbulenceLayout"), false);
+	}
+
+	// Mip chain of the rendered volume
+	if (m_numParticles == 0 && m_gridSize.z > 1)
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(0, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[DOWNSAMPLE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"DownsampleLayout"), false);
+	}
+
+	// Block compression of the rendered volume
+	if (m_blockCompression)
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(0, DescriptorType::UAV, 2, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[ENCODE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"EncodeLayout"), false);
+	}
+
+	// Occupancy grid
+	if (m_numParticles == 0 && m_gridSize.z > 1)
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(0, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[OCCUPANCY], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"OccupancyLayout"), false);
+	}
+
+	// Bound of the occupied macro-cells
+	if (m_numParticles == 0 && m_gridSize.z > 1)
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 3, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[BOUND], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"BoundLayout"), false);
+	}
+
+	// Light transmittance sweep
+	if (m_numParticles == 0 && m_gridSize.z > 1)
+	{
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetConstants(0, 8, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(1, DescriptorType::UAV, 3, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+		X_RETURN(m_pipelineLayouts[LIGHT_TRANS], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"LightTransmittanceLayout"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Particle rendering
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRootCBV(0, 0, 0, Shader::Stage::VS);
+		pipelineLayout->SetRootCBV(1, 1, 0, Shader::Stage::VS);
+		pipelineLayout->SetRange(2, DescriptorType::SRV, 2, 0);
+		pipelineLayout->SetRange(3, DescriptorType::SRV, 1, 5);
+		pipelineLayout->SetRange(4, DescriptorType::SAMPLER, 1, 0);
+		pipelineLayout->SetRange(5, DescriptorType::SRV, 1, 6);
+		pipelineLayout->SetShaderStage(2, Shader::Stage::VS);
+		pipelineLayout->SetShaderStage(3, Shader::Stage::VS);
+		pipelineLayout->SetShaderStage(4, Shader::Stage::VS);
+		pipelineLayout->SetShaderStage(5, Shader::Stage::VS);
+		X_RETURN(m_pipelineLayouts[VISUALIZE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"ParticleLayout"), false);
+	}
+	else if (m_gridSize.z > 1)
+	{
+		// Ray casting, with the bound shared by the vertex and pixel shaders
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRootCBV(0, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
+		pipelineLayout->SetRange(3, DescriptorType::SRV, 1, 1);
+		pipelineLayout->SetRange(4, DescriptorType::SRV, 1, 2);
+		pipelineLayout->SetRange(5, DescriptorType::SRV, 1, 3);
+		pipelineLayout->SetShaderStage(1, Shader::Stage::PS);
+		pipelineLayout->SetShaderStage(2, Shader::Stage::PS);
+		pipelineLayout->SetShaderStage(3, Shader::Stage::PS);
+		pipelineLayout->SetShaderStage(4, Shader::Stage::PS);
+		if (m_blockCompression)
+		{
+			// The BC4 density along with the BC6H color in place of the rendered volume
+			pipelineLayout->SetRange(6, DescriptorType::SRV, 1, 4);
+			pipelineLayout->SetShaderStage(6, Shader::Stage::PS);
+		}
+		X_RETURN(m_pipelineLayouts[VISUALIZE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"RayCastingLayout"), false);
+
+		// Resolve
+		{
+			const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+			pipelineLayout->SetRootCBV(0, 0, 0, Shader::Stage::PS);
+			pipelineLayout->SetRange(1, DescriptorType::SRV, 3, 0);
+			pipelineLayout->SetRange(1, DescriptorType::UAV, 1, 0, 0, DescriptorFlag::DATA_STATIC_WHILE_SET_AT_EXECUTE);
+			pipelineLayout->SetRange(2, DescriptorType::SAMPLER, 1, 0);
+			pipelineLayout->SetShaderStage(0, Shader::Stage::PS);
+			pipelineLayout->SetShaderStage(1, Shader::Stage::PS);
+			pipelineLayout->SetShaderStage(2, Shader::Stage::PS);
+			X_RETURN(m_pipelineLayouts[RESOLVE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+				PipelineLayoutFlag::NONE, L"ResolveLayout"), false);
+		}
+	}
+	else
+	{
+		// Visualization
+		const auto pipelineLayout = Util::PipelineLayout::MakeUnique();
+		pipelineLayout->SetRange(0, DescriptorType::SRV, 1, 0);
+		pipelineLayout->SetRange(1, DescriptorType::SAMPLER, 1, 0);
+		pipelineLayout->SetShaderStage(0, Shader::PS);
+		pipelineLayout->SetShaderStage(1, Shader::PS);
+		X_RETURN(m_pipelineLayouts[VISUALIZE], pipelineLayout->GetPipelineLayout(m_pipelineLayoutCache.get(),
+			PipelineLayoutFlag::NONE, L"VisualizationLayout"), false);
+	}
+
+	return true;
+}
+
+bool Fluid::createPipelines(Format rtFormat, Format dsFormat)
+{
+	auto vsIndex = 0u;
+	auto psIndex = 0u;
+	auto csIndex = 0u;
+
+	// Vorticity
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSVorticity.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[VORTICITY]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[VORTICITY], state->GetPipeline(m_computePipelineCache.get(), L"Vorticity"), false);
+	}
+
+	// Advection
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, m_transfer ?
+			L"CSAdvectHybrid.cso" : L"CSAdvect.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[ADVECT]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[ADVECT], state->GetPipeline(m_computePipelineCache.get(), L"Advection"), false);
+	}
+
+	// Projection
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, m_gridSize.z > 1 ?
+			L"CSProject3D.cso" : L"CSProject2D.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[PROJECT]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[PROJECT], state->GetPipeline(m_computePipelineCache.get(), L"Projection"), false);
+	}
+
+	// Resampling for resize
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSResample.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[RESAMPLE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[RESAMPLE], state->GetPipeline(m_computePipelineCache.get(), L"Resampling"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Density gradient for particle shading
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSGradient.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[GRADIENT]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[GRADIENT], state->GetPipeline(m_computePipelineCache.get(), L"Gradient"), false);
+	}
+
+	if (m_transfer)
+	{
+		// Particle-to-grid transfer of the hybrid solver
+		const wchar_t* shaderNames[] = { L"CSCountBins.cso", L"CSScanBins.cso", L"CSBinParticles.cso", L"CSParticleToGrid.cso" };
+		const wchar_t* pipelineNames[] = { L"ParticleBinCount", L"ParticleBinScan", L"ParticleBinning", L"ParticleToGrid" };
+		for (uint8_t i = 0; i < size(shaderNames); ++i)
+		{
+			N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, shaderNames[i]), false);
+
+			const auto state = Compute::State::MakeUnique();
+			state->SetPipelineLayout(m_pipelineLayouts[COUNT_PARTICLE_BIN + i]);
+			state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+			X_RETURN(m_pipelines[COUNT_PARTICLE_BIN + i], state->GetPipeline(m_computePipelineCache.get(), pipelineNames[i]), false);
+		}
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Particle list initialization
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSInitParticles.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[INIT_PARTICLE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[INIT_PARTICLE], state->GetPipeline(m_computePipelineCache.get(), L"ParticleInit"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Particle integration over the alive list
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, m_transfer ?
+			L"CSParticleHybrid.cso" : L"CSParticle.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[UPDATE_PARTICLE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[UPDATE_PARTICLE], state->GetPipeline(m_computePipelineCache.get(), L"ParticleUpdate"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Budgeted particle emission
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSEmit.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[EMIT_PARTICLE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[EMIT_PARTICLE], state->GetPipeline(m_computePipelineCache.get(), L"ParticleEmission"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Indirect argument preparation
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSPrepareArgs.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[PREPARE_ARGS]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[PREPARE_ARGS], state->GetPipeline(m_computePipelineCache.get(), L"ArgumentPreparation"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Particle culling and LOD per frame
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSCullParticles.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[CULL_PARTICLE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[CULL_PARTICLE], state->GetPipeline(m_computePipelineCache.get(), L"ParticleCulling"), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Indirect draw argument preparation from the culling
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSPrepareDrawArgs.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[PREPARE_DRAW_ARGS]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[PREPARE_DRAW_ARGS], state->GetPipeline(m_computePipelineCache.get(), L"DrawArgumentPreparation"), false);
+	}
+
+	if (m_sortBuffer)
+	{
+		// Spatial reorder
+		const wchar_t* shaderNames[] = { L"CSPresort.cso", L"CSBitonicMerge.cso", L"CSBitonicMergeLocal.cso", L"CSReorder.cso" };
+		const wchar_t* pipelineNames[] = { L"ParticlePresort", L"ParticleMerge", L"ParticleMergeLocal", L"ParticleReorder" };
+		for (uint8_t i = 0; i < size(shaderNames); ++i)
+		{
+			N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, shaderNames[i]), false);
+
+			const auto state = Compute::State::MakeUnique();
+			state->SetPipelineLayout(m_pipelineLayouts[PRESORT_PARTICLE + i]);
+			state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+			X_RETURN(m_pipelines[PRESORT_PARTICLE + i], state->GetPipeline(m_computePipelineCache.get(), pipelineNames[i]), false);
+		}
+	}
+
+	// Temporal interpolation
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSInterpolate.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[INTERPOLATE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[INTERPOLATE], state->GetPipeline(m_computePipelineCache.get(), L"Interpolation"), false);
+	}
+
+	// Wavelet turbulence
+	if (m_upsample > 1)
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSTurbulence.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[TURBULENCE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[TURBULENCE], state->GetPipeline(m_computePipelineCache.get(), L"Turbulence"), false);
+	}
+
+	// Mip chain of the rendered volume
+	if (m_occupancy)
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSDownsample3D.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[DOWNSAMPLE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[DOWNSAMPLE], state->GetPipeline(m_computePipelineCache.get(), L"Downsample3D"), false);
+	}
+
+	// Block compression of the rendered volume
+	if (m_compressedColor)
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSEncodeBC.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[ENCODE]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[ENCODE], state->GetPipeline(m_computePipelineCache.get(), L"EncodeBC"), false);
+	}
+
+	// Occupancy grid
+	if (m_occupancy)
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSOccupancy.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[OCCUPANCY]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[OCCUPANCY], state->GetPipeline(m_computePipelineCache.get(), L"Occupancy"), false);
+	}
+
+	// Bound of the occupied macro-cells
+	if (m_boundBuffer)
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSBound.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[BOUND]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[BOUND], state->GetPipeline(m_computePipelineCache.get(), L"Bound"), false);
+	}
+
+	// Light transmittance sweep
+	if (m_lightTrans)
+	{
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::CS, csIndex, L"CSLightTrans.cso"), false);
+
+		const auto state = Compute::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[LIGHT_TRANS]);
+		state->SetShader(m_shaderPool->GetShader(Shader::Stage::CS, csIndex++));
+		X_RETURN(m_pipelines[LIGHT_TRANS], state->GetPipeline(m_computePipelineCache.get(), L"LightTransmittance"), false);
+	}
+
+	// Visualization
+	if (m_numParticles > 0)
+	{
+		// Particle rendering
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSParticle.cso"), false);
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, L"PSParticle.cso"), false);
 
 		const auto state = Graphics::State::MakeUnique();
 		state->SetPipelineLayout(m_pipelineLayouts[VISUALIZE]);
 		state->SetShader(Shader::Stage::VS, m_shaderPool->GetShader(Shader::Stage::VS, vsIndex++));
-		state->SetShader(Shader::Stage::HS, m_shaderPool->GetShader(Shader::Stage::HS, hsIndex++));
-		state->SetShader(Shader::Stage::DS, m_shaderPool->GetShader(Shader::Stage::DS, dsIndex++));
 		state->SetShader(Shader::Stage::PS, m_shaderPool->GetShader(Shader::Stage::PS, psIndex));
-		state->IASetPrimitiveTopologyType(PrimitiveTopologyType::PATCH);
+		state->IASetPrimitiveTopologyType(PrimitiveTopologyType::TRIANGLE);
 		state->DSSetState(Graphics::DEPTH_STENCIL_NONE, m_graphicsPipelineCache.get());
 		state->OMSetBlendState(Graphics::NON_PRE_MUL, m_graphicsPipelineCache.get());
 		state->OMSetNumRenderTargets(1);
@@ -372,100 +1283,919 @@ bool Fluid::createPipelines(Format rtFormat, Format dsFormat)
 		//state->OMSetDSVFormat(dsFormat);
 		X_RETURN(m_pipelines[VISUALIZE], state->GetPipeline(m_graphicsPipelineCache.get(), L"Particle"), false);
 	}
-	else if (m_gridSize.z > 1)
+	else if (m_gridSize.z > 1)
+	{
+		// Ray casting into the reduced-resolution color and view distance targets, over the
+		// screen rectangle of the bound
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSBound.cso"), false);
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, m_blockCompression ?
+			L"PSRayCastBC.cso" : L"PSRayCast.cso"), false);
+
+		{
+			const Format rtFormats[] = { Format::R16G16B16A16_FLOAT, Format::R16_FLOAT };
+			const auto state = Graphics::State::MakeUnique();
+			state->SetPipelineLayout(m_pipelineLayouts[VISUALIZE]);
+			state->SetShader(Shader::Stage::VS, m_shaderPool->GetShader(Shader::Stage::VS, vsIndex++));
+			state->SetShader(Shader::Stage::PS, m_shaderPool->GetShader(Shader::Stage::PS, psIndex++));
+			state->IASetPrimitiveTopologyType(PrimitiveTopologyType::TRIANGLE);
+			state->DSSetState(Graphics::DEPTH_STENCIL_NONE, m_graphicsPipelineCache.get());
+			state->OMSetBlendState(Graphics::DEFAULT_OPAQUE, m_graphicsPipelineCache.get());
+			state->OMSetRTVFormats(rtFormats, static_cast<uint32_t>(size(rtFormats)));
+			X_RETURN(m_pipelines[VISUALIZE], state->GetPipeline(m_graphicsPipelineCache.get(), L"RayCasting"), false);
+		}
+
+		// Edge-aware upsampling with the temporal accumulation onto the back buffer
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSScreenQuad.cso"), false);
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, L"PSResolve.cso"), false);
+
+		{
+			const auto state = Graphics::State::MakeUnique();
+			state->SetPipelineLayout(m_pipelineLayouts[RESOLVE]);
+			state->SetShader(Shader::Stage::VS, m_shaderPool->GetShader(Shader::Stage::VS, vsIndex++));
+			state->SetShader(Shader::Stage::PS, m_shaderPool->GetShader(Shader::Stage::PS, psIndex));
+			state->IASetPrimitiveTopologyType(PrimitiveTopologyType::TRIANGLE);
+			state->DSSetState(Graphics::DEPTH_STENCIL_NONE, m_graphicsPipelineCache.get());
+			state->OMSetBlendState(Graphics::PREMULTIPLITED, m_graphicsPipelineCache.get());
+			state->OMSetRTVFormats(&rtFormat, 1);
+			X_RETURN(m_pipelines[RESOLVE], state->GetPipeline(m_graphicsPipelineCache.get(), L"Resolve"), false);
+		}
+	}
+	else
+	{
+		// Visualization
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSScreenQuad.cso"), false);
+		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, L"PSVisualizeColor.cso"), false);
+
+		const auto state = Graphics::State::MakeUnique();
+		state->SetPipelineLayout(m_pipelineLayouts[VISUALIZE]);
+		state->SetShader(Shader::Stage::VS, m_shaderPool->GetShader(Shader::Stage::VS, vsIndex));
+		state->SetShader(Shader::Stage::PS, m_shaderPool->GetShader(Shader::Stage::PS, psIndex++));
+		state->IASetPrimitiveTopologyType(PrimitiveTopologyType::TRIANGLE);
+		state->OMSetBlendState(Graphics::NON_PRE_MUL, m_graphicsPipelineCache.get());
+		state->DSSetState(Graphics::DEPTH_STENCIL_NONE, m_graphicsPipelineCache.get());
+		state->OMSetRTVFormats(&rtFormat, 1);
+		X_RETURN(m_pipelines[VISUALIZE], state->GetPipeline(m_graphicsPipelineCache.get(), L"Visualization"), false);
+	}
+
+	return true;
+}
+
+bool Fluid::createDescriptorTables()
+{
+	// Create particle UAV and SRV tables for the update and emission,
+	// writing the alive list i and reading the other one
+	for (uint8_t i = 0; i < 2 && m_numParticles > 0; ++i)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_particleBuffer->GetUAV(),
+			m_deadListBuffer->GetUAV(),
+			m_aliveListBuffers[i]->GetUAV(),
+			m_counterBuffer->GetUAV(),
+			m_aliveListBuffers[(i + 1) % 2]->GetSRV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[UAV_SRV_TABLE_PARTICLE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create particle SRV tables for rendering the alive list i
+	for (uint8_t i = 0; i < 2 && m_numParticles > 0; ++i)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_aliveListBuffers[i]->GetSRV(),
+			m_particleBuffer->GetSRV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_TABLE_PARTICLE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Create counter and indirect argument UAVs
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_counterBuffer->GetUAV(),
+			m_argumentBuffer->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[UAV_TABLE_PARTICLE_ARGS], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Create visible list and counter UAVs for the culling
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_visibleListBuffer->GetUAV(),
+			m_counterBuffer->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[UAV_TABLE_PARTICLE_CULL], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Create particle SRV table for rendering the visible list
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_visibleListBuffer->GetSRV(),
+			m_particleBuffer->GetSRV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_TABLE_PARTICLE_VISIBLE], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_sortBuffer)
+	{
+		// Create sort and gather UAVs of the spatial reorder
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_sortBuffer->GetUAV(),
+			m_reorderBuffer->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[UAV_TABLE_PARTICLE_SORT], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create resolve SRV and UAV tables, reading the history i and writing the other one
+	for (uint8_t i = 0; i < 2 && m_histories[i]; ++i)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_rayCastColor->GetSRV(),
+			m_rayCastDepth->GetSRV(),
+			m_histories[i]->GetSRV(),
+			m_histories[(i + 1) % 2]->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_RESOLVE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_boundBuffer)
+	{
+		// Create bound SRV table for the ray casting
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_boundBuffer->GetSRV());
+		X_RETURN(m_srvUavTables[SRV_TABLE_BOUND], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create grid SRV and UAV tables
+	N_RETURN(createGridDescriptorTables(), false);
+
+	// Create the samplers
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const auto samplerLinearMirror = SamplerPreset::LINEAR_MIRROR;
+		descriptorTable->SetSamplers(0, 1, &samplerLinearMirror, m_descriptorTableCache.get());
+		X_RETURN(m_samplerTables[SAMPLER_TABLE_MIRROR], descriptorTable->GetSamplerTable(m_descriptorTableCache.get()), false);
+	}
+
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const auto samplerLinearClamp = SamplerPreset::LINEAR_CLAMP;
+		descriptorTable->SetSamplers(0, 1, &samplerLinearClamp, m_descriptorTableCache.get());
+		X_RETURN(m_samplerTables[SAMPLER_TABLE_CLAMP], descriptorTable->GetSamplerTable(m_descriptorTableCache.get()), false);
+	}
+
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const auto samplerLinearWrap = SamplerPreset::LINEAR_WRAP;
+		descriptorTable->SetSamplers(0, 1, &samplerLinearWrap, m_descriptorTableCache.get());
+		X_RETURN(m_samplerTables[SAMPLER_TABLE_WRAP], descriptorTable->GetSamplerTable(m_descriptorTableCache.get()), false);
+	}
+
+	return true;
+}
+
+bool Fluid::createCommandLayouts()
+{
+	// Indirect dispatch of the particle update
+	{
+		IndirectArgument arg;
+		arg.Type = IndirectArgumentType::DISPATCH;
+		m_dispatchLayout = CommandLayout::MakeUnique();
+		N_RETURN(m_dispatchLayout->Create(m_device.get(), sizeof(uint32_t[3]), 1, &arg,
+			0, L"ParticleDispatchLayout"), false);
+	}
+
+	// Indirect draw over the alive particles
+	{
+		IndirectArgument arg;
+		arg.Type = IndirectArgumentType::DRAW;
+		m_drawLayout = CommandLayout::MakeUnique();
+		N_RETURN(m_drawLayout->Create(m_device.get(), sizeof(uint32_t[4]), 1, &arg,
+			0, L"ParticleDrawLayout"), false);
+	}
+
+	return true;
+}
+
+bool Fluid::createGridDescriptorTables()
+{
+	// Create velocity SRV and UAV tables for advection
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_velocities[0]->GetSRV(),
+			m_velocities[1]->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_VECOLITY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create velocity SRV
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_velocities[0]->GetSRV());
+		X_RETURN(m_srvUavTables[SRV_TABLE_VELOCITY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create velocity and incompressibility SRV and UAV tables for projection
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_velocities[1]->GetSRV(),
+			m_velocities[0]->GetUAV(),
+			m_incompress->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_VECOLITY1], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	for (uint8_t i = 0; i < 2; ++i)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_colors[(i + 1) % 2]->GetSRV(),
+			m_colors[i]->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_COLOR + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create emitter SRV tables
+	for (uint8_t i = 0; i < FrameCount; ++i)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_emitterBuffer->GetSRV(i),
+			m_brickRangeBuffer->GetSRV(i),
+			m_emitterIndexBuffer->GetSRV(i)
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_TABLE_EMITTER + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	// Create vorticity SRV and UAV tables
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_velocities[0]->GetSRV(),
+			m_vorticity->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_VORTICITY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_vorticity->GetSRV());
+		X_RETURN(m_srvUavTables[SRV_TABLE_VORTICITY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_upsample > 1)
+	{
+		// Create wavelet turbulence SRV and UAV tables
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				m_velocities[0]->GetSRV(),
+				m_colorInterp->GetSRV(),
+				m_noise->GetSRV(),
+				m_colorHiRes->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_TURBULENCE], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_colorHiRes->GetSRV());
+			X_RETURN(m_srvUavTables[SRV_TABLE_COLOR_HI_RES], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+	}
+
+	// Create temporal interpolation SRV and UAV tables
+	for (uint8_t i = 0; i < 2; ++i)
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		const Descriptor descriptors[] =
+		{
+			m_velocities[0]->GetSRV(),
+			m_colors[i]->GetSRV(),
+			m_colors[(i + 1) % 2]->GetSRV(),
+			m_colorInterp->GetUAV()
+		};
+		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_INTERPOLATE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	{
+		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+		descriptorTable->SetDescriptors(0, 1, &m_colorInterp->GetSRV());
+		X_RETURN(m_srvUavTables[SRV_TABLE_COLOR_INTERP], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+	}
+
+	if (m_numParticles > 0)
+	{
+		// Create density gradient SRV and UAV table of the rendered volume
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				m_upsample > 1 ? m_colorHiRes->GetSRV() : m_colorInterp->GetSRV(),
+				m_normal->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_GRADIENT], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_normal->GetSRV());
+			X_RETURN(m_srvUavTables[SRV_TABLE_NORMAL], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+	}
+
+	if (m_transfer)
+	{
+		// Create particle-to-grid transfer UAV and SRV tables
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				m_binBuffer->GetUAV(),
+				m_binnedBuffer->GetUAV(),
+				m_counterBuffer->GetUAV(),
+				m_transfer->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[UAV_TABLE_TRANSFER], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				m_transfer->GetSRV(),
+				m_gridVelocity->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_TRANSFER], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_gridVelocity->GetSRV());
+			X_RETURN(m_srvUavTables[SRV_TABLE_GRID_VELOCITY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+	}
+
+	if (m_occupancy)
 	{
-		// Ray casting
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSScreenQuad.cso"), false);
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, L"PSRayCast.cso"), false);
+		// Create downsampling SRV and UAV tables from each level of the rendered volume to the next
+		const auto pVolume = m_upsample > 1 ? m_colorHiRes : m_colorInterp;
+		for (uint8_t i = 1; i < pVolume->GetNumMips(); ++i)
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				pVolume->GetSRVLevel(i - 1),
+				pVolume->GetUAV(i)
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_DOWNSAMPLE + i - 1], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
 
-		const auto state = Graphics::State::MakeUnique();
-		state->SetPipelineLayout(m_pipelineLayouts[VISUALIZE]);
-		state->SetShader(Shader::Stage::VS, m_shaderPool->GetShader(Shader::Stage::VS, vsIndex++));
-		state->SetShader(Shader::Stage::PS, m_shaderPool->GetShader(Shader::Stage::PS, psIndex));
-		state->IASetPrimitiveTopologyType(PrimitiveTopologyType::TRIANGLE);
-		state->DSSetState(Graphics::DEPTH_STENCIL_NONE, m_graphicsPipelineCache.get());
-		state->OMSetBlendState(Graphics::NON_PRE_MUL, m_graphicsPipelineCache.get());
-		state->OMSetRTVFormats(&rtFormat, 1);
-		X_RETURN(m_pipelines[VISUALIZE], state->GetPipeline(m_graphicsPipelineCache.get(), L"RayCasting"), false);
+		// Create encoding SRV and UAV tables from each level of the rendered volume to its blocks,
+		// and the SRV tables of the compressed levels for the ray casting
+		if (m_compressedColor)
+		{
+			for (uint8_t i = 0; i < m_compressedColor->GetNumMips(); ++i)
+			{
+				const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+				const Descriptor descriptors[] =
+				{
+					pVolume->GetNumMips() > 1 ? pVolume->GetSRVLevel(i) : pVolume->GetSRV(),
+					m_colorBlocks->GetUAV(i),
+					m_densityBlocks->GetUAV(i)
+				};
+				descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+				X_RETURN(m_srvUavTables[SRV_UAV_TABLE_ENCODE + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+			}
+
+			{
+				const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+				descriptorTable->SetDescriptors(0, 1, &m_compressedColor->GetSRV());
+				X_RETURN(m_srvUavTables[SRV_TABLE_COLOR_BC], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+			}
+
+			{
+				const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+				descriptorTable->SetDescriptors(0, 1, &m_compressedDensity->GetSRV());
+				X_RETURN(m_srvUavTables[SRV_TABLE_DENSITY_BC], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+			}
+		}
+
+		// Create occupancy SRV and UAV tables over the rendered volume
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				m_upsample > 1 ? m_colorHiRes->GetSRV() : m_colorInterp->GetSRV(),
+				m_occupancy->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_OCCUPANCY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_occupancy->GetSRV());
+			X_RETURN(m_srvUavTables[SRV_TABLE_OCCUPANCY], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
+
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				m_occupancy->GetSRV(),
+				m_boundBuffer->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_BOUND], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
 	}
-	else
+
+	if (m_lightTrans)
 	{
-		// Visualization
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::VS, vsIndex, L"VSScreenQuad.cso"), false);
-		N_RETURN(m_shaderPool->CreateShader(Shader::Stage::PS, psIndex, L"PSVisualizeColor.cso"), false);
+		// Create light transmittance SRV and UAV table of the rendered volume
+		{
+			const auto pVolume = m_upsample > 1 ? m_colorHiRes : m_colorInterp;
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			const Descriptor descriptors[] =
+			{
+				pVolume->GetSRV(),
+				m_lightTrans->GetUAV(),
+				m_lightDensity->GetUAV(),
+				m_lightStamps->GetUAV()
+			};
+			descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
+			X_RETURN(m_srvUavTables[SRV_UAV_TABLE_LIGHT_TRANS], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
 
-		const auto state = Graphics::State::MakeUnique();
-		state->SetPipelineLayout(m_pipelineLayouts[VISUALIZE]);
-		state->SetShader(Shader::Stage::VS, m_shaderPool->GetShader(Shader::Stage::VS, vsIndex));
-		state->SetShader(Shader::Stage::PS, m_shaderPool->GetShader(Shader::Stage::PS, psIndex++));
-		state->IASetPrimitiveTopologyType(PrimitiveTopologyType::TRIANGLE);
-		state->OMSetBlendState(Graphics::NON_PRE_MUL, m_graphicsPipelineCache.get());
-		state->DSSetState(Graphics::DEPTH_STENCIL_NONE, m_graphicsPipelineCache.get());
-		state->OMSetRTVFormats(&rtFormat, 1);
-		X_RETURN(m_pipelines[VISUALIZE], state->GetPipeline(m_graphicsPipelineCache.get(), L"Visualization"), false);
+		{
+			const auto descriptorTable = Util::DescriptorTable::MakeUnique();
+			descriptorTable->SetDescriptors(0, 1, &m_lightTrans->GetSRV());
+			X_RETURN(m_srvUavTables[SRV_TABLE_LIGHT_TRANS], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		}
 	}
 
 	return true;
 }
 
-bool Fluid::createDescriptorTables()
+void Fluid::resample(const CommandList* pCommandList)
 {
-	if (m_numParticles > 0)
+	const auto& src = *m_srcGrid;
+
+	// Set barriers
+	ResourceBarrier barriers[8];
+	auto numBarriers = src.Velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = src.Incompress->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_incompress->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	for (uint8_t i = 0; i < 2; ++i)
 	{
-		// Create particle UAV
-		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
-		descriptorTable->SetDescriptors(0, 1, &m_particleBuffer->GetUAV());
-		X_RETURN(m_srvUavTables[UAV_SRV_TABLE_PARTICLE], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		numBarriers = src.Colors[i]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		numBarriers = m_colors[i]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
 	}
+	pCommandList->Barrier(numBarriers, barriers);
 
-	// Create SRV and UAV tables
-	for (uint8_t i = 0; i < 2; ++i)
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[RESAMPLE]);
+	pCommandList->SetPipelineState(m_pipelines[RESAMPLE]);
+
+	// Set descriptor tables
 	{
 		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
 		const Descriptor descriptors[] =
 		{
-			m_velocities[i]->GetSRV(),
-			m_velocities[(i + 1) % 2]->GetUAV()
+			src.Velocities[0]->GetSRV(),
+			src.Colors[0]->GetSRV(),
+			src.Colors[1]->GetSRV(),
+			src.Incompress->GetSRV(),
+			m_velocities[0]->GetUAV(),
+			m_colors[0]->GetUAV(),
+			m_colors[1]->GetUAV(),
+			m_incompress->GetUAV()
 		};
 		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
-		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_VECOLITY + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		m_srvUavTables[SRV_UAV_TABLE_RESAMPLE] = descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get());
 	}
 
+	// The pressure is in cell units, so it scales with the grid resolution
+	const auto pressureScale = static_cast<float>(m_gridSize.x) / m_srcGridSize.x;
+	pCommandList->SetCompute32BitConstant(0, reinterpret_cast<const uint32_t&>(pressureScale));
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_RESAMPLE]);
+	pCommandList->SetComputeDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_CLAMP]);
+
+	pCommandList->Dispatch(DIV_UP(m_gridSize.x, 8), DIV_UP(m_gridSize.y, 8), m_gridSize.z);
+
+	// Set barriers for the following passes
+	numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	for (uint8_t i = 0; i < 2; ++i)
+		numBarriers = m_colors[i]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+			ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_incompress->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	m_srcGrid = nullptr;
+}
+
+void Fluid::advance(const CommandList* pCommandList, uint8_t frameIndex)
+{
+	ResourceBarrier barriers[4];
+
+	// Vorticity
 	{
-		// Create incompressibility UAV
-		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
-		descriptorTable->SetDescriptors(0, 1, &m_incompress->GetUAV());
-		X_RETURN(m_srvUavTables[UAV_TABLE_INCOMPRESS], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+		// Set barriers (promotions)
+		m_velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+		const auto numBarriers = m_vorticity->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		// Set pipeline state
+		pCommandList->SetComputePipelineLayout(m_pipelineLayouts[VORTICITY]);
+		pCommandList->SetPipelineState(m_pipelines[VORTICITY]);
+
+		// Set descriptor table
+		pCommandList->SetComputeDescriptorTable(0, m_srvUavTables[SRV_UAV_TABLE_VORTICITY]);
+
+		pCommandList->Dispatch(DIV_UP(m_gridSize.x, 8), DIV_UP(m_gridSize.y, 8), m_gridSize.z);
 	}
 
-	for (uint8_t i = 0; i < 2; ++i)
+	// Advection
 	{
-		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
-		const Descriptor descriptors[] =
+		// Set barriers
+		auto numBarriers = m_velocities[1]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		numBarriers = m_colors[m_frameParity]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+		numBarriers = m_vorticity->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		if (m_transfer)
 		{
-			m_colors[(i + 1) % 2]->GetSRV(),
-			m_colors[i]->GetUAV()
-		};
-		descriptorTable->SetDescriptors(0, static_cast<uint32_t>(size(descriptors)), descriptors);
-		X_RETURN(m_srvUavTables[SRV_UAV_TABLE_COLOR + i], descriptorTable->GetCbvSrvUavTable(m_descriptorTableCache.get()), false);
+			numBarriers = m_transfer->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+			numBarriers = m_gridVelocity->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+		}
+		pCommandList->Barrier(numBarriers, barriers);
+
+		// Set pipeline state
+		pCommandList->SetComputePipelineLayout(m_pipelineLayouts[ADVECT]);
+		pCommandList->SetPipelineState(m_pipelines[ADVECT]);
+
+		// Set descriptor tables
+		pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(),
+			m_cbPerFrame->GetCBVOffset(frameIndex * MaxSubsteps + m_substep));
+		pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_VECOLITY]);
+		pCommandList->SetComputeDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_MIRROR]);
+		pCommandList->SetComputeDescriptorTable(3, m_srvUavTables[SRV_UAV_TABLE_COLOR + m_frameParity]);
+		pCommandList->SetComputeDescriptorTable(4, m_srvUavTables[SRV_TABLE_EMITTER + frameIndex]);
+		pCommandList->SetComputeDescriptorTable(5, m_srvUavTables[SRV_TABLE_VORTICITY]);
+		if (m_transfer) pCommandList->SetComputeDescriptorTable(6, m_srvUavTables[SRV_UAV_TABLE_TRANSFER]);
+
+		pCommandList->Dispatch(DIV_UP(m_gridSize.x, 8), DIV_UP(m_gridSize.y, 8), m_gridSize.z);
 	}
 
-	// Create the samplers
+	// Projection
 	{
-		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
-		const auto samplerLinearMirror = SamplerPreset::LINEAR_MIRROR;
-		descriptorTable->SetSamplers(0, 1, &samplerLinearMirror, m_descriptorTableCache.get());
-		X_RETURN(m_samplerTables[SAMPLER_TABLE_MIRROR], descriptorTable->GetSamplerTable(m_descriptorTableCache.get()), false);
+		// Set barriers
+		auto numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		numBarriers = m_velocities[1]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+		numBarriers = m_colors[m_frameParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+			ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		// Set pipeline state
+		pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PROJECT]);
+		pCommandList->SetPipelineState(m_pipelines[PROJECT]);
+
+		// Set descriptor tables
+		pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(),
+			m_cbPerFrame->GetCBVOffset(frameIndex * MaxSubsteps + m_substep));
+		pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_VECOLITY1]);
+		
+		XMUINT3 numGroups;
+		if (m_gridSize.z > 1) // optimized for 3D
+		{
+			numGroups.x = DIV_UP(m_gridSize.x, 4);
+			numGroups.y = DIV_UP(m_gridSize.y, 4);
+			numGroups.z = DIV_UP(m_gridSize.z, 4);
+		}
+		else
+		{
+			numGroups.x = DIV_UP(m_gridSize.x, 8);
+			numGroups.y = DIV_UP(m_gridSize.y, 8);
+			numGroups.z = m_gridSize.z;
+		}
+
+		pCommandList->Dispatch(numGroups.x, numGroups.y, numGroups.z);
 	}
+}
+
+void Fluid::computeGradient(const CommandList* pCommandList)
+{
+	// Set barriers
+	const auto pVolume = m_upsample > 1 ? m_colorHiRes : m_colorInterp;
+	ResourceBarrier barriers[2];
+	auto numBarriers = pVolume->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE);
+	numBarriers = m_normal->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[GRADIENT]);
+	pCommandList->SetPipelineState(m_pipelines[GRADIENT]);
+
+	// Set descriptor table
+	pCommandList->SetComputeDescriptorTable(0, m_srvUavTables[SRV_UAV_TABLE_GRADIENT]);
+
+	pCommandList->Dispatch(DIV_UP(m_normal->GetWidth(), 8), DIV_UP(m_normal->GetHeight(), 8), m_normal->GetDepth());
+
+	// Set barrier for rendering
+	numBarriers = m_normal->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, barriers);
+}
+
+void Fluid::transferToGrid(const CommandList* pCommandList)
+{
+	// Set barriers
+	ResourceBarrier barriers[7];
+	auto numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = m_aliveListBuffers[m_particleParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_argumentBuffer->SetBarrier(barriers, ResourceState::INDIRECT_ARGUMENT, numBarriers);
+	numBarriers = m_binBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_binnedBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_transfer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// All the passes share the same layout and tables
+	const uint32_t constants[] = { m_gridSize.x, m_gridSize.y, m_gridSize.z, m_particleParity };
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[COUNT_PARTICLE_BIN]);
+	pCommandList->SetCompute32BitConstants(0, static_cast<uint32_t>(size(constants)), constants);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_TABLE_PARTICLE + m_particleParity]);
+	pCommandList->SetComputeDescriptorTable(2, m_srvUavTables[UAV_TABLE_TRANSFER]);
+
+	// Count the particles of the latest alive list per overlapped brick, with the indirect
+	// arguments of the update
+	pCommandList->SetPipelineState(m_pipelines[COUNT_PARTICLE_BIN]);
+	pCommandList->ExecuteIndirect(m_dispatchLayout.get(), 1, m_argumentBuffer.get());
+
+	// Scan the counts into the bin offsets
+	numBarriers = m_binBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	pCommandList->SetPipelineState(m_pipelines[SCAN_PARTICLE_BIN]);
+	pCommandList->Dispatch(1, 1, 1);
+
+	// Scatter the particle IDs into the bins
+	numBarriers = m_binBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	pCommandList->SetPipelineState(m_pipelines[BIN_PARTICLE]);
+	pCommandList->ExecuteIndirect(m_dispatchLayout.get(), 1, m_argumentBuffer.get());
+
+	// Reduce the bins per brick into the transfer velocity, with one group per brick
+	numBarriers = m_binBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_binnedBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	const auto& brickGridSize = m_emitterBins.GetBrickGridSize();
+	pCommandList->SetPipelineState(m_pipelines[PARTICLE_TO_GRID]);
+	pCommandList->Dispatch(brickGridSize.x, brickGridSize.y, brickGridSize.z);
+}
 
+void Fluid::initParticles(const CommandList* pCommandList)
+{
+	// Set barriers
+	ResourceBarrier barriers[2];
+	auto numBarriers = m_deadListBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Grid-stride over the particles, bounded the same way as CSParticle
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[INIT_PARTICLE]);
+	pCommandList->SetPipelineState(m_pipelines[INIT_PARTICLE]);
+	pCommandList->SetCompute32BitConstant(0, m_numParticles);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[UAV_SRV_TABLE_PARTICLE]);
+	pCommandList->Dispatch(min(DIV_UP(m_numParticles, 64), 4096u), 1, 1);
+}
+
+void Fluid::updateParticles(CommandList* pCommandList, uint8_t frameIndex)
+{
+	// Write the other alive list in this step
+	const uint8_t parity = !m_particleParity;
+
+	// Emission budget of this step, with the fraction carried over
+	m_emissionBudget += m_emissionRate * m_timeStep;
+	const auto budget = min(static_cast<uint32_t>(m_emissionBudget), m_numParticles);
+	m_emissionBudget -= budget;
+
+	// Set barriers
+	ResourceBarrier barriers[8];
+	auto numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	if (m_transfer) numBarriers = m_gridVelocity->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_deadListBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_aliveListBuffers[parity]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_aliveListBuffers[m_particleParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_argumentBuffer->SetBarrier(barriers, ResourceState::INDIRECT_ARGUMENT, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Integrate the alive particles, compacting the survivors into the other alive list
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[UPDATE_PARTICLE]);
+	pCommandList->SetPipelineState(m_pipelines[UPDATE_PARTICLE]);
+	pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(),
+		m_cbPerFrame->GetCBVOffset(frameIndex * MaxSubsteps + m_substep));
+	pCommandList->SetCompute32BitConstant(1, parity);
+	pCommandList->SetComputeDescriptorTable(2, m_srvUavTables[UAV_SRV_TABLE_PARTICLE + parity]);
+	pCommandList->SetComputeDescriptorTable(3, m_srvUavTables[SRV_TABLE_VELOCITY]);
+	pCommandList->SetComputeDescriptorTable(4, m_samplerTables[SAMPLER_TABLE_CLAMP]);
+	if (m_transfer) pCommandList->SetComputeDescriptorTable(5, m_srvUavTables[SRV_TABLE_GRID_VELOCITY]);
+	pCommandList->ExecuteIndirect(m_dispatchLayout.get(), 1, m_argumentBuffer.get());
+
+	// Emit from the dead list within the budget
+	if (budget > 0)
 	{
-		const auto descriptorTable = Util::DescriptorTable::MakeUnique();
-		const auto samplerLinearClamp = SamplerPreset::LINEAR_CLAMP;
-		descriptorTable->SetSamplers(0, 1, &samplerLinearClamp, m_descriptorTableCache.get());
-		X_RETURN(m_samplerTables[SAMPLER_TABLE_CLAMP], descriptorTable->GetSamplerTable(m_descriptorTableCache.get()), false);
+		numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		numBarriers = m_deadListBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+		numBarriers = m_aliveListBuffers[parity]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+		numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		const uint32_t constants[] = { parity, budget, m_gridSize.z > 1 };
+		pCommandList->SetComputePipelineLayout(m_pipelineLayouts[EMIT_PARTICLE]);
+		pCommandList->SetPipelineState(m_pipelines[EMIT_PARTICLE]);
+		pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(),
+			m_cbPerFrame->GetCBVOffset(frameIndex * MaxSubsteps + m_substep));
+		pCommandList->SetCompute32BitConstants(1, static_cast<uint32_t>(size(constants)), constants);
+		pCommandList->SetComputeDescriptorTable(2, m_srvUavTables[UAV_SRV_TABLE_PARTICLE + parity]);
+		pCommandList->SetComputeDescriptorTable(3, m_srvUavTables[SRV_TABLE_EMITTER + frameIndex]);
+		pCommandList->Dispatch(DIV_UP(budget, 64), 1, 1);
 	}
 
-	return true;
+	// Prepare the indirect arguments from the alive count
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_argumentBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PREPARE_ARGS]);
+	pCommandList->SetPipelineState(m_pipelines[PREPARE_ARGS]);
+	pCommandList->SetCompute32BitConstant(0, parity);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[UAV_TABLE_PARTICLE_ARGS]);
+	pCommandList->Dispatch(1, 1, 1);
+
+	m_particleParity = parity;
+}
+
+void Fluid::reorderParticles(const CommandList* pCommandList)
+{
+	// Set barriers
+	ResourceBarrier barriers[6];
+	auto numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_deadListBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_aliveListBuffers[m_particleParity]->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_sortBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_reorderBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// All the passes share the same layout and tables
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PRESORT_PARTICLE]);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[UAV_SRV_TABLE_PARTICLE + m_particleParity]);
+	pCommandList->SetComputeDescriptorTable(2, m_srvUavTables[UAV_TABLE_PARTICLE_SORT]);
+
+	// Morton codes of the cells of the alive particles, sorted per chunk
+	const uint32_t reorderConstants[] = { m_gridSize.x, m_gridSize.y, m_gridSize.z, m_particleParity };
+	pCommandList->SetPipelineState(m_pipelines[PRESORT_PARTICLE]);
+	pCommandList->SetCompute32BitConstants(0, static_cast<uint32_t>(size(reorderConstants)), reorderConstants);
+	pCommandList->Dispatch(m_sortCapacity / g_sortChunkSize, 1, 1);
+
+	// Bitonic merges, across the chunks in global memory, then within each chunk in shared memory
+	for (auto k = g_sortChunkSize * 2; k <= m_sortCapacity; k <<= 1)
+	{
+		for (auto j = k >> 1; j >= g_sortChunkSize; j >>= 1)
+		{
+			numBarriers = m_sortBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+			pCommandList->Barrier(numBarriers, barriers);
+
+			const uint32_t sortConstants[] = { k, j };
+			pCommandList->SetPipelineState(m_pipelines[MERGE_PARTICLE]);
+			pCommandList->SetCompute32BitConstants(0, static_cast<uint32_t>(size(sortConstants)), sortConstants);
+			pCommandList->Dispatch(m_sortCapacity / 2 / g_sortGroupSize, 1, 1);
+		}
+
+		numBarriers = m_sortBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		pCommandList->Barrier(numBarriers, barriers);
+
+		pCommandList->SetPipelineState(m_pipelines[MERGE_PARTICLE_LOCAL]);
+		pCommandList->SetCompute32BitConstant(0, k);
+		pCommandList->Dispatch(m_sortCapacity / g_sortChunkSize, 1, 1);
+	}
+
+	// Gather the alive particles in the sorted order, resetting the lists
+	numBarriers = m_sortBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	pCommandList->SetPipelineState(m_pipelines[REORDER_PARTICLE]);
+	pCommandList->SetCompute32BitConstants(0, static_cast<uint32_t>(size(reorderConstants)), reorderConstants);
+	pCommandList->Dispatch(min(DIV_UP(m_numParticles, 64), 4096u), 1, 1);
+
+	// Copy the gathered particles back
+	numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::COPY_DEST);
+	numBarriers = m_reorderBuffer->SetBarrier(barriers, ResourceState::COPY_SOURCE, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+	pCommandList->CopyResource(m_particleBuffer.get(), m_reorderBuffer.get());
+}
+
+void Fluid::interpolate(const CommandList* pCommandList)
+{
+	// Set barriers
+	ResourceBarrier barriers[4];
+	auto numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = m_colors[m_frameParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_colors[!m_frameParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_colorInterp->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[INTERPOLATE]);
+	pCommandList->SetPipelineState(m_pipelines[INTERPOLATE]);
+
+	// Set descriptor tables
+	pCommandList->SetCompute32BitConstant(0, reinterpret_cast<const uint32_t&>(m_interpFactor));
+	pCommandList->SetCompute32BitConstant(0, reinterpret_cast<const uint32_t&>(m_simStep), 1);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_INTERPOLATE + m_frameParity]);
+	pCommandList->SetComputeDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_CLAMP]);
+
+	pCommandList->Dispatch(DIV_UP(m_gridSize.x, 8), DIV_UP(m_gridSize.y, 8), m_gridSize.z);
+
+	// Set barrier for rendering
+	numBarriers = m_colorInterp->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, barriers);
+}
+
+void Fluid::synthesizeTurbulence(const CommandList* pCommandList)
+{
+	// Set barriers
+	ResourceBarrier barriers[2];
+	auto numBarriers = m_velocities[0]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = m_colorHiRes->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[TURBULENCE]);
+	pCommandList->SetPipelineState(m_pipelines[TURBULENCE]);
+
+	// Set descriptor tables
+	pCommandList->SetCompute32BitConstant(0, reinterpret_cast<const uint32_t&>(m_time));
+	pCommandList->SetCompute32BitConstant(0, WaveletTurbulence::GetNumOctaves(m_upsample), 1);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_TURBULENCE]);
+	pCommandList->SetComputeDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_CLAMP]);
+	pCommandList->SetComputeDescriptorTable(3, m_samplerTables[SAMPLER_TABLE_WRAP]);
+
+	const auto depth = m_gridSize.z > 1 ? m_gridSize.z * m_upsample : 1;
+	pCommandList->Dispatch(DIV_UP(m_gridSize.x * m_upsample, 4), DIV_UP(m_gridSize.y * m_upsample, 4), DIV_UP(depth, 4));
+
+	// Set barrier for rendering
+	numBarriers = m_colorHiRes->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, barriers);
 }
 
 void Fluid::visualizeColor(const CommandList* pCommandList)
@@ -477,47 +2207,335 @@ void Fluid::visualizeColor(const CommandList* pCommandList)
 	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::TRIANGLELIST);
 
 	// Set descriptor tables
-	pCommandList->SetGraphicsDescriptorTable(0, m_srvUavTables[SRV_UAV_TABLE_COLOR + !m_frameParity]);
+	pCommandList->SetGraphicsDescriptorTable(0, m_upsample > 1 ? m_srvUavTables[SRV_TABLE_COLOR_HI_RES] :
+		m_srvUavTables[SRV_TABLE_COLOR_INTERP]);
 	pCommandList->SetGraphicsDescriptorTable(1, m_samplerTables[SAMPLER_TABLE_CLAMP]);
 
 	pCommandList->Draw(3, 1, 0, 0);
 }
 
-void Fluid::rayCast(const CommandList* pCommandList, uint8_t frameIndex)
+void Fluid::updateLightTrans(const CommandList* pCommandList, bool force)
+{
+	// Set barriers
+	const auto pVolume = m_upsample > 1 ? m_colorHiRes : m_colorInterp;
+	ResourceBarrier barriers[4];
+	auto numBarriers = pVolume->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE);
+	numBarriers = m_lightTrans->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_lightDensity->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_lightStamps->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[LIGHT_TRANS]);
+	pCommandList->SetPipelineState(m_pipelines[LIGHT_TRANS]);
+
+	// Set descriptor tables
+	const uint32_t constants[] = { ++m_lightStamp, force ? 1u : 0u };
+	pCommandList->SetCompute32BitConstants(0, sizeof(RayCasterCPU::LightSweep) / sizeof(uint32_t), &m_lightSweep);
+	pCommandList->SetCompute32BitConstants(0, static_cast<uint32_t>(size(constants)), constants, 6);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_LIGHT_TRANS]);
+
+	// Slices in order from the light, each attenuating the previous one
+	const uint32_t dims[] = { m_lightTrans->GetWidth(), m_lightTrans->GetHeight(), m_lightTrans->GetDepth() };
+	const float offsets[] = { m_lightSweep.CellOffset.x, m_lightSweep.CellOffset.y, m_lightSweep.CellOffset.z };
+	const auto a = m_lightSweep.Axis;
+	const auto b = a == 0 ? 1u : 0u;
+	const auto c = a == 2 ? 1u : 2u;
+	for (auto s = 0u; s < dims[a]; ++s)
+	{
+		pCommandList->SetCompute32BitConstant(0, offsets[a] > 0.0f ? dims[a] - 1 - s : s, 5);
+		pCommandList->Dispatch(DIV_UP(dims[b], 8), DIV_UP(dims[c], 8), 1);
+
+		// UAV barriers for the next slice
+		numBarriers = m_lightTrans->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+		numBarriers = m_lightStamps->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+		pCommandList->Barrier(numBarriers, barriers);
+	}
+
+	// Set barrier for ray casting
+	numBarriers = m_lightTrans->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, barriers);
+}
+
+void Fluid::generateMips(const CommandList* pCommandList)
+{
+	const auto pVolume = m_upsample > 1 ? m_colorHiRes : m_colorInterp;
+	const auto numMips = pVolume->GetNumMips();
+	if (numMips <= 1) return;
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[DOWNSAMPLE]);
+	pCommandList->SetPipelineState(m_pipelines[DOWNSAMPLE]);
+
+	// Each level from the previous one, which is already readable
+	ResourceBarrier barrier;
+	for (uint8_t i = 1; i < numMips; ++i)
+	{
+		auto numBarriers = pVolume->SetBarrier(&barrier, i, ResourceState::UNORDERED_ACCESS);
+		pCommandList->Barrier(numBarriers, &barrier);
+
+		pCommandList->SetComputeDescriptorTable(0, m_srvUavTables[SRV_UAV_TABLE_DOWNSAMPLE + i - 1]);
+		pCommandList->Dispatch(DIV_UP(max(pVolume->GetWidth() >> i, 1u), 4), DIV_UP(max(pVolume->GetHeight() >> i, 1u), 4),
+			DIV_UP(max(pVolume->GetDepth() >> i, 1u), 4));
+
+		numBarriers = pVolume->SetBarrier(&barrier, i, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+			ResourceState::PIXEL_SHADER_RESOURCE);
+		pCommandList->Barrier(numBarriers, &barrier);
+	}
+}
+
+void Fluid::compressVolume(const CommandList* pCommandList)
+{
+	// Set barriers
+	ResourceBarrier barriers[4];
+	auto numBarriers = m_colorBlocks->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_densityBlocks->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[ENCODE]);
+	pCommandList->SetPipelineState(m_pipelines[ENCODE]);
+
+	// One thread per 4x4 block of each slice, for every level, which are all readable after the downsampling
+	const auto numMips = m_compressedColor->GetNumMips();
+	for (uint8_t i = 0; i < numMips; ++i)
+	{
+		pCommandList->SetComputeDescriptorTable(0, m_srvUavTables[SRV_UAV_TABLE_ENCODE + i]);
+		pCommandList->Dispatch(DIV_UP(max(m_colorBlocks->GetWidth() >> i, 1u), 8),
+			DIV_UP(max(m_colorBlocks->GetHeight() >> i, 1u), 8), max(m_colorBlocks->GetDepth() >> i, 1u));
+	}
+
+	// Copy the blocks into the compressed levels, as the same bits
+	numBarriers = m_colorBlocks->SetBarrier(barriers, ResourceState::COPY_SOURCE);
+	numBarriers = m_densityBlocks->SetBarrier(barriers, ResourceState::COPY_SOURCE, numBarriers);
+	numBarriers = m_compressedColor->SetBarrier(barriers, ResourceState::COPY_DEST, numBarriers);
+	numBarriers = m_compressedDensity->SetBarrier(barriers, ResourceState::COPY_DEST, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	for (uint8_t i = 0; i < numMips; ++i)
+	{
+		pCommandList->CopyTextureRegion(TextureCopyLocation(m_compressedColor, i), 0, 0, 0,
+			TextureCopyLocation(m_colorBlocks, i));
+		pCommandList->CopyTextureRegion(TextureCopyLocation(m_compressedDensity, i), 0, 0, 0,
+			TextureCopyLocation(m_densityBlocks, i));
+	}
+
+	// Set barriers for ray casting
+	numBarriers = m_compressedColor->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE);
+	numBarriers = m_compressedDensity->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+}
+
+void Fluid::buildOccupancy(const CommandList* pCommandList)
+{
+	// Set barrier
+	ResourceBarrier barrier;
+	auto numBarriers = m_occupancy->SetBarrier(&barrier, ResourceState::UNORDERED_ACCESS);
+	pCommandList->Barrier(numBarriers, &barrier);
+
+	// Set pipeline state
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[OCCUPANCY]);
+	pCommandList->SetPipelineState(m_pipelines[OCCUPANCY]);
+
+	// Set descriptor table
+	pCommandList->SetComputeDescriptorTable(0, m_srvUavTables[SRV_UAV_TABLE_OCCUPANCY]);
+
+	// One group per macro-cell
+	const auto occupancySize = RayCasterCPU::GetOccupancySize(XMUINT3(m_gridSize.x * m_upsample,
+		m_gridSize.y * m_upsample, m_gridSize.z * m_upsample));
+	pCommandList->Dispatch(occupancySize.x, occupancySize.y, occupancySize.z);
+
+	// Set barriers
+	ResourceBarrier barriers[2];
+	numBarriers = m_occupancy->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE);
+	numBarriers = m_boundBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Reduce the occupied macro-cells to their bound in a single group
+	const uint32_t renderGridSize[] = { m_gridSize.x * m_upsample, m_gridSize.y * m_upsample, m_gridSize.z * m_upsample };
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[BOUND]);
+	pCommandList->SetPipelineState(m_pipelines[BOUND]);
+	pCommandList->SetCompute32BitConstants(0, static_cast<uint32_t>(size(renderGridSize)), renderGridSize);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_BOUND]);
+	pCommandList->Dispatch(1, 1, 1);
+
+	// Set barrier for ray casting
+	numBarriers = m_boundBuffer->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE |
+		ResourceState::PIXEL_SHADER_RESOURCE);
+	pCommandList->Barrier(numBarriers, barriers);
+}
+
+void Fluid::rayCast(const CommandList* pCommandList, uint8_t frameIndex, const Descriptor& rtv)
 {
+	// Downsample the current volume for the adaptive sampling, compress it for the sampling bandwidth
+	// once per change, skip its empty space, and bound the occupied
+	generateMips(pCommandList);
+	if (m_compressedColor && !m_isEncoded)
+	{
+		compressVolume(pCommandList);
+		m_isEncoded = true;
+	}
+	buildOccupancy(pCommandList);
+
+	// Set barriers
+	ResourceBarrier barriers[4];
+	auto numBarriers = m_rayCastColor->SetBarrier(barriers, ResourceState::RENDER_TARGET);
+	numBarriers = m_rayCastDepth->SetBarrier(barriers, ResourceState::RENDER_TARGET, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Ray cast at the render scale, into the top-left of the targets, cleared for the discarded pixels
+	const auto renderSize = RayCasterCPU::GetRenderSize(m_viewport, m_renderScale);
+	Viewport viewport(0.0f, 0.0f, m_viewport.x * m_renderScale, m_viewport.y * m_renderScale);
+	RectRange scissorRect(0, 0, renderSize.x, renderSize.y);
+
+	const float clearColor[4] = {};
+	const Descriptor rtvs[] = { m_rayCastColor->GetRTV(), m_rayCastDepth->GetRTV() };
+	pCommandList->ClearRenderTargetView(rtvs[0], clearColor, 1, &scissorRect);
+	pCommandList->ClearRenderTargetView(rtvs[1], clearColor, 1, &scissorRect);
+	pCommandList->OMSetRenderTargets(static_cast<uint32_t>(size(rtvs)), rtvs);
+	pCommandList->RSSetViewports(1, &viewport);
+	pCommandList->RSSetScissorRects(1, &scissorRect);
+
 	// Set pipeline state
 	pCommandList->SetGraphicsPipelineLayout(m_pipelineLayouts[VISUALIZE]);
 	pCommandList->SetPipelineState(m_pipelines[VISUALIZE]);
 
-	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::TRIANGLELIST);
+	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::TRIANGLESTRIP);
 
 	// Set descriptor tables
 	pCommandList->SetGraphicsRootConstantBufferView(0, m_cbPerObject.get(), m_cbPerObject->GetCBVOffset(frameIndex));
-	pCommandList->SetGraphicsDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_COLOR + !m_frameParity]);
+	if (m_compressedColor)
+	{
+		pCommandList->SetGraphicsDescriptorTable(1, m_srvUavTables[SRV_TABLE_COLOR_BC]);
+		pCommandList->SetGraphicsDescriptorTable(6, m_srvUavTables[SRV_TABLE_DENSITY_BC]);
+	}
+	else pCommandList->SetGraphicsDescriptorTable(1, m_upsample > 1 ? m_srvUavTables[SRV_TABLE_COLOR_HI_RES] :
+		m_srvUavTables[SRV_TABLE_COLOR_INTERP]);
+	pCommandList->SetGraphicsDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_CLAMP]);
+	pCommandList->SetGraphicsDescriptorTable(3, m_srvUavTables[SRV_TABLE_OCCUPANCY]);
+	pCommandList->SetGraphicsDescriptorTable(4, m_srvUavTables[SRV_TABLE_LIGHT_TRANS]);
+	pCommandList->SetGraphicsDescriptorTable(5, m_srvUavTables[SRV_TABLE_BOUND]);
+
+	// Draw the screen rectangle of the bound
+	pCommandList->Draw(4, 1, 0, 0);
+
+	// Set barriers for the resolve
+	const auto& history = m_histories[m_historyParity];
+	const auto& resolved = m_histories[!m_historyParity];
+	numBarriers = m_rayCastColor->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE);
+	numBarriers = m_rayCastDepth->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = history->SetBarrier(barriers, ResourceState::PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = resolved->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Resolve onto the back buffer over the full viewport
+	pCommandList->OMSetRenderTargets(1, &rtv);
+	viewport = Viewport(0.0f, 0.0f, static_cast<float>(m_viewport.x), static_cast<float>(m_viewport.y));
+	scissorRect = RectRange(0, 0, m_viewport.x, m_viewport.y);
+	pCommandList->RSSetViewports(1, &viewport);
+	pCommandList->RSSetScissorRects(1, &scissorRect);
+
+	pCommandList->SetGraphicsPipelineLayout(m_pipelineLayouts[RESOLVE]);
+	pCommandList->SetPipelineState(m_pipelines[RESOLVE]);
+
+	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::TRIANGLELIST);
+
+	pCommandList->SetGraphicsRootConstantBufferView(0, m_cbPerObject.get(), m_cbPerObject->GetCBVOffset(frameIndex));
+	pCommandList->SetGraphicsDescriptorTable(1, m_srvUavTables[SRV_UAV_TABLE_RESOLVE + m_historyParity]);
 	pCommandList->SetGraphicsDescriptorTable(2, m_samplerTables[SAMPLER_TABLE_CLAMP]);
 
 	pCommandList->Draw(3, 1, 0, 0);
+	m_historyParity = !m_historyParity;
 }
 
-void Fluid::renderParticles(const CommandList* pCommandList, uint8_t frameIndex)
+void Fluid::updateRenderScale(float frameTime)
 {
-	// Set barrier
-	ResourceBarrier barrier;
-	const auto numBarriers = m_velocities[0]->SetBarrier(&barrier, ResourceState::NON_PIXEL_SHADER_RESOURCE);;
-	pCommandList->Barrier(numBarriers, &barrier);
+	if (m_frameBudget <= 0.0f) return;
+
+	// Smoothed frame time, restarted after each step of the render scale
+	m_frameTime = m_frameTime > 0.0f ? m_frameTime + (frameTime - m_frameTime) * 0.1f : frameTime;
+	if (m_renderScaleHold > 0)
+	{
+		--m_renderScaleHold;
+		return;
+	}
+
+	auto renderScale = m_renderScale;
+	if (m_frameTime > m_frameBudget * g_frameTimeHigh) renderScale = max(m_renderScale - g_renderScaleStep, g_minRenderScale);
+	else if (m_frameTime < m_frameBudget * g_frameTimeLow) renderScale = min(m_renderScale + g_renderScaleStep, 1.0f);
+
+	if (renderScale != m_renderScale)
+	{
+		m_renderScale = renderScale;
+		m_frameTime = 0.0f;
+		m_renderScaleHold = g_renderScaleHold;
+	}
+}
+
+void Fluid::cullParticles(CommandList* pCommandList, uint8_t frameIndex)
+{
+	// Set barriers
+	ResourceBarrier barriers[5];
+	auto numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = m_aliveListBuffers[m_particleParity]->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_visibleListBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	numBarriers = m_argumentBuffer->SetBarrier(barriers, ResourceState::INDIRECT_ARGUMENT, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	// Cull the alive particles into the visible list, with the dispatch of the particle update
+	const uint32_t constants[] = { m_particleParity, reinterpret_cast<const uint32_t&>(m_lodDistance) };
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[CULL_PARTICLE]);
+	pCommandList->SetPipelineState(m_pipelines[CULL_PARTICLE]);
+	pCommandList->SetComputeRootConstantBufferView(0, m_cbPerFrame.get(),
+		m_cbPerFrame->GetCBVOffset(frameIndex * MaxSubsteps + m_substep));
+	pCommandList->SetComputeRootConstantBufferView(1, m_cbPerObject.get(), m_cbPerObject->GetCBVOffset(frameIndex));
+	pCommandList->SetCompute32BitConstants(2, static_cast<uint32_t>(size(constants)), constants);
+	pCommandList->SetComputeDescriptorTable(3, m_srvUavTables[SRV_TABLE_PARTICLE + m_particleParity]);
+	pCommandList->SetComputeDescriptorTable(4, m_srvUavTables[UAV_TABLE_PARTICLE_CULL]);
+	pCommandList->ExecuteIndirect(m_dispatchLayout.get(), 1, m_argumentBuffer.get());
+
+	// Prepare the draw arguments from the visible count
+	numBarriers = m_counterBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS);
+	numBarriers = m_argumentBuffer->SetBarrier(barriers, ResourceState::UNORDERED_ACCESS, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
+
+	pCommandList->SetComputePipelineLayout(m_pipelineLayouts[PREPARE_DRAW_ARGS]);
+	pCommandList->SetPipelineState(m_pipelines[PREPARE_DRAW_ARGS]);
+	pCommandList->SetComputeDescriptorTable(1, m_srvUavTables[UAV_TABLE_PARTICLE_ARGS]);
+	pCommandList->Dispatch(1, 1, 1);
+}
+
+void Fluid::renderParticles(CommandList* pCommandList, uint8_t frameIndex)
+{
+	// Drop the off-screen particles, and thin the distant ones
+	cullParticles(pCommandList, frameIndex);
+
+	// Set barriers
+	ResourceBarrier barriers[3];
+	auto numBarriers = m_particleBuffer->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE);
+	numBarriers = m_visibleListBuffer->SetBarrier(barriers, ResourceState::NON_PIXEL_SHADER_RESOURCE, numBarriers);
+	numBarriers = m_argumentBuffer->SetBarrier(barriers, ResourceState::INDIRECT_ARGUMENT, numBarriers);
+	pCommandList->Barrier(numBarriers, barriers);
 
 	// Set pipeline state
 	pCommandList->SetGraphicsPipelineLayout(m_pipelineLayouts[VISUALIZE]);
 	pCommandList->SetPipelineState(m_pipelines[VISUALIZE]);
 
-	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::CONTROL_POINT1_PATCHLIST);
+	pCommandList->IASetPrimitiveTopology(PrimitiveTopology::TRIANGLESTRIP);
 
 	// Set descriptor tables
-	pCommandList->SetGraphicsRootConstantBufferView(0, m_cbPerFrame.get(), m_cbPerFrame->GetCBVOffset(frameIndex));
+	pCommandList->SetGraphicsRootConstantBufferView(0, m_cbPerFrame.get(),
+		m_cbPerFrame->GetCBVOffset(frameIndex * MaxSubsteps + m_substep));
 	pCommandList->SetGraphicsRootConstantBufferView(1, m_cbPerObject.get(), m_cbPerObject->GetCBVOffset(frameIndex));
-	pCommandList->SetGraphicsDescriptorTable(2, m_srvUavTables[UAV_SRV_TABLE_PARTICLE]);
-	pCommandList->SetGraphicsDescriptorTable(3, m_srvUavTables[SRV_UAV_TABLE_COLOR + !m_frameParity]);
+	pCommandList->SetGraphicsDescriptorTable(2, m_srvUavTables[SRV_TABLE_PARTICLE_VISIBLE]);
+	pCommandList->SetGraphicsDescriptorTable(3, m_upsample > 1 ? m_srvUavTables[SRV_TABLE_COLOR_HI_RES] :
+		m_srvUavTables[SRV_TABLE_COLOR_INTERP]);
 	pCommandList->SetGraphicsDescriptorTable(4, m_samplerTables[SAMPLER_TABLE_CLAMP]);
+	pCommandList->SetGraphicsDescriptorTable(5, m_srvUavTables[SRV_TABLE_NORMAL]);
 
-	pCommandList->Draw(m_numParticles, 1, 0, 0);
+	// Draw a quad instance per visible particle, with the count from the GPU
+	pCommandList->ExecuteIndirect(m_drawLayout.get(), 1, m_argumentBuffer.get(), sizeof(uint32_t[3]));
 }
@@ -6,6 +6,11 @@
 
 #include "DXFramework.h"
 #include "Core/XUSG.h"
+#include "BlockCompressor.h"
+#include "Emitter.h"
+#include "ParticleCPU.h"
+#include "RayCasterCPU.h"
+#include "WaveletTurbulence.h"
 
 class Fluid
 {
@@ -16,21 +21,58 @@ public:
 	bool Init(XUSG::CommandList* pCommandList, uint32_t width, uint32_t height,
 		const XUSG::DescriptorTableCache::sptr& descriptorTableCache,
 		std::vector<XUSG::Resource::uptr>& uploaders, XUSG::Format rtFormat, XUSG::Format dsFormat,
-		const DirectX::XMUINT3& gridSize, uint32_t numParticles = 0);
+		const DirectX::XMUINT3& gridSize, uint32_t numParticles = 0, uint32_t upsample = 1);
 
+	bool Resize(const DirectX::XMUINT3& gridSize);
+	void SetEmitters(uint32_t numEmitters, const Emitter* pEmitters);
+	void SetSimulationRate(float rate);
+	void SetSeed(uint32_t seed);
+	void SetReorderInterval(uint32_t interval);
+	void SetFlipRatio(float ratio);	// Hybrid PIC/FLIP solver with the particles, negative for passive tracers
+	void SetIntegrator(ParticleCPU::Integrator integrator);
+	void SetFrameBudget(float budget);	// Frame time the ray casting resolution adapts to, 0 for full resolution
+	void SetBlockCompression(bool compress);	// Of the ray cast volume per frame, before Init
 	void UpdateFrame(float timeStep, uint8_t frameIndex, const DirectX::XMFLOAT4X4& view,
 		const DirectX::XMFLOAT4X4& proj, const DirectX::XMFLOAT3& eyePt);
-	void Simulate(const XUSG::CommandList* pCommandList, uint8_t frameIndex);
-	void Render(const XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void Simulate(XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void Render(XUSG::CommandList* pCommandList, uint8_t frameIndex, const XUSG::Descriptor& rtv);
 
 	static const uint8_t FrameCount = 3;
+	static const uint32_t MaxEmitters = 1024;
+	static const uint8_t MaxPooledGrids = 3;	// Grid sizes kept for resizing back, least recently used evicted
+	static const uint8_t MaxSubsteps = 4;	// Simulation steps per frame at most, catching up with the frame time
 
 protected:
 	enum PipelineIndex : uint8_t
 	{
+		VORTICITY,
 		ADVECT,
 		PROJECT,
+		RESAMPLE,
+		GRADIENT,
+		COUNT_PARTICLE_BIN,
+		SCAN_PARTICLE_BIN,
+		BIN_PARTICLE,
+		PARTICLE_TO_GRID,
+		INIT_PARTICLE,
+		UPDATE_PARTICLE,
+		EMIT_PARTICLE,
+		PREPARE_ARGS,
+		PRESORT_PARTICLE,
+		MERGE_PARTICLE,
+		MERGE_PARTICLE_LOCAL,
+		REORDER_PARTICLE,
+		CULL_PARTICLE,
+		PREPARE_DRAW_ARGS,
+		INTERPOLATE,
+		TURBULENCE,
+		DOWNSAMPLE,
+		ENCODE,
+		OCCUPANCY,
+		BOUND,
+		LIGHT_TRANS,
 		VISUALIZE,
+		RESOLVE,
 
 		NUM_PIPELINE
 	};
@@ -41,8 +83,48 @@ protected:
 		SRV_UAV_TABLE_VECOLITY1,
 		SRV_UAV_TABLE_COLOR,
 		SRV_UAV_TABLE_COLOR1,
-		UAV_TABLE_INCOMPRESS,
 		UAV_SRV_TABLE_PARTICLE,
+		UAV_SRV_TABLE_PARTICLE1,
+		SRV_TABLE_PARTICLE,
+		SRV_TABLE_PARTICLE1,
+		UAV_TABLE_PARTICLE_ARGS,
+		UAV_TABLE_PARTICLE_SORT,
+		UAV_TABLE_PARTICLE_CULL,
+		SRV_TABLE_PARTICLE_VISIBLE,
+		SRV_TABLE_VELOCITY,
+		SRV_TABLE_EMITTER,
+		SRV_TABLE_EMITTER1,
+		SRV_TABLE_EMITTER2,
+		SRV_UAV_TABLE_VORTICITY,
+		SRV_TABLE_VORTICITY,
+		SRV_UAV_TABLE_TURBULENCE,
+		SRV_TABLE_COLOR_HI_RES,
+		SRV_UAV_TABLE_INTERPOLATE,
+		SRV_UAV_TABLE_INTERPOLATE1,
+		SRV_TABLE_COLOR_INTERP,
+		SRV_UAV_TABLE_RESAMPLE,
+		SRV_UAV_TABLE_GRADIENT,
+		SRV_TABLE_NORMAL,
+		UAV_TABLE_TRANSFER,
+		SRV_UAV_TABLE_TRANSFER,
+		SRV_TABLE_GRID_VELOCITY,
+		SRV_UAV_TABLE_DOWNSAMPLE,
+		SRV_UAV_TABLE_DOWNSAMPLE1,
+		SRV_UAV_TABLE_DOWNSAMPLE2,
+		SRV_UAV_TABLE_ENCODE,
+		SRV_UAV_TABLE_ENCODE1,
+		SRV_UAV_TABLE_ENCODE2,
+		SRV_UAV_TABLE_ENCODE3,
+		SRV_TABLE_COLOR_BC,
+		SRV_TABLE_DENSITY_BC,
+		SRV_UAV_TABLE_OCCUPANCY,
+		SRV_TABLE_OCCUPANCY,
+		SRV_UAV_TABLE_BOUND,
+		SRV_TABLE_BOUND,
+		SRV_UAV_TABLE_LIGHT_TRANS,
+		SRV_TABLE_LIGHT_TRANS,
+		SRV_UAV_TABLE_RESOLVE,
+		SRV_UAV_TABLE_RESOLVE1,
 
 		NUM_SRV_UAV_TABLE
 	};
@@ -51,24 +133,62 @@ protected:
 	{
 		SAMPLER_TABLE_MIRROR,
 		SAMPLER_TABLE_CLAMP,
+		SAMPLER_TABLE_WRAP,
 		
 		NUM_SAMPLER_TABLE
 	};
 
-	struct ParticleInfo
+	// Grid-size dependent resources, pooled per grid size for resizing
+	struct GridResources
 	{
-		DirectX::XMFLOAT3 Pos;
-		DirectX::XMFLOAT3 Velocity;
-		float LifeTime;
+		XUSG::Texture3D::uptr Velocities[2];
+		XUSG::Texture3D::uptr Colors[2];
+		XUSG::Texture3D::uptr Incompress;
+		XUSG::Texture3D::uptr Vorticity;
+		XUSG::Texture3D::uptr ColorInterp;
+		XUSG::Texture3D::uptr ColorHiRes;
+		XUSG::Texture3D::uptr Normal;
+		XUSG::Texture3D::uptr Transfer;
+		XUSG::Texture3D::uptr GridVelocity;
+		XUSG::Texture3D::uptr CompressedColor;
+		XUSG::Texture3D::uptr CompressedDensity;
+		XUSG::Texture3D::uptr ColorBlocks;
+		XUSG::Texture3D::uptr DensityBlocks;
+		XUSG::Texture3D::uptr Occupancy;
+		XUSG::Texture3D::uptr LightTrans;
+		XUSG::Texture3D::uptr LightDensity;
+		XUSG::Texture3D::uptr LightStamps;
+		XUSG::RawBuffer::uptr BinBuffer;
+		XUSG::StructuredBuffer::uptr BrickRangeBuffer;
+		XUSG::StructuredBuffer::uptr EmitterIndexBuffer;
+		uint32_t LastUsed;	// Stamp of the last switch to the grid, for the eviction
 	};
 
+	bool createGridResources(const DirectX::XMUINT3& gridSize);
 	bool createPipelineLayouts();
 	bool createPipelines(XUSG::Format rtFormat, XUSG::Format dsFormat);
 	bool createDescriptorTables();
+	bool createCommandLayouts();
+	bool createGridDescriptorTables();
 
+	void initParticles(const XUSG::CommandList* pCommandList);
+	void resample(const XUSG::CommandList* pCommandList);
+	void advance(const XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void computeGradient(const XUSG::CommandList* pCommandList);
+	void transferToGrid(const XUSG::CommandList* pCommandList);
+	void updateParticles(XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void reorderParticles(const XUSG::CommandList* pCommandList);
+	void cullParticles(XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void interpolate(const XUSG::CommandList* pCommandList);
+	void synthesizeTurbulence(const XUSG::CommandList* pCommandList);
 	void visualizeColor(const XUSG::CommandList* pCommandList);
-	void rayCast(const XUSG::CommandList* pCommandList, uint8_t frameIndex);
-	void renderParticles(const XUSG::CommandList* pCommandList, uint8_t frameIndex);
+	void updateLightTrans(const XUSG::CommandList* pCommandList, bool force);
+	void generateMips(const XUSG::CommandList* pCommandList);	// Of the rendered volume for the adaptive sampling
+	void compressVolume(const XUSG::CommandList* pCommandList);	// Every level of the rendered volume
+	void buildOccupancy(const XUSG::CommandList* pCommandList);	// With the bound of the occupied macro-cells
+	void rayCast(const XUSG::CommandList* pCommandList, uint8_t frameIndex, const XUSG::Descriptor& rtv);
+	void updateRenderScale(float frameTime);
+	void renderParticles(XUSG::CommandList* pCommandList, uint8_t frameIndex);
 
 	XUSG::Device::sptr m_device;
 
@@ -84,19 +204,92 @@ protected:
 	XUSG::DescriptorTable	m_srvUavTables[NUM_SRV_UAV_TABLE];
 	XUSG::DescriptorTable	m_samplerTables[NUM_SAMPLER_TABLE];
 
-	XUSG::Texture3D::uptr	m_incompress;
-	XUSG::Texture3D::uptr	m_velocities[2];
-	XUSG::Texture3D::uptr	m_colors[2];
+	XUSG::CommandLayout::uptr m_dispatchLayout;
+	XUSG::CommandLayout::uptr m_drawLayout;
+
+	std::unordered_map<uint64_t, GridResources> m_gridPool;
+	GridResources*			m_grid;
+	GridResources*			m_srcGrid;		// Grid to resample from after a resize
+	DirectX::XMUINT3		m_srcGridSize;
+	uint32_t				m_gridStamp;
+
+	XUSG::Texture3D*		m_incompress;
+	XUSG::Texture3D*		m_velocities[2];
+	XUSG::Texture3D*		m_colors[2];
+	XUSG::Texture3D*		m_vorticity;
+	XUSG::Texture3D*		m_colorInterp;
+	XUSG::Texture3D*		m_colorHiRes;
+	XUSG::Texture3D*		m_normal;		// Shading normals of the particles, packed from the rendered volume per frame
+	XUSG::Texture3D*		m_transfer;		// Particle velocities on the grid and their weights, per step
+	XUSG::Texture3D*		m_gridVelocity;	// Grid velocity right after the transfer blend, for the FLIP update
+	XUSG::Texture3D*		m_compressedColor;	// BC6H color of the rendered volume for the ray casting
+	XUSG::Texture3D*		m_compressedDensity;	// BC4 density of the rendered volume, saturated
+	XUSG::Texture3D*		m_colorBlocks;	// Encoded blocks, copied into the compressed levels
+	XUSG::Texture3D*		m_densityBlocks;
+	XUSG::Texture3D*		m_occupancy;	// Maximum density per macro-cell of the rendered volume
+	XUSG::Texture3D*		m_lightTrans;	// Light transmittance of the rendered volume
+	XUSG::Texture3D*		m_lightDensity;	// Densities as of the last stamps of the light transmittance
+	XUSG::Texture3D*		m_lightStamps;	// Update index of the last change per cell
+	XUSG::RawBuffer*		m_binBuffer;	// Particle counts and offsets per brick of the transfer
+	XUSG::StructuredBuffer*	m_brickRangeBuffer;
+	XUSG::StructuredBuffer*	m_emitterIndexBuffer;
+
+	XUSG::Texture3D::uptr	m_noise;
 	XUSG::StructuredBuffer::uptr m_particleBuffer;
+	XUSG::StructuredBuffer::uptr m_deadListBuffer;
+	XUSG::StructuredBuffer::uptr m_aliveListBuffers[2];
+	XUSG::RawBuffer::uptr	m_counterBuffer;	// Dead count and the counts of both alive lists
+	XUSG::RawBuffer::uptr	m_argumentBuffer;	// Indirect dispatch and draw arguments
+	XUSG::RawBuffer::uptr	m_boundBuffer;		// Local-space bound of the occupied macro-cells
+	XUSG::StructuredBuffer::uptr m_sortBuffer;		// Morton codes and particle IDs of the alive list
+	XUSG::StructuredBuffer::uptr m_reorderBuffer;	// Particles gathered in the sorted order
+	XUSG::StructuredBuffer::uptr m_visibleListBuffer;	// IDs and radius scales of the culled particles
+	XUSG::StructuredBuffer::uptr m_binnedBuffer;	// Particle IDs sorted by brick for the transfer
+	XUSG::StructuredBuffer::uptr m_emitterBuffer;
+	XUSG::RenderTarget::uptr m_rayCastColor;	// Reduced-resolution ray casting, in the top-left
+	XUSG::RenderTarget::uptr m_rayCastDepth;	// Opacity-weighted view distances of the ray casting
+	XUSG::Texture2D::uptr	m_histories[2];		// Resolved images of the temporal accumulation
 
 	XUSG::ConstantBuffer::uptr m_cbPerFrame;
 	XUSG::ConstantBuffer::uptr m_cbPerObject;
 
 	DirectX::XMUINT3		m_gridSize;
 	DirectX::XMUINT2		m_viewport;
+	DirectX::XMFLOAT4X4		m_prevWorldViewProj;
+
+	std::vector<Emitter>	m_emitters;
+	EmitterBins				m_emitterBins;
 
 	float					m_timeStep;
+	float					m_time;
 	float					m_timeInterval;
+	float					m_simStep;
+	float					m_interpFactor;
+	float					m_emissionRate;
+	float					m_emissionBudget;
+	float					m_lodDistance;	// View depth beyond which the particles are thinned
+	float					m_flipRatio;	// FLIP share of the particle velocity update, negative for passive tracers
+	ParticleCPU::Integrator	m_integrator;
+	float					m_frameBudget;
+	float					m_frameTime;	// Smoothed frame time for the render scale
+	float					m_renderScale;	// Ray casting resolution relative to the viewport
+	RayCasterCPU::LightSweep m_lightSweep;
 	uint8_t					m_frameParity;
+	uint8_t					m_numSubsteps;	// Simulation steps of the frame
+	uint8_t					m_substep;		// Simulation step being recorded, selecting its per-frame constants
+	uint8_t					m_particleParity;
+	uint8_t					m_historyParity;
+	bool					m_blockCompression;
+	bool					m_isVolumeChanged;	// The rendered volume changes in this frame
+	bool					m_isEncoded;	// The compressed levels hold the current rendered volume
 	uint32_t				m_numParticles;
+	uint32_t				m_upsample;
+	uint32_t				m_seed;			// Key of the emission draws
+	uint32_t				m_step;			// Simulation step index, the counter of the emission draws
+	uint32_t				m_reorderInterval;	// Simulation steps between spatial reorders, 0 for none
+	uint32_t				m_sortCapacity;
+	uint32_t				m_lightStamp;	// Index of the light transmittance update, 0 to recompute all cells
+	uint32_t				m_numResolved;	// Frames accumulated into the history, 0 to restart
+	uint32_t				m_renderScaleHold;	// Frames before the render scale may change again
+	uint32_t				m_numDroppedEmitters;	// Emitter-brick overlaps beyond the cap of the bins
 };
@@ -0,0 +1,536 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "FluidCPU.h"
+#include "VolumeSampler.h"
+
+using namespace std;
+using namespace concurrency;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+const float FluidCPU::ForceScale3D = 4.0f;
+const float FluidCPU::VorticityScale = 0.35f;
+const float FluidCPU::Dissipation = 0.1f;
+const float FluidCPU::TransferQuant = 4096.0f;
+const float FluidCPU::TransferMaxSpeed = 256.0f;
+
+FluidCPU::FluidCPU() :
+	m_gridSize(0, 0, 0),
+	m_frameParity(0)
+{
+	m_emitters.emplace_back(Emitter::Default());
+}
+
+FluidCPU::~FluidCPU()
+{
+}
+
+void FluidCPU::Init(const XMUINT3& gridSize)
+{
+	m_gridSize = gridSize;
+	m_frameParity = 0;
+
+	const auto numCells = gridSize.x * gridSize.y * gridSize.z;
+	for (auto& velocity : m_velocities) velocity.assign(numCells, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	for (auto& color : m_colors) color.assign(numCells, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	m_vorticity.assign(numCells, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	m_incompress.assign(numCells, 0.0f);
+	m_divergence.assign(numCells, 0.0f);
+	m_normals.assign(numCells, XMBYTEN4());
+	m_transfer.clear();
+
+	m_emitterBins.Init(gridSize);
+}
+
+void FluidCPU::SetEmitters(uint32_t numEmitters, const Emitter* pEmitters)
+{
+	m_emitters.assign(pEmitters, pEmitters + numEmitters);
+}
+
+// Visits the bricks overlapped by the cells of a trilinear support, at most 2 per axis
+template<typename Func>
+static void forEachBrick(const uint32_t cells[2][3], const XMUINT3& brickGridSize, const Func& func)
+{
+	const auto brickSize = EmitterBins::BrickSize;
+	for (auto z = cells[0][2] / brickSize; z <= cells[1][2] / brickSize; ++z)
+		for (auto y = cells[0][1] / brickSize; y <= cells[1][1] / brickSize; ++y)
+			for (auto x = cells[0][0] / brickSize; x <= cells[1][0] / brickSize; ++x)
+				func((z * brickGridSize.y + y) * brickGridSize.x + x);
+}
+
+void FluidCPU::TransferToGrid(const PackedParticle* pParticles, const uint32_t* pAliveList, uint32_t numAlive, bool parallel)
+{
+	const auto& gridSize = m_gridSize;
+	const auto& brickGridSize = m_emitterBins.GetBrickGridSize();
+	const auto numBricks = m_emitterBins.GetNumBricks();
+	const auto numBatches = (numAlive + ParticleCPU::BatchSize - 1) / ParticleCPU::BatchSize;
+	m_transfer.resize(gridSize.x * gridSize.y * gridSize.z);
+	m_gridVelocity.resize(m_transfer.size());
+	m_binCounts.resize(numBatches * numBricks);
+	m_binOffsets.resize(numBricks + 1);
+
+	const auto forEach = [parallel](uint32_t count, const auto& func)
+	{
+		if (parallel) parallel_for(0u, count, func);
+		else for (auto i = 0u; i < count; ++i) func(i);
+	};
+
+	// Bin the particles by every brick overlapped by their trilinear support, as CSCountBins does
+	forEach(numBatches, [&](uint32_t batch)
+	{
+		const auto pCounts = &m_binCounts[batch * numBricks];
+		memset(pCounts, 0, sizeof(uint32_t) * numBricks);
+		const auto end = min((batch + 1) * ParticleCPU::BatchSize, numAlive);
+		for (auto i = batch * ParticleCPU::BatchSize; i < end; ++i)
+		{
+			TransferSupport support;
+			if (!getTransferSupport(pParticles[pAliveList[i]], support)) continue;
+			forEachBrick(support.Cells, brickGridSize, [pCounts](uint32_t brick) { ++pCounts[brick]; });
+		}
+	});
+
+	// Exclusive prefix scan in the brick-major order, so that the scatter is stable and each brick
+	// sees its particles in the order of the alive list, independent of the thread count
+	auto offset = 0u;
+	for (auto brick = 0u; brick < numBricks; ++brick)
+	{
+		m_binOffsets[brick] = offset;
+		for (auto batch = 0u; batch < numBatches; ++batch)
+		{
+			auto& count = m_binCounts[batch * numBricks + brick];
+			const auto numBinned = count;
+			count = offset;
+			offset += numBinned;
+		}
+	}
+	m_binOffsets[numBricks] = offset;
+	m_binned.resize(offset);
+
+	// Scatter the particle IDs, as CSBinParticles does
+	forEach(numBatches, [&](uint32_t batch)
+	{
+		const auto pOffsets = &m_binCounts[batch * numBricks];
+		const auto end = min((batch + 1) * ParticleCPU::BatchSize, numAlive);
+		for (auto i = batch * ParticleCPU::BatchSize; i < end; ++i)
+		{
+			TransferSupport support;
+			if (!getTransferSupport(pParticles[pAliveList[i]], support)) continue;
+			const auto particleId = pAliveList[i];
+			forEachBrick(support.Cells, brickGridSize, [&](uint32_t brick) { m_binned[pOffsets[brick]++] = particleId; });
+		}
+	});
+
+	// Reduce each brick in a local tile, which stays in cache, and write its cells once as
+	// CSParticleToGrid does; no cell is shared between the bricks, so no atomics are needed
+	const auto brickSize = EmitterBins::BrickSize;
+	forEach(numBricks, [&](uint32_t brick)
+	{
+		const XMUINT3 origin(brick % brickGridSize.x * brickSize, brick / brickGridSize.x % brickGridSize.y * brickSize,
+			brick / (brickGridSize.x * brickGridSize.y) * brickSize);
+		const XMUINT3 extent(min(gridSize.x - origin.x, brickSize), min(gridSize.y - origin.y, brickSize),
+			min(gridSize.z - origin.z, brickSize));
+
+		XMINT4 sums[EmitterBins::BrickSize * EmitterBins::BrickSize * EmitterBins::BrickSize] = {};
+		for (auto i = m_binOffsets[brick]; i < m_binOffsets[brick + 1]; ++i)
+		{
+			TransferSupport support;
+			getTransferSupport(pParticles[m_binned[i]], support);
+			const XMFLOAT3 v(min(max(support.Velocity.x, -TransferMaxSpeed), TransferMaxSpeed),
+				min(max(support.Velocity.y, -TransferMaxSpeed), TransferMaxSpeed),
+				min(max(support.Velocity.z, -TransferMaxSpeed), TransferMaxSpeed));
+
+			for (uint8_t j = 0; j < 8; ++j)
+			{
+				const auto x = j & 1, y = (j >> 1) & 1, z = j >> 2;
+				const auto localX = support.Cells[x][0] - origin.x;
+				const auto localY = support.Cells[y][1] - origin.y;
+				const auto localZ = support.Cells[z][2] - origin.z;
+
+				// Unsigned wrap-around rejects the cells below the origin as well
+				if (localX >= extent.x || localY >= extent.y || localZ >= extent.z) continue;
+
+				// Integer sums in the fixed point of CSParticleToGrid, rounding to the nearest even
+				// as the HLSL round does, are independent of the order of the particles
+				const auto weight = support.Weights[x][0] * support.Weights[y][1] * support.Weights[z][2];
+				auto& sum = sums[(localZ * brickSize + localY) * brickSize + localX];
+				sum.x += static_cast<int32_t>(nearbyint(v.x * weight * TransferQuant));
+				sum.y += static_cast<int32_t>(nearbyint(v.y * weight * TransferQuant));
+				sum.z += static_cast<int32_t>(nearbyint(v.z * weight * TransferQuant));
+				sum.w += static_cast<int32_t>(nearbyint(weight * TransferQuant));
+			}
+		}
+
+		// Averaged velocity, and the total weight of the particles for the blending with the grid
+		for (auto z = 0u; z < extent.z; ++z)
+		{
+			for (auto y = 0u; y < extent.y; ++y)
+			{
+				for (auto x = 0u; x < extent.x; ++x)
+				{
+					const auto& quant = sums[(z * brickSize + y) * brickSize + x];
+					const XMFLOAT4 sum(quant.x / TransferQuant, quant.y / TransferQuant, quant.z / TransferQuant, quant.w / TransferQuant);
+					m_transfer[VolumeSampler::Index(origin.x + x, origin.y + y, origin.z + z, gridSize)] = sum.w > 0.0f ?
+						XMFLOAT4(sum.x / sum.w, sum.y / sum.w, sum.z / sum.w, sum.w) : XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				}
+			}
+		}
+	});
+}
+
+bool FluidCPU::getTransferSupport(const PackedParticle& packed, TransferSupport& support) const
+{
+	const auto particle = UnpackParticle(packed);
+
+	// Freshly emitted particles carry no velocity yet, and take the grid velocity instead
+	const auto& v = particle.Velocity;
+	if (v.x == 0.0f && v.y == 0.0f && v.z == 0.0f) return false;
+	support.Velocity = v;
+
+	// Trilinear weights of the 8 cells around the particle, with the cell centers at integers
+	const auto& gridSize = m_gridSize;
+	const int32_t dims[] = { static_cast<int32_t>(gridSize.x), static_cast<int32_t>(gridSize.y), static_cast<int32_t>(gridSize.z) };
+	const float pos[] =
+	{
+		particle.Pos.x * gridSize.x - 0.5f,
+		particle.Pos.y * gridSize.y - 0.5f,
+		particle.Pos.z * gridSize.z - 0.5f
+	};
+	for (uint8_t k = 0; k < 3; ++k)
+	{
+		const auto base = floor(pos[k]);
+		support.Weights[1][k] = pos[k] - base;
+		support.Weights[0][k] = 1.0f - support.Weights[1][k];
+		support.Cells[0][k] = VolumeSampler::Address(static_cast<int32_t>(base), dims[k], VolumeSampler::CLAMP);
+		support.Cells[1][k] = VolumeSampler::Address(static_cast<int32_t>(base) + 1, dims[k], VolumeSampler::CLAMP);
+	}
+
+	return true;
+}
+
+void FluidCPU::Simulate(float timeStep)
+{
+	if (timeStep <= 0.0f) return;
+
+	m_emitterBins.Bin(static_cast<uint32_t>(m_emitters.size()), m_emitters.data());
+
+	computeVorticity();
+	advect(timeStep);
+	project();
+
+	m_frameParity = !m_frameParity;
+}
+
+void FluidCPU::ComputeNormals()
+{
+	const auto& gridSize = m_gridSize;
+	const auto pColor = m_colors[m_frameParity].data();
+	const auto is3D = gridSize.z > 1;
+
+	parallel_for(0u, gridSize.y * gridSize.z, [&](uint32_t row)
+	{
+		const auto y = row % gridSize.y;
+		const auto z = row / gridSize.y;
+		const auto yU = y > 0 ? y - 1 : 0;
+		const auto yD = min(y + 1, gridSize.y - 1);
+		const auto zF = z > 0 ? z - 1 : 0;
+		const auto zB = min(z + 1, gridSize.z - 1);
+
+		for (auto x = 0u; x < gridSize.x; ++x)
+		{
+			const auto xL = x > 0 ? x - 1 : 0;
+			const auto xR = min(x + 1, gridSize.x - 1);
+			const auto rhoL = pColor[VolumeSampler::Index(xL, y, z, gridSize)].w;
+			const auto rhoR = pColor[VolumeSampler::Index(xR, y, z, gridSize)].w;
+			const auto rhoU = pColor[VolumeSampler::Index(x, yU, z, gridSize)].w;
+			const auto rhoD = pColor[VolumeSampler::Index(x, yD, z, gridSize)].w;
+			const auto rhoF = pColor[VolumeSampler::Index(x, y, zF, gridSize)].w;
+			const auto rhoB = pColor[VolumeSampler::Index(x, y, zB, gridSize)].w;
+
+			// Central differences, then the normal facing down the gradient with the magnitude in w
+			const auto gradient = XMVectorScale(XMVectorSet(rhoR - rhoL, rhoD - rhoU, rhoB - rhoF, 0.0f), 0.5f);
+			const auto magnitude = XMVectorGetX(XMVector3Length(gradient));
+			const auto normal = XMVectorNegate(is3D ? gradient : XMVectorSetZ(gradient, -1.0f));
+			const auto lengthSq = XMVectorGetX(XMVector3LengthSq(normal));
+			XMStoreByteN4(&m_normals[VolumeSampler::Index(x, y, z, gridSize)], XMVectorSetW(lengthSq > 0.0f ?
+				XMVector3Normalize(normal) : XMVectorZero(), min(magnitude, 1.0f)));
+		}
+	});
+}
+
+const XMUINT3& FluidCPU::GetGridSize() const
+{
+	return m_gridSize;
+}
+
+const XMFLOAT4* FluidCPU::GetVelocity() const
+{
+	return m_velocities[0].data();
+}
+
+const XMFLOAT4* FluidCPU::GetGridVelocity() const
+{
+	return m_gridVelocity.data();
+}
+
+const XMFLOAT4* FluidCPU::GetColor() const
+{
+	return m_colors[m_frameParity].data();
+}
+
+const XMFLOAT4* FluidCPU::GetVorticity() const
+{
+	return m_vorticity.data();
+}
+
+const XMFLOAT4* FluidCPU::GetTransfer() const
+{
+	return m_transfer.data();
+}
+
+const XMBYTEN4* FluidCPU::GetNormals() const
+{
+	return m_normals.data();
+}
+
+void FluidCPU::computeVorticity()
+{
+	const auto& gridSize = m_gridSize;
+	const auto pVelocity = m_velocities[0].data();
+	const auto is3D = gridSize.z > 1;
+
+	parallel_for(0u, gridSize.y * gridSize.z, [&](uint32_t row)
+	{
+		const auto y = row % gridSize.y;
+		const auto z = row / gridSize.y;
+		const auto yU = y > 0 ? y - 1 : 0;
+		const auto yD = min(y + 1, gridSize.y - 1);
+		const auto zF = z > 0 ? z - 1 : 0;
+		const auto zB = min(z + 1, gridSize.z - 1);
+
+		for (auto x = 0u; x < gridSize.x; ++x)
+		{
+			const auto xL = x > 0 ? x - 1 : 0;
+			const auto xR = min(x + 1, gridSize.x - 1);
+			const auto& uL = pVelocity[VolumeSampler::Index(xL, y, z, gridSize)];
+			const auto& uR = pVelocity[VolumeSampler::Index(xR, y, z, gridSize)];
+			const auto& uU = pVelocity[VolumeSampler::Index(x, yU, z, gridSize)];
+			const auto& uD = pVelocity[VolumeSampler::Index(x, yD, z, gridSize)];
+			const auto& uF = pVelocity[VolumeSampler::Index(x, y, zF, gridSize)];
+			const auto& uB = pVelocity[VolumeSampler::Index(x, y, zB, gridSize)];
+
+			// Curl using central differences
+			auto w = XMVectorScale(XMVectorSet(
+				(uD.z - uU.z) - (uB.y - uF.y),
+				(uB.x - uF.x) - (uR.z - uL.z),
+				(uR.y - uL.y) - (uD.x - uU.x), 0.0f), 0.5f);
+
+			// Only the scalar curl out of the plane in 2D
+			if (!is3D) w = XMVectorSet(0.0f, 0.0f, XMVectorGetZ(w), 0.0f);
+
+			XMStoreFloat4(&m_vorticity[VolumeSampler::Index(x, y, z, gridSize)], XMVectorSetW(w, XMVectorGetX(XMVector3Length(w))));
+		}
+	});
+}
+
+void FluidCPU::advect(float timeStep)
+{
+	const auto& gridSize = m_gridSize;
+	const auto is3D = gridSize.z > 1;
+	const auto pVelocity = m_velocities[0].data();
+	const auto pColor = m_colors[m_frameParity].data();
+	const auto pTransfer = m_transfer.empty() ? nullptr : m_transfer.data();
+	auto& velocityOut = m_velocities[1];
+	auto& colorOut = m_colors[!m_frameParity];
+
+	const auto& brickGridSize = m_emitterBins.GetBrickGridSize();
+	const auto pBrickRanges = m_emitterBins.GetBrickRanges();
+	const auto pIndices = m_emitterBins.GetIndices();
+
+	const auto gridSizeV = XMVectorSet(static_cast<float>(gridSize.x),
+		static_cast<float>(gridSize.y), static_cast<float>(gridSize.z), 1.0f);
+	const auto dissipation = max(1.0f - Dissipation * timeStep, 0.0f);
+	const auto threshold = exp(-4.0f);
+
+	parallel_for(0u, gridSize.y * gridSize.z, [&](uint32_t row)
+	{
+		const auto y = row % gridSize.y;
+		const auto z = row / gridSize.y;
+
+		for (auto x = 0u; x < gridSize.x; ++x)
+		{
+			const auto i = VolumeSampler::Index(x, y, z, gridSize);
+
+			// Advections
+			const auto pos = XMVectorDivide(XMVectorSet(x + 0.5f, y + 0.5f, z + 0.5f, 0.0f), gridSizeV);
+			const auto adv = XMVectorSubtract(pos, XMVectorScale(XMLoadFloat4(&pVelocity[i]), timeStep));
+			auto u = VolumeSampler::SampleLinear(pVelocity, gridSize, adv, VolumeSampler::MIRROR);
+			auto color = VolumeSampler::SampleLinear(pColor, gridSize, adv, VolumeSampler::MIRROR);
+
+			// Velocity carried by the particles, with the semi-Lagrangian advection filling the sparse cells
+			if (pTransfer)
+			{
+				u = XMVectorLerp(u, XMLoadFloat4(&pTransfer[i]), min(pTransfer[i].w, 1.0f));
+				XMStoreFloat4(&m_gridVelocity[i], XMVectorSetW(u, 0.0f));
+			}
+
+			// Vorticity confinement
+			u = XMVectorAdd(u, XMVectorScale(getConfinementForce(x, y, z), timeStep));
+
+			// Impulses of the emitters overlapping the brick
+			const auto brick = VolumeSampler::Index(x / EmitterBins::BrickSize,
+				y / EmitterBins::BrickSize, z / EmitterBins::BrickSize, brickGridSize);
+			const auto& range = pBrickRanges[brick];
+			for (auto j = 0u; j < range.y; ++j)
+			{
+				const auto& emitter = m_emitters[pIndices[range.x + j]];
+				const auto disp = XMVectorSubtract(pos, XMLoadFloat3(&emitter.Pos));
+				const auto basis = exp(-4.0f * XMVectorGetX(XMVector3LengthSq(disp)) / (emitter.Radius * emitter.Radius));
+				if (basis >= threshold)
+				{
+					auto extForce = XMVectorScale(XMLoadFloat3(&emitter.Force), basis);
+					if (is3D)
+					{
+						XMFLOAT3 d;
+						XMStoreFloat3(&d, disp);
+						const auto swirlForce = XMVectorScale(XMVectorSet(-d.z, 0.0f, d.x, 0.0f), emitter.Swirl);
+						extForce = XMVectorAdd(XMVectorScale(extForce, ForceScale3D), swirlForce);
+					}
+					u = XMVectorAdd(u, XMVectorScale(extForce, timeStep));
+					color = XMVectorAdd(color, XMVectorScale(XMLoadFloat4(&emitter.Color), timeStep * basis));
+				}
+			}
+
+			// Output
+			XMStoreFloat4(&velocityOut[i], XMVectorSetW(u, 0.0f));
+			XMStoreFloat4(&colorOut[i], XMVectorScale(color, dissipation));
+		}
+	});
+}
+
+void FluidCPU::project()
+{
+	const auto& gridSize = m_gridSize;
+	const auto is3D = gridSize.z > 1;
+	const auto numNeighbors = is3D ? 6.0f : 4.0f;
+	const auto density = is3D ? 0.48f : 1.0f;
+	const auto boundary = is3D ? 2u : 1u;
+	const auto numRows = gridSize.y * gridSize.z;
+	const auto pVelocity = m_velocities[1].data();
+	auto& velocityOut = m_velocities[0];
+	auto& q = m_incompress;
+
+	const auto neighbors = [&](uint32_t x, uint32_t y, uint32_t z, uint32_t cells[6])
+	{
+		cells[0] = VolumeSampler::Index(x > 0 ? x - 1 : 0, y, z, gridSize);
+		cells[1] = VolumeSampler::Index(min(x + 1, gridSize.x - 1), y, z, gridSize);
+		cells[2] = VolumeSampler::Index(x, y > 0 ? y - 1 : 0, z, gridSize);
+		cells[3] = VolumeSampler::Index(x, min(y + 1, gridSize.y - 1), z, gridSize);
+		cells[4] = VolumeSampler::Index(x, y, z > 0 ? z - 1 : 0, gridSize);
+		cells[5] = VolumeSampler::Index(x, y, min(z + 1, gridSize.z - 1), gridSize);
+	};
+
+	// Compute divergence using central differences
+	parallel_for(0u, numRows, [&](uint32_t row)
+	{
+		const auto y = row % gridSize.y;
+		const auto z = row / gridSize.y;
+
+		uint32_t cells[6];
+		for (auto x = 0u; x < gridSize.x; ++x)
+		{
+			neighbors(x, y, z, cells);
+			m_divergence[VolumeSampler::Index(x, y, z, gridSize)] = 0.5f *
+				((pVelocity[cells[1]].x - pVelocity[cells[0]].x) +
+				(pVelocity[cells[3]].y - pVelocity[cells[2]].y) +
+				(pVelocity[cells[5]].z - pVelocity[cells[4]].z));
+		}
+	});
+
+	// Poisson solver: red-black Gauss-Seidel, warm-started from the last frame
+	vector<float> rowDeltas(numRows);
+	for (auto k = 0u; k < 64; ++k)
+	{
+		for (uint8_t parity = 0; parity < 2; ++parity)
+		{
+			parallel_for(0u, numRows, [&](uint32_t row)
+			{
+				const auto y = row % gridSize.y;
+				const auto z = row / gridSize.y;
+
+				uint32_t cells[6];
+				auto delta = parity ? rowDeltas[row] : 0.0f;
+				for (auto x = (y + z + parity) & 1; x < gridSize.x; x += 2)
+				{
+					neighbors(x, y, z, cells);
+					const auto i = VolumeSampler::Index(x, y, z, gridSize);
+					auto sum = q[cells[0]] + q[cells[1]] + q[cells[2]] + q[cells[3]];
+					if (is3D) sum += q[cells[4]] + q[cells[5]];
+
+					const auto x1 = (sum - m_divergence[i]) / numNeighbors;
+					delta = max(delta, abs(x1 - q[i]));
+					q[i] = x1;
+				}
+				rowDeltas[row] = delta;
+			});
+		}
+
+		if (*max_element(rowDeltas.cbegin(), rowDeltas.cend()) < 0.001f) break;
+	}
+
+	// Boundary process and projection
+	parallel_for(0u, numRows, [&](uint32_t row)
+	{
+		const auto y = row % gridSize.y;
+		const auto z = row / gridSize.y;
+		const auto offsetAxis = [boundary](uint32_t i, uint32_t size)
+		{
+			return i + boundary >= size ? -1 : (i < boundary ? 1 : 0);
+		};
+		const auto offsetY = offsetAxis(y, gridSize.y);
+		const auto offsetZ = is3D ? offsetAxis(z, gridSize.z) : 0;
+
+		uint32_t cells[6];
+		for (auto x = 0u; x < gridSize.x; ++x)
+		{
+			const auto i = VolumeSampler::Index(x, y, z, gridSize);
+			const auto offsetX = offsetAxis(x, gridSize.x);
+			auto u = XMLoadFloat4(&pVelocity[i]);
+			if (offsetX || offsetY || offsetZ)
+				u = XMVectorNegate(XMLoadFloat4(&pVelocity[VolumeSampler::Index(x + offsetX, y + offsetY, z + offsetZ, gridSize)]));
+
+			// Project the velocity onto its divergence-free component
+			neighbors(x, y, z, cells);
+			const auto grad = XMVectorSet(q[cells[1]] - q[cells[0]], q[cells[3]] - q[cells[2]],
+				is3D ? q[cells[5]] - q[cells[4]] : 0.0f, 0.0f);
+			u = XMVectorSubtract(u, XMVectorScale(grad, 0.5f / density));
+
+			XMStoreFloat4(&velocityOut[i], XMVectorSetW(u, 0.0f));
+		}
+	});
+}
+
+XMVECTOR XM_CALLCONV FluidCPU::getConfinementForce(uint32_t x, uint32_t y, uint32_t z) const
+{
+	const auto& gridSize = m_gridSize;
+	const auto wL = m_vorticity[VolumeSampler::Index(x > 0 ? x - 1 : 0, y, z, gridSize)].w;
+	const auto wR = m_vorticity[VolumeSampler::Index(min(x + 1, gridSize.x - 1), y, z, gridSize)].w;
+	const auto wU = m_vorticity[VolumeSampler::Index(x, y > 0 ? y - 1 : 0, z, gridSize)].w;
+	const auto wD = m_vorticity[VolumeSampler::Index(x, min(y + 1, gridSize.y - 1), z, gridSize)].w;
+	const auto wF = m_vorticity[VolumeSampler::Index(x, y, z > 0 ? z - 1 : 0, gridSize)].w;
+	const auto wB = m_vorticity[VolumeSampler::Index(x, y, min(z + 1, gridSize.z - 1), gridSize)].w;
+
+	// N = normalize(grad |w|), f = eps * h * (N x w), where the curl is already in cell units
+	const auto eta = XMVectorSet(wR - wL, wD - wU, wB - wF, 0.0f);
+	const auto lenSq = XMVectorGetX(XMVector3LengthSq(eta));
+	if (lenSq < 1e-12f) return XMVectorZero();
+
+	// In 2D, N x w with the scalar curl w_z alone: eps * h * (N.y, -N.x) * w_z
+	const auto& w = m_vorticity[VolumeSampler::Index(x, y, z, gridSize)];
+	const auto n = XMVectorScale(eta, 1.0f / sqrt(lenSq));
+	const auto force = gridSize.z > 1 ? XMVector3Cross(n, XMVectorSet(w.x, w.y, w.z, 0.0f)) :
+		XMVectorScale(XMVectorSet(XMVectorGetY(n), -XMVectorGetX(n), 0.0f, 0.0f), w.z);
+
+	return XMVectorScale(force, VorticityScale);
+}
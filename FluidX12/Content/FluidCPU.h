@@ -0,0 +1,74 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ParticleCPU.h"
+#include <DirectXPackedVector.h>
+
+// CPU simulation path, mirroring CSVorticity, CSAdvect, CSProject2D/3D and CSGradient, and
+// the brick-binned particle-to-grid transfer of the hybrid solver
+class FluidCPU
+{
+public:
+	FluidCPU();
+	virtual ~FluidCPU();
+
+	void Init(const DirectX::XMUINT3& gridSize);
+	void SetEmitters(uint32_t numEmitters, const Emitter* pEmitters);
+	// Only the particle velocities are transferred: the particles carry no density or color of
+	// their own, which stay on the grid and are advected there, and are sampled for the rendering
+	void TransferToGrid(const PackedParticle* pParticles, const uint32_t* pAliveList, uint32_t numAlive,
+		bool parallel = true);
+	void Simulate(float timeStep);	// With the transferred particle velocities once TransferToGrid is used
+	void ComputeNormals();	// Packed shading normals of the current color, once per step
+
+	const DirectX::XMUINT3& GetGridSize() const;
+	const DirectX::XMFLOAT4* GetVelocity() const;
+	const DirectX::XMFLOAT4* GetGridVelocity() const;	// Right after the transfer blend, before the forces and the projection
+	const DirectX::XMFLOAT4* GetColor() const;
+	const DirectX::XMFLOAT4* GetVorticity() const;
+	const DirectX::XMFLOAT4* GetTransfer() const;
+	const DirectX::PackedVector::XMBYTEN4* GetNormals() const;
+
+	static const float ForceScale3D;
+	static const float VorticityScale;
+	static const float Dissipation;
+	static const float TransferQuant;	// Fixed-point scale of the transfer sums, as TRANSFER_QUANT in Transfer.hlsli
+	static const float TransferMaxSpeed;	// Velocity clamp keeping the transfer sums in int32, as TRANSFER_MAX_SPEED
+
+protected:
+	struct TransferSupport
+	{
+		uint32_t Cells[2][3];	// Lower and upper cells per axis
+		float Weights[2][3];
+		DirectX::XMFLOAT3 Velocity;
+	};
+
+	void computeVorticity();
+	void advect(float timeStep);
+	void project();
+
+	bool getTransferSupport(const PackedParticle& packed, TransferSupport& support) const;	// False for fresh particles
+	DirectX::XMVECTOR XM_CALLCONV getConfinementForce(uint32_t x, uint32_t y, uint32_t z) const;
+
+	DirectX::XMUINT3 m_gridSize;
+
+	std::vector<DirectX::XMFLOAT4> m_velocities[2];
+	std::vector<DirectX::XMFLOAT4> m_colors[2];
+	std::vector<DirectX::XMFLOAT4> m_vorticity;
+	std::vector<float> m_incompress;
+	std::vector<float> m_divergence;
+	std::vector<DirectX::PackedVector::XMBYTEN4> m_normals;
+	std::vector<DirectX::XMFLOAT4> m_gridVelocity;	// Grid velocity right after the transfer blend
+	std::vector<DirectX::XMFLOAT4> m_transfer;	// Particle velocities and their weights in w
+	std::vector<uint32_t> m_binCounts;			// Particle counts per batch and brick, then the scatter offsets
+	std::vector<uint32_t> m_binOffsets;			// First binned particle per brick, with the total at the end
+	std::vector<uint32_t> m_binned;				// Particle IDs sorted by brick
+
+	std::vector<Emitter>	m_emitters;
+	EmitterBins				m_emitterBins;
+
+	uint8_t m_frameParity;
+};
@@ -0,0 +1,556 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "ParticleCPU.h"
+#include "VolumeSampler.h"
+#include "Philox.h"
+#include <DirectXPackedVector.h>
+#include <fstream>
+
+using namespace std;
+using namespace concurrency;
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+const float ParticleCPU::FullLife = 3.0f;
+const float ParticleCPU::MaxLifeTime = 4.0f;
+const float ParticleCPU::ParticleRadius = 0.4f;
+
+static const float g_posQuant = 2097151.0f;	// 21-bit UNORM
+static const float g_lifeQuant = 65535.0f;	// 16-bit UNORM
+static const uint32_t g_checkpointMagic = 0x43505846;	// "FXPC"
+static const uint32_t g_checkpointVersion = 2;
+
+// Integer hash of the particle ID, matching HashId in CSCullParticles
+static uint32_t hashId(uint32_t id)
+{
+	const auto state = id * 747796405u + 2891336453u;
+	const auto word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+
+	return (word >> 22) ^ word;
+}
+
+// Spread the lower 10 bits to every third bit, matching Reorder.hlsli
+static uint32_t spreadBits(uint32_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x << 8)) & 0x0300f00f;
+	x = (x | (x << 4)) & 0x030c30c3;
+	x = (x | (x << 2)) & 0x09249249;
+
+	return x;
+}
+
+PackedParticle PackParticle(const Particle& particle)
+{
+	XMUINT3 pos;
+	XMStoreUInt3(&pos, XMVectorAdd(XMVectorScale(XMVectorSaturate(XMLoadFloat3(&particle.Pos)),
+		g_posQuant), XMVectorReplicate(0.5f)));
+
+	// A particle still alive never rounds down to a zero lifetime
+	auto life = static_cast<uint32_t>(min(max(particle.LifeTime / ParticleCPU::MaxLifeTime, 0.0f), 1.0f)
+		* g_lifeQuant + 0.5f);
+	life = particle.LifeTime > 0.0f ? max(life, 1u) : 0;
+
+	PackedParticle packed;
+	packed.PosXY = (pos.x >> 5) | ((pos.y >> 5) << 16);
+	packed.PosZLifeTime = (pos.z >> 5) | (life << 16);
+	packed.VelocityXY = XMConvertFloatToHalf(particle.Velocity.x) |
+		(static_cast<uint32_t>(XMConvertFloatToHalf(particle.Velocity.y)) << 16);
+	packed.VelocityZPosLow = XMConvertFloatToHalf(particle.Velocity.z) |
+		(((pos.x & 0x1f) | ((pos.y & 0x1f) << 5) | ((pos.z & 0x1f) << 10)) << 16);
+
+	return packed;
+}
+
+Particle UnpackParticle(const PackedParticle& packed)
+{
+	const XMUINT3 pos
+	(
+		((packed.PosXY & 0xffff) << 5) | ((packed.VelocityZPosLow >> 16) & 0x1f),
+		((packed.PosXY >> 16) << 5) | ((packed.VelocityZPosLow >> 21) & 0x1f),
+		((packed.PosZLifeTime & 0xffff) << 5) | ((packed.VelocityZPosLow >> 26) & 0x1f)
+	);
+
+	Particle particle;
+	XMStoreFloat3(&particle.Pos, XMVectorScale(XMLoadUInt3(&pos), 1.0f / g_posQuant));
+	particle.Velocity.x = XMConvertHalfToFloat(static_cast<HALF>(packed.VelocityXY & 0xffff));
+	particle.Velocity.y = XMConvertHalfToFloat(static_cast<HALF>(packed.VelocityXY >> 16));
+	particle.Velocity.z = XMConvertHalfToFloat(static_cast<HALF>(packed.VelocityZPosLow & 0xffff));
+	particle.LifeTime = (packed.PosZLifeTime >> 16) * (ParticleCPU::MaxLifeTime / g_lifeQuant);
+
+	return particle;
+}
+
+ParticleCPU::ParticleCPU() :
+	m_seed(0),
+	m_numAlive(0),
+	m_numDead(0),
+	m_parity(0),
+	m_integrator(EULER)
+{
+	m_emitters.emplace_back(Emitter::Default());
+}
+
+ParticleCPU::~ParticleCPU()
+{
+}
+
+void ParticleCPU::Init(uint32_t numParticles, uint32_t seed)
+{
+	m_seed = seed;
+	m_particles.assign(numParticles, {});
+	m_aliveLists[0].resize(numParticles);
+	m_aliveLists[1].resize(numParticles);
+
+	// All particles start in the dead list, filled in batches across the threads
+	m_deadList.resize(numParticles);
+	parallel_for(0u, numParticles, BatchSize, [&](uint32_t first)
+	{
+		const auto end = min(first + BatchSize, numParticles);
+		for (auto i = first; i < end; ++i) m_deadList[i] = i;
+	});
+	m_numDead = numParticles;
+	m_numAlive = 0;
+	m_parity = 0;
+}
+
+void ParticleCPU::SetEmitters(uint32_t numEmitters, const Emitter* pEmitters)
+{
+	m_emitters.assign(pEmitters, pEmitters + numEmitters);
+}
+
+void ParticleCPU::SetIntegrator(Integrator integrator)
+{
+	m_integrator = integrator;
+}
+
+void ParticleCPU::Update(const XMFLOAT4* pVelocity, const XMUINT3& gridSize,
+	float timeStep, uint32_t step, uint32_t budget, const XMFLOAT4* pGridVelocity, float flipRatio)
+{
+	integrate(pVelocity, gridSize, timeStep, pGridVelocity, flipRatio);
+	compact();
+	emit(step, budget, gridSize.z > 1);
+}
+
+void ParticleCPU::Reorder(const XMUINT3& gridSize)
+{
+	auto& aliveList = m_aliveLists[m_parity];
+	const auto numParticles = GetNumParticles();
+	const auto numBatches = (m_numAlive + BatchSize - 1) / BatchSize;
+	m_sortKeys[0].resize(m_numAlive);
+	m_sortValues[0].resize(m_numAlive);
+	m_sortKeys[1].resize(m_numAlive);
+	m_sortValues[1].resize(m_numAlive);
+
+	// Morton codes of the cells of the alive particles, the same as in CSPresort
+	parallel_for(0u, numBatches, [&](uint32_t batch)
+	{
+		const auto end = min((batch + 1) * BatchSize, m_numAlive);
+		for (auto i = batch * BatchSize; i < end; ++i)
+		{
+			const auto particle = UnpackParticle(m_particles[aliveList[i]]);
+			const auto x = min(static_cast<uint32_t>(particle.Pos.x * gridSize.x), gridSize.x - 1);
+			const auto y = min(static_cast<uint32_t>(particle.Pos.y * gridSize.y), gridSize.y - 1);
+			const auto z = min(static_cast<uint32_t>(particle.Pos.z * gridSize.z), gridSize.z - 1);
+			m_sortKeys[0][i] = spreadBits(x) | (spreadBits(y) << 1) | (spreadBits(z) << 2);
+			m_sortValues[0][i] = aliveList[i];
+		}
+	});
+
+	radixSort(m_numAlive);
+
+	// Gather the alive particles in the sorted order, so that the alive list becomes the
+	// identity and the dead list holds the remaining slots, as CSReorder does
+	m_reordered.resize(numParticles);
+	parallel_for(0u, numParticles, BatchSize, [&](uint32_t first)
+	{
+		const auto end = min(first + BatchSize, numParticles);
+		for (auto i = first; i < end; ++i)
+		{
+			if (i < m_numAlive)
+			{
+				m_reordered[i] = m_particles[m_sortValues[0][i]];
+				aliveList[i] = i;
+			}
+			else m_deadList[i - m_numAlive] = i;
+		}
+	});
+
+	m_particles.swap(m_reordered);
+	m_numDead = numParticles - m_numAlive;
+}
+
+uint32_t ParticleCPU::Cull(float renderTimeOffset, CXMMATRIX worldView, CXMMATRIX proj, float lodDistance)
+{
+	const auto& aliveList = m_aliveLists[m_parity];
+	const auto numBatches = (m_numAlive + BatchSize - 1) / BatchSize;
+	const auto extentScale = XMVectorSet(XMVectorGetX(proj.r[0]), XMVectorGetY(proj.r[1]), 0.0f, 0.0f);
+	m_visibleList.resize(m_numAlive);
+	m_batchCounts.resize(numBatches);
+
+	// Frustum test and distance-based thinning, the same as in CSCullParticles, with the
+	// survivors of each batch packed at the start of the batch
+	parallel_for(0u, numBatches, [&](uint32_t batch)
+	{
+		const auto end = min((batch + 1) * BatchSize, m_numAlive);
+		auto slot = batch * BatchSize;
+		for (auto i = batch * BatchSize; i < end; ++i)
+		{
+			const auto particleId = aliveList[i];
+			const auto particle = UnpackParticle(m_particles[particleId]);
+			auto pos = XMVectorMultiplyAdd(XMLoadFloat3(&particle.Velocity), XMVectorReplicate(renderTimeOffset),
+				XMLoadFloat3(&particle.Pos));
+			pos = XMVectorMultiplyAdd(pos, XMVectorReplicate(2.0f), XMVectorReplicate(-1.0f));
+			pos = XMVectorSetW(XMVectorMultiply(pos, XMVectorSet(1.0f, -1.0f, 1.0f, 1.0f)), 1.0f);
+			pos = XMVectorSetW(XMVector4Transform(pos, worldView), 1.0f);
+			XMFLOAT4 clipPos;
+			XMStoreFloat4(&clipPos, XMVector4Transform(pos, proj));
+
+			const auto keep = clipPos.w > lodDistance ? lodDistance / clipPos.w : 1.0f;
+			if (Philox::ToFloat(hashId(particleId)) >= keep * keep) continue;
+			const auto radiusScale = 1.0f / keep;
+
+			XMFLOAT2 extent;
+			XMStoreFloat2(&extent, XMVectorScale(extentScale, ParticleRadius * radiusScale));
+			if (clipPos.w <= 0.0f || clipPos.z < 0.0f || clipPos.z > clipPos.w) continue;
+			if (abs(clipPos.x) > clipPos.w + extent.x || abs(clipPos.y) > clipPos.w + extent.y) continue;
+
+			m_visibleList[slot++] = { particleId, radiusScale };
+		}
+		m_batchCounts[batch] = slot - batch * BatchSize;
+	});
+
+	// Close the gaps between the batches in order; each batch moves to an offset no later than its start
+	auto numVisible = 0u;
+	for (auto batch = 0u; batch < numBatches; ++batch)
+	{
+		const auto count = m_batchCounts[batch];
+		memmove(&m_visibleList[numVisible], &m_visibleList[batch * BatchSize], sizeof(VisibleParticle) * count);
+		numVisible += count;
+	}
+	m_visibleList.resize(numVisible);
+
+	return numVisible;
+}
+
+ParticleCPU::Integrator ParticleCPU::GetIntegrator() const
+{
+	return m_integrator;
+}
+
+uint32_t ParticleCPU::GetNumParticles() const
+{
+	return static_cast<uint32_t>(m_particles.size());
+}
+
+uint32_t ParticleCPU::GetNumAlive() const
+{
+	return m_numAlive;
+}
+
+const PackedParticle* ParticleCPU::GetParticles() const
+{
+	return m_particles.data();
+}
+
+const uint32_t* ParticleCPU::GetAliveList() const
+{
+	return m_aliveLists[m_parity].data();
+}
+
+const VisibleParticle* ParticleCPU::GetVisibleList() const
+{
+	return m_visibleList.data();
+}
+
+bool ParticleCPU::SaveCheckpoint(const char* fileName) const
+{
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	// Header, packed particles, then the current alive list and the dead list
+	const uint32_t header[] =
+	{
+		g_checkpointMagic, g_checkpointVersion,
+		GetNumParticles(), m_numAlive, m_numDead, m_seed
+	};
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_particles.data()), sizeof(PackedParticle) * m_particles.size());
+	file.write(reinterpret_cast<const char*>(m_aliveLists[m_parity].data()), sizeof(uint32_t) * m_numAlive);
+	file.write(reinterpret_cast<const char*>(m_deadList.data()), sizeof(uint32_t) * m_numDead);
+
+	return file.good();
+}
+
+bool ParticleCPU::LoadCheckpoint(const char* fileName)
+{
+	ifstream file(fileName, ios::binary | ios::ate);
+	if (!file) return false;
+	const auto fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	uint32_t header[6];
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+	if (header[0] != g_checkpointMagic || header[1] != g_checkpointVersion) return false;
+
+	const auto numParticles = header[2];
+	const auto numAlive = header[3];
+	const auto numDead = header[4];
+	if (numAlive > numParticles || numDead != numParticles - numAlive) return false;
+	if (fileSize != sizeof(header) + (sizeof(PackedParticle) + sizeof(uint32_t)) * static_cast<uint64_t>(numParticles))
+		return false;
+
+	// Read into temporaries, so that a rejected checkpoint leaves the current state intact;
+	// the alive list is followed by the dead list
+	vector<PackedParticle> particles(numParticles);
+	vector<uint32_t> lists(numParticles);
+	file.read(reinterpret_cast<char*>(particles.data()), sizeof(PackedParticle) * numParticles);
+	file.read(reinterpret_cast<char*>(lists.data()), sizeof(uint32_t) * numParticles);
+	if (!file) return false;
+
+	// The lists must hold every particle ID exactly once, and the alive particles must be alive
+	vector<uint8_t> isListed(numParticles);
+	for (auto i = 0u; i < numParticles; ++i)
+	{
+		const auto particleId = lists[i];
+		if (particleId >= numParticles || isListed[particleId]) return false;
+		if (i < numAlive && !(particles[particleId].PosZLifeTime >> 16)) return false;
+		isListed[particleId] = 1;
+	}
+
+	Init(numParticles, header[5]);
+	m_particles.swap(particles);
+	memcpy(m_aliveLists[0].data(), lists.data(), sizeof(uint32_t) * numAlive);
+	memcpy(m_deadList.data(), &lists[numAlive], sizeof(uint32_t) * numDead);
+	m_numAlive = numAlive;
+	m_numDead = numDead;
+
+	return true;
+}
+
+void ParticleCPU::integrate(const XMFLOAT4* pVelocity, const XMUINT3& gridSize, float timeStep,
+	const XMFLOAT4* pGridVelocity, float flipRatio)
+{
+	const auto& aliveList = m_aliveLists[m_parity];
+	const auto numBatches = (m_numAlive + BatchSize - 1) / BatchSize;
+	m_batchCounts.resize(numBatches);
+
+	// Batches of consecutive alive-list entries, matching CSParticle; count the survivors per batch
+	parallel_for(0u, numBatches, [&](uint32_t batch)
+	{
+		const auto end = min((batch + 1) * BatchSize, m_numAlive);
+		auto numSurvivors = 0u;
+		for (auto i = batch * BatchSize; i < end; ++i)
+		{
+			auto& packed = m_particles[aliveList[i]];
+			auto particle = UnpackParticle(packed);
+			const auto tex = XMVectorSaturate(XMLoadFloat3(&particle.Pos));
+			const auto velocity = VolumeSampler::SampleLinear(pVelocity, gridSize, tex, VolumeSampler::CLAMP);
+			const auto& v = particle.Velocity;
+			if (pGridVelocity && (v.x != 0.0f || v.y != 0.0f || v.z != 0.0f))
+			{
+				// FLIP update by the grid change since the transfer, blended with the PIC velocity
+				const auto change = XMVectorSubtract(velocity, VolumeSampler::SampleLinear(pGridVelocity, gridSize, tex, VolumeSampler::CLAMP));
+				XMStoreFloat3(&particle.Velocity, XMVectorLerp(velocity, XMVectorAdd(XMLoadFloat3(&v), change), flipRatio));
+			}
+			else XMStoreFloat3(&particle.Velocity, velocity);
+			XMStoreFloat3(&particle.Pos, XMVectorMultiplyAdd(getPathVelocity(XMLoadFloat3(&particle.Pos), velocity,
+				pVelocity, gridSize, timeStep), XMVectorReplicate(timeStep), XMLoadFloat3(&particle.Pos)));
+			particle.LifeTime -= timeStep;
+
+			// Particles leaving the simulation cube cannot be represented, so they are released
+			if (particle.Pos.x < 0.0f || particle.Pos.y < 0.0f || particle.Pos.z < 0.0f ||
+				particle.Pos.x > 1.0f || particle.Pos.y > 1.0f || particle.Pos.z > 1.0f)
+				particle.LifeTime = 0.0f;
+			packed = PackParticle(particle);
+			numSurvivors += particle.LifeTime > 0.0f ? 1 : 0;
+		}
+		m_batchCounts[batch] = numSurvivors;
+	});
+}
+
+XMVECTOR XM_CALLCONV ParticleCPU::getPathVelocity(FXMVECTOR pos, FXMVECTOR velocity, const XMFLOAT4* pVelocity,
+	const XMUINT3& gridSize, float timeStep) const
+{
+	// Further stages along the path from the velocity sampled at the start, as in CSParticle
+	if (m_integrator == EULER) return velocity;
+
+	const auto k2 = VolumeSampler::SampleLinear(pVelocity, gridSize, XMVectorSaturate(XMVectorMultiplyAdd(velocity,
+		XMVectorReplicate(0.5f * timeStep), pos)), VolumeSampler::CLAMP);
+	if (m_integrator == RK2) return k2;
+
+	const auto k3 = VolumeSampler::SampleLinear(pVelocity, gridSize, XMVectorSaturate(XMVectorMultiplyAdd(k2,
+		XMVectorReplicate(0.75f * timeStep), pos)), VolumeSampler::CLAMP);
+
+	return XMVectorScale(XMVectorAdd(XMVectorAdd(XMVectorScale(velocity, 2.0f), XMVectorScale(k2, 3.0f)),
+		XMVectorScale(k3, 4.0f)), 1.0f / 9.0f);
+}
+
+void ParticleCPU::compact()
+{
+	const auto numBatches = static_cast<uint32_t>(m_batchCounts.size());
+
+	// Exclusive prefix scan of the survivor counts into the batch offsets
+	auto numSurvivors = 0u;
+	for (auto& count : m_batchCounts)
+	{
+		const auto offset = numSurvivors;
+		numSurvivors += count;
+		count = offset;
+	}
+
+	// Scatter the survivors into the other alive list, and the others onto the dead list,
+	// both in the batch order so that the result is deterministic
+	const auto& aliveList = m_aliveLists[m_parity];
+	auto& nextAliveList = m_aliveLists[!m_parity];
+	const auto numDead = m_numDead;
+	parallel_for(0u, numBatches, [&](uint32_t batch)
+	{
+		const auto end = min((batch + 1) * BatchSize, m_numAlive);
+		auto aliveSlot = m_batchCounts[batch];
+		auto deadSlot = numDead + batch * BatchSize - aliveSlot;
+		for (auto i = batch * BatchSize; i < end; ++i)
+		{
+			const auto particleId = aliveList[i];
+			if (m_particles[particleId].PosZLifeTime >> 16) nextAliveList[aliveSlot++] = particleId;
+			else m_deadList[deadSlot++] = particleId;
+		}
+	});
+
+	m_numDead += m_numAlive - numSurvivors;
+	m_numAlive = numSurvivors;
+	m_parity = !m_parity;
+}
+
+void ParticleCPU::emit(uint32_t step, uint32_t budget, bool is3D)
+{
+	if (m_emitters.empty()) return;
+
+	// Pop from the top of the dead list within the budget, and append to the alive list
+	const auto numEmitters = static_cast<uint32_t>(m_emitters.size());
+	const auto numEmitted = min(budget, m_numDead);
+	auto& aliveList = m_aliveLists[m_parity];
+	parallel_for(0u, numEmitted, BatchSize, [&](uint32_t first)
+	{
+		const auto end = min(first + BatchSize, numEmitted);
+		for (auto i = first; i < end; ++i)
+		{
+			const auto particleId = m_deadList[m_numDead - 1 - i];
+			Particle particle;
+			Emit(particle, numEmitters, m_emitters.data(), i, step, m_seed, is3D);
+			m_particles[particleId] = PackParticle(particle);
+			aliveList[m_numAlive + i] = particleId;
+		}
+	});
+
+	m_numDead -= numEmitted;
+	m_numAlive += numEmitted;
+}
+
+void ParticleCPU::Emit(Particle& particle, uint32_t numEmitters, const Emitter* pEmitters,
+	uint32_t emissionId, uint32_t step, uint32_t seed, bool is3D)
+{
+	// Independent draws per emission and simulation step, the same as in CSEmit
+	const auto rands = Philox::Generate(XMUINT4(emissionId, step, 0, Philox::EMISSION), XMUINT2(seed, 0));
+	Emit(particle, numEmitters, pEmitters, rands, is3D);
+}
+
+void ParticleCPU::Emit(Particle& particle, uint32_t numEmitters, const Emitter* pEmitters,
+	const XMUINT4& rands, bool is3D)
+{
+	// Load emitter with a random index
+	const auto& emitter = pEmitters[numEmitters > 1 ? rands.x % numEmitters : 0];
+	const auto r = emitter.Radius * Philox::ToFloat(rands.y);
+	const auto t = Philox::ToFloat(rands.z);
+	const auto theta = t * 2.0f * XM_PI;
+	XMFLOAT3 sphere(r * cos(theta), r * sin(theta), 0.0f);
+
+	if (is3D)
+	{
+		const auto s = Philox::ToFloat(rands.w);
+		const auto phi = s * XM_PI;
+		sphere.x *= sin(phi);
+		sphere.y *= sin(phi);
+		sphere.z = r * cos(phi);
+	}
+
+	// Particle emission
+	particle.Pos = XMFLOAT3(emitter.Pos.x + sphere.x, emitter.Pos.y + sphere.y, emitter.Pos.z + sphere.z);
+	particle.Velocity = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	particle.LifeTime = FullLife + Philox::LowBytesToFloat(rands.y, rands.z, rands.w);
+}
+
+void ParticleCPU::ExpandQuad(XMFLOAT4 pCorners[4], XMFLOAT2 pTexcoords[4], const Particle& particle,
+	float renderTimeOffset, CXMMATRIX worldView, CXMMATRIX proj, float radiusScale)
+{
+	// Simulation position at the rendered time, then to object and view spaces
+	auto pos = XMVectorMultiplyAdd(XMLoadFloat3(&particle.Velocity), XMVectorReplicate(renderTimeOffset),
+		XMLoadFloat3(&particle.Pos));
+	pos = XMVectorMultiplyAdd(pos, XMVectorReplicate(2.0f), XMVectorReplicate(-1.0f));
+	pos = XMVectorSetW(XMVectorMultiply(pos, XMVectorSet(1.0f, -1.0f, 1.0f, 1.0f)), 1.0f);
+	pos = XMVector4Transform(pos, worldView);
+
+	for (uint8_t i = 0; i < 4; ++i)
+	{
+		// Corner of the quad, the same as from SV_VertexID in VSParticle
+		const XMFLOAT2 domain(static_cast<float>(i & 1), static_cast<float>(i >> 1));
+		const auto radius = ParticleRadius * radiusScale;
+		const auto offset = XMVectorSet((domain.x * 2.0f - 1.0f) * radius, (1.0f - domain.y * 2.0f) * radius, 0.0f, 0.0f);
+		XMStoreFloat4(&pCorners[i], XMVector4Transform(XMVectorSetW(XMVectorAdd(pos, offset), 1.0f), proj));
+		pTexcoords[i] = domain;
+	}
+}
+
+void ParticleCPU::radixSort(uint32_t numElements)
+{
+	const auto numBatches = (numElements + BatchSize - 1) / BatchSize;
+	m_digitCounts.resize(numBatches * 256);
+
+	// LSD radix sort of 8-bit digits; the even number of passes ends in the first buffers
+	for (uint8_t pass = 0; pass < 4; ++pass)
+	{
+		const auto shift = pass * 8;
+		const auto& keys = m_sortKeys[pass & 1];
+		const auto& values = m_sortValues[pass & 1];
+		auto& sortedKeys = m_sortKeys[!(pass & 1)];
+		auto& sortedValues = m_sortValues[!(pass & 1)];
+
+		// Digit counts per batch
+		parallel_for(0u, numBatches, [&](uint32_t batch)
+		{
+			const auto pCounts = &m_digitCounts[batch * 256];
+			memset(pCounts, 0, sizeof(uint32_t) * 256);
+			const auto end = min((batch + 1) * BatchSize, numElements);
+			for (auto i = batch * BatchSize; i < end; ++i) ++pCounts[(keys[i] >> shift) & 0xff];
+		});
+
+		// Exclusive prefix scan in the digit-major order, so that the scatter is stable
+		auto offset = 0u;
+		for (auto digit = 0u; digit < 256; ++digit)
+		{
+			for (auto batch = 0u; batch < numBatches; ++batch)
+			{
+				auto& count = m_digitCounts[batch * 256 + digit];
+				const auto numDigits = count;
+				count = offset;
+				offset += numDigits;
+			}
+		}
+
+		// Scatter
+		parallel_for(0u, numBatches, [&](uint32_t batch)
+		{
+			const auto pOffsets = &m_digitCounts[batch * 256];
+			const auto end = min((batch + 1) * BatchSize, numElements);
+			for (auto i = batch * BatchSize; i < end; ++i)
+			{
+				const auto dst = pOffsets[(keys[i] >> shift) & 0xff]++;
+				sortedKeys[dst] = keys[i];
+				sortedValues[dst] = values[i];
+			}
+		});
+	}
+}
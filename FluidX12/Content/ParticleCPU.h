@@ -0,0 +1,123 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "Emitter.h"
+
+// Layout matches the Particle structure in Particle.hlsli
+struct Particle
+{
+	DirectX::XMFLOAT3 Pos;		// Position in simulation space
+	DirectX::XMFLOAT3 Velocity;
+	float LifeTime;
+};
+
+// 16-byte quantized particle, matching PackParticle and UnpackParticle in Particle.hlsli;
+// positions are 21-bit UNORM over the unit simulation cube, split into the high 16 bits
+// and the low 5 bits
+struct PackedParticle
+{
+	uint32_t PosXY;				// High bits of the position x and y
+	uint32_t PosZLifeTime;		// High bits of the position z, and the 16-bit UNORM lifetime
+	uint32_t VelocityXY;		// Half-precision velocity x and y
+	uint32_t VelocityZPosLow;	// Half-precision velocity z, and the low bits of the position
+};
+
+// Entry of the visible list, matching the output of CSCullParticles
+struct VisibleParticle
+{
+	uint32_t ParticleId;
+	float RadiusScale;			// Enlargement of the thinned distant particles
+};
+
+PackedParticle PackParticle(const Particle& particle);
+Particle UnpackParticle(const PackedParticle& packed);
+
+// CPU particle update path, mirroring CSParticle and CSEmit; the alive and dead lists
+// are compacted by a prefix scan over the batch counts instead of atomic counters
+class ParticleCPU
+{
+public:
+	enum Integrator : uint8_t
+	{
+		EULER,
+		RK2,	// Midpoint
+		RK3,	// Ralston's third order
+
+		NUM_INTEGRATOR
+	};
+
+	ParticleCPU();
+	virtual ~ParticleCPU();
+
+	void Init(uint32_t numParticles, uint32_t seed = 0);
+	void SetEmitters(uint32_t numEmitters, const Emitter* pEmitters);
+	void SetIntegrator(Integrator integrator);
+	// With the grid velocities right after the transfer of FluidCPU::GetGridVelocity, the particle
+	// velocities are updated by the FLIP ratio as in CSParticleHybrid
+	void Update(const DirectX::XMFLOAT4* pVelocity, const DirectX::XMUINT3& gridSize,
+		float timeStep, uint32_t step, uint32_t budget, const DirectX::XMFLOAT4* pGridVelocity = nullptr,
+		float flipRatio = 0.0f);
+	void Reorder(const DirectX::XMUINT3& gridSize);
+	uint32_t Cull(float renderTimeOffset, DirectX::CXMMATRIX worldView, DirectX::CXMMATRIX proj, float lodDistance);
+
+	uint32_t GetNumParticles() const;
+	uint32_t GetNumAlive() const;
+	Integrator GetIntegrator() const;
+	const PackedParticle* GetParticles() const;
+	const uint32_t* GetAliveList() const;
+	const VisibleParticle* GetVisibleList() const;
+
+	bool SaveCheckpoint(const char* fileName) const;
+	bool LoadCheckpoint(const char* fileName);	// Malformed checkpoints are rejected, keeping the current state
+
+	static void Emit(Particle& particle, uint32_t numEmitters, const Emitter* pEmitters,
+		uint32_t emissionId, uint32_t step, uint32_t seed, bool is3D);
+	static void Emit(Particle& particle, uint32_t numEmitters, const Emitter* pEmitters,
+		const DirectX::XMUINT4& rands, bool is3D);	// From the block drawn for the emission
+
+	// Clip-space corners and texture coordinates of the billboard quad of a particle in the
+	// triangle-strip order of VSParticle
+	static void ExpandQuad(DirectX::XMFLOAT4 pCorners[4], DirectX::XMFLOAT2 pTexcoords[4],
+		const Particle& particle, float renderTimeOffset, DirectX::CXMMATRIX worldView,
+		DirectX::CXMMATRIX proj, float radiusScale = 1.0f);
+
+	static const uint32_t BatchSize = 4096;
+	static const float FullLife;
+	static const float MaxLifeTime;	// Range of the quantized lifetime
+	static const float ParticleRadius;	// Billboard half-size in view space
+
+protected:
+	void integrate(const DirectX::XMFLOAT4* pVelocity, const DirectX::XMUINT3& gridSize, float timeStep,
+		const DirectX::XMFLOAT4* pGridVelocity, float flipRatio);
+	void compact();
+
+	// Displacement velocity over the step by the integrator, from the velocity sampled at the start
+	DirectX::XMVECTOR XM_CALLCONV getPathVelocity(DirectX::FXMVECTOR pos, DirectX::FXMVECTOR velocity,
+		const DirectX::XMFLOAT4* pVelocity, const DirectX::XMUINT3& gridSize, float timeStep) const;
+	void emit(uint32_t step, uint32_t budget, bool is3D);
+	void radixSort(uint32_t numElements);
+
+	std::vector<PackedParticle> m_particles;
+	std::vector<uint32_t>	m_aliveLists[2];
+	std::vector<uint32_t>	m_deadList;
+	std::vector<uint32_t>	m_batchCounts;	// Survivors per batch, scanned into offsets
+	std::vector<Emitter>	m_emitters;
+
+	// Spatial reorder: sort keys and values in both ping-pong buffers, the per-batch
+	// digit counts, and the particles gathered in the sorted order
+	std::vector<uint32_t>	m_sortKeys[2];
+	std::vector<uint32_t>	m_sortValues[2];
+	std::vector<uint32_t>	m_digitCounts;
+	std::vector<PackedParticle> m_reordered;
+
+	std::vector<VisibleParticle> m_visibleList;	// Survivors of the culling, in the alive-list order
+
+	uint32_t m_seed;
+	uint32_t m_numAlive;
+	uint32_t m_numDead;
+	uint8_t m_parity;
+	Integrator m_integrator;
+};
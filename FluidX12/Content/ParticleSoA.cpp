@@ -0,0 +1,421 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <intrin.h>
+#include <immintrin.h>
+#include "ParticleSoA.h"
+#include "Philox.h"
+#include "VolumeSampler.h"
+
+using namespace std;
+using namespace concurrency;
+using namespace DirectX;
+
+ParticleSoA::ParticleSoA() :
+	m_components(),
+	m_numParticles(0),
+	m_numAlive(0),
+	m_seed(0),
+	m_kernel(GetBestKernel())
+{
+	m_emitters.emplace_back(Emitter::Default());
+}
+
+ParticleSoA::~ParticleSoA()
+{
+}
+
+void ParticleSoA::Init(uint32_t numParticles, uint32_t seed)
+{
+	// Pad each component array to a whole cache line, so that every array stays aligned
+	const auto stride = (numParticles + Alignment / sizeof(float) - 1) / (Alignment / sizeof(float)) * (Alignment / sizeof(float));
+	m_data.reset(static_cast<float*>(_aligned_malloc(sizeof(float) * stride * NUM_COMPONENT, Alignment)));
+	memset(m_data.get(), 0, sizeof(float) * stride * NUM_COMPONENT);
+	for (uint8_t i = 0; i < NUM_COMPONENT; ++i) m_components[i] = &m_data[stride * i];
+
+	// All particles start dead, and are emitted within the budgets of the updates
+	m_numParticles = numParticles;
+	m_numAlive = 0;
+	m_seed = seed;
+}
+
+void ParticleSoA::SetEmitters(uint32_t numEmitters, const Emitter* pEmitters)
+{
+	m_emitters.assign(pEmitters, pEmitters + numEmitters);
+}
+
+void ParticleSoA::SetKernel(Kernel kernel)
+{
+	m_kernel = min(kernel, GetBestKernel());
+}
+
+void ParticleSoA::Update(const XMFLOAT4* pVelocity, const XMUINT3& gridSize,
+	float timeStep, uint32_t step, uint32_t budget, bool parallel)
+{
+	// Batches of the alive particles, integrated and then packed in place; the batch starts
+	// are multiples of the vector widths, so that the aligned loads hold
+	const auto numBatches = (m_numAlive + BatchSize - 1) / BatchSize;
+	m_batchCounts.resize(numBatches);
+	const auto update = [&](uint32_t batch)
+	{
+		const auto first = batch * BatchSize;
+		const auto last = min(first + BatchSize, m_numAlive);
+		switch (m_kernel)
+		{
+		case AVX512:
+			integrateAVX512(first, last, pVelocity, gridSize, timeStep);
+			break;
+		case AVX2:
+			integrateAVX2(first, last, pVelocity, gridSize, timeStep);
+			break;
+		default:
+			integrateScalar(first, last, pVelocity, gridSize, timeStep);
+		}
+		m_batchCounts[batch] = packSurvivors(first, last);
+	};
+
+	if (parallel) parallel_for(0u, numBatches, update);
+	else for (auto batch = 0u; batch < numBatches; ++batch) update(batch);
+
+	compact();
+
+	// Emit into the front of the dead slots within the budget, with the same emission IDs as ParticleCPU
+	if (m_emitters.empty()) return;
+	const auto is3D = gridSize.z > 1;
+	const auto numEmitted = min(budget, m_numParticles - m_numAlive);
+	const XMUINT2 key(m_seed, 0);
+	const auto emitBatch = [&](uint32_t first)
+	{
+		const auto end = min(first + BatchSize, numEmitted);
+		auto i = first;
+
+		// The draws of 8 emissions at a time under AVX2 and AVX-512, the same blocks as ParticleCPU::Emit
+		if (m_kernel >= AVX2)
+		{
+			for (; i + 8 <= end; i += 8)
+			{
+				uint32_t rands[4][8];
+				Philox::GenerateAVX2(rands, i, step, 0, Philox::EMISSION, key);
+				for (uint8_t j = 0; j < 8; ++j)
+					emit(m_numAlive + i + j, XMUINT4(rands[0][j], rands[1][j], rands[2][j], rands[3][j]), is3D);
+			}
+		}
+		for (; i < end; ++i) emit(m_numAlive + i, Philox::Generate(XMUINT4(i, step, 0, Philox::EMISSION), key), is3D);
+	};
+
+	if (parallel) parallel_for(0u, numEmitted, BatchSize, emitBatch);
+	else for (auto i = 0u; i < numEmitted; i += BatchSize) emitBatch(i);
+	m_numAlive += numEmitted;
+}
+
+void ParticleSoA::Export(PackedParticle* pParticles, bool parallel) const
+{
+	const auto pack = [&](uint32_t first, uint32_t last)
+	{
+		for (auto i = first; i < last; ++i)
+		{
+			Particle particle = {};
+			if (i < m_numAlive)
+			{
+				particle.Pos = XMFLOAT3(m_components[POS_X][i], m_components[POS_Y][i], m_components[POS_Z][i]);
+				particle.Velocity = XMFLOAT3(m_components[VELOCITY_X][i], m_components[VELOCITY_Y][i], m_components[VELOCITY_Z][i]);
+				particle.LifeTime = m_components[LIFE_TIME][i];
+			}
+			pParticles[i] = PackParticle(particle);
+		}
+	};
+
+	if (parallel)
+	{
+		const auto numBatches = (m_numParticles + BatchSize - 1) / BatchSize;
+		parallel_for(0u, numBatches, [&](uint32_t batch)
+		{
+			pack(batch * BatchSize, min((batch + 1) * BatchSize, m_numParticles));
+		});
+	}
+	else pack(0, m_numParticles);
+}
+
+uint32_t ParticleSoA::GetNumParticles() const
+{
+	return m_numParticles;
+}
+
+uint32_t ParticleSoA::GetNumAlive() const
+{
+	return m_numAlive;
+}
+
+ParticleSoA::Kernel ParticleSoA::GetKernel() const
+{
+	return m_kernel;
+}
+
+const float* ParticleSoA::GetComponent(Component component) const
+{
+	return m_components[component];
+}
+
+ParticleSoA::Kernel ParticleSoA::GetBestKernel()
+{
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return SCALAR;
+
+	// The OS must save the YMM (and ZMM) states
+	__cpuid(info, 1);
+	const auto hasFMA = (info[2] & (1 << 12)) != 0;
+	const auto hasOSXSAVE = (info[2] & (1 << 27)) != 0;
+	if (!hasOSXSAVE) return SCALAR;
+	const auto xcr0 = _xgetbv(0);
+
+	__cpuidex(info, 7, 0);
+	const auto hasAVX2 = (info[1] & (1 << 5)) != 0;
+	const auto hasAVX512F = (info[1] & (1 << 16)) != 0;
+
+	if (hasAVX512F && (xcr0 & 0xe6) == 0xe6) return AVX512;
+	if (hasAVX2 && hasFMA && (xcr0 & 0x6) == 0x6) return AVX2;
+
+	return SCALAR;
+}
+
+void ParticleSoA::integrateScalar(uint32_t first, uint32_t last, const XMFLOAT4* pVelocity,
+	const XMUINT3& gridSize, float timeStep)
+{
+	const float size[] = { static_cast<float>(gridSize.x), static_cast<float>(gridSize.y), static_cast<float>(gridSize.z) };
+	const int32_t maxIdx[] = { static_cast<int32_t>(gridSize.x - 1), static_cast<int32_t>(gridSize.y - 1),
+		static_cast<int32_t>(gridSize.z - 1) };
+	const auto pVel = reinterpret_cast<const float*>(pVelocity);
+	const auto lerp = [](float a, float b, float t) { return a + t * (b - a); };
+
+	for (auto i = first; i < last; ++i)
+	{
+		// Texel space with the texel centers at integers, clamp addressing
+		float w[3];
+		int32_t i0[3], i1[3];
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			const auto tex = min(max(m_components[POS_X + c][i], 0.0f), 1.0f);
+			const auto t = tex * size[c] - 0.5f;
+			const auto base = floor(t);
+			w[c] = t - base;
+			const auto baseI = static_cast<int32_t>(base);
+			i0[c] = min(max(baseI, 0), maxIdx[c]);
+			i1[c] = min(max(baseI + 1, 0), maxIdx[c]);
+		}
+
+		// Float4 element offsets of the 8 corners
+		uint32_t corners[8];
+		for (uint8_t k = 0; k < 8; ++k)
+			corners[k] = VolumeSampler::Index((k & 1) ? i1[0] : i0[0], (k & 2) ? i1[1] : i0[1], (k & 4) ? i1[2] : i0[2], gridSize) * 4;
+
+		// Trilinear interpolation per velocity component
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			const auto pBase = pVel + c;
+			const auto c00 = lerp(pBase[corners[0]], pBase[corners[1]], w[0]);
+			const auto c10 = lerp(pBase[corners[2]], pBase[corners[3]], w[0]);
+			const auto c01 = lerp(pBase[corners[4]], pBase[corners[5]], w[0]);
+			const auto c11 = lerp(pBase[corners[6]], pBase[corners[7]], w[0]);
+			const auto u = lerp(lerp(c00, c10, w[1]), lerp(c01, c11, w[1]), w[2]);
+			m_components[VELOCITY_X + c][i] = u;
+			m_components[POS_X + c][i] += u * timeStep;
+		}
+		m_components[LIFE_TIME][i] -= timeStep;
+	}
+}
+
+void ParticleSoA::integrateAVX2(uint32_t first, uint32_t last, const XMFLOAT4* pVelocity,
+	const XMUINT3& gridSize, float timeStep)
+{
+	const auto pVel = reinterpret_cast<const float*>(pVelocity);
+	const auto zero = _mm256_setzero_ps();
+	const auto one = _mm256_set1_ps(1.0f);
+	const auto half = _mm256_set1_ps(0.5f);
+	const auto dt = _mm256_set1_ps(timeStep);
+	const __m256 size[] = { _mm256_set1_ps(static_cast<float>(gridSize.x)),
+		_mm256_set1_ps(static_cast<float>(gridSize.y)), _mm256_set1_ps(static_cast<float>(gridSize.z)) };
+	const __m256i maxIdx[] = { _mm256_set1_epi32(gridSize.x - 1), _mm256_set1_epi32(gridSize.y - 1),
+		_mm256_set1_epi32(gridSize.z - 1) };
+	const auto zeroI = _mm256_setzero_si256();
+	const auto oneI = _mm256_set1_epi32(1);
+	const auto pitchY = _mm256_set1_epi32(gridSize.x);
+	const auto pitchZ = _mm256_set1_epi32(gridSize.x * gridSize.y);
+
+	// Whole 8-wide vectors, then the tail in scalar
+	const auto simdLast = first + (last - first) / 8 * 8;
+	for (auto i = first; i < simdLast; i += 8)
+	{
+		// Texel space with the texel centers at integers, clamp addressing
+		__m256 pos[3], w[3];
+		__m256i i0[3], i1[3];
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			pos[c] = _mm256_load_ps(&m_components[POS_X + c][i]);
+			const auto tex = _mm256_min_ps(_mm256_max_ps(pos[c], zero), one);
+			const auto t = _mm256_sub_ps(_mm256_mul_ps(tex, size[c]), half);
+			const auto base = _mm256_floor_ps(t);
+			w[c] = _mm256_sub_ps(t, base);
+			const auto baseI = _mm256_cvttps_epi32(base);
+			i0[c] = _mm256_min_epi32(_mm256_max_epi32(baseI, zeroI), maxIdx[c]);
+			i1[c] = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(baseI, oneI), zeroI), maxIdx[c]);
+		}
+
+		// Float4 element offsets of the 8 corners
+		const __m256i rows[] =
+		{
+			_mm256_add_epi32(_mm256_mullo_epi32(i0[2], pitchZ), _mm256_mullo_epi32(i0[1], pitchY)),
+			_mm256_add_epi32(_mm256_mullo_epi32(i0[2], pitchZ), _mm256_mullo_epi32(i1[1], pitchY)),
+			_mm256_add_epi32(_mm256_mullo_epi32(i1[2], pitchZ), _mm256_mullo_epi32(i0[1], pitchY)),
+			_mm256_add_epi32(_mm256_mullo_epi32(i1[2], pitchZ), _mm256_mullo_epi32(i1[1], pitchY))
+		};
+		__m256i corners[8];
+		for (uint8_t r = 0; r < 4; ++r)
+		{
+			corners[r * 2] = _mm256_slli_epi32(_mm256_add_epi32(rows[r], i0[0]), 2);
+			corners[r * 2 + 1] = _mm256_slli_epi32(_mm256_add_epi32(rows[r], i1[0]), 2);
+		}
+
+		// Trilinear interpolation per velocity component
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			const auto pBase = pVel + c;
+			__m256 v[8];
+			for (uint8_t k = 0; k < 8; ++k) v[k] = _mm256_i32gather_ps(pBase, corners[k], 4);
+			const auto lerp = [](__m256 a, __m256 b, __m256 t) { return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a))); };
+			const auto c00 = lerp(v[0], v[1], w[0]);
+			const auto c10 = lerp(v[2], v[3], w[0]);
+			const auto c01 = lerp(v[4], v[5], w[0]);
+			const auto c11 = lerp(v[6], v[7], w[0]);
+			const auto u = lerp(lerp(c00, c10, w[1]), lerp(c01, c11, w[1]), w[2]);
+
+			_mm256_store_ps(&m_components[VELOCITY_X + c][i], u);
+			_mm256_store_ps(&m_components[POS_X + c][i], _mm256_add_ps(pos[c], _mm256_mul_ps(u, dt)));
+		}
+		_mm256_store_ps(&m_components[LIFE_TIME][i], _mm256_sub_ps(_mm256_load_ps(&m_components[LIFE_TIME][i]), dt));
+	}
+
+	integrateScalar(simdLast, last, pVelocity, gridSize, timeStep);
+}
+
+void ParticleSoA::integrateAVX512(uint32_t first, uint32_t last, const XMFLOAT4* pVelocity,
+	const XMUINT3& gridSize, float timeStep)
+{
+	const auto pVel = reinterpret_cast<const float*>(pVelocity);
+	const auto zero = _mm512_setzero_ps();
+	const auto one = _mm512_set1_ps(1.0f);
+	const auto half = _mm512_set1_ps(0.5f);
+	const auto dt = _mm512_set1_ps(timeStep);
+	const __m512 size[] = { _mm512_set1_ps(static_cast<float>(gridSize.x)),
+		_mm512_set1_ps(static_cast<float>(gridSize.y)), _mm512_set1_ps(static_cast<float>(gridSize.z)) };
+	const __m512i maxIdx[] = { _mm512_set1_epi32(gridSize.x - 1), _mm512_set1_epi32(gridSize.y - 1),
+		_mm512_set1_epi32(gridSize.z - 1) };
+	const auto zeroI = _mm512_setzero_si512();
+	const auto oneI = _mm512_set1_epi32(1);
+	const auto pitchY = _mm512_set1_epi32(gridSize.x);
+	const auto pitchZ = _mm512_set1_epi32(gridSize.x * gridSize.y);
+
+	// Whole 16-wide vectors, then the tail in scalar
+	const auto simdLast = first + (last - first) / 16 * 16;
+	for (auto i = first; i < simdLast; i += 16)
+	{
+		// Texel space with the texel centers at integers, clamp addressing
+		__m512 pos[3], w[3];
+		__m512i i0[3], i1[3];
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			pos[c] = _mm512_load_ps(&m_components[POS_X + c][i]);
+			const auto tex = _mm512_min_ps(_mm512_max_ps(pos[c], zero), one);
+			const auto t = _mm512_sub_ps(_mm512_mul_ps(tex, size[c]), half);
+			const auto base = _mm512_roundscale_ps(t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+			w[c] = _mm512_sub_ps(t, base);
+			const auto baseI = _mm512_cvttps_epi32(base);
+			i0[c] = _mm512_min_epi32(_mm512_max_epi32(baseI, zeroI), maxIdx[c]);
+			i1[c] = _mm512_min_epi32(_mm512_max_epi32(_mm512_add_epi32(baseI, oneI), zeroI), maxIdx[c]);
+		}
+
+		// Float4 element offsets of the 8 corners
+		const __m512i rows[] =
+		{
+			_mm512_add_epi32(_mm512_mullo_epi32(i0[2], pitchZ), _mm512_mullo_epi32(i0[1], pitchY)),
+			_mm512_add_epi32(_mm512_mullo_epi32(i0[2], pitchZ), _mm512_mullo_epi32(i1[1], pitchY)),
+			_mm512_add_epi32(_mm512_mullo_epi32(i1[2], pitchZ), _mm512_mullo_epi32(i0[1], pitchY)),
+			_mm512_add_epi32(_mm512_mullo_epi32(i1[2], pitchZ), _mm512_mullo_epi32(i1[1], pitchY))
+		};
+		__m512i corners[8];
+		for (uint8_t r = 0; r < 4; ++r)
+		{
+			corners[r * 2] = _mm512_slli_epi32(_mm512_add_epi32(rows[r], i0[0]), 2);
+			corners[r * 2 + 1] = _mm512_slli_epi32(_mm512_add_epi32(rows[r], i1[0]), 2);
+		}
+
+		// Trilinear interpolation per velocity component
+		for (uint8_t c = 0; c < 3; ++c)
+		{
+			const auto pBase = pVel + c;
+			__m512 v[8];
+			for (uint8_t k = 0; k < 8; ++k) v[k] = _mm512_i32gather_ps(corners[k], pBase, 4);
+			const auto lerp = [](__m512 a, __m512 b, __m512 t) { return _mm512_add_ps(a, _mm512_mul_ps(t, _mm512_sub_ps(b, a))); };
+			const auto c00 = lerp(v[0], v[1], w[0]);
+			const auto c10 = lerp(v[2], v[3], w[0]);
+			const auto c01 = lerp(v[4], v[5], w[0]);
+			const auto c11 = lerp(v[6], v[7], w[0]);
+			const auto u = lerp(lerp(c00, c10, w[1]), lerp(c01, c11, w[1]), w[2]);
+
+			_mm512_store_ps(&m_components[VELOCITY_X + c][i], u);
+			_mm512_store_ps(&m_components[POS_X + c][i], _mm512_add_ps(pos[c], _mm512_mul_ps(u, dt)));
+		}
+		_mm512_store_ps(&m_components[LIFE_TIME][i], _mm512_sub_ps(_mm512_load_ps(&m_components[LIFE_TIME][i]), dt));
+	}
+
+	integrateScalar(simdLast, last, pVelocity, gridSize, timeStep);
+}
+
+uint32_t ParticleSoA::packSurvivors(uint32_t first, uint32_t last)
+{
+	// Particles leaving the simulation cube are released, the same as in ParticleCPU
+	auto slot = first;
+	for (auto i = first; i < last; ++i)
+	{
+		const auto x = m_components[POS_X][i];
+		const auto y = m_components[POS_Y][i];
+		const auto z = m_components[POS_Z][i];
+		if (m_components[LIFE_TIME][i] <= 0.0f || x < 0.0f || y < 0.0f || z < 0.0f || x > 1.0f || y > 1.0f || z > 1.0f)
+			continue;
+
+		if (slot != i) for (uint8_t c = 0; c < NUM_COMPONENT; ++c) m_components[c][slot] = m_components[c][i];
+		++slot;
+	}
+
+	return slot - first;
+}
+
+void ParticleSoA::compact()
+{
+	// Close the gaps between the batches in order; each batch moves to an offset no later than its start
+	auto numAlive = 0u;
+	const auto numBatches = static_cast<uint32_t>(m_batchCounts.size());
+	for (auto batch = 0u; batch < numBatches; ++batch)
+	{
+		const auto count = m_batchCounts[batch];
+		for (uint8_t c = 0; c < NUM_COMPONENT; ++c)
+			memmove(&m_components[c][numAlive], &m_components[c][batch * BatchSize], sizeof(float) * count);
+		numAlive += count;
+	}
+	m_numAlive = numAlive;
+}
+
+void ParticleSoA::emit(uint32_t slot, const XMUINT4& rands, bool is3D)
+{
+	Particle particle;
+	ParticleCPU::Emit(particle, static_cast<uint32_t>(m_emitters.size()), m_emitters.data(), rands, is3D);
+
+	m_components[POS_X][slot] = particle.Pos.x;
+	m_components[POS_Y][slot] = particle.Pos.y;
+	m_components[POS_Z][slot] = particle.Pos.z;
+	m_components[VELOCITY_X][slot] = particle.Velocity.x;
+	m_components[VELOCITY_Y][slot] = particle.Velocity.y;
+	m_components[VELOCITY_Z][slot] = particle.Velocity.z;
+	m_components[LIFE_TIME][slot] = particle.LifeTime;
+}
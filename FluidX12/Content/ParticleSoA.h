@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ParticleCPU.h"
+
+// Structure-of-arrays particle store for the CPU-side particle work (baking, queries and export),
+// with the same budgeted emission as ParticleCPU; the alive particles are kept packed at the front
+// of the arrays, so that the remaining slots form the dead list and the kernels run on whole vectors
+class ParticleSoA
+{
+public:
+	enum Kernel : uint8_t
+	{
+		SCALAR,
+		AVX2,
+		AVX512,
+
+		NUM_KERNEL
+	};
+
+	enum Component : uint8_t
+	{
+		POS_X,
+		POS_Y,
+		POS_Z,
+		VELOCITY_X,
+		VELOCITY_Y,
+		VELOCITY_Z,
+		LIFE_TIME,
+
+		NUM_COMPONENT
+	};
+
+	ParticleSoA();
+	virtual ~ParticleSoA();
+
+	void Init(uint32_t numParticles, uint32_t seed = 0);
+	void SetEmitters(uint32_t numEmitters, const Emitter* pEmitters);
+	void SetKernel(Kernel kernel);
+	void Update(const DirectX::XMFLOAT4* pVelocity, const DirectX::XMUINT3& gridSize,
+		float timeStep, uint32_t step, uint32_t budget, bool parallel = true);
+	void Export(PackedParticle* pParticles, bool parallel = true) const;	// Slots past the alive particles are exported as dead
+
+	uint32_t GetNumParticles() const;
+	uint32_t GetNumAlive() const;
+	Kernel GetKernel() const;
+	const float* GetComponent(Component component) const;
+
+	static Kernel GetBestKernel();
+
+	static const uint32_t Alignment = 64;
+	static const uint32_t BatchSize = ParticleCPU::BatchSize;
+
+protected:
+	struct AlignedDeleter
+	{
+		void operator()(float* p) const { _aligned_free(p); }
+	};
+
+	// The kernels share the operations and their order, without fused multiply-adds, so that
+	// they give the same results
+	void integrateScalar(uint32_t first, uint32_t last, const DirectX::XMFLOAT4* pVelocity,
+		const DirectX::XMUINT3& gridSize, float timeStep);
+	void integrateAVX2(uint32_t first, uint32_t last, const DirectX::XMFLOAT4* pVelocity,
+		const DirectX::XMUINT3& gridSize, float timeStep);
+	void integrateAVX512(uint32_t first, uint32_t last, const DirectX::XMFLOAT4* pVelocity,
+		const DirectX::XMUINT3& gridSize, float timeStep);
+	uint32_t packSurvivors(uint32_t first, uint32_t last);
+	void compact();
+	void emit(uint32_t slot, const DirectX::XMUINT4& rands, bool is3D);
+
+	std::unique_ptr<float[], AlignedDeleter> m_data;
+	float*					m_components[NUM_COMPONENT];
+
+	std::vector<Emitter>	m_emitters;
+	std::vector<uint32_t>	m_batchCounts;	// Survivors per batch, packed at the start of the batch
+
+	uint32_t				m_numParticles;
+	uint32_t				m_numAlive;
+	uint32_t				m_seed;
+	Kernel					m_kernel;
+};
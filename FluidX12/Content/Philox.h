@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <immintrin.h>
+
+// Philox4x32-10 counter-based random number generator, bit-exact with Philox.hlsli;
+// every (counter, key) pair gives an independent block of four numbers, so that streams
+// can be drawn in any order and on any thread
+class Philox
+{
+public:
+	// Streams in the counter w, keeping the draws of different uses apart
+	enum Stream : uint32_t
+	{
+		EMISSION
+	};
+
+	static DirectX::XMUINT4 Generate(DirectX::XMUINT4 counter, DirectX::XMUINT2 key)
+	{
+		for (uint8_t i = 0; i < NumRounds; ++i)
+		{
+			const auto product0 = static_cast<uint64_t>(M0) * counter.x;
+			const auto product1 = static_cast<uint64_t>(M1) * counter.z;
+			counter = DirectX::XMUINT4
+			(
+				static_cast<uint32_t>(product1 >> 32) ^ counter.y ^ key.x,
+				static_cast<uint32_t>(product1),
+				static_cast<uint32_t>(product0 >> 32) ^ counter.w ^ key.y,
+				static_cast<uint32_t>(product0)
+			);
+			key.x += W0;
+			key.y += W1;
+		}
+
+		return counter;
+	}
+
+	// Eight blocks at the counters (first + lane, y, z, w), stored as one 8-wide array per
+	// component of the block
+	static void GenerateAVX2(uint32_t results[4][8], uint32_t first, uint32_t y, uint32_t z, uint32_t w,
+		const DirectX::XMUINT2& key)
+	{
+		__m256i c0 = _mm256_add_epi32(_mm256_set1_epi32(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		__m256i c1 = _mm256_set1_epi32(y);
+		__m256i c2 = _mm256_set1_epi32(z);
+		__m256i c3 = _mm256_set1_epi32(w);
+		__m256i k0 = _mm256_set1_epi32(key.x);
+		__m256i k1 = _mm256_set1_epi32(key.y);
+		const auto m0 = _mm256_set1_epi32(M0);
+		const auto m1 = _mm256_set1_epi32(M1);
+
+		for (uint8_t i = 0; i < NumRounds; ++i)
+		{
+			__m256i hi0, lo0, hi1, lo1;
+			mulHiLoAVX2(c0, m0, hi0, lo0);
+			mulHiLoAVX2(c2, m1, hi1, lo1);
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+			c1 = lo1;
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+			c3 = lo0;
+			k0 = _mm256_add_epi32(k0, _mm256_set1_epi32(W0));
+			k1 = _mm256_add_epi32(k1, _mm256_set1_epi32(W1));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(results[0]), c0);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(results[1]), c1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(results[2]), c2);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(results[3]), c3);
+	}
+
+	// Uniform float in [0, 1) from the top 24 bits
+	static float ToFloat(uint32_t r)
+	{
+		return (r >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Uniform float in [0, 1) from the low bytes of three numbers, which ToFloat leaves unused
+	static float LowBytesToFloat(uint32_t a, uint32_t b, uint32_t c)
+	{
+		return ((a & 0xff) << 16 | (b & 0xff) << 8 | (c & 0xff)) * (1.0f / 16777216.0f);
+	}
+
+	static const uint8_t NumRounds = 10;
+
+protected:
+	static void mulHiLoAVX2(__m256i a, __m256i b, __m256i& hi, __m256i& lo)
+	{
+		// 64-bit products of the even lanes and of the odd lanes, with the high halves interleaved
+		const auto even = _mm256_mul_epu32(a, b);
+		const auto odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+		hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+		lo = _mm256_mullo_epi32(a, b);
+	}
+
+	static const uint32_t M0 = 0xd2511f53;
+	static const uint32_t M1 = 0xcd9e8d57;
+	static const uint32_t W0 = 0x9e3779b9;	// Golden ratio
+	static const uint32_t W1 = 0xbb67ae85;	// sqrt(3) - 1
+};
@@ -0,0 +1,1399 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include <intrin.h>
+#include <immintrin.h>
+#include "RayCasterCPU.h"
+#include "ParticleSoA.h"
+#include "VolumeSampler.h"
+#include <fstream>
+
+using namespace std;
+using namespace concurrency;
+using namespace DirectX;
+
+// Matching PSRayCast
+static const float g_absorption = 1.0f;
+static const float g_zeroThreshold = 0.01f;
+static const float g_densityScale = 24.0f;
+static const float g_maxDist = 2.0f * sqrt(3.0f);
+static const float g_stepScale = g_maxDist / RayCasterCPU::NumSamples;
+static const float g_lightStepScale = g_maxDist / RayCasterCPU::NumLightSamples;
+
+static bool computeStartPoint(XMFLOAT3& pos, const XMFLOAT3& rayDir)
+{
+	const float p[] = { pos.x, pos.y, pos.z };
+	const float d[] = { rayDir.x, rayDir.y, rayDir.z };
+	if (abs(p[0]) <= 1.0f && abs(p[1]) <= 1.0f && abs(p[2]) <= 1.0f) return true;
+
+	auto U = FLT_MAX;
+	auto isHit = false;
+	for (uint8_t i = 0; i < 3; ++i)
+	{
+		const auto u = (-static_cast<float>((d[i] > 0.0f) - (d[i] < 0.0f)) - p[i]) / d[i];
+		if (u < 0.0f) continue;
+
+		const auto j = (i + 1) % 3, k = (i + 2) % 3;
+		if (abs(d[j] * u + p[j]) > 1.0f) continue;
+		if (abs(d[k] * u + p[k]) > 1.0f) continue;
+		if (u < U)
+		{
+			U = u;
+			isHit = true;
+		}
+	}
+
+	pos.x = min(max(d[0] * U + p[0], -1.0f), 1.0f);
+	pos.y = min(max(d[1] * U + p[1], -1.0f), 1.0f);
+	pos.z = min(max(d[2] * U + p[2], -1.0f), 1.0f);
+
+	return isHit;
+}
+
+static XMVECTOR XM_CALLCONV toSample(FXMVECTOR color)
+{
+	const auto density = XMVectorGetW(color) * g_densityScale;
+
+	return XMVectorMin(XMVectorSetW(XMVectorScale(color, density), density), XMVectorReplicate(g_densityScale));
+}
+
+static XMVECTOR XM_CALLCONV getSample(const XMFLOAT4* pGrid, const XMUINT3& gridSize, FXMVECTOR tex)
+{
+	return toSample(VolumeSampler::SampleLinear(pGrid, gridSize, tex, VolumeSampler::CLAMP));
+}
+
+// Lanes of the ray packets, each masked on its own; the multiply-adds are kept unfused
+// as XMVectorMultiplyAdd and XMVectorLerp of the scalar path
+struct PacketAVX2
+{
+	using Float = __m256;
+	using Int = __m256i;
+	using Mask = __m256;
+
+	static const uint32_t Width = 8;
+
+	static Float Set(float a) { return _mm256_set1_ps(a); }
+	static Int SetI(int32_t a) { return _mm256_set1_epi32(a); }
+	static Float Load(const float* p) { return _mm256_load_ps(p); }
+	static Int LoadI(const int32_t* p) { return _mm256_load_si256(reinterpret_cast<const __m256i*>(p)); }
+	static void Store(float* p, Float a) { _mm256_store_ps(p, a); }
+	static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Float Div(Float a, Float b) { return _mm256_div_ps(a, b); }
+	static Float Min(Float a, Float b) { return _mm256_min_ps(a, b); }
+	static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+	static Float Abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	static Float Floor(Float a) { return _mm256_floor_ps(a); }
+	static Float Ceil(Float a) { return _mm256_ceil_ps(a); }
+	static Float ToFloat(Int a) { return _mm256_cvtepi32_ps(a); }
+	static Int ToInt(Float a) { return _mm256_cvttps_epi32(a); }
+	static Int AddI(Int a, Int b) { return _mm256_add_epi32(a, b); }
+	static Int MulI(Int a, Int b) { return _mm256_mullo_epi32(a, b); }
+	static Int MinI(Int a, Int b) { return _mm256_min_epi32(a, b); }
+	static Int MaxI(Int a, Int b) { return _mm256_max_epi32(a, b); }
+	static Float Gather(const float* p, Int i) { return _mm256_i32gather_ps(p, i, 4); }
+	static Mask Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask LessEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static Mask Greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static Mask NotEqual(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ); }
+	static Mask LessI(Int a, Int b) { return _mm256_castsi256_ps(_mm256_cmpgt_epi32(b, a)); }
+	static Mask EqualI(Int a, Int b) { return _mm256_castsi256_ps(_mm256_cmpeq_epi32(a, b)); }
+	static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+	static Mask AndNot(Mask a, Mask b) { return _mm256_andnot_ps(b, a); }
+	static Float Select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+	static Int SelectI(Mask m, Int a, Int b)
+	{
+		return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m));
+	}
+	static uint32_t Bits(Mask m) { return static_cast<uint32_t>(_mm256_movemask_ps(m)); }
+};
+
+struct PacketAVX512
+{
+	using Float = __m512;
+	using Int = __m512i;
+	using Mask = __mmask16;
+
+	static const uint32_t Width = 16;
+
+	static Float Set(float a) { return _mm512_set1_ps(a); }
+	static Int SetI(int32_t a) { return _mm512_set1_epi32(a); }
+	static Float Load(const float* p) { return _mm512_load_ps(p); }
+	static Int LoadI(const int32_t* p) { return _mm512_load_si512(p); }
+	static void Store(float* p, Float a) { _mm512_store_ps(p, a); }
+	static Float Add(Float a, Float b) { return _mm512_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+	static Float Div(Float a, Float b) { return _mm512_div_ps(a, b); }
+	static Float Min(Float a, Float b) { return _mm512_min_ps(a, b); }
+	static Float Max(Float a, Float b) { return _mm512_max_ps(a, b); }
+	static Float Abs(Float a) { return _mm512_abs_ps(a); }
+	static Float Floor(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+	static Float Ceil(Float a) { return _mm512_roundscale_ps(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC); }
+	static Float ToFloat(Int a) { return _mm512_cvtepi32_ps(a); }
+	static Int ToInt(Float a) { return _mm512_cvttps_epi32(a); }
+	static Int AddI(Int a, Int b) { return _mm512_add_epi32(a, b); }
+	static Int MulI(Int a, Int b) { return _mm512_mullo_epi32(a, b); }
+	static Int MinI(Int a, Int b) { return _mm512_min_epi32(a, b); }
+	static Int MaxI(Int a, Int b) { return _mm512_max_epi32(a, b); }
+	static Float Gather(const float* p, Int i) { return _mm512_i32gather_ps(i, p, 4); }
+	static Mask Less(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static Mask LessEqual(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+	static Mask Greater(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	static Mask NotEqual(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_NEQ_OQ); }
+	static Mask LessI(Int a, Int b) { return _mm512_cmplt_epi32_mask(a, b); }
+	static Mask EqualI(Int a, Int b) { return _mm512_cmpeq_epi32_mask(a, b); }
+	static Mask And(Mask a, Mask b) { return static_cast<Mask>(a & b); }
+	static Mask Or(Mask a, Mask b) { return static_cast<Mask>(a | b); }
+	static Mask AndNot(Mask a, Mask b) { return static_cast<Mask>(a & ~b); }
+	static Float Select(Mask m, Float a, Float b) { return _mm512_mask_blend_ps(m, b, a); }
+	static Int SelectI(Mask m, Int a, Int b) { return _mm512_mask_blend_epi32(m, b, a); }
+	static uint32_t Bits(Mask m) { return m; }
+};
+
+RayCasterCPU::RayCasterCPU() :
+	m_jitter(0.0f, 0.0f),
+	m_boundMin(1.0f, 1.0f, 1.0f),
+	m_boundMax(-1.0f, -1.0f, -1.0f),
+	m_boundRect(0, 0, 0, 0),
+	m_viewport(0, 0),
+	m_renderSize(0, 0),
+	m_occupancySize(0, 0, 0),
+	m_lightSize(0, 0, 0),
+	m_lightStamp(0),
+	m_numResolved(0),
+	m_renderScale(1.0f),
+	m_kernel(GetBestKernel())
+{
+}
+
+RayCasterCPU::~RayCasterCPU()
+{
+}
+
+void RayCasterCPU::Init(uint32_t width, uint32_t height)
+{
+	m_viewport = XMUINT2(width, height);
+	m_renderSize = m_viewport;
+	m_image.resize(width * height);
+	m_depths.resize(width * height);
+	for (auto& history : m_history) history.resize(width * height);
+	m_tileSamples.resize(((width + TileWidth - 1) / TileWidth) * ((height + TileHeight - 1) / TileHeight));
+	m_numResolved = 0;
+}
+
+void RayCasterCPU::UpdateFrame(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, const XMFLOAT3& eyePt,
+	float renderScale, const XMFLOAT2& jitter)
+{
+	// The same matrices as in Fluid::UpdateFrame
+	const auto world = XMMatrixScaling(10.0f, 10.0f, 10.0f);
+	const auto worldViewProj = world * XMLoadFloat4x4(&view) * XMLoadFloat4x4(&proj);
+	const auto worldI = XMMatrixInverse(nullptr, world);
+	XMStoreFloat3(&m_localSpaceLightPt, XMVector3TransformCoord(XMVectorSet(75.0f, 75.0f, -75.0f, 0.0f), worldI));
+	XMStoreFloat3(&m_localSpaceEyePt, XMVector3TransformCoord(XMLoadFloat3(&eyePt), worldI));
+
+	// The history is reprojected with the last frame
+	m_prevWorldViewProj = m_worldViewProj;
+	XMStoreFloat4x4(&m_worldViewProj, worldViewProj);
+	if (m_numResolved == 0) m_prevWorldViewProj = m_worldViewProj;
+
+	const auto toScreen = [&worldViewProj](float width, float height)
+	{
+		const auto mToScreen = XMMATRIX
+		(
+			0.5f * width, 0.0f, 0.0f, 0.0f,
+			0.0f, -0.5f * height, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.5f * width, 0.5f * height, 0.0f, 1.0f
+		);
+
+		return XMMatrixInverse(nullptr, XMMatrixMultiply(worldViewProj, mToScreen));
+	};
+
+	// Render pixels are offset by the jitter
+	m_renderScale = renderScale;
+	m_renderSize = GetRenderSize(m_viewport, renderScale);
+	m_jitter = jitter;
+	XMStoreFloat4x4(&m_screenToLocal, XMMatrixTranslation(jitter.x, jitter.y, 0.0f) *
+		toScreen(m_viewport.x * renderScale, m_viewport.y * renderScale));
+	XMStoreFloat4x4(&m_resolveToLocal, toScreen(static_cast<float>(m_viewport.x), static_cast<float>(m_viewport.y)));
+}
+
+void RayCasterCPU::UpdateOccupancy(const XMFLOAT4* pGrid, const XMUINT3& gridSize)
+{
+	m_occupancySize = GetOccupancySize(gridSize);
+	m_occupancy.resize(m_occupancySize.x * m_occupancySize.y * m_occupancySize.z);
+
+	// Maximum density per macro-cell over the cells with the apron, as CSOccupancy does
+	const int32_t dims[] = { static_cast<int32_t>(gridSize.x), static_cast<int32_t>(gridSize.y), static_cast<int32_t>(gridSize.z) };
+	parallel_for(0u, static_cast<uint32_t>(m_occupancy.size()), [&](uint32_t i)
+	{
+		const int32_t first[] =
+		{
+			static_cast<int32_t>(i % m_occupancySize.x * MacroCellSize) - 1,
+			static_cast<int32_t>(i / m_occupancySize.x % m_occupancySize.y * MacroCellSize) - 1,
+			static_cast<int32_t>(i / (m_occupancySize.x * m_occupancySize.y) * MacroCellSize) - 1
+		};
+
+		auto maxDensity = 0.0f;
+		for (auto z = first[2]; z <= first[2] + static_cast<int32_t>(MacroCellSize) + 1; ++z)
+		{
+			const auto cz = VolumeSampler::Address(z, dims[2], VolumeSampler::CLAMP);
+			for (auto y = first[1]; y <= first[1] + static_cast<int32_t>(MacroCellSize) + 1; ++y)
+			{
+				const auto cy = VolumeSampler::Address(y, dims[1], VolumeSampler::CLAMP);
+				for (auto x = first[0]; x <= first[0] + static_cast<int32_t>(MacroCellSize) + 1; ++x)
+				{
+					const auto cx = VolumeSampler::Address(x, dims[0], VolumeSampler::CLAMP);
+					maxDensity = max(maxDensity, pGrid[VolumeSampler::Index(cx, cy, cz, gridSize)].w);
+				}
+			}
+		}
+		m_occupancy[i] = maxDensity;
+	});
+
+	// Bound of the occupied macro-cells from the texture space to the local space, as CSBound does
+	XMUINT3 minCell(UINT32_MAX, UINT32_MAX, UINT32_MAX), maxCell(0, 0, 0);
+	for (auto i = 0u; i < m_occupancy.size(); ++i)
+	{
+		if (m_occupancy[i] * g_densityScale <= g_zeroThreshold) continue;
+		const XMUINT3 macroCell(i % m_occupancySize.x, i / m_occupancySize.x % m_occupancySize.y,
+			i / (m_occupancySize.x * m_occupancySize.y));
+		minCell = XMUINT3(min(minCell.x, macroCell.x), min(minCell.y, macroCell.y), min(minCell.z, macroCell.z));
+		maxCell = XMUINT3(max(maxCell.x, macroCell.x + 1), max(maxCell.y, macroCell.y + 1), max(maxCell.z, macroCell.z + 1));
+	}
+
+	if (maxCell.x > 0)
+	{
+		const auto texMin = XMFLOAT3(static_cast<float>(minCell.x * MacroCellSize) / gridSize.x,
+			static_cast<float>(minCell.y * MacroCellSize) / gridSize.y, static_cast<float>(minCell.z * MacroCellSize) / gridSize.z);
+		const auto texMax = XMFLOAT3(min(static_cast<float>(maxCell.x * MacroCellSize) / gridSize.x, 1.0f),
+			min(static_cast<float>(maxCell.y * MacroCellSize) / gridSize.y, 1.0f),
+			min(static_cast<float>(maxCell.z * MacroCellSize) / gridSize.z, 1.0f));
+		m_boundMin = XMFLOAT3(texMin.x * 2.0f - 1.0f, 1.0f - texMax.y * 2.0f, texMin.z * 2.0f - 1.0f);
+		m_boundMax = XMFLOAT3(texMax.x * 2.0f - 1.0f, 1.0f - texMin.y * 2.0f, texMax.z * 2.0f - 1.0f);
+	}
+	else
+	{
+		m_boundMin = XMFLOAT3(1.0f, 1.0f, 1.0f);
+		m_boundMax = XMFLOAT3(-1.0f, -1.0f, -1.0f);
+	}
+}
+
+void RayCasterCPU::UpdateMips(const XMFLOAT4* pGrid, const XMUINT3& gridSize)
+{
+	const auto numMips = GetNumMips(gridSize);
+	m_mips.resize(numMips - 1);
+	m_mipSizes.resize(numMips - 1);
+
+	// Each level averages the 2x2x2 texels of the previous one, clamped at the odd edges, as CSDownsample3D does
+	auto pSrc = pGrid;
+	auto srcSize = gridSize;
+	for (uint8_t i = 1; i < numMips; ++i)
+	{
+		const XMUINT3 dstSize(max(srcSize.x >> 1, 1u), max(srcSize.y >> 1, 1u), max(srcSize.z >> 1, 1u));
+		auto& dst = m_mips[i - 1];
+		dst.resize(dstSize.x * dstSize.y * dstSize.z);
+		parallel_for(0u, dstSize.z, [&](uint32_t z)
+		{
+			for (auto y = 0u; y < dstSize.y; ++y)
+			{
+				for (auto x = 0u; x < dstSize.x; ++x)
+				{
+					auto sum = XMVectorZero();
+					for (uint8_t j = 0; j < 8; ++j)
+					{
+						const auto sx = min(x * 2 + (j & 1), srcSize.x - 1);
+						const auto sy = min(y * 2 + ((j >> 1) & 1), srcSize.y - 1);
+						const auto sz = min(z * 2 + (j >> 2), srcSize.z - 1);
+						sum = XMVectorAdd(sum, XMLoadFloat4(&pSrc[VolumeSampler::Index(sx, sy, sz, srcSize)]));
+					}
+					XMStoreFloat4(&dst[VolumeSampler::Index(x, y, z, dstSize)], XMVectorScale(sum, 1.0f / 8.0f));
+				}
+			}
+		});
+
+		m_mipSizes[i - 1] = dstSize;
+		pSrc = dst.data();
+		srcSize = dstSize;
+	}
+}
+
+uint32_t RayCasterCPU::UpdateLightTrans(const XMFLOAT4* pGrid, const XMUINT3& gridSize, bool incremental)
+{
+	const auto numCells = gridSize.x * gridSize.y * gridSize.z;
+	const auto force = !incremental || gridSize.x != m_lightSize.x || gridSize.y != m_lightSize.y || gridSize.z != m_lightSize.z;
+	if (force)
+	{
+		m_lightTrans.assign(numCells, 1.0f);
+		m_lightDensities.assign(numCells, 0.0f);
+		m_lightStamps.assign(numCells, 0);
+		m_lightSize = gridSize;
+	}
+	const auto stamp = ++m_lightStamp;
+
+	// Lateral axes of the slices
+	const auto sweep = GetLightSweep(m_localSpaceLightPt, gridSize);
+	const auto a = sweep.Axis;
+	const auto b = a == 0 ? 1u : 0u;
+	const auto c = a == 2 ? 1u : 2u;
+	const uint32_t dims[] = { gridSize.x, gridSize.y, gridSize.z };
+	const float offsets[] = { sweep.CellOffset.x, sweep.CellOffset.y, sweep.CellOffset.z };
+	const auto tolerance = LightTolerance / (g_absorption * sweep.StepScale);
+
+	// Slices in order from the light, as the dispatches of CSLightTrans
+	vector<uint32_t> rowCounts(dims[c]);
+	auto numUpdated = 0u;
+	for (auto s = 0u; s < dims[a]; ++s)
+	{
+		const auto slice = offsets[a] > 0.0f ? dims[a] - 1 - s : s;
+		parallel_for(0u, dims[c], [&](uint32_t v)
+		{
+			auto count = 0u;
+			for (auto u = 0u; u < dims[b]; ++u)
+			{
+				uint32_t cell[3];
+				cell[a] = slice;
+				cell[b] = u;
+				cell[c] = v;
+				const auto i = VolumeSampler::Index(cell[0], cell[1], cell[2], gridSize);
+
+				// Stamp the density change of the cell for the next slice, against the density last stamped,
+				// so that the changes within the tolerance cannot accumulate
+				const auto density = min(pGrid[i].w * g_densityScale, g_densityScale);
+				if (force || abs(density - m_lightDensities[i]) > tolerance)
+				{
+					m_lightDensities[i] = density;
+					m_lightStamps[i] = stamp;
+				}
+
+				// The previous slice position toward the light; the light enters the grid there if outside
+				const auto prevSlice = static_cast<int32_t>(slice) + static_cast<int32_t>(offsets[a]);
+				const auto posB = u + offsets[b];
+				const auto posC = v + offsets[c];
+				if (prevSlice < 0 || prevSlice >= static_cast<int32_t>(dims[a]) || posB < -0.5f || posB > dims[b] - 0.5f ||
+					posC < -0.5f || posC > dims[c] - 0.5f)
+				{
+					if (force)
+					{
+						m_lightTrans[i] = 1.0f;
+						++count;
+					}
+					continue;
+				}
+
+				// Bilinear footprint in the previous slice
+				const auto baseB = floor(posB), baseC = floor(posC);
+				const auto wB = posB - baseB, wC = posC - baseC;
+				uint32_t indices[4];
+				float weights[4];
+				for (uint8_t j = 0; j < 4; ++j)
+				{
+					uint32_t prev[3];
+					prev[a] = prevSlice;
+					prev[b] = VolumeSampler::Address(static_cast<int32_t>(baseB) + (j & 1), dims[b], VolumeSampler::CLAMP);
+					prev[c] = VolumeSampler::Address(static_cast<int32_t>(baseC) + (j >> 1), dims[c], VolumeSampler::CLAMP);
+					indices[j] = VolumeSampler::Index(prev[0], prev[1], prev[2], gridSize);
+					weights[j] = ((j & 1) ? wB : 1.0f - wB) * ((j >> 1) ? wC : 1.0f - wC);
+				}
+
+				// Recompute only if the density or the transmittance has changed over the footprint
+				auto isDirty = force;
+				for (uint8_t j = 0; j < 4 && !isDirty; ++j) isDirty = weights[j] > 0.0f && m_lightStamps[indices[j]] == stamp;
+				if (!isDirty) continue;
+
+				auto footprintDensity = 0.0f, lightTrans = 0.0f;
+				for (uint8_t j = 0; j < 4; ++j)
+				{
+					footprintDensity += weights[j] * pGrid[indices[j]].w;
+					lightTrans += weights[j] * m_lightTrans[indices[j]];
+				}
+				footprintDensity = min(footprintDensity * g_densityScale, g_densityScale);
+				m_lightTrans[i] = lightTrans * min(max(1.0f - g_absorption * sweep.StepScale * footprintDensity, 0.0f), 1.0f);
+				m_lightStamps[i] = stamp;
+				++count;
+			}
+			rowCounts[v] = count;
+		});
+
+		for (const auto& count : rowCounts) numUpdated += count;
+	}
+
+	return numUpdated;
+}
+
+void RayCasterCPU::Render(const XMFLOAT4* pGrid, const XMUINT3& gridSize, bool skipEmpty, bool sweptLight,
+	bool bounded, bool adaptive)
+{
+	// Pixels covered by the projected bound, padded by a pixel for the jitter, as VSBound does;
+	// all of them if the bound reaches behind the eye
+	m_boundRect = XMUINT4(0, 0, m_renderSize.x, m_renderSize.y);
+	if (bounded && m_boundMin.x > m_boundMax.x) m_boundRect = XMUINT4(0, 0, 0, 0);
+	else if (bounded)
+	{
+		const auto worldViewProj = XMLoadFloat4x4(&m_worldViewProj);
+		auto ndcMin = XMVectorReplicate(FLT_MAX), ndcMax = XMVectorReplicate(-FLT_MAX);
+		auto isBehind = false;
+		for (uint8_t i = 0; i < 8; ++i)
+		{
+			const auto corner = XMVectorSet(i & 1 ? m_boundMax.x : m_boundMin.x, i & 2 ? m_boundMax.y : m_boundMin.y,
+				i & 4 ? m_boundMax.z : m_boundMin.z, 1.0f);
+			const auto pos = XMVector4Transform(corner, worldViewProj);
+			const auto w = XMVectorGetW(pos);
+			isBehind = isBehind || w <= 0.0f;
+			const auto ndc = XMVectorScale(pos, 1.0f / w);
+			ndcMin = XMVectorMin(ndcMin, ndc);
+			ndcMax = XMVectorMax(ndcMax, ndc);
+		}
+
+		if (!isBehind)
+		{
+			XMFLOAT2 lo, hi;
+			XMStoreFloat2(&lo, ndcMin);
+			XMStoreFloat2(&hi, ndcMax);
+			const auto width = m_viewport.x * m_renderScale, height = m_viewport.y * m_renderScale;
+			const float rect[] =
+			{
+				(lo.x * 0.5f + 0.5f) * width - 1.0f,
+				(0.5f - hi.y * 0.5f) * height - 1.0f,
+				(hi.x * 0.5f + 0.5f) * width + 1.0f,
+				(0.5f - lo.y * 0.5f) * height + 1.0f
+			};
+
+			// Pixel centers within the rectangle
+			const auto toPixel = [](float x, uint32_t size)
+			{
+				return static_cast<uint32_t>(min(max(ceil(x - 0.5f), 0.0f), static_cast<float>(size)));
+			};
+			m_boundRect = XMUINT4(toPixel(rect[0], m_renderSize.x), toPixel(rect[1], m_renderSize.y),
+				toPixel(rect[2], m_renderSize.x), toPixel(rect[3], m_renderSize.y));
+		}
+	}
+
+	// Tiles across the threads; the packets take the runs of the tile rows within the bound rectangle
+	const auto numTilesX = (m_renderSize.x + TileWidth - 1) / TileWidth;
+	const auto numTiles = numTilesX * ((m_renderSize.y + TileHeight - 1) / TileHeight);
+	fill(m_tileSamples.begin(), m_tileSamples.end(), 0);
+	parallel_for(0u, numTiles, [&](uint32_t tile)
+	{
+		const auto left = tile % numTilesX * TileWidth;
+		const auto top = tile / numTilesX * TileHeight;
+		const auto right = min(left + TileWidth, m_renderSize.x);
+		const auto bottom = min(top + TileHeight, m_renderSize.y);
+		auto numSamples = 0u;
+		for (auto y = top; y < bottom; ++y)
+		{
+			const auto isRowCast = y >= m_boundRect.y && y < m_boundRect.w;
+			const auto first = isRowCast ? min(max(m_boundRect.x, left), right) : right;
+			const auto last = isRowCast ? max(min(m_boundRect.z, right), first) : right;
+			for (auto x = left; x < right; ++x)
+			{
+				if (x >= first && x < last) continue;
+				m_image[m_renderSize.x * y + x] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				m_depths[m_renderSize.x * y + x] = 0.0f;
+			}
+
+			switch (m_kernel)
+			{
+			case AVX512:
+				for (auto x = first; x < last; x += PacketAVX512::Width)
+					rayCastPacket<PacketAVX512>(x, y, min(last - x, PacketAVX512::Width), pGrid, gridSize,
+						skipEmpty, sweptLight, bounded, adaptive, numSamples);
+				break;
+			case AVX2:
+				for (auto x = first; x < last; x += PacketAVX2::Width)
+					rayCastPacket<PacketAVX2>(x, y, min(last - x, PacketAVX2::Width), pGrid, gridSize,
+						skipEmpty, sweptLight, bounded, adaptive, numSamples);
+				break;
+			default:
+				for (auto x = first; x < last; ++x)
+				{
+					const auto i = m_renderSize.x * y + x;
+					m_image[i] = rayCast(x + 0.5f, y + 0.5f, pGrid, gridSize, skipEmpty, sweptLight, bounded,
+						adaptive, m_depths[i], numSamples);
+				}
+			}
+		}
+		m_tileSamples[tile] = numSamples;
+	});
+}
+
+void RayCasterCPU::Resolve()
+{
+	const auto& prevHistory = m_history[(m_numResolved + 1) % 2];
+	auto& history = m_history[m_numResolved % 2];
+	const auto resolveToLocal = XMLoadFloat4x4(&m_resolveToLocal);
+	const auto prevWorldViewProj = XMLoadFloat4x4(&m_prevWorldViewProj);
+	const auto eyePt = XMLoadFloat3(&m_localSpaceEyePt);
+	const auto eyeDist = XMVectorGetX(XMVector3Length(eyePt));
+
+	parallel_for(0u, m_viewport.y, [&](uint32_t y)
+	{
+		for (auto x = 0u; x < m_viewport.x; ++x)
+		{
+			// Render pixel position, with the jittered samples at the integers
+			const float pos[] =
+			{
+				(x + 0.5f) * m_renderScale - 0.5f - m_jitter.x,
+				(y + 0.5f) * m_renderScale - 0.5f - m_jitter.y
+			};
+			const auto baseX = floor(pos[0]), baseY = floor(pos[1]);
+			const auto wX = pos[0] - baseX, wY = pos[1] - baseY;
+
+			uint32_t indices[4];
+			float weights[4];
+			auto depth = 0.0f, nearestWeight = 0.0f;
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				const auto sx = VolumeSampler::Address(static_cast<int32_t>(baseX) + (j & 1), m_renderSize.x, VolumeSampler::CLAMP);
+				const auto sy = VolumeSampler::Address(static_cast<int32_t>(baseY) + (j >> 1), m_renderSize.y, VolumeSampler::CLAMP);
+				indices[j] = m_renderSize.x * sy + sx;
+				weights[j] = ((j & 1) ? wX : 1.0f - wX) * ((j >> 1) ? wY : 1.0f - wY);
+
+				// View distance of the nearest sample hitting the volume
+				if (m_depths[indices[j]] > 0.0f && weights[j] > nearestWeight)
+				{
+					depth = m_depths[indices[j]];
+					nearestWeight = weights[j];
+				}
+			}
+
+			// Edge-aware upsampling in premultiplied colors: the samples off the view distance of the
+			// nearest hit fall off, while the empty samples are transparent and keep their weights
+			auto current = XMVectorZero();
+			auto minColor = XMVectorReplicate(FLT_MAX);
+			auto maxColor = XMVectorReplicate(-FLT_MAX);
+			auto weightSum = 0.0f;
+			for (uint8_t j = 0; j < 4; ++j)
+			{
+				const auto& pixel = m_image[indices[j]];
+				const auto color = XMVectorSet(pixel.x * pixel.w, pixel.y * pixel.w, pixel.z * pixel.w, pixel.w);
+				const auto sampleDepth = m_depths[indices[j]];
+				const auto deltaDepth = sampleDepth > 0.0f ? (sampleDepth - depth) / DepthSigma : 0.0f;
+				const auto weight = weights[j] * exp(-deltaDepth * deltaDepth);
+				current = XMVectorMultiplyAdd(XMVectorReplicate(weight), color, current);
+				minColor = XMVectorMin(minColor, color);
+				maxColor = XMVectorMax(maxColor, color);
+				weightSum += weight;
+			}
+			current = XMVectorScale(current, 1.0f / weightSum);
+
+			// Reproject at the view distance, or at that of the volume center if empty
+			const auto nearPt = XMVector3TransformCoord(XMVectorSet(x + 0.5f, y + 0.5f, 0.0f, 1.0f), resolveToLocal);
+			const auto rayDir = XMVector3Normalize(XMVectorSubtract(nearPt, eyePt));
+			const auto pt = XMVectorMultiplyAdd(rayDir, XMVectorReplicate(depth > 0.0f ? depth : eyeDist), eyePt);
+			XMFLOAT2 prevPos;
+			XMStoreFloat2(&prevPos, XMVector3TransformCoord(pt, prevWorldViewProj));
+			const auto u = prevPos.x * 0.5f + 0.5f;
+			const auto v = prevPos.y * -0.5f + 0.5f;
+
+			// Blend over the history clamped to the neighborhood
+			auto result = current;
+			if (m_numResolved > 0 && u >= 0.0f && u <= 1.0f && v >= 0.0f && v <= 1.0f)
+			{
+				auto prev = VolumeSampler::SampleLinear(prevHistory.data(), XMUINT3(m_viewport.x, m_viewport.y, 1),
+					XMVectorSet(u, v, 0.5f, 0.0f), VolumeSampler::CLAMP);
+				prev = XMVectorMin(XMVectorMax(prev, minColor), maxColor);
+				result = XMVectorLerp(prev, current, HistoryBlend);
+			}
+			XMStoreFloat4(&history[m_viewport.x * y + x], result);
+		}
+	});
+
+	++m_numResolved;
+}
+
+void RayCasterCPU::SetKernel(Kernel kernel)
+{
+	m_kernel = min(kernel, GetBestKernel());
+}
+
+bool RayCasterCPU::SaveImage(const char* fileName, const XMFLOAT3& background) const
+{
+	ofstream file(fileName, ios::binary);
+	if (!file) return false;
+
+	// Blended over the background as the resolve does, at the render size
+	file << "P6\n" << m_renderSize.x << " " << m_renderSize.y << "\n255\n";
+	vector<uint8_t> row(m_renderSize.x * 3);
+	const auto bg = XMLoadFloat3(&background);
+	for (auto y = 0u; y < m_renderSize.y; ++y)
+	{
+		for (auto x = 0u; x < m_renderSize.x; ++x)
+		{
+			const auto& pixel = m_image[m_renderSize.x * y + x];
+			const auto color = XMVectorSaturate(XMVectorLerp(bg, XMLoadFloat4(&pixel), pixel.w));
+			XMFLOAT3 rgb;
+			XMStoreFloat3(&rgb, XMVectorMultiplyAdd(color, XMVectorReplicate(255.0f), XMVectorReplicate(0.5f)));
+			row[x * 3] = static_cast<uint8_t>(rgb.x);
+			row[x * 3 + 1] = static_cast<uint8_t>(rgb.y);
+			row[x * 3 + 2] = static_cast<uint8_t>(rgb.z);
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+
+	return file.good();
+}
+
+const XMFLOAT4* RayCasterCPU::GetImage() const
+{
+	return m_image.data();
+}
+
+const float* RayCasterCPU::GetDepths() const
+{
+	return m_depths.data();
+}
+
+const XMFLOAT4* RayCasterCPU::GetResolved() const
+{
+	return m_history[(m_numResolved + 1) % 2].data();
+}
+
+const XMUINT2& RayCasterCPU::GetRenderSize() const
+{
+	return m_renderSize;
+}
+
+const float* RayCasterCPU::GetOccupancy() const
+{
+	return m_occupancy.data();
+}
+
+const XMUINT3& RayCasterCPU::GetOccupancySize() const
+{
+	return m_occupancySize;
+}
+
+const XMUINT4& RayCasterCPU::GetBoundRect() const
+{
+	return m_boundRect;
+}
+
+const float* RayCasterCPU::GetLightTrans() const
+{
+	return m_lightTrans.data();
+}
+
+uint64_t RayCasterCPU::GetNumSamples() const
+{
+	auto numSamples = 0ull;
+	for (const auto& tileSamples : m_tileSamples) numSamples += tileSamples;
+
+	return numSamples;
+}
+
+RayCasterCPU::Kernel RayCasterCPU::GetKernel() const
+{
+	return m_kernel;
+}
+
+XMUINT3 RayCasterCPU::GetOccupancySize(const XMUINT3& gridSize)
+{
+	return XMUINT3((gridSize.x - 1) / MacroCellSize + 1, (gridSize.y - 1) / MacroCellSize + 1,
+		(gridSize.z - 1) / MacroCellSize + 1);
+}
+
+RayCasterCPU::LightSweep RayCasterCPU::GetLightSweep(const XMFLOAT3& localSpaceLightPt, const XMUINT3& gridSize)
+{
+	// Light direction in cells, of which the dominant axis keeps the footprints within the neighbors
+	XMFLOAT3 dir;
+	XMStoreFloat3(&dir, XMVectorMultiply(XMVector3Normalize(XMLoadFloat3(&localSpaceLightPt)),
+		XMVectorSet(0.5f * gridSize.x, -0.5f * gridSize.y, 0.5f * gridSize.z, 0.0f)));
+	auto axis = abs(dir.y) > abs(dir.x) ? 1u : 0u;
+	axis = abs(dir.z) > abs(axis ? dir.y : dir.x) ? 2u : axis;
+
+	LightSweep sweep;
+	const auto scale = 1.0f / abs(axis == 0 ? dir.x : (axis == 1 ? dir.y : dir.z));
+	sweep.CellOffset = XMFLOAT3(dir.x * scale, dir.y * scale, dir.z * scale);
+	sweep.Axis = axis;
+
+	// Texture space spans 2 in local space
+	const auto x = sweep.CellOffset.x / gridSize.x;
+	const auto y = sweep.CellOffset.y / gridSize.y;
+	const auto z = sweep.CellOffset.z / gridSize.z;
+	sweep.StepScale = 2.0f * sqrt(x * x + y * y + z * z);
+
+	return sweep;
+}
+
+XMUINT2 RayCasterCPU::GetRenderSize(const XMUINT2& viewport, float renderScale)
+{
+	return XMUINT2(static_cast<uint32_t>(ceil(viewport.x * renderScale)), static_cast<uint32_t>(ceil(viewport.y * renderScale)));
+}
+
+XMFLOAT2 RayCasterCPU::GetJitter(uint32_t frame)
+{
+	const auto halton = [](uint32_t i, uint32_t base)
+	{
+		auto f = 1.0f, r = 0.0f;
+		for (++i; i > 0; i /= base)
+		{
+			f /= base;
+			r += f * (i % base);
+		}
+
+		return r;
+	};
+
+	frame %= NumJitters;
+
+	return XMFLOAT2(halton(frame, 2) - 0.5f, halton(frame, 3) - 0.5f);
+}
+
+uint8_t RayCasterCPU::GetNumMips(const XMUINT3& gridSize)
+{
+	// Down to 8 texels on the shortest axis at most
+	auto minSize = min(min(gridSize.x, gridSize.y), gridSize.z);
+	uint8_t numMips = 1;
+	for (; numMips < NumMips && minSize >= 16; minSize >>= 1) ++numMips;
+
+	return numMips;
+}
+
+RayCasterCPU::Kernel RayCasterCPU::GetBestKernel()
+{
+	// The same instruction sets as of the particle kernels
+	return static_cast<Kernel>(ParticleSoA::GetBestKernel());
+}
+
+bool RayCasterCPU::setupRay(float x, float y, bool bounded, Ray& ray) const
+{
+	// The point on the near plane
+	XMFLOAT3 pos;
+	XMStoreFloat3(&pos, XMVector3TransformCoord(XMVectorSet(x, y, 0.0f, 1.0f), XMLoadFloat4x4(&m_screenToLocal)));
+	XMStoreFloat3(&ray.Dir, XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&pos), XMLoadFloat3(&m_localSpaceEyePt))));
+	if (!computeStartPoint(pos, ray.Dir)) return false;
+
+	ray.Start = pos;
+	ray.StartDist = XMVectorGetX(XMVector3Dot(XMVectorSubtract(XMLoadFloat3(&pos), XMLoadFloat3(&m_localSpaceEyePt)),
+		XMLoadFloat3(&ray.Dir)));
+
+	// Only the samples within the bound, at the same positions as from the unit box
+	ray.First = 0;
+	ray.Last = NumSamples;
+	if (bounded)
+	{
+		if (m_boundMin.x > m_boundMax.x) return false;
+
+		const float p[] = { pos.x, pos.y, pos.z };
+		const float d[] = { ray.Dir.x, ray.Dir.y, ray.Dir.z };
+		const float lo[] = { m_boundMin.x, m_boundMin.y, m_boundMin.z };
+		const float hi[] = { m_boundMax.x, m_boundMax.y, m_boundMax.z };
+		auto tEnter = 0.0f, tExit = FLT_MAX;
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			if (d[k] == 0.0f)
+			{
+				if (p[k] < lo[k] || p[k] > hi[k]) return false;
+				continue;
+			}
+			const auto t0 = (lo[k] - p[k]) / d[k], t1 = (hi[k] - p[k]) / d[k];
+			tEnter = max(tEnter, min(t0, t1));
+			tExit = min(tExit, max(t0, t1));
+		}
+		if (tEnter > tExit) return false;
+
+		ray.First = static_cast<uint32_t>(ceil(tEnter / g_stepScale));
+		ray.Last = min(static_cast<uint32_t>(tExit / g_stepScale) + 1, NumSamples);
+	}
+
+	return true;
+}
+
+XMFLOAT4 RayCasterCPU::shade(const XMFLOAT3& scatter, const XMFLOAT3& ambient, float transmit,
+	float depthSum, float& depth) const
+{
+	// The tone curve of PSRayCast
+	const auto result = XMVectorAdd(XMLoadFloat3(&scatter), XMVectorScale(XMVectorLerp(XMLoadFloat3(&ambient),
+		XMVectorReplicate(1.0f), 0.75f), 0.16f));
+	depth = transmit < 1.0f ? depthSum / (1.0f - transmit) : 0.0f;
+	XMFLOAT4 output;
+	XMStoreFloat4(&output, XMVectorSetW(XMVectorSqrt(result), min(max(1.0f - transmit, 0.0f), 1.0f)));
+
+	return output;
+}
+
+XMFLOAT4 RayCasterCPU::rayCast(float x, float y, const XMFLOAT4* pGrid, const XMUINT3& gridSize,
+	bool skipEmpty, bool sweptLight, bool bounded, bool adaptive, float& depth, uint32_t& numSamples) const
+{
+	depth = 0.0f;
+	Ray ray;
+	if (!setupRay(x, y, bounded, ray)) return XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	const auto& rayDir = ray.Dir;
+	const auto start = XMLoadFloat3(&ray.Start);
+	const auto startDist = ray.StartDist;
+	const auto lightStep = XMVectorScale(XMVector3Normalize(XMLoadFloat3(&m_localSpaceLightPt)), g_lightStepScale);
+	const auto texScale = XMVectorSet(0.5f, -0.5f, 0.5f, 0.0f);
+	const auto half = XMVectorReplicate(0.5f);
+	const auto one = XMVectorReplicate(1.0f);
+
+	XMFLOAT3 texStart, texDir;
+	XMStoreFloat3(&texStart, XMVectorMultiplyAdd(texScale, start, half));
+	XMStoreFloat3(&texDir, XMVectorMultiply(texScale, XMLoadFloat3(&rayDir)));
+
+	// Pixel footprint per unit view distance in texels
+	const auto texelScale = 0.5f * max(max(gridSize.x, gridSize.y), gridSize.z);
+	const auto stepTexels = g_stepScale * texelScale;
+	const auto maxLod = static_cast<float>(m_mips.size());
+	const auto footprint = adaptive ? getFootprint(x, y, rayDir, gridSize) : 0.0f;
+
+	auto transmit = 1.0f;	// Transmittance
+	auto scatter = XMVectorZero();	// In-scattered radiance
+	auto ambient = XMVectorZero();
+	auto depthSum = 0.0f;	// View distances weighted by the opacity gained
+
+	const auto first = ray.First, last = ray.Last;
+	auto isSparse = false;	// The last sample is thin enough to probe the span ahead
+	for (auto i = first; i < last;)
+	{
+		auto samplePos = XMVectorMultiplyAdd(XMLoadFloat3(&rayDir), XMVectorReplicate(g_stepScale * i), start);
+		if (!XMVector3InBounds(samplePos, one)) break;
+		auto tex = XMVectorMultiplyAdd(texScale, samplePos, half);
+
+		// Skip the empty macro-cells as a whole, to the first sample beyond
+		if (skipEmpty)
+		{
+			XMFLOAT3 t;
+			XMStoreFloat3(&t, tex);
+			const XMUINT3 macroCell
+			(
+				min(static_cast<uint32_t>(t.x * gridSize.x) / MacroCellSize, m_occupancySize.x - 1),
+				min(static_cast<uint32_t>(t.y * gridSize.y) / MacroCellSize, m_occupancySize.y - 1),
+				min(static_cast<uint32_t>(t.z * gridSize.z) / MacroCellSize, m_occupancySize.z - 1)
+			);
+			const auto maxDensity = m_occupancy[VolumeSampler::Index(macroCell.x, macroCell.y, macroCell.z, m_occupancySize)];
+			if (maxDensity * g_densityScale <= g_zeroThreshold)
+			{
+				i = getNextSample(texStart, texDir, macroCell, gridSize, i);
+				continue;
+			}
+		}
+
+		// Get a sample
+		auto stride = 1u;
+		auto sampleDist = startDist + g_stepScale * i;
+		XMVECTOR color;
+		if (adaptive)
+		{
+			// Mip level of the pixel footprint at the distance, striding over the samples finer than it
+			const auto footprintTexels = sampleDist * footprint;
+			const auto lod = min(log2(max(footprintTexels, 1.0f)), maxLod);
+			stride = min(max(static_cast<uint32_t>(footprintTexels / stepTexels), 1u), MaxStride);
+
+			// Probe the span ahead at the level of its extent, taken as a whole if thin
+			if (isSparse)
+			{
+				const auto offset = g_stepScale * (MaxStride - 1) * 0.5f;
+				const auto spanPos = XMVectorMultiplyAdd(XMLoadFloat3(&rayDir), XMVectorReplicate(offset), samplePos);
+				isSparse = XMVector3InBounds(spanPos, one);
+				if (isSparse)
+				{
+					const auto spanTex = XMVectorMultiplyAdd(texScale, spanPos, half);
+					color = getSampleLevel(pGrid, gridSize, spanTex, min(max(lod, log2(MaxStride * stepTexels)), maxLod));
+					++numSamples;
+					isSparse = XMVectorGetW(color) * g_stepScale * MaxStride * g_absorption < SparseOpacity;
+					if (isSparse)
+					{
+						stride = MaxStride;
+						samplePos = spanPos;
+						tex = spanTex;
+						sampleDist += offset;
+					}
+				}
+			}
+
+			if (!isSparse)
+			{
+				// At the middle of the stride
+				const auto offset = g_stepScale * (stride - 1) * 0.5f;
+				const auto midPos = XMVectorMultiplyAdd(XMLoadFloat3(&rayDir), XMVectorReplicate(offset), samplePos);
+				if (XMVector3InBounds(midPos, one))
+				{
+					samplePos = midPos;
+					tex = XMVectorMultiplyAdd(texScale, samplePos, half);
+					sampleDist += offset;
+				}
+				else stride = 1;
+				color = getSampleLevel(pGrid, gridSize, tex, lod);
+				++numSamples;
+				isSparse = XMVectorGetW(color) * g_stepScale * MaxStride * g_absorption < SparseOpacity;
+			}
+		}
+		else
+		{
+			color = getSample(pGrid, gridSize, tex);
+			++numSamples;
+		}
+		i += stride;
+
+		// Skip empty space
+		if (XMVectorGetW(color) > g_zeroThreshold)
+		{
+			// Attenuate ray-throughput
+			const auto scaledColor = XMVectorScale(color, g_stepScale * stride);
+			const auto prevTransmit = transmit;
+			transmit *= min(max(1.0f - XMVectorGetW(scaledColor) * g_absorption, 0.0f), 1.0f);
+			depthSum += (prevTransmit - transmit) * sampleDist;
+			if (transmit < g_zeroThreshold) break;
+
+			// Sample light
+			auto lightTrans = 1.0f;	// Transmittance along light ray
+			if (sweptLight)
+			{
+				// Swept in advance
+				lightTrans = XMVectorGetX(VolumeSampler::SampleLinear(m_lightTrans.data(), m_lightSize, tex, VolumeSampler::CLAMP));
+			}
+			else
+			{
+				auto lightPos = XMVectorAdd(samplePos, lightStep);
+				for (auto j = 0u; j < NumLightSamples; ++j)
+				{
+					if (!XMVector3InBounds(lightPos, one)) break;
+
+					// Get a sample along light ray
+					const auto density = XMVectorGetW(getSample(pGrid, gridSize, XMVectorMultiplyAdd(texScale, lightPos, half)));
+
+					// Attenuate ray-throughput along light direction
+					lightTrans *= min(max(1.0f - g_absorption * g_lightStepScale * density, 0.0f), 1.0f);
+					if (lightTrans < g_zeroThreshold) break;
+
+					// Update position along light ray
+					lightPos = XMVectorAdd(lightPos, lightStep);
+				}
+			}
+
+			scatter = XMVectorMultiplyAdd(XMVectorReplicate(lightTrans * transmit), scaledColor, scatter);
+			ambient = XMVectorMultiplyAdd(XMVectorReplicate(transmit), scaledColor, ambient);
+		}
+	}
+
+	XMFLOAT3 scatterOut, ambientOut;
+	XMStoreFloat3(&scatterOut, scatter);
+	XMStoreFloat3(&ambientOut, ambient);
+
+	return shade(scatterOut, ambientOut, transmit, depthSum, depth);
+}
+
+template<typename T>
+void RayCasterCPU::rayCastPacket(uint32_t x, uint32_t y, uint32_t numRays, const XMFLOAT4* pGrid,
+	const XMUINT3& gridSize, bool skipEmpty, bool sweptLight, bool bounded, bool adaptive, uint32_t& numSamples)
+{
+	using Float = typename T::Float;
+	using Int = typename T::Int;
+	using Mask = typename T::Mask;
+
+	// Set the rays up per lane; the lanes past the run, or missing, start inactive at the origin
+	alignas(64) float starts[3][T::Width], dirs[3][T::Width], startDists[T::Width], footprints[T::Width];
+	alignas(64) int32_t firsts[T::Width], lasts[T::Width];
+	bool isHits[T::Width];
+	for (auto j = 0u; j < T::Width; ++j)
+	{
+		Ray ray = {};
+		isHits[j] = j < numRays && setupRay(x + j + 0.5f, y + 0.5f, bounded, ray);
+		if (!isHits[j]) ray = {};
+		footprints[j] = adaptive && isHits[j] ? getFootprint(x + j + 0.5f, y + 0.5f, ray.Dir, gridSize) : 0.0f;
+		starts[0][j] = ray.Start.x;
+		starts[1][j] = ray.Start.y;
+		starts[2][j] = ray.Start.z;
+		dirs[0][j] = ray.Dir.x;
+		dirs[1][j] = ray.Dir.y;
+		dirs[2][j] = ray.Dir.z;
+		startDists[j] = ray.StartDist;
+		firsts[j] = ray.First;
+		lasts[j] = ray.Last;
+	}
+
+	const auto zero = T::Set(0.0f);
+	const auto one = T::Set(1.0f);
+	const auto half = T::Set(0.5f);
+	const auto stepScale = T::Set(g_stepScale);
+	const auto zeroThreshold = T::Set(g_zeroThreshold);
+	const auto densityScale = T::Set(g_densityScale);
+	const auto absorption = T::Set(g_absorption);
+	const Float texScales[] = { T::Set(0.5f), T::Set(-0.5f), T::Set(0.5f) };
+	const uint32_t dims[] = { gridSize.x, gridSize.y, gridSize.z };
+	const uint32_t occupancyDims[] = { m_occupancySize.x, m_occupancySize.y, m_occupancySize.z };
+
+	// Mip levels and strides of the adaptive sampling, as in the scalar path
+	const auto stepTexels = g_stepScale * (0.5f * max(max(gridSize.x, gridSize.y), gridSize.z));
+	const auto maxLod = static_cast<float>(m_mips.size());
+	const auto spanLod = T::Set(log2(MaxStride * stepTexels));
+	const auto sparseScale = T::Set(static_cast<float>(MaxStride));
+	const auto sparseOpacity = T::Set(SparseOpacity);
+
+	XMFLOAT3 lightStep;
+	XMStoreFloat3(&lightStep, XMVectorScale(XMVector3Normalize(XMLoadFloat3(&m_localSpaceLightPt)), g_lightStepScale));
+	const Float lightSteps[] = { T::Set(lightStep.x), T::Set(lightStep.y), T::Set(lightStep.z) };
+
+	Float start[3], dir[3], texStart[3], texDir[3];
+	for (uint8_t k = 0; k < 3; ++k)
+	{
+		start[k] = T::Load(starts[k]);
+		dir[k] = T::Load(dirs[k]);
+		texStart[k] = T::Add(T::Mul(texScales[k], start[k]), half);
+		texDir[k] = T::Mul(texScales[k], dir[k]);
+	}
+	const auto startDist = T::Load(startDists);
+	const auto last = T::LoadI(lasts);
+	auto i = T::LoadI(firsts);
+
+	const auto lerp = [](Float a, Float b, Float t) { return T::Add(T::Mul(T::Sub(b, a), t), a); };
+
+	// Trilinear samples of the channels of a volume, as VolumeSampler::SampleLinear with clamp addressing
+	const auto sampleLinear = [&](const float* pVolume, const XMUINT3& size, int32_t stride, const Float tex[3],
+		uint32_t firstChannel, uint32_t numChannels, Float* pResults)
+	{
+		const uint32_t sizes[] = { size.x, size.y, size.z };
+		Float w[3];
+		Int i0[3], i1[3];
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			const auto t = T::Sub(T::Mul(tex[k], T::Set(static_cast<float>(sizes[k]))), half);
+			const auto base = T::Floor(t);
+			const auto baseI = T::ToInt(base);
+			const auto maxI = T::SetI(sizes[k] - 1);
+			w[k] = T::Sub(t, base);
+			i0[k] = T::MinI(T::MaxI(baseI, T::SetI(0)), maxI);
+			i1[k] = T::MinI(T::MaxI(T::AddI(baseI, T::SetI(1)), T::SetI(0)), maxI);
+		}
+
+		// Element offsets of the 8 corners, x in the lowest bit
+		Int corners[8];
+		for (uint8_t k = 0; k < 8; ++k)
+		{
+			const auto row = T::AddI(T::MulI(k & 4 ? i1[2] : i0[2], T::SetI(size.y)), k & 2 ? i1[1] : i0[1]);
+			corners[k] = T::MulI(T::AddI(T::MulI(row, T::SetI(size.x)), k & 1 ? i1[0] : i0[0]), T::SetI(stride));
+		}
+
+		for (auto c = 0u; c < numChannels; ++c)
+		{
+			Float v[8];
+			for (uint8_t k = 0; k < 8; ++k) v[k] = T::Gather(pVolume + firstChannel + c, corners[k]);
+			const auto c00 = lerp(v[0], v[1], w[0]);
+			const auto c10 = lerp(v[2], v[3], w[0]);
+			const auto c01 = lerp(v[4], v[5], w[0]);
+			const auto c11 = lerp(v[6], v[7], w[0]);
+			pResults[c] = lerp(lerp(c00, c10, w[1]), lerp(c01, c11, w[1]), w[2]);
+		}
+	};
+
+	// Colors scaled by the densities, as toSample
+	const auto toSamples = [&](Float color[4])
+	{
+		const auto density = T::Mul(color[3], densityScale);
+		for (uint8_t c = 0; c < 3; ++c) color[c] = T::Min(T::Mul(color[c], density), densityScale);
+		color[3] = T::Min(density, densityScale);
+	};
+
+	// Trilinear between the levels around the levels of detail of the lanes, as getSampleLevel;
+	// each level is sampled once for all the lanes reading it
+	const auto sampleLevels = [&](const Float tex[3], Float lod, Mask mask, Float color[4])
+	{
+		const auto level = T::ToInt(lod);
+		const auto t = T::Sub(lod, T::ToFloat(level));
+		const auto isBlended = T::Greater(t, zero);
+		Float lower[] = { zero, zero, zero, zero };
+		Float upper[] = { zero, zero, zero, zero };
+		for (auto l = 0; l <= static_cast<int32_t>(m_mips.size()); ++l)
+		{
+			const auto isLower = T::And(mask, T::EqualI(level, T::SetI(l)));
+			const auto isUpper = T::And(T::And(mask, isBlended), T::EqualI(level, T::SetI(l - 1)));
+			if (!T::Bits(T::Or(isLower, isUpper))) continue;
+
+			Float samples[4];
+			sampleLinear(reinterpret_cast<const float*>(l > 0 ? m_mips[l - 1].data() : pGrid),
+				l > 0 ? m_mipSizes[l - 1] : gridSize, 4, tex, 0, 4, samples);
+			for (uint8_t c = 0; c < 4; ++c)
+			{
+				lower[c] = T::Select(isLower, samples[c], lower[c]);
+				upper[c] = T::Select(isUpper, samples[c], upper[c]);
+			}
+		}
+		for (uint8_t c = 0; c < 4; ++c) color[c] = T::Select(isBlended, lerp(lower[c], upper[c], t), lower[c]);
+		toSamples(color);
+	};
+
+	// Lanes of which the opacity over a whole span is thin enough to stride over it
+	const auto getThin = [&](Mask mask, Float density)
+	{
+		return T::And(mask, T::Less(T::Mul(T::Mul(T::Mul(density, stepScale), sparseScale), absorption), sparseOpacity));
+	};
+
+	auto transmit = one;	// Transmittance
+	Float scatter[] = { zero, zero, zero };	// In-scattered radiance
+	Float ambient[] = { zero, zero, zero };
+	auto depthSum = zero;	// View distances weighted by the opacity gained
+
+	// Each lane marches on its own sample index, until it leaves the box, its range or the opacity
+	auto active = T::LessI(i, last);
+	auto isSparse = T::Less(zero, zero);	// The last sample is thin enough to probe the span ahead
+	while (T::Bits(active))
+	{
+		const auto dist = T::Mul(stepScale, T::ToFloat(i));
+		Float pos[3], tex[3];
+		for (uint8_t k = 0; k < 3; ++k)
+		{
+			pos[k] = T::Add(T::Mul(dir[k], dist), start[k]);
+			active = T::And(active, T::LessEqual(T::Abs(pos[k]), one));
+			tex[k] = T::Add(T::Mul(texScales[k], pos[k]), half);
+		}
+
+		// Skip the empty macro-cells as a whole, to the first sample beyond
+		auto sampled = active;
+		if (skipEmpty)
+		{
+			Int macroCell[3];
+			for (uint8_t k = 0; k < 3; ++k)
+				macroCell[k] = T::MinI(T::ToInt(T::Mul(T::Mul(tex[k], T::Set(static_cast<float>(dims[k]))),
+					T::Set(1.0f / MacroCellSize))), T::SetI(occupancyDims[k] - 1));
+			const auto cellIdx = T::AddI(T::MulI(T::AddI(T::MulI(macroCell[2], T::SetI(occupancyDims[1])), macroCell[1]),
+				T::SetI(occupancyDims[0])), macroCell[0]);
+			const auto maxDensity = T::Gather(m_occupancy.data(), cellIdx);
+			const auto isEmpty = T::And(active, T::LessEqual(T::Mul(maxDensity, densityScale), zeroThreshold));
+
+			if (T::Bits(isEmpty))
+			{
+				// One 3D-DDA step: the nearest of the exit planes of the macro-cell
+				auto tExit = T::Set(FLT_MAX);
+				for (uint8_t k = 0; k < 3; ++k)
+				{
+					const auto isForward = T::Greater(texDir[k], zero);
+					const auto plane = T::Div(T::ToFloat(T::MulI(T::AddI(macroCell[k], T::SelectI(isForward, T::SetI(1),
+						T::SetI(0))), T::SetI(MacroCellSize))), T::Set(static_cast<float>(dims[k])));
+					const auto t = T::Div(T::Sub(plane, texStart[k]), texDir[k]);
+					tExit = T::Select(T::NotEqual(texDir[k], zero), T::Min(tExit, t), tExit);
+				}
+				const auto next = T::MaxI(T::ToInt(T::Ceil(T::Min(T::Div(tExit, stepScale),
+					T::Set(static_cast<float>(NumSamples))))), T::AddI(i, T::SetI(1)));
+				i = T::SelectI(isEmpty, next, i);
+				sampled = T::AndNot(active, isEmpty);
+			}
+		}
+
+		if (T::Bits(sampled))
+		{
+			// Get a sample
+			auto stride = T::SetI(1);
+			auto sampleDist = T::Add(startDist, dist);
+			Float color[] = { zero, zero, zero, zero };
+			if (adaptive)
+			{
+				// Mip level of the pixel footprint at the distance, striding over the samples finer than it
+				alignas(64) float sampleDists[T::Width], lods[T::Width];
+				alignas(64) int32_t strides[T::Width];
+				T::Store(sampleDists, sampleDist);
+				const auto sampledBits = T::Bits(sampled);
+				for (auto j = 0u; j < T::Width; ++j)
+				{
+					const auto footprintTexels = sampleDists[j] * footprints[j];
+					const auto isSampled = (sampledBits >> j) & 1;
+					lods[j] = isSampled ? min(log2(max(footprintTexels, 1.0f)), maxLod) : 0.0f;
+					strides[j] = isSampled ? min(max(static_cast<uint32_t>(footprintTexels / stepTexels), 1u), MaxStride) : 1;
+				}
+				const auto lod = T::Load(lods);
+				stride = T::LoadI(strides);
+
+				// Probe the span ahead at the level of its extent, taken as a whole if thin
+				const auto isProbed = T::And(sampled, isSparse);
+				isSparse = T::AndNot(isSparse, isProbed);
+				if (T::Bits(isProbed))
+				{
+					const auto offset = T::Set(g_stepScale * (MaxStride - 1) * 0.5f);
+					Float spanPos[3], spanTex[3];
+					auto isInside = isProbed;
+					for (uint8_t k = 0; k < 3; ++k)
+					{
+						spanPos[k] = T::Add(T::Mul(dir[k], offset), pos[k]);
+						isInside = T::And(isInside, T::LessEqual(T::Abs(spanPos[k]), one));
+						spanTex[k] = T::Add(T::Mul(texScales[k], spanPos[k]), half);
+					}
+
+					if (T::Bits(isInside))
+					{
+						Float spanColor[4];
+						sampleLevels(spanTex, T::Min(T::Max(lod, spanLod), T::Set(maxLod)), isInside, spanColor);
+						numSamples += __popcnt(T::Bits(isInside));
+						const auto isThin = getThin(isInside, spanColor[3]);
+						isSparse = T::Or(isSparse, isThin);
+						stride = T::SelectI(isThin, T::SetI(MaxStride), stride);
+						for (uint8_t k = 0; k < 3; ++k)
+						{
+							pos[k] = T::Select(isThin, spanPos[k], pos[k]);
+							tex[k] = T::Select(isThin, spanTex[k], tex[k]);
+						}
+						for (uint8_t c = 0; c < 4; ++c) color[c] = T::Select(isThin, spanColor[c], color[c]);
+						sampleDist = T::Select(isThin, T::Add(sampleDist, offset), sampleDist);
+					}
+				}
+
+				// At the middle of the stride, for the lanes not taking the span
+				const auto isMid = T::AndNot(sampled, isSparse);
+				if (T::Bits(isMid))
+				{
+					const auto offset = T::Mul(T::Mul(stepScale, T::ToFloat(T::AddI(stride, T::SetI(-1)))), half);
+					Float midPos[3];
+					auto isInside = isMid;
+					for (uint8_t k = 0; k < 3; ++k)
+					{
+						midPos[k] = T::Add(T::Mul(dir[k], offset), pos[k]);
+						isInside = T::And(isInside, T::LessEqual(T::Abs(midPos[k]), one));
+					}
+					for (uint8_t k = 0; k < 3; ++k)
+					{
+						pos[k] = T::Select(isInside, midPos[k], pos[k]);
+						tex[k] = T::Select(isInside, T::Add(T::Mul(texScales[k], pos[k]), half), tex[k]);
+					}
+					sampleDist = T::Select(isInside, T::Add(sampleDist, offset), sampleDist);
+					stride = T::SelectI(T::AndNot(isMid, isInside), T::SetI(1), stride);
+
+					Float midColor[4];
+					sampleLevels(tex, lod, isMid, midColor);
+					numSamples += __popcnt(T::Bits(isMid));
+					isSparse = T::Or(isSparse, getThin(isMid, midColor[3]));
+					for (uint8_t c = 0; c < 4; ++c) color[c] = T::Select(isMid, midColor[c], color[c]);
+				}
+			}
+			else
+			{
+				sampleLinear(reinterpret_cast<const float*>(pGrid), gridSize, 4, tex, 0, 4, color);
+				toSamples(color);
+				numSamples += __popcnt(T::Bits(sampled));
+			}
+
+			// Skip empty space
+			const auto isDense = T::And(sampled, T::Greater(color[3], zeroThreshold));
+			if (T::Bits(isDense))
+			{
+				// Attenuate ray-throughput
+				const auto strideScale = T::Mul(stepScale, T::ToFloat(stride));
+				Float scaledColor[4];
+				for (uint8_t c = 0; c < 4; ++c) scaledColor[c] = T::Mul(color[c], strideScale);
+				const auto prevTransmit = transmit;
+				transmit = T::Select(isDense, T::Mul(transmit, T::Min(T::Max(T::Sub(one,
+					T::Mul(scaledColor[3], absorption)), zero), one)), transmit);
+				depthSum = T::Select(isDense, T::Add(depthSum, T::Mul(T::Sub(prevTransmit, transmit), sampleDist)), depthSum);
+				const auto isOpaque = T::And(isDense, T::Less(transmit, zeroThreshold));
+				const auto isLit = T::AndNot(isDense, isOpaque);
+				active = T::AndNot(active, isOpaque);
+
+				// Sample light
+				auto lightTrans = one;	// Transmittance along light ray
+				if (sweptLight)
+				{
+					// Swept in advance
+					sampleLinear(m_lightTrans.data(), m_lightSize, 1, tex, 0, 1, &lightTrans);
+				}
+				else
+				{
+					Float lightPos[3];
+					for (uint8_t k = 0; k < 3; ++k) lightPos[k] = T::Add(pos[k], lightSteps[k]);
+					auto isMarching = isLit;
+					for (auto j = 0u; j < NumLightSamples; ++j)
+					{
+						for (uint8_t k = 0; k < 3; ++k) isMarching = T::And(isMarching, T::LessEqual(T::Abs(lightPos[k]), one));
+						if (!T::Bits(isMarching)) break;
+
+						// Get a sample along light ray
+						Float lightTex[3];
+						for (uint8_t k = 0; k < 3; ++k) lightTex[k] = T::Add(T::Mul(texScales[k], lightPos[k]), half);
+						Float lightDensity;
+						sampleLinear(reinterpret_cast<const float*>(pGrid), gridSize, 4, lightTex, 3, 1, &lightDensity);
+						lightDensity = T::Min(T::Mul(lightDensity, densityScale), densityScale);
+
+						// Attenuate ray-throughput along light direction
+						lightTrans = T::Select(isMarching, T::Mul(lightTrans, T::Min(T::Max(T::Sub(one,
+							T::Mul(T::Set(g_absorption * g_lightStepScale), lightDensity)), zero), one)), lightTrans);
+						isMarching = T::AndNot(isMarching, T::Less(lightTrans, zeroThreshold));
+
+						// Update position along light ray
+						for (uint8_t k = 0; k < 3; ++k) lightPos[k] = T::Add(lightPos[k], lightSteps[k]);
+					}
+				}
+
+				const auto lightTransmit = T::Mul(lightTrans, transmit);
+				for (uint8_t c = 0; c < 3; ++c)
+				{
+					scatter[c] = T::Select(isLit, T::Add(T::Mul(lightTransmit, scaledColor[c]), scatter[c]), scatter[c]);
+					ambient[c] = T::Select(isLit, T::Add(T::Mul(transmit, scaledColor[c]), ambient[c]), ambient[c]);
+				}
+			}
+			i = T::SelectI(sampled, T::AddI(i, stride), i);
+		}
+		active = T::And(active, T::LessI(i, last));
+	}
+
+	// Write the lanes of the run out through the tone curve
+	alignas(64) float scatters[3][T::Width], ambients[3][T::Width], transmits[T::Width], depthSums[T::Width];
+	for (uint8_t c = 0; c < 3; ++c)
+	{
+		T::Store(scatters[c], scatter[c]);
+		T::Store(ambients[c], ambient[c]);
+	}
+	T::Store(transmits, transmit);
+	T::Store(depthSums, depthSum);
+	for (auto j = 0u; j < numRays; ++j)
+	{
+		const auto idx = m_renderSize.x * y + x + j;
+		m_depths[idx] = 0.0f;
+		m_image[idx] = isHits[j] ? shade(XMFLOAT3(scatters[0][j], scatters[1][j], scatters[2][j]),
+			XMFLOAT3(ambients[0][j], ambients[1][j], ambients[2][j]), transmits[j], depthSums[j], m_depths[idx]) :
+			XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+}
+
+float RayCasterCPU::getFootprint(float x, float y, const XMFLOAT3& rayDir, const XMUINT3& gridSize) const
+{
+	// From the next pixel on the near plane
+	const auto texelScale = 0.5f * max(max(gridSize.x, gridSize.y), gridSize.z);
+	const auto screenToLocal = XMLoadFloat4x4(&m_screenToLocal);
+	const auto nearPt = XMVector3TransformCoord(XMVectorSet(x, y, 0.0f, 1.0f), screenToLocal);
+	const auto nextPt = XMVector3TransformCoord(XMVectorSet(x + 1.0f, y, 0.0f, 1.0f), screenToLocal);
+	const auto nearDist = XMVectorGetX(XMVector3Dot(XMVectorSubtract(nearPt, XMLoadFloat3(&m_localSpaceEyePt)),
+		XMLoadFloat3(&rayDir)));
+
+	return XMVectorGetX(XMVector3Length(XMVectorSubtract(nextPt, nearPt))) / nearDist * texelScale;
+}
+
+XMVECTOR XM_CALLCONV RayCasterCPU::getSampleLevel(const XMFLOAT4* pGrid, const XMUINT3& gridSize,
+	FXMVECTOR tex, float lod) const
+{
+	// Trilinear between the levels around the level of detail
+	const auto level = static_cast<uint32_t>(lod);
+	const auto sampleLevel = [&](uint32_t i)
+	{
+		return i > 0 ? VolumeSampler::SampleLinear(m_mips[i - 1].data(), m_mipSizes[i - 1], tex, VolumeSampler::CLAMP) :
+			VolumeSampler::SampleLinear(pGrid, gridSize, tex, VolumeSampler::CLAMP);
+	};
+
+	auto color = sampleLevel(level);
+	const auto t = lod - level;
+	if (t > 0.0f) color = XMVectorLerp(color, sampleLevel(level + 1), t);
+
+	return toSample(color);
+}
+
+uint32_t RayCasterCPU::getNextSample(const XMFLOAT3& texStart, const XMFLOAT3& texDir,
+	const XMUINT3& macroCell, const XMUINT3& gridSize, uint32_t i) const
+{
+	// One 3D-DDA step: the ray leaves the macro-cell at the nearest of its exit planes
+	const float starts[] = { texStart.x, texStart.y, texStart.z };
+	const float dirs[] = { texDir.x, texDir.y, texDir.z };
+	const uint32_t cells[] = { macroCell.x, macroCell.y, macroCell.z };
+	const uint32_t dims[] = { gridSize.x, gridSize.y, gridSize.z };
+
+	auto tExit = FLT_MAX;
+	for (uint8_t k = 0; k < 3; ++k)
+	{
+		if (dirs[k] == 0.0f) continue;
+		const auto plane = static_cast<float>((cells[k] + (dirs[k] > 0.0f ? 1 : 0)) * MacroCellSize) / dims[k];
+		tExit = min(tExit, (plane - starts[k]) / dirs[k]);
+	}
+
+	// The first sample beyond, advancing at least one
+	return max(static_cast<uint32_t>(ceil(min(tExit / g_stepScale, static_cast<float>(NumSamples)))), i + 1);
+}
@@ -0,0 +1,140 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Reference of the volume ray casting, CPU counterpart of CSOccupancy, CSLightTrans, PSRayCast and PSResolve;
+// the macro-cells of the occupancy grid hold the maximum density over the cells they
+// cover, with the 1-cell apron reached by the trilinear samples. The image is cast at a
+// reduced render size with jittered samples, and resolved to the viewport over the history
+// reprojected at the opacity-weighted view distances. The rays are cast only over the pixels
+// covered by the bound of the occupied macro-cells, and sampled within it, as CSBound and VSBound do.
+// Adaptive sampling strides over the thin spans probed on the mip chain of CSDownsample3D, and over
+// the samples finer than the pixel footprint, sampling the mip level matching it. The image is cast
+// in tiles across the threads, with 8- or 16-ray packets under AVX2 or AVX-512, each lane marching on its own
+class RayCasterCPU
+{
+public:
+	enum Kernel : uint8_t
+	{
+		SCALAR,
+		AVX2,
+		AVX512,
+
+		NUM_KERNEL
+	};
+
+	// Light transmittance is swept slice by slice along the dominant axis of the light direction,
+	// each cell attenuating the transmittance bilinearly sampled from the previous slice toward the light
+	struct LightSweep
+	{
+		DirectX::XMFLOAT3 CellOffset;	// From a cell to the previous slice, in cells
+		float StepScale;				// Length of the offset in local space
+		uint32_t Axis;
+	};
+
+	RayCasterCPU();
+	virtual ~RayCasterCPU();
+
+	void Init(uint32_t width, uint32_t height);
+	void UpdateFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj, const DirectX::XMFLOAT3& eyePt,
+		float renderScale = 1.0f, const DirectX::XMFLOAT2& jitter = DirectX::XMFLOAT2(0.0f, 0.0f));
+	void UpdateOccupancy(const DirectX::XMFLOAT4* pGrid, const DirectX::XMUINT3& gridSize);
+	void UpdateMips(const DirectX::XMFLOAT4* pGrid, const DirectX::XMUINT3& gridSize);
+	uint32_t UpdateLightTrans(const DirectX::XMFLOAT4* pGrid, const DirectX::XMUINT3& gridSize,
+		bool incremental = true);	// Returns the number of cells recomputed
+	void Render(const DirectX::XMFLOAT4* pGrid, const DirectX::XMUINT3& gridSize, bool skipEmpty = true,
+		bool sweptLight = false, bool bounded = false, bool adaptive = false);
+	void Resolve();
+	void SetKernel(Kernel kernel);
+	bool SaveImage(const char* fileName, const DirectX::XMFLOAT3& background) const;	// Binary PPM over the background
+
+	const DirectX::XMFLOAT4* GetImage() const;	// At the render size; discarded pixels are zero
+	const float* GetDepths() const;				// View distances of the image, zero if empty
+	const DirectX::XMFLOAT4* GetResolved() const;	// At the viewport size, premultiplied
+	const DirectX::XMUINT2& GetRenderSize() const;
+	const float* GetOccupancy() const;
+	const DirectX::XMUINT3& GetOccupancySize() const;
+	const DirectX::XMUINT4& GetBoundRect() const;	// Left, top, right and bottom of the pixels cast
+	const float* GetLightTrans() const;
+	uint64_t GetNumSamples() const;	// Density samples along the view rays of the last render
+	Kernel GetKernel() const;
+
+	static DirectX::XMUINT3 GetOccupancySize(const DirectX::XMUINT3& gridSize);
+	static LightSweep GetLightSweep(const DirectX::XMFLOAT3& localSpaceLightPt, const DirectX::XMUINT3& gridSize);
+	static DirectX::XMUINT2 GetRenderSize(const DirectX::XMUINT2& viewport, float renderScale);
+	static DirectX::XMFLOAT2 GetJitter(uint32_t frame);	// Centered Halton (2, 3) offsets in render pixels
+	static uint8_t GetNumMips(const DirectX::XMUINT3& gridSize);
+	static Kernel GetBestKernel();
+
+	static const uint32_t MacroCellSize = 8;	// Matching MACRO_CELL_SIZE in Occupancy.hlsli
+	static const uint32_t NumSamples = 128;
+	static const uint32_t NumLightSamples = 32;
+	static constexpr float LightTolerance = 1.0f / 1024.0f;	// Attenuation change kept as unchanged
+	static const uint32_t NumJitters = 8;
+	static constexpr float HistoryBlend = 0.1f;	// Weight of the current frame over the history
+	static constexpr float DepthSigma = 0.05f;	// View distance falloff of the upsampling weights, in local space
+	static const uint8_t NumMips = 4;
+	static const uint32_t MaxStride = 4;		// Matching MAX_STRIDE in PSRayCast
+	static constexpr float SparseOpacity = 0.02f;	// Opacity of the spans strided over as a whole
+	static const uint32_t TileWidth = 64;		// Whole packets of either width
+	static const uint32_t TileHeight = 8;
+
+protected:
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Start;	// Where the ray enters the unit box
+		DirectX::XMFLOAT3 Dir;
+		float StartDist;			// View distance of the start
+		uint32_t First;				// Sample range, within the bound if bounded
+		uint32_t Last;
+	};
+
+	bool setupRay(float x, float y, bool bounded, Ray& ray) const;	// False if the ray misses
+	DirectX::XMFLOAT4 shade(const DirectX::XMFLOAT3& scatter, const DirectX::XMFLOAT3& ambient,
+		float transmit, float depthSum, float& depth) const;
+	DirectX::XMFLOAT4 rayCast(float x, float y, const DirectX::XMFLOAT4* pGrid,
+		const DirectX::XMUINT3& gridSize, bool skipEmpty, bool sweptLight, bool bounded, bool adaptive,
+		float& depth, uint32_t& numSamples) const;
+	template<typename T>
+	void rayCastPacket(uint32_t x, uint32_t y, uint32_t numRays, const DirectX::XMFLOAT4* pGrid,
+		const DirectX::XMUINT3& gridSize, bool skipEmpty, bool sweptLight, bool bounded, bool adaptive,
+		uint32_t& numSamples);
+	float getFootprint(float x, float y, const DirectX::XMFLOAT3& rayDir,
+		const DirectX::XMUINT3& gridSize) const;	// Pixel footprint per unit view distance in texels
+	DirectX::XMVECTOR XM_CALLCONV getSampleLevel(const DirectX::XMFLOAT4* pGrid, const DirectX::XMUINT3& gridSize,
+		DirectX::FXMVECTOR tex, float lod) const;
+	uint32_t getNextSample(const DirectX::XMFLOAT3& texStart, const DirectX::XMFLOAT3& texDir,
+		const DirectX::XMUINT3& macroCell, const DirectX::XMUINT3& gridSize, uint32_t i) const;
+
+	DirectX::XMFLOAT4X4 m_screenToLocal;	// From the jittered render pixels
+	DirectX::XMFLOAT4X4 m_resolveToLocal;	// From the viewport pixels
+	DirectX::XMFLOAT4X4 m_worldViewProj;
+	DirectX::XMFLOAT4X4 m_prevWorldViewProj;
+	DirectX::XMFLOAT2 m_jitter;
+	DirectX::XMFLOAT3 m_localSpaceEyePt;
+	DirectX::XMFLOAT3 m_localSpaceLightPt;
+	DirectX::XMFLOAT3 m_boundMin;	// Local-space bound of the occupied macro-cells, inverted if none
+	DirectX::XMFLOAT3 m_boundMax;
+	DirectX::XMUINT4 m_boundRect;
+	DirectX::XMUINT2 m_viewport;
+	DirectX::XMUINT2 m_renderSize;
+	DirectX::XMUINT3 m_occupancySize;
+	DirectX::XMUINT3 m_lightSize;
+	uint32_t m_lightStamp;
+	uint32_t m_numResolved;
+	float m_renderScale;
+	Kernel m_kernel;
+
+	std::vector<DirectX::XMFLOAT4> m_image;
+	std::vector<DirectX::XMFLOAT4> m_history[2];
+	std::vector<float> m_depths;
+	std::vector<float> m_occupancy;
+	std::vector<float> m_lightTrans;
+	std::vector<float> m_lightDensities;	// Densities as of the last stamps
+	std::vector<uint32_t> m_lightStamps;	// Update index of the last change per cell
+	std::vector<uint32_t> m_tileSamples;
+	std::vector<std::vector<DirectX::XMFLOAT4>> m_mips;	// From level 1
+	std::vector<DirectX::XMUINT3> m_mipSizes;
+};
@@ -7,10 +7,9 @@
 //--------------------------------------------------------------------------------------
 // Constants
 //--------------------------------------------------------------------------------------
-static const float3	g_extForce = float3(0.0, -48.0, 0.0);
 static const float	g_forceScl3D = 4.0;
-static const float	g_vortScl = 200.0;
 static const float	g_dissipation = 0.1;
+static const float	g_vorticityScl = 0.35;
 
 //--------------------------------------------------------------------------------------
 // Textures
@@ -20,6 +19,11 @@ RWTexture3D<float4>	g_rwColor;
 
 Texture3D<float3>	g_txVelocity;
 Texture3D			g_txColor;
+Texture3D<float4>	g_txVorticity	: register (t5);
+#ifdef HYBRID
+Texture3D<float4>	g_txTransfer	: register (t6);
+RWTexture3D<float3> g_rwGridVelocity : register (u2);
+#endif
 
 //--------------------------------------------------------------------------------------
 // Sampler
@@ -42,6 +46,32 @@ float Gaussian(float3 disp, float r)
 	return exp(-4.0 * dot(disp, disp) / (r * r));
 }
 
+//--------------------------------------------------------------------------------------
+// Vorticity confinement force, with the curl in cell units
+//--------------------------------------------------------------------------------------
+float3 VorticityConfinement(uint3 cell, uint3 gridSize)
+{
+	const uint3 cellMin = max(cell, 1) - 1;
+	const uint3 cellMax = min(cell + 1, gridSize - 1);
+	const float wL = g_txVorticity[uint3(cellMin.x, cell.yz)].w;
+	const float wR = g_txVorticity[uint3(cellMax.x, cell.yz)].w;
+	const float wU = g_txVorticity[uint3(cell.x, cellMin.y, cell.z)].w;
+	const float wD = g_txVorticity[uint3(cell.x, cellMax.y, cell.z)].w;
+	const float wF = g_txVorticity[uint3(cell.xy, cellMin.z)].w;
+	const float wB = g_txVorticity[uint3(cell.xy, cellMax.z)].w;
+
+	// N = normalize(grad |w|), f = eps * h * (N x w)
+	const float3 eta = float3(wR - wL, wD - wU, wB - wF);
+	const float lenSq = dot(eta, eta);
+	if (lenSq < 1e-12) return 0.0;
+
+	// In 2D, N x w with the scalar curl w_z alone: eps * h * (N.y, -N.x) * w_z
+	const float3 n = eta * rsqrt(lenSq);
+	const float4 w = g_txVorticity[cell];
+
+	return g_vorticityScl * (gridSize.z > 1 ? cross(n, w.xyz) : float3(n.y, -n.x, 0.0) * w.z);
+}
+
 //--------------------------------------------------------------------------------------
 // Compute shader of advection
 //--------------------------------------------------------------------------------------
@@ -60,17 +90,34 @@ void main(uint3 DTid : SV_DispatchThreadID)
 	u = g_txVelocity.SampleLevel(g_smpLinear, adv, 0.0);
 	float4 color = g_txColor.SampleLevel(g_smpLinear, adv, 0.0);
 
-	// Impulse
-	const float3 disp = pos - g_impulsePos;
-	float basis = Gaussian(disp, g_impulseR);
-	if (basis >= exp(-4.0))
+#ifdef HYBRID
+	// Velocity carried by the particles, with the semi-Lagrangian advection filling the sparse cells
+	const float4 transfer = g_txTransfer[DTid];
+	u = lerp(u, transfer.xyz, saturate(transfer.w));
+
+	// The FLIP delta is taken against the grid velocity right after the transfer, so that the
+	// forces below and the projection reach the particles
+	g_rwGridVelocity[DTid] = u;
+#endif
+
+	// Vorticity confinement
+	u += VorticityConfinement(DTid, uint3(gridSize)) * timeStep;
+
+	// Impulses of the emitters overlapping the brick
+	const uint2 range = GetBrickEmitterRange(DTid, uint3(gridSize));
+	for (uint i = 0; i < range.y; ++i)
 	{
-		//basis = sqrt(basis) * 0.4;
-		const float3 vortForce = float3(-disp.z, 0.0, disp.x) * g_vortScl;
-		float3 extForce = g_extForce * basis;
-		extForce = gridSize.z > 1 ? extForce * g_forceScl3D + vortForce : extForce;
-		u += extForce * timeStep;
-		color += g_impulse * timeStep * basis;
+		const Emitter emitter = g_emitters[g_emitterIndices[range.x + i]];
+		const float3 disp = pos - emitter.Pos;
+		const float basis = Gaussian(disp, emitter.Radius);
+		if (basis >= exp(-4.0))
+		{
+			const float3 swirlForce = float3(-disp.z, 0.0, disp.x) * emitter.Swirl;
+			float3 extForce = emitter.Force * basis;
+			extForce = gridSize.z > 1 ? extForce * g_forceScl3D + swirlForce : extForce;
+			u += extForce * timeStep;
+			color += emitter.Color * timeStep * basis;
+		}
 	}
 
 	// Output
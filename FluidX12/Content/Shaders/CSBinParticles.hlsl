@@ -0,0 +1,42 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Transfer.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Compute shader of scattering the particle IDs into the bins of the overlapped bricks
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	uint numAlive;
+	const uint numThreads = GetNumAliveThreads(numAlive);
+	const uint numBricks = GetNumBricks();
+
+	for (uint i = DTid; i < numAlive; i += numThreads)
+	{
+		const uint particleId = g_roAliveList[i];
+		const Particle particle = UnpackParticle(g_roParticles[particleId]);
+		if (IsFresh(particle)) continue;
+
+		const Support support = GetSupport(particle.Pos);
+		const uint3 brickMin = support.Cell0 / TRANSFER_BRICK_SIZE;
+		const uint3 brickMax = support.Cell1 / TRANSFER_BRICK_SIZE;
+		for (uint z = brickMin.z; z <= brickMax.z; ++z)
+		{
+			for (uint y = brickMin.y; y <= brickMax.y; ++y)
+			{
+				for (uint x = brickMin.x; x <= brickMax.x; ++x)
+				{
+					// Count down to the slot in the bin, which also leaves the counts zeroed
+					// for the next step
+					const uint brick = GetBrickIndex(uint3(x, y, z));
+					uint count;
+					g_rwBins.InterlockedAdd(brick * 4, 0xffffffff, count);
+					g_rwBinned[g_rwBins.Load((numBricks + brick) * 4) + count - 1] = particleId;
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,32 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Reorder.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbSort
+{
+	uint	g_k;	// Size of the bitonic blocks being merged
+	uint	g_j;	// Distance of the compared pairs, at least the chunk size
+};
+
+//--------------------------------------------------------------------------------------
+// Compute shader of a bitonic merge step across the chunks
+//--------------------------------------------------------------------------------------
+[numthreads(SORT_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	const uint i = BitonicPairIndex(DTid, g_j);
+	const uint2 a = g_rwSortBuffer[i];
+	const uint2 b = g_rwSortBuffer[i | g_j];
+
+	const bool ascending = (i & g_k) == 0;
+	if ((a.x > b.x) == ascending)
+	{
+		g_rwSortBuffer[i] = b;
+		g_rwSortBuffer[i | g_j] = a;
+	}
+}
@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Reorder.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbSort
+{
+	uint	g_k;	// Size of the bitonic blocks being merged
+};
+
+//--------------------------------------------------------------------------------------
+// Compute shader of the remaining bitonic merge steps within each chunk
+//--------------------------------------------------------------------------------------
+[numthreads(SORT_GROUP_SIZE, 1, 1)]
+void main(uint GTid : SV_GroupThreadID, uint Gid : SV_GroupID)
+{
+	const uint chunkBase = Gid * SORT_CHUNK_SIZE;
+
+	LoadChunk(GTid, chunkBase);
+	BitonicMergeShared(GTid, chunkBase, g_k, SORT_GROUP_SIZE);
+	StoreChunk(GTid, chunkBase);
+}
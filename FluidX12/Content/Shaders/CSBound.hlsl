@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Occupancy.hlsli"
+
+#define GROUP_SIZE		256
+#define ZERO_THRESHOLD	0.01	// Matching PSRayCast
+
+//--------------------------------------------------------------------------------------
+// Constant buffer
+//--------------------------------------------------------------------------------------
+cbuffer cbBound
+{
+	uint3	g_gridSize;	// Of the rendered volume
+};
+
+//--------------------------------------------------------------------------------------
+// Texture
+//--------------------------------------------------------------------------------------
+Texture3D<float>	g_txOccupancy;
+
+//--------------------------------------------------------------------------------------
+// Buffer
+//--------------------------------------------------------------------------------------
+RWByteAddressBuffer	g_rwBound;
+
+groupshared uint g_minCell[3];
+groupshared uint g_maxCell[3];
+
+//--------------------------------------------------------------------------------------
+// Compute shader of the bound of the occupied macro-cells, with a single group
+//--------------------------------------------------------------------------------------
+[numthreads(GROUP_SIZE, 1, 1)]
+void main(uint GIdx : SV_GroupIndex)
+{
+	if (GIdx < 3)
+	{
+		g_minCell[GIdx] = 0xffffffff;
+		g_maxCell[GIdx] = 0;
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	uint3 occupancySize;
+	g_txOccupancy.GetDimensions(occupancySize.x, occupancySize.y, occupancySize.z);
+
+	// Bound of the macro-cells of the thread, with the maximum exclusive
+	uint3 minCell = 0xffffffff, maxCell = 0;
+	const uint numMacroCells = occupancySize.x * occupancySize.y * occupancySize.z;
+	for (uint i = GIdx; i < numMacroCells; i += GROUP_SIZE)
+	{
+		const uint3 macroCell = uint3(i % occupancySize.x, i / occupancySize.x % occupancySize.y,
+			i / (occupancySize.x * occupancySize.y));
+		if (g_txOccupancy[macroCell] * 24.0 > ZERO_THRESHOLD)
+		{
+			minCell = min(minCell, macroCell);
+			maxCell = max(maxCell, macroCell + 1);
+		}
+	}
+
+	[unroll]
+	for (uint j = 0; j < 3; ++j)
+	{
+		InterlockedMin(g_minCell[j], minCell[j]);
+		InterlockedMax(g_maxCell[j], maxCell[j]);
+	}
+	GroupMemoryBarrierWithGroupSync();
+
+	if (GIdx == 0)
+	{
+		// From the texture space to the local space
+		float3 boundMin = 1.0, boundMax = -1.0;
+		if (g_maxCell[0] > 0)
+		{
+			const float3 texMin = float3(g_minCell[0], g_minCell[1], g_minCell[2]) * MACRO_CELL_SIZE / g_gridSize;
+			const float3 texMax = min(float3(g_maxCell[0], g_maxCell[1], g_maxCell[2]) * MACRO_CELL_SIZE / g_gridSize, 1.0);
+			boundMin = float3(texMin.x * 2.0 - 1.0, 1.0 - texMax.y * 2.0, texMin.z * 2.0 - 1.0);
+			boundMax = float3(texMax.x * 2.0 - 1.0, 1.0 - texMin.y * 2.0, texMax.z * 2.0 - 1.0);
+		}
+
+		g_rwBound.Store3(BOUND_MIN, asuint(boundMin));
+		g_rwBound.Store3(BOUND_MAX, asuint(boundMax));
+	}
+}
@@ -0,0 +1,30 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Transfer.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Compute shader of counting the particles per brick overlapped by their trilinear support
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	uint numAlive;
+	const uint numThreads = GetNumAliveThreads(numAlive);
+
+	for (uint i = DTid; i < numAlive; i += numThreads)
+	{
+		const Particle particle = UnpackParticle(g_roParticles[g_roAliveList[i]]);
+		if (IsFresh(particle)) continue;
+
+		// At most 2 bricks per axis
+		const Support support = GetSupport(particle.Pos);
+		const uint3 brickMin = support.Cell0 / TRANSFER_BRICK_SIZE;
+		const uint3 brickMax = support.Cell1 / TRANSFER_BRICK_SIZE;
+		for (uint z = brickMin.z; z <= brickMax.z; ++z)
+			for (uint y = brickMin.y; y <= brickMax.y; ++y)
+				for (uint x = brickMin.x; x <= brickMax.x; ++x)
+					g_rwBins.InterlockedAdd(GetBrickIndex(uint3(x, y, z)) * 4, 1);
+	}
+}
@@ -0,0 +1,83 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Impulse.hlsli"
+#include "Particle.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbPerObject : register (b1)
+{
+	float4x3 g_worldView;
+	float4x3 g_worldViewI;
+	matrix g_proj;
+};
+
+cbuffer cbCull : register (b2)
+{
+	uint	g_parity;		// Index of the alive list to draw
+	float	g_lodDistance;	// View depth beyond which the particles are thinned
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+StructuredBuffer<uint>		g_roAliveList	: register (t0);
+StructuredBuffer<uint4>		g_roParticles	: register (t1);
+
+RWStructuredBuffer<uint2>	g_rwVisibleList	: register (u0);	// Particle ID and radius scale
+RWByteAddressBuffer			g_rwCounters	: register (u1);
+
+//--------------------------------------------------------------------------------------
+// Integer hash of the particle ID, for the stable thinning of the distant particles
+//--------------------------------------------------------------------------------------
+uint HashId(uint id)
+{
+	const uint state = id * 747796405u + 2891336453u;
+	const uint word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+
+	return (word >> 22) ^ word;
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader of particle frustum culling and distance-based thinning, per rendered frame
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	// The indirect dispatch of the particle update is bounded by the same alive count
+	const uint numAlive = g_rwCounters.Load(ALIVE_COUNT(g_parity));
+	const uint numGroups = min((numAlive + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, MAX_PARTICLE_GROUPS);
+	const uint numThreads = numGroups * PARTICLE_GROUP_SIZE;
+
+	for (uint i = DTid; i < numAlive; i += numThreads)
+	{
+		const uint particleId = g_roAliveList[i];
+		const Particle particle = UnpackParticle(g_roParticles[particleId]);
+
+		// Object position at the rendered time, as in VSParticle
+		float3 pos = particle.Pos + particle.Velocity * g_renderTimeOffset;
+		pos = pos * 2.0 - 1.0;
+		pos.y = -pos.y;
+		pos = mul(float4(pos, 1.0), g_worldView);
+		const float4 clipPos = mul(float4(pos, 1.0), g_proj);
+
+		// Keep a fraction of the particles falling off with the squared distance, and enlarge
+		// them to keep the covered area, so that the distant ones merge into fewer sprites
+		const float keep = clipPos.w > g_lodDistance ? g_lodDistance / clipPos.w : 1.0;
+		if ((HashId(particleId) >> 8) * (1.0 / 16777216.0) >= keep * keep) continue;
+		const float radiusScale = 1.0 / keep;
+
+		// Frustum test of the billboard quad, whose extent in clip space is the view-space
+		// radius scaled by the projection
+		const float2 extent = PARTICLE_RADIUS * radiusScale * float2(g_proj[0][0], g_proj[1][1]);
+		if (clipPos.w <= 0.0 || clipPos.z < 0.0 || clipPos.z > clipPos.w) continue;
+		if (any(abs(clipPos.xy) > clipPos.w + extent)) continue;
+
+		uint slot;
+		g_rwCounters.InterlockedAdd(VISIBLE_COUNT, 1, slot);
+		g_rwVisibleList[slot] = uint2(particleId, asuint(radiusScale));
+	}
+}
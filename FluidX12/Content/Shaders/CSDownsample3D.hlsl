@@ -0,0 +1,34 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Texture of the previous level
+//--------------------------------------------------------------------------------------
+Texture3D<float4>	g_txSource;
+
+//--------------------------------------------------------------------------------------
+// Unordered access texture of the current level
+//--------------------------------------------------------------------------------------
+RWTexture3D<float4>	g_rwDest;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of one mip level of the rendered volume, for the adaptive sampling
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint3 srcSize, dstSize;
+	g_txSource.GetDimensions(srcSize.x, srcSize.y, srcSize.z);
+	g_rwDest.GetDimensions(dstSize.x, dstSize.y, dstSize.z);
+	if (any(DTid >= dstSize)) return;
+
+	// Average of the 2x2x2 texels, clamped at the odd edges
+	const uint3 src = DTid * 2;
+	float4 sum = 0.0;
+	[unroll]
+	for (uint i = 0; i < 8; ++i)
+		sum += g_txSource[min(src + uint3(i & 1, (i >> 1) & 1, i >> 2), srcSize - 1)];
+
+	g_rwDest[DTid] = sum / 8.0;
+}
@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Impulse.hlsli"
+#include "Particle.hlsli"
+#include "Philox.hlsli"
+
+#define PI 3.1415926535897
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbEmission : register (b1)
+{
+	uint	g_parity;	// Index of the alive list being written
+	uint	g_budget;	// Particles to emit in this step
+	uint	g_is3D;
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint4>	g_rwParticles;
+RWStructuredBuffer<uint>	g_rwDeadList;
+RWStructuredBuffer<uint>	g_rwAliveList;
+RWByteAddressBuffer			g_rwCounters;
+
+//--------------------------------------------------------------------------------------
+// Common particle emission
+//--------------------------------------------------------------------------------------
+void Emit(uint emissionId, inout Particle particle, bool is3D)
+{
+	// Independent draws per emission and simulation step, reproducible for the same seed;
+	// a single block, with the lifetime from the low bytes of the position draws
+	const uint2 key = { g_seed, 0 };
+	const uint4 rands = Philox(uint4(emissionId, g_step, 0, STREAM_EMISSION), key);
+
+	// Load emitter with a random index
+	const Emitter emitter = g_emitters[g_numEmitters > 1 ? rands.x % g_numEmitters : 0];
+	const float r = emitter.Radius * RandToFloat(rands.y);
+	const float t = RandToFloat(rands.z);
+	const float theta = t * 2.0 * PI;
+	float3 sphere;
+	sphere.x = r * cos(theta);
+	sphere.y = r * sin(theta);
+	sphere.z = 0.0;
+
+	if (is3D)
+	{
+		const float s = RandToFloat(rands.w);
+		const float phi = s * PI;
+		sphere.xy *= sin(phi);
+		sphere.z = r * cos(phi);
+	}
+
+	// Particle emission
+	particle.Pos = emitter.Pos + sphere;
+	particle.Velocity = 0.0;
+	particle.LifeTime = g_fullLife + RandLowBytesToFloat(rands.yzw);
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader of budgeted particle emission from the dead list
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	if (DTid >= g_budget || g_numEmitters < 1) return;
+
+	// Pop a dead particle, giving the slot back if the list has run out
+	uint count;
+	g_rwCounters.InterlockedAdd(DEAD_COUNT, 0xffffffff, count);
+	const int numDead = asint(count);
+	if (numDead < 1)
+	{
+		g_rwCounters.InterlockedAdd(DEAD_COUNT, 1);
+		return;
+	}
+
+	const uint particleId = g_rwDeadList[numDead - 1];
+	Particle particle;
+	Emit(DTid, particle, g_is3D);
+	g_rwParticles[particleId] = PackParticle(particle);
+
+	// Append to the alive list
+	uint slot;
+	g_rwCounters.InterlockedAdd(ALIVE_COUNT(g_parity), 1, slot);
+	g_rwAliveList[slot] = particleId;
+}
@@ -0,0 +1,172 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define BLOCK_SIZE		4
+#define BLOCK_TEXELS	(BLOCK_SIZE * BLOCK_SIZE)
+#define BC6H_MODE		0x03	// Single region with 10-bit endpoints and 4-bit indices
+#define MAX_HALF		65504.0
+
+//--------------------------------------------------------------------------------------
+// Texture
+//--------------------------------------------------------------------------------------
+Texture3D			g_txSource;			// A level of the rendered volume
+
+//--------------------------------------------------------------------------------------
+// Unordered access textures, copied into the BC6H and BC4 levels of the same blocks
+//--------------------------------------------------------------------------------------
+RWTexture3D<uint4>	g_rwColorBlocks;
+RWTexture3D<uint2>	g_rwDensityBlocks;
+
+//--------------------------------------------------------------------------------------
+// BC6H endpoint quantization to 10 bits, and the half-float bits it decodes to
+//--------------------------------------------------------------------------------------
+uint3 QuantizeBC6H(uint3 halfBits)
+{
+	return min(halfBits / 31, 1023);
+}
+
+float3 UnquantizeBC6H(uint3 comp)
+{
+	const uint3 unquantized = comp == 0 ? 0 : (comp == 1023 ? 0xffff : ((comp << 16) + 0x8000) >> 10);
+
+	return (unquantized * 31) >> 6;
+}
+
+//--------------------------------------------------------------------------------------
+// Append the bits of the value to the block, across the 32-bit words
+//--------------------------------------------------------------------------------------
+void WriteBits(inout uint4 bits, inout uint offset, uint value, uint numBits)
+{
+	const uint word = offset >> 5;
+	const uint shift = offset & 31;
+	bits[word] |= value << shift;
+	if (shift + numBits > 32) bits[word + 1] |= value >> (32 - shift);
+	offset += numBits;
+}
+
+//--------------------------------------------------------------------------------------
+// BC6H block of the unsigned half-float colors, as BlockCompressor::EncodeBC6H
+//--------------------------------------------------------------------------------------
+uint4 EncodeBC6H(float3 colors[BLOCK_TEXELS])
+{
+	// Bounding box in the half-float bits, which are interpolated linearly; its diagonal runs along
+	// the channel of the widest range, with each other channel reversed if it decreases along it
+	uint3 texels[BLOCK_TEXELS];
+	uint3 boundMin = 0xffffffff, boundMax = 0;
+	float3 mean = 0.0;
+	[unroll]
+	for (uint i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		texels[i] = f32tof16(clamp(colors[i], 0.0, MAX_HALF));
+		boundMin = min(boundMin, texels[i]);
+		boundMax = max(boundMax, texels[i]);
+		mean += texels[i] / float(BLOCK_TEXELS);
+	}
+
+	const uint3 range = boundMax - boundMin;
+	const uint axis = range.y > range.x ? (range.z > range.y ? 2 : 1) : (range.z > range.x ? 2 : 0);
+
+	float3 covariance = 0.0;
+	[unroll]
+	for (i = 0; i < BLOCK_TEXELS; ++i) covariance += (texels[i] - mean) * (texels[i][axis] - mean[axis]);
+	const bool3 isReversed = covariance < 0.0;
+
+	// Quantize the endpoints, and project the texels onto the line between them for their indices
+	uint3 comps[2];
+	comps[0] = QuantizeBC6H(isReversed ? boundMax : boundMin);
+	comps[1] = QuantizeBC6H(isReversed ? boundMin : boundMax);
+	const float3 lineStart = UnquantizeBC6H(comps[0]);
+	const float3 dir = UnquantizeBC6H(comps[1]) - lineStart;
+	const float lengthSq = dot(dir, dir);
+
+	uint indices[BLOCK_TEXELS];
+	[unroll]
+	for (i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		const float t = lengthSq > 0.0 ? dot(texels[i] - lineStart, dir) / lengthSq : 0.0;
+		indices[i] = uint(clamp(t * 15.0 + 0.5, 0.0, 15.0));
+	}
+
+	// The anchor index of the first texel has its top bit implied as zero
+	const bool isSwapped = indices[0] >= 8;
+	uint4 bits = 0;
+	uint offset = 0;
+	WriteBits(bits, offset, BC6H_MODE, 5);
+	[unroll]
+	for (uint j = 0; j < 2; ++j)
+	{
+		const uint3 comp = comps[isSwapped ? 1 - j : j];
+		[unroll]
+		for (uint c = 0; c < 3; ++c) WriteBits(bits, offset, comp[c], 10);
+	}
+
+	[unroll]
+	for (i = 0; i < BLOCK_TEXELS; ++i)
+		WriteBits(bits, offset, isSwapped ? 15 - indices[i] : indices[i], i ? 4 : 3);
+
+	return bits;
+}
+
+//--------------------------------------------------------------------------------------
+// BC4 block of the saturated densities, as BlockCompressor::EncodeBC4
+//--------------------------------------------------------------------------------------
+uint2 EncodeBC4(float densities[BLOCK_TEXELS])
+{
+	// The maximum as the first endpoint for the 8-value palette, unless the block is uniform
+	float minValue = 1.0, maxValue = 0.0;
+	[unroll]
+	for (uint i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		minValue = min(minValue, saturate(densities[i]));
+		maxValue = max(maxValue, saturate(densities[i]));
+	}
+
+	const uint red0 = uint(maxValue * 255.0 + 0.5);
+	const uint red1 = uint(minValue * 255.0 + 0.5);
+	uint2 bits = uint2(red0 | (red1 << 8), 0);
+	if (red0 > red1)
+	{
+		// Steps from the first endpoint, where the palette holds the second endpoint at 1
+		[unroll]
+		for (i = 0; i < BLOCK_TEXELS; ++i)
+		{
+			const float t = saturate((saturate(densities[i]) * 255.0 - red1) / (red0 - red1));
+			const uint step = uint((1.0 - t) * 7.0 + 0.5);
+			const uint index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+			const uint offset = 16 + 3 * i;
+			bits[offset >> 5] |= index << (offset & 31);
+			if ((offset & 31) > 29) bits.y |= index >> (32 - (offset & 31));
+		}
+	}
+
+	return bits;
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader of one 4x4 block per thread, with the texels beyond the edges clamped
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint3 numBlocks;
+	g_rwColorBlocks.GetDimensions(numBlocks.x, numBlocks.y, numBlocks.z);
+	if (any(DTid >= numBlocks)) return;
+
+	uint3 gridSize;
+	g_txSource.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	float3 colors[BLOCK_TEXELS];
+	float densities[BLOCK_TEXELS];
+	[unroll]
+	for (uint i = 0; i < BLOCK_TEXELS; ++i)
+	{
+		const uint2 xy = DTid.xy * BLOCK_SIZE + uint2(i % BLOCK_SIZE, i / BLOCK_SIZE);
+		const float4 texel = g_txSource[min(uint3(xy, DTid.z), gridSize - 1)];
+		colors[i] = texel.xyz;
+		densities[i] = texel.w;
+	}
+
+	g_rwColorBlocks[DTid] = EncodeBC6H(colors);
+	g_rwDensityBlocks[DTid] = EncodeBC4(densities);
+}
@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D			g_txColor;
+
+RWTexture3D<float4>	g_rwNormal;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of the density gradient, packed into the shading normal volume
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint3 gridSize;
+	g_txColor.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	// Neighbor cells
+	const uint3 cellMin = max(DTid, 1) - 1;
+	const uint3 cellMax = min(DTid + 1, gridSize - 1);
+	const float rhoL = g_txColor[uint3(cellMin.x, DTid.yz)].w;
+	const float rhoR = g_txColor[uint3(cellMax.x, DTid.yz)].w;
+	const float rhoU = g_txColor[uint3(DTid.x, cellMin.y, DTid.z)].w;
+	const float rhoD = g_txColor[uint3(DTid.x, cellMax.y, DTid.z)].w;
+	const float rhoF = g_txColor[uint3(DTid.xy, cellMin.z)].w;
+	const float rhoB = g_txColor[uint3(DTid.xy, cellMax.z)].w;
+
+	// Central differences, the same as the half-texel linear taps at the cell center
+	float3 gradient = float3(rhoR - rhoL, rhoD - rhoU, rhoB - rhoF) * 0.5;
+	const float magnitude = length(gradient);
+	gradient.z = gridSize.z > 1 ? gradient.z : -1.0;
+
+	// Normal facing down the gradient, and the gradient magnitude in the alpha channel
+	const float3 normal = any(gradient != 0.0) ? normalize(-gradient) : 0.0;
+	g_rwNormal[DTid] = float4(normal, saturate(magnitude));
+}
@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Particle.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbParticle
+{
+	uint	g_numParticles;
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers, bound in the same table as for the update and emission
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint>	g_rwDeadList	: register (u1);
+RWByteAddressBuffer			g_rwCounters	: register (u3);
+
+//--------------------------------------------------------------------------------------
+// Compute shader of particle list initialization, in place of a host-side upload
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	// All particles start in the dead list, and are emitted by the per-step budget
+	const uint numGroups = min((g_numParticles + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, MAX_PARTICLE_GROUPS);
+	const uint numThreads = numGroups * PARTICLE_GROUP_SIZE;
+	for (uint i = DTid; i < g_numParticles; i += numThreads) g_rwDeadList[i] = i;
+
+	if (DTid == 0) g_rwCounters.Store4(DEAD_COUNT, uint4(g_numParticles, 0, 0, 0));
+}
@@ -0,0 +1,47 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbPerFrame
+{
+	float	g_interpFactor;	// Elapsed fraction of the simulation step
+	float	g_timeStep;		// Fixed simulation step
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D<float3>	g_txVelocity;
+Texture3D			g_txColor;		// Latest simulated state
+Texture3D			g_txColorPrev;	// Previous simulated state
+
+RWTexture3D<float4>	g_rwColor;
+
+//--------------------------------------------------------------------------------------
+// Sampler
+//--------------------------------------------------------------------------------------
+SamplerState g_smpLinear;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of temporal interpolation between two simulated states
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	float3 gridSize;
+	g_txVelocity.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	const float3 u = g_txVelocity[DTid];
+	const float3 pos = (DTid + 0.5) / gridSize;
+
+	// Velocity-guided: carry the previous state forward by t and the latest state
+	// backward by (1 - t) along the flow, then blend; with u = 0 this is a plain blend
+	const float t = g_interpFactor;
+	const float4 prev = g_txColorPrev.SampleLevel(g_smpLinear, pos - u * (t * g_timeStep), 0.0);
+	const float4 next = g_txColor.SampleLevel(g_smpLinear, pos + u * ((1.0 - t) * g_timeStep), 0.0);
+
+	g_rwColor[DTid] = lerp(prev, next, t);
+}
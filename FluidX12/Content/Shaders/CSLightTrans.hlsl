@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define ABSORPTION			1.0
+#define DENSITY_SCALE		24.0
+#define LIGHT_TOLERANCE		(1.0 / 1024.0)	// Attenuation change kept as unchanged
+
+//--------------------------------------------------------------------------------------
+// Constants, matching RayCasterCPU::LightSweep
+//--------------------------------------------------------------------------------------
+cbuffer cbLightSweep
+{
+	float3	g_cellOffset;	// From a cell to the previous slice toward the light, in cells
+	float	g_stepScale;	// Length of the offset in local space
+	uint	g_axis;
+	uint	g_slice;
+	uint	g_stamp;		// Index of this update
+	uint	g_force;		// Recompute all cells
+};
+
+//--------------------------------------------------------------------------------------
+// Texture
+//--------------------------------------------------------------------------------------
+Texture3D<float4>	g_txGrid;
+
+//--------------------------------------------------------------------------------------
+// Unordered access textures
+//--------------------------------------------------------------------------------------
+RWTexture3D<float>	g_rwLightTrans;
+RWTexture3D<float>	g_rwDensities;	// Densities as of the last stamps
+RWTexture3D<uint>	g_rwStamps;		// Update index of the last change per cell
+
+//--------------------------------------------------------------------------------------
+// Compute shader of one slice of the light transmittance sweep from the directional
+// light, attenuating the transmittance bilinearly sampled from the previous slice
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint2 DTid : SV_DispatchThreadID)
+{
+	uint3 gridSize;
+	g_txGrid.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	// Lateral axes of the slice
+	const uint3 axisB = g_axis == 0 ? uint3(0, 1, 0) : uint3(1, 0, 0);
+	const uint3 axisC = g_axis == 2 ? uint3(0, 1, 0) : uint3(0, 0, 1);
+	const uint3 axisA = 1 - axisB - axisC;
+	const uint3 cell = axisA * g_slice + axisB * DTid.x + axisC * DTid.y;
+	if (any(cell >= gridSize)) return;
+
+	// Stamp the density change of the cell for the next slice, against the density last stamped,
+	// so that the changes within the tolerance cannot accumulate
+	const float density = min(g_txGrid[cell].w * DENSITY_SCALE, DENSITY_SCALE);
+	if (g_force || abs(density - g_rwDensities[cell]) > LIGHT_TOLERANCE / (ABSORPTION * g_stepScale))
+	{
+		g_rwDensities[cell] = density;
+		g_rwStamps[cell] = g_stamp;
+	}
+
+	// The previous slice position toward the light; the light enters the grid there if outside
+	const float3 pos = cell + g_cellOffset;
+	const float prevSlice = dot(pos, axisA);
+	const float2 posBC = float2(dot(pos, axisB), dot(pos, axisC));
+	const float2 sizeBC = float2(dot(gridSize, axisB), dot(gridSize, axisC));
+	if (prevSlice < 0.0 || prevSlice >= dot(gridSize, axisA) || any(posBC < -0.5) || any(posBC > sizeBC - 0.5))
+	{
+		if (g_force) g_rwLightTrans[cell] = 1.0;
+		return;
+	}
+
+	// Bilinear footprint in the previous slice
+	const float2 base = floor(posBC);
+	const float2 w = posBC - base;
+	uint3 footprint[4];
+	float weights[4];
+	bool isDirty = g_force;
+
+	[unroll]
+	for (uint i = 0; i < 4; ++i)
+	{
+		const uint2 bc = clamp(int2(base) + int2(i & 1, i >> 1), 0, int2(sizeBC) - 1);
+		footprint[i] = axisA * uint(prevSlice) + axisB * bc.x + axisC * bc.y;
+		weights[i] = ((i & 1) ? w.x : 1.0 - w.x) * ((i >> 1) ? w.y : 1.0 - w.y);
+
+		// Recompute only if the density or the transmittance has changed over the footprint
+		isDirty = isDirty || (weights[i] > 0.0 && g_rwStamps[footprint[i]] == g_stamp);
+	}
+	if (!isDirty) return;
+
+	float footprintDensity = 0.0, lightTrans = 0.0;
+
+	[unroll]
+	for (uint j = 0; j < 4; ++j)
+	{
+		footprintDensity += weights[j] * g_txGrid[footprint[j]].w;
+		lightTrans += weights[j] * g_rwLightTrans[footprint[j]];
+	}
+	footprintDensity = min(footprintDensity * DENSITY_SCALE, DENSITY_SCALE);
+
+	g_rwLightTrans[cell] = lightTrans * saturate(1.0 - ABSORPTION * g_stepScale * footprintDensity);
+	g_rwStamps[cell] = g_stamp;
+}
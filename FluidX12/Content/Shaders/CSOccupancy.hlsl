@@ -0,0 +1,48 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Occupancy.hlsli"
+
+#define APRON_SIZE	(MACRO_CELL_SIZE + 2)
+
+//--------------------------------------------------------------------------------------
+// Texture
+//--------------------------------------------------------------------------------------
+Texture3D<float4>	g_txGrid;
+
+//--------------------------------------------------------------------------------------
+// Unordered access texture
+//--------------------------------------------------------------------------------------
+RWTexture3D<float>	g_rwOccupancy;
+
+groupshared uint g_maxDensity;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of the occupancy grid, with one group per macro-cell
+//--------------------------------------------------------------------------------------
+[numthreads(MACRO_CELL_SIZE, MACRO_CELL_SIZE, MACRO_CELL_SIZE)]
+void main(uint3 Gid : SV_GroupID, uint GIdx : SV_GroupIndex)
+{
+	if (GIdx == 0) g_maxDensity = 0;
+	GroupMemoryBarrierWithGroupSync();
+
+	int3 gridSize;
+	g_txGrid.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	// The cells of the macro-cell with the 1-cell apron, which the trilinear samples
+	// within the macro-cell reach
+	const int3 first = int3(Gid * MACRO_CELL_SIZE) - 1;
+	float maxDensity = 0.0;
+	for (uint i = GIdx; i < APRON_SIZE * APRON_SIZE * APRON_SIZE; i += MACRO_CELL_SIZE * MACRO_CELL_SIZE * MACRO_CELL_SIZE)
+	{
+		const int3 cell = first + int3(i % APRON_SIZE, i / APRON_SIZE % APRON_SIZE, i / (APRON_SIZE * APRON_SIZE));
+		maxDensity = max(maxDensity, g_txGrid[clamp(cell, 0, gridSize - 1)].w);
+	}
+
+	// Non-negative floats order the same as their bits
+	InterlockedMax(g_maxDensity, asuint(maxDensity));
+	GroupMemoryBarrierWithGroupSync();
+
+	if (GIdx == 0) g_rwOccupancy[Gid] = asfloat(g_maxDensity);
+}
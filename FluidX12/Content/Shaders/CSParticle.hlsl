@@ -0,0 +1,109 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Impulse.hlsli"
+#include "Particle.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbParticle : register (b1)
+{
+	uint	g_parity;	// Index of the alive list being written
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers and textures
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint4>	g_rwParticles;
+RWStructuredBuffer<uint>	g_rwDeadList;
+RWStructuredBuffer<uint>	g_rwAliveList;
+RWByteAddressBuffer			g_rwCounters;
+
+StructuredBuffer<uint>		g_roAliveList;
+Texture3D<float3>			g_txVelocity;
+#ifdef HYBRID
+Texture3D<float3>			g_txGridVelocity	: register (t6);	// Right after the transfer of the step
+#endif
+
+//--------------------------------------------------------------------------------------
+// Sampler
+//--------------------------------------------------------------------------------------
+SamplerState g_smpLinear;
+
+//--------------------------------------------------------------------------------------
+// Displacement velocity over the step by the integrator, from the velocity sampled at
+// the start; the integrator is uniform over the dispatch
+//--------------------------------------------------------------------------------------
+float3 GetPathVelocity(float3 pos, float3 velocity, float3 gridSize)
+{
+	[branch]
+	if (g_integrator == INTEGRATOR_EULER) return velocity;
+
+	const float3 k2 = g_txVelocity.SampleLevel(g_smpLinear,
+		SimulationToTextureSpace(pos + 0.5 * g_timeStep * velocity, gridSize), 0.0);
+	[branch]
+	if (g_integrator == INTEGRATOR_RK2) return k2;
+
+	const float3 k3 = g_txVelocity.SampleLevel(g_smpLinear,
+		SimulationToTextureSpace(pos + 0.75 * g_timeStep * k2, gridSize), 0.0);
+
+	return (2.0 * velocity + 3.0 * k2 + 4.0 * k3) / 9.0;
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader of particle integration, once per simulation step over the alive list
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	// Get grid size
+	float3 gridSize;
+	g_txVelocity.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	// The indirect dispatch is bounded the same way by CSPrepareArgs
+	const uint numAlive = g_rwCounters.Load(ALIVE_COUNT(!g_parity));
+	const uint numGroups = min((numAlive + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, MAX_PARTICLE_GROUPS);
+	const uint numThreads = numGroups * PARTICLE_GROUP_SIZE;
+
+	// Strided over the bounded dispatch, so that the consecutive threads take consecutive
+	// list entries and keep the list accesses coalesced
+	for (uint i = DTid; i < numAlive; i += numThreads)
+	{
+		const uint particleId = g_roAliveList[i];
+		Particle particle = UnpackParticle(g_rwParticles[particleId]);
+
+		// Integrate and update particle
+		const float3 tex = SimulationToTextureSpace(particle.Pos, gridSize);
+		const float3 velocity = g_txVelocity.SampleLevel(g_smpLinear, tex, 0.0);
+#ifdef HYBRID
+		// FLIP update by the grid change since the transfer, blended with the PIC velocity;
+		// freshly emitted particles without a velocity take the grid velocity
+		const float3 change = velocity - g_txGridVelocity.SampleLevel(g_smpLinear, tex, 0.0);
+		const bool isFresh = all(particle.Velocity == 0.0);
+		particle.Velocity = isFresh ? velocity : lerp(velocity, particle.Velocity + change, g_flipRatio);
+#else
+		particle.Velocity = velocity;
+#endif
+		particle.Pos += GetPathVelocity(particle.Pos, velocity, gridSize) * g_timeStep;
+		particle.LifeTime -= g_timeStep;
+
+		// Particles leaving the simulation cube cannot be represented, so they are released
+		if (any(particle.Pos < 0.0) || any(particle.Pos > 1.0)) particle.LifeTime = 0.0;
+		g_rwParticles[particleId] = PackParticle(particle);
+
+		// Compact the survivors into the next alive list, and release the others
+		uint slot;
+		if (particle.LifeTime > 0.0)
+		{
+			g_rwCounters.InterlockedAdd(ALIVE_COUNT(g_parity), 1, slot);
+			g_rwAliveList[slot] = particleId;
+		}
+		else
+		{
+			g_rwCounters.InterlockedAdd(DEAD_COUNT, 1, slot);
+			g_rwDeadList[slot] = particleId;
+		}
+	}
+}
@@ -0,0 +1,66 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Transfer.hlsli"
+
+// Fixed-point sums of the weighted velocities and the weights, 4 per cell of the brick
+groupshared int g_sums[TRANSFER_BRICK_CELLS * 4];
+
+//--------------------------------------------------------------------------------------
+// Compute shader of the particle-to-grid velocity transfer of the hybrid solver, reducing
+// the binned particles of a brick in shared memory with one group per brick; the particles
+// carry no density or color of their own, which stay on the grid
+//--------------------------------------------------------------------------------------
+[numthreads(TRANSFER_BRICK_SIZE, TRANSFER_BRICK_SIZE, TRANSFER_BRICK_SIZE)]
+void main(uint3 DTid : SV_DispatchThreadID, uint3 Gid : SV_GroupID, uint GIdx : SV_GroupIndex)
+{
+	g_sums[GIdx * 4] = 0;
+	g_sums[GIdx * 4 + 1] = 0;
+	g_sums[GIdx * 4 + 2] = 0;
+	g_sums[GIdx * 4 + 3] = 0;
+	GroupMemoryBarrierWithGroupSync();
+
+	const uint numBricks = GetNumBricks();
+	const uint brick = GetBrickIndex(Gid);
+	const uint first = g_rwBins.Load((numBricks + brick) * 4);
+	const uint last = g_rwBins.Load((numBricks + brick + 1) * 4);
+	const int3 origin = Gid * TRANSFER_BRICK_SIZE;
+
+	for (uint i = first + GIdx; i < last; i += TRANSFER_BRICK_CELLS)
+	{
+		const Particle particle = UnpackParticle(g_roParticles[g_rwBinned[i]]);
+		const Support support = GetSupport(particle.Pos);
+		const float3 w0 = 1.0 - support.Weight1;
+
+		[unroll]
+		for (uint j = 0; j < 8; ++j)
+		{
+			// Only the cells within this brick, the others are reduced by the neighbor bricks
+			const bool3 upper = bool3(j & 1, (j >> 1) & 1, j >> 2);
+			const int3 cell = int3(upper ? support.Cell1 : support.Cell0) - origin;
+			if (any(cell < 0) || any(cell >= TRANSFER_BRICK_SIZE)) continue;
+
+			// Integer sums are independent of the order of the particles, with the velocity clamped
+			// as the bound of TRANSFER_MAX_SPEED keeps them from overflowing
+			const float3 w = upper ? support.Weight1 : w0;
+			const float weight = w.x * w.y * w.z;
+			const float3 velocity = clamp(particle.Velocity, -TRANSFER_MAX_SPEED, TRANSFER_MAX_SPEED);
+			const int4 value = int4(round(float4(velocity * weight, weight) * TRANSFER_QUANT));
+			const uint offset = ((cell.z * TRANSFER_BRICK_SIZE + cell.y) * TRANSFER_BRICK_SIZE + cell.x) * 4;
+			InterlockedAdd(g_sums[offset], value.x);
+			InterlockedAdd(g_sums[offset + 1], value.y);
+			InterlockedAdd(g_sums[offset + 2], value.z);
+			InterlockedAdd(g_sums[offset + 3], value.w);
+		}
+	}
+
+	GroupMemoryBarrierWithGroupSync();
+	if (any(DTid >= g_gridSize)) return;
+
+	// Averaged velocity, and the total weight of the particles for the blending with the grid,
+	// written once per cell without clearing
+	const uint offset = GIdx * 4;
+	const float4 sum = int4(g_sums[offset], g_sums[offset + 1], g_sums[offset + 2], g_sums[offset + 3]) / TRANSFER_QUANT;
+	g_rwTransfer[DTid] = sum.w > 0.0 ? float4(sum.xyz / sum.w, sum.w) : 0.0;
+}
@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Particle.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbParticle
+{
+	uint	g_parity;	// Index of the alive list just written
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+RWByteAddressBuffer	g_rwCounters;
+RWByteAddressBuffer	g_rwArgs;	// Dispatch arguments at 0, draw arguments at 12
+
+//--------------------------------------------------------------------------------------
+// Compute shader of preparing the indirect arguments from the alive count
+//--------------------------------------------------------------------------------------
+[numthreads(1, 1, 1)]
+void main()
+{
+	const uint numAlive = g_rwCounters.Load(ALIVE_COUNT(g_parity));
+
+	// The other list is written in the next step
+	g_rwCounters.Store(ALIVE_COUNT(!g_parity), 0);
+
+	// Update dispatch of the next step and of the culling, while the draw arguments
+	// are prepared from the culling per frame
+	const uint numGroups = (numAlive + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE;
+	g_rwArgs.Store3(0, uint3(min(numGroups, MAX_PARTICLE_GROUPS), 1, 1));
+}
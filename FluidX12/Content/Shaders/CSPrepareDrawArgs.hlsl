@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Particle.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+RWByteAddressBuffer	g_rwCounters;
+RWByteAddressBuffer	g_rwArgs;	// Dispatch arguments at 0, draw arguments at 12
+
+//--------------------------------------------------------------------------------------
+// Compute shader of preparing the indirect draw arguments from the visible count
+//--------------------------------------------------------------------------------------
+[numthreads(1, 1, 1)]
+void main()
+{
+	const uint numVisible = g_rwCounters.Load(VISIBLE_COUNT);
+
+	// Culled again in the next frame
+	g_rwCounters.Store(VISIBLE_COUNT, 0);
+
+	// Draw a 4-vertex quad instance per visible particle
+	g_rwArgs.Store4(12, uint4(4, numVisible, 0, 0));
+}
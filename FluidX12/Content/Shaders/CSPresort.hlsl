@@ -0,0 +1,54 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Particle.hlsli"
+#include "Reorder.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbReorder
+{
+	uint3	g_gridSize;
+	uint	g_parity;	// Index of the alive list being reordered
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers, bound in the same table as for the update and emission
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint4>	g_rwParticles	: register (u0);
+RWStructuredBuffer<uint>	g_rwAliveList	: register (u2);
+RWByteAddressBuffer			g_rwCounters	: register (u3);
+
+//--------------------------------------------------------------------------------------
+// Sort key of the alive list entry, with the entries past the alive count sorted last
+//--------------------------------------------------------------------------------------
+uint2 LoadElement(uint i, uint numAlive)
+{
+	if (i >= numAlive) return uint2(DEAD_KEY, 0);
+
+	const uint particleId = g_rwAliveList[i];
+	const Particle particle = UnpackParticle(g_rwParticles[particleId]);
+	const uint3 cell = min(uint3(particle.Pos * g_gridSize), g_gridSize - 1);
+
+	return uint2(MortonCode(cell), particleId);
+}
+
+//--------------------------------------------------------------------------------------
+// Compute shader of generating the sort keys and sorting each chunk in shared memory
+//--------------------------------------------------------------------------------------
+[numthreads(SORT_GROUP_SIZE, 1, 1)]
+void main(uint GTid : SV_GroupThreadID, uint Gid : SV_GroupID)
+{
+	const uint numAlive = g_rwCounters.Load(ALIVE_COUNT(g_parity));
+	const uint chunkBase = Gid * SORT_CHUNK_SIZE;
+
+	g_elements[GTid] = LoadElement(chunkBase + GTid, numAlive);
+	g_elements[GTid + SORT_GROUP_SIZE] = LoadElement(chunkBase + GTid + SORT_GROUP_SIZE, numAlive);
+	GroupMemoryBarrierWithGroupSync();
+
+	for (uint k = 2; k <= SORT_CHUNK_SIZE; k <<= 1) BitonicMergeShared(GTid, chunkBase, k, k >> 1);
+
+	StoreChunk(GTid, chunkBase);
+}
@@ -0,0 +1,51 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Particle.hlsli"
+#include "Reorder.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbReorder
+{
+	uint3	g_gridSize;
+	uint	g_parity;	// Index of the alive list being reordered
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers, bound in the same table as for the update and emission
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint4>	g_rwParticles	: register (u0);
+RWStructuredBuffer<uint>	g_rwDeadList	: register (u1);
+RWStructuredBuffer<uint>	g_rwAliveList	: register (u2);
+RWByteAddressBuffer			g_rwCounters	: register (u3);
+RWStructuredBuffer<uint4>	g_rwReordered	: register (u5);
+
+//--------------------------------------------------------------------------------------
+// Compute shader of gathering the alive particles in the sorted order, so that the alive
+// list becomes the identity and the dead list holds the remaining slots
+//--------------------------------------------------------------------------------------
+[numthreads(PARTICLE_GROUP_SIZE, 1, 1)]
+void main(uint DTid : SV_DispatchThreadID)
+{
+	uint numParticles, stride;
+	g_rwParticles.GetDimensions(numParticles, stride);
+
+	const uint numAlive = g_rwCounters.Load(ALIVE_COUNT(g_parity));
+	const uint numGroups = min((numParticles + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, MAX_PARTICLE_GROUPS);
+	const uint numThreads = numGroups * PARTICLE_GROUP_SIZE;
+
+	for (uint i = DTid; i < numParticles; i += numThreads)
+	{
+		if (i < numAlive)
+		{
+			g_rwReordered[i] = g_rwParticles[g_rwSortBuffer[i].y];
+			g_rwAliveList[i] = i;
+		}
+		else g_rwDeadList[i - numAlive] = i;
+	}
+
+	if (DTid == 0) g_rwCounters.Store(DEAD_COUNT, numParticles - numAlive);
+}
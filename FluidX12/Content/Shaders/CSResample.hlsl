@@ -0,0 +1,50 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbPerFrame
+{
+	float	g_pressureScl;	// Destination-to-source grid resolution ratio
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D<float3>	g_txVelocity;
+Texture3D			g_txColor0;
+Texture3D			g_txColor1;
+Texture3D<float>	g_txIncompress;
+
+RWTexture3D<float3>	g_rwVelocity;
+RWTexture3D<float4>	g_rwColor0;
+RWTexture3D<float4>	g_rwColor1;
+RWTexture3D<float>	g_rwIncompress;
+
+//--------------------------------------------------------------------------------------
+// Sampler
+//--------------------------------------------------------------------------------------
+SamplerState g_smpLinear;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of resampling the fields into a resized grid
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	float3 gridSize;
+	g_rwVelocity.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+	if (any(DTid >= gridSize)) return;
+
+	const float3 tex = (DTid + 0.5) / gridSize;
+
+	// Velocity is in domain units per second, so it carries over unchanged
+	g_rwVelocity[DTid] = g_txVelocity.SampleLevel(g_smpLinear, tex, 0.0);
+	g_rwColor0[DTid] = g_txColor0.SampleLevel(g_smpLinear, tex, 0.0);
+	g_rwColor1[DTid] = g_txColor1.SampleLevel(g_smpLinear, tex, 0.0);
+
+	// Pressure is in cell units, so rescale it as a warm start for the projection
+	g_rwIncompress[DTid] = g_txIncompress.SampleLevel(g_smpLinear, tex, 0.0) * g_pressureScl;
+}
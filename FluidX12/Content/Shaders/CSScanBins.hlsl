@@ -0,0 +1,45 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Transfer.hlsli"
+
+groupshared uint g_sums[SCAN_GROUP_SIZE];
+
+//--------------------------------------------------------------------------------------
+// Compute shader of the exclusive prefix scan of the brick counts into the bin offsets,
+// in a single group over contiguous chunks of the bricks
+//--------------------------------------------------------------------------------------
+[numthreads(SCAN_GROUP_SIZE, 1, 1)]
+void main(uint GTid : SV_GroupIndex)
+{
+	const uint numBricks = GetNumBricks();
+	const uint chunkSize = (numBricks + SCAN_GROUP_SIZE - 1) / SCAN_GROUP_SIZE;
+	const uint first = min(GTid * chunkSize, numBricks);
+	const uint last = min(first + chunkSize, numBricks);
+
+	uint sum = 0;
+	for (uint i = first; i < last; ++i) sum += g_rwBins.Load(i * 4);
+	g_sums[GTid] = sum;
+	GroupMemoryBarrierWithGroupSync();
+
+	// Inclusive scan of the chunk sums
+	[unroll]
+	for (uint stride = 1; stride < SCAN_GROUP_SIZE; stride <<= 1)
+	{
+		const uint value = GTid >= stride ? g_sums[GTid - stride] : 0;
+		GroupMemoryBarrierWithGroupSync();
+		g_sums[GTid] += value;
+		GroupMemoryBarrierWithGroupSync();
+	}
+
+	// Offsets after the counts, with the total at the end
+	uint offset = g_sums[GTid] - sum;
+	for (uint j = first; j < last; ++j)
+	{
+		g_rwBins.Store((numBricks + j) * 4, offset);
+		offset += g_rwBins.Load(j * 4);
+	}
+
+	if (GTid == SCAN_GROUP_SIZE - 1) g_rwBins.Store(numBricks * 8, offset);
+}
@@ -0,0 +1,67 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define NOISE_TILE_SIZE 64.0
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbPerFrame
+{
+	float	g_time;
+	uint	g_numOctaves;
+};
+
+static const float g_displacementScl = 1.0 / 60.0;
+static const float g_noiseDrift = 0.05;
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D<float3>	g_txVelocity;
+Texture3D			g_txColor;
+Texture3D<float3>	g_txNoise;
+
+RWTexture3D<float4>	g_rwColor;
+
+//--------------------------------------------------------------------------------------
+// Samplers
+//--------------------------------------------------------------------------------------
+SamplerState g_smpLinear;
+SamplerState g_smpWrap;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of wavelet turbulence upsampling
+//--------------------------------------------------------------------------------------
+[numthreads(4, 4, 4)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	float3 gridSize, hiResGridSize;
+	g_txVelocity.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+	g_rwColor.GetDimensions(hiResGridSize.x, hiResGridSize.y, hiResGridSize.z);
+	if (any(DTid >= hiResGridSize)) return;
+
+	const float3 tex = (DTid + 0.5) / hiResGridSize;
+
+	// Local energy of the simulated velocity, amplitude = sqrt(2E) = |u|
+	const float amplitude = length(g_txVelocity.SampleLevel(g_smpLinear, tex, 0.0));
+
+	// Band-limited octaves with a Kolmogorov falloff of 2^(-5/6),
+	// starting right above the Nyquist limit of the simulation grid
+	const float3 noiseScl = 2.0 * gridSize / NOISE_TILE_SIZE;
+	float3 disp = 0.0;
+	float freq = 1.0, weight = 1.0;
+	for (uint i = 0; i < g_numOctaves; ++i)
+	{
+		const float3 pos = tex * noiseScl * freq + g_time * g_noiseDrift * freq;
+		disp += g_txNoise.SampleLevel(g_smpWrap, pos, 0.0) * weight;
+		freq *= 2.0;
+		weight *= 0.561231;
+	}
+
+	// Displace the lookup into the simulated color
+	disp *= amplitude * g_displacementScl;
+	disp.z = hiResGridSize.z > 1.0 ? disp.z : 0.0;
+	g_rwColor[DTid] = g_txColor.SampleLevel(g_smpLinear, tex + disp, 0.0);
+}
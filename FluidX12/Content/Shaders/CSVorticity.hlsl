@@ -0,0 +1,43 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture3D<float3>	g_txVelocity;
+
+RWTexture3D<float4>	g_rwVorticity;
+
+//--------------------------------------------------------------------------------------
+// Compute shader of vorticity (curl of the velocity field)
+//--------------------------------------------------------------------------------------
+[numthreads(8, 8, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+	uint3 gridSize;
+	g_txVelocity.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+
+	// Neighbor cells
+	const uint3 cellMin = max(DTid, 1) - 1;
+	const uint3 cellMax = min(DTid + 1, gridSize - 1);
+	const float3 uL = g_txVelocity[uint3(cellMin.x, DTid.yz)];
+	const float3 uR = g_txVelocity[uint3(cellMax.x, DTid.yz)];
+	const float3 uU = g_txVelocity[uint3(DTid.x, cellMin.y, DTid.z)];
+	const float3 uD = g_txVelocity[uint3(DTid.x, cellMax.y, DTid.z)];
+	const float3 uF = g_txVelocity[uint3(DTid.xy, cellMin.z)];
+	const float3 uB = g_txVelocity[uint3(DTid.xy, cellMax.z)];
+
+	// Compute the curl using central differences
+	float3 w;
+	w.x = (uD.z - uU.z) - (uB.y - uF.y);
+	w.y = (uB.x - uF.x) - (uR.z - uL.z);
+	w.z = (uR.y - uL.y) - (uD.x - uU.x);
+	w *= 0.5;
+
+	// Only the scalar curl out of the plane in 2D
+	if (gridSize.z <= 1) w.xy = 0.0;
+
+	// Store |w| in the alpha channel for the confinement gradient
+	g_rwVorticity[DTid] = float4(w, length(w));
+}
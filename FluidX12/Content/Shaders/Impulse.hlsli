@@ -2,18 +2,41 @@
 // Copyright (c) XU, Tianchen. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#define BRICK_SIZE 8
+
+//--------------------------------------------------------------------------------------
+// Structure
+//--------------------------------------------------------------------------------------
+struct Emitter
+{
+	float3	Pos;
+	float	Radius;
+	float3	Force;
+	float	Swirl;
+	float4	Color;
+};
+
 //--------------------------------------------------------------------------------------
 // Constants
 //--------------------------------------------------------------------------------------
 cbuffer cbPerFrame
 {
 	float	g_timeStep;
-	uint	g_baseSeed;
+	uint	g_step;				// Simulation step index, the counter of the emission draws
+	uint	g_numEmitters;
+	float	g_renderTimeOffset;	// Rendered time relative to the latest simulated state
+	uint	g_seed;				// Key of the emission draws
+	float	g_flipRatio;		// FLIP share of the particle velocity update in the hybrid solver
+	uint	g_integrator;		// Particle integrator, INTEGRATOR_EULER, INTEGRATOR_RK2 or INTEGRATOR_RK3
+	float	g_fullLife;			// Lifetime of the emitted particles before the random extension, ParticleCPU::FullLife
 };
 
-static const float3	g_impulsePos = { 0.5, 0.9, 0.5 };
-static const float	g_impulseR = 1.0 / 28.0;
-static const float4	g_impulse = float4(0.0, 40.0, 100.0, 64.0);
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+StructuredBuffer<Emitter>	g_emitters			: register (t2);
+StructuredBuffer<uint2>		g_brickRanges		: register (t3);
+StructuredBuffer<uint>		g_emitterIndices	: register (t4);
 
 //--------------------------------------------------------------------------------------
 // Grid space to simulation space
@@ -22,3 +45,14 @@ float3 SimulationToTextureSpace(float3 pos, float3 gridSize)
 {
 	return pos;
 }
+
+//--------------------------------------------------------------------------------------
+// Get the (offset, count) of the emitter list of the brick containing the cell
+//--------------------------------------------------------------------------------------
+uint2 GetBrickEmitterRange(uint3 cell, uint3 gridSize)
+{
+	const uint3 brickGridSize = (gridSize - 1) / BRICK_SIZE + 1;
+	const uint3 brick = cell / BRICK_SIZE;
+
+	return g_brickRanges[(brick.z * brickGridSize.y + brick.y) * brickGridSize.x + brick.x];
+}
@@ -0,0 +1,10 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+// Cells per edge of a macro-cell of the occupancy grid
+#define MACRO_CELL_SIZE	8
+
+// Byte offsets of the local-space bound of the occupied macro-cells, inverted if none
+#define BOUND_MIN		0
+#define BOUND_MAX		16
@@ -2,11 +2,24 @@
 // Copyright (c) XU, Tianchen. All rights reserved.
 //--------------------------------------------------------------------------------------
 
+#include "Occupancy.hlsli"
+
 #define NUM_SAMPLES			128
 #define NUM_LIGHT_SAMPLES	32
 #define ABSORPTION			1.0
 #define ZERO_THRESHOLD		0.01
 #define ONE_THRESHOLD		0.999
+#define MAX_STRIDE			4
+#define SPARSE_OPACITY		0.02
+
+//--------------------------------------------------------------------------------------
+// Structure
+//--------------------------------------------------------------------------------------
+struct PSOut
+{
+	min16float4	Color	: SV_TARGET0;
+	float		Depth	: SV_TARGET1;	// Opacity-weighted view distance for the upsampling, 0 if empty
+};
 
 //--------------------------------------------------------------------------------------
 // Constant buffers
@@ -15,8 +28,14 @@ cbuffer cbPerObject
 {
 	float3	g_localSpaceLightPt;
 	float3	g_localSpaceEyePt;
-	matrix	g_screenToLocal;
+	matrix	g_screenToLocal;	// From the jittered pixels of the reduced-resolution target
 	matrix	g_worldViewProj;
+	matrix	g_prevWorldViewProj;
+	matrix	g_resolveToLocal;
+	float2	g_jitter;
+	float	g_renderScale;
+	float	g_historyBlend;
+	float2	g_renderViewport;
 };
 
 static const min16float g_maxDist = 2.0 * sqrt(3.0);
@@ -26,9 +45,23 @@ static const min16float g_lightStepScale = g_maxDist / NUM_LIGHT_SAMPLES;
 static const min16float3 g_clearColor = 0.0;
 
 //--------------------------------------------------------------------------------------
-// Texture
+// Textures
+//--------------------------------------------------------------------------------------
+#ifdef BLOCK_COMPRESSED
+Texture3D<float3>	g_txGrid		: register (t0);	// BC6H color, encoded by CSEncodeBC per frame
+#else
+Texture3D<float4>	g_txGrid		: register (t0);
+#endif
+Texture3D<float>	g_txOccupancy	: register (t1);	// Maximum density per macro-cell
+Texture3D<float>	g_txLightTrans	: register (t2);	// Light transmittance swept from the rendered volume
+#ifdef BLOCK_COMPRESSED
+Texture3D<float>	g_txDensity		: register (t4);	// BC4 density, saturated
+#endif
+
+//--------------------------------------------------------------------------------------
+// Buffer
 //--------------------------------------------------------------------------------------
-Texture3D<float4>	g_txGrid;
+ByteAddressBuffer	g_roBound		: register (t3);	// Local-space bound of the occupied macro-cells
 
 //--------------------------------------------------------------------------------------
 // Unordered access texture
@@ -83,57 +116,160 @@ bool ComputeStartPoint(inout float3 pos, float3 rayDir)
 }
 
 //--------------------------------------------------------------------------------------
-// Sample density field
+// Sample density field at the mip level
 //--------------------------------------------------------------------------------------
-min16float4 GetSample(float3 tex)
+min16float4 GetSample(float3 tex, float lod = 0.0)
 {
-	min16float4 color = min16float4(g_txGrid.SampleLevel(g_smpLinear, tex, 0.0));
+#ifdef BLOCK_COMPRESSED
+	min16float4 color = min16float4(g_txGrid.SampleLevel(g_smpLinear, tex, lod),
+		g_txDensity.SampleLevel(g_smpLinear, tex, lod));
+#else
+	min16float4 color = min16float4(g_txGrid.SampleLevel(g_smpLinear, tex, lod));
+#endif
 	color.w *= 24.0;
 
 	return min(min16float4(color.xyz * color.w, color.w), 24.0);
 }
 
+//--------------------------------------------------------------------------------------
+// One 3D-DDA step: the first sample beyond the exit of the ray from the macro-cell
+//--------------------------------------------------------------------------------------
+uint GetNextSample(float3 texStart, float3 texDir, uint3 macroCell, float3 gridSize, uint i)
+{
+	const float3 planes = (macroCell + (texDir > 0.0)) * MACRO_CELL_SIZE / gridSize;
+	const float3 tExits = texDir != 0.0 ? (planes - texStart) / texDir : 3.402823466e+38;
+	const float tExit = min(tExits.x, min(tExits.y, tExits.z));
+
+	return max(uint(ceil(min(tExit / g_stepScale, NUM_SAMPLES))), i + 1);
+}
+
 //--------------------------------------------------------------------------------------
 // Pixel Shader
 //--------------------------------------------------------------------------------------
-min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
+PSOut main(float4 sspos : SV_POSITION)
 {
-	float3 pos = ScreenToLocal(float3(sspos.xy, 0.0));	// The point on the near plane
-	const float3 rayDir = normalize(pos - g_localSpaceEyePt);
+	const float3 nearPt = ScreenToLocal(float3(sspos.xy, 0.0));	// The point on the near plane
+	const float3 rayDir = normalize(nearPt - g_localSpaceEyePt);
+	float3 pos = nearPt;
 	if (!ComputeStartPoint(pos, rayDir)) discard;
 
-	const float3 step = rayDir * g_stepScale;
+	float3 gridSize, occupancySize;
+	float numMips;
+	g_txGrid.GetDimensions(0, gridSize.x, gridSize.y, gridSize.z, numMips);
+	g_txOccupancy.GetDimensions(occupancySize.x, occupancySize.y, occupancySize.z);
 
-#ifndef _POINT_LIGHT_
-	const float3 lightStep = normalize(g_localSpaceLightPt) * g_lightStepScale;
-#endif
+	// Pixel footprint per unit view distance in texels, from the next pixel on the near plane
+	const float texelScale = 0.5 * max(gridSize.x, max(gridSize.y, gridSize.z));
+	const float stepTexels = g_stepScale * texelScale;
+	const float maxLod = numMips - 1.0;
+	const float footprint = length(ScreenToLocal(float3(sspos.x + 1.0, sspos.y, 0.0)) - nearPt) /
+		dot(nearPt - g_localSpaceEyePt, rayDir) * texelScale;
+
+	const float3 start = pos;
+	const float startDist = dot(start - g_localSpaceEyePt, rayDir);
+	const float3 texStart = float3(0.5, -0.5, 0.5) * start + 0.5;
+	const float3 texDir = float3(0.5, -0.5, 0.5) * rayDir;
 
 	// Transmittance
 	min16float transmit = 1.0;
 	// In-scattered radiance
 	min16float3 scatter = 0.0;
 	min16float3 ambient = 0.0;
-
-	for (uint i = 0; i < NUM_SAMPLES; ++i)
+	// View distances weighted by the opacity gained
+	float depthSum = 0.0;
+
+	// Only the samples within the bound, at the same positions as from the unit box
+	const float3 boundMin = asfloat(g_roBound.Load3(BOUND_MIN));
+	const float3 boundMax = asfloat(g_roBound.Load3(BOUND_MAX));
+	if (boundMin.x > boundMax.x) discard;
+	// A ray parallel to a slab is either within it all along or misses the bound
+	const bool3 isParallel = rayDir == 0.0;
+	if (any(isParallel && (start < boundMin || start > boundMax))) discard;
+	const float3 invDir = isParallel ? 0.0 : 1.0 / rayDir;
+	const float3 t0 = (boundMin - start) * invDir;
+	const float3 t1 = (boundMax - start) * invDir;
+	const float3 tMin = isParallel ? 0.0 : min(t0, t1);
+	const float3 tMax = isParallel ? 3.402823466e+38 : max(t0, t1);
+	const float tEnter = max(max(tMin.x, tMin.y), max(tMin.z, 0.0));
+	const float tExit = min(tMax.x, min(tMax.y, tMax.z));
+	if (tEnter > tExit) discard;
+	const uint last = min(uint(tExit / g_stepScale) + 1, NUM_SAMPLES);
+
+	bool isSparse = false;	// The last sample is thin enough to probe the span ahead
+	for (uint i = uint(ceil(tEnter / g_stepScale)); i < last;)
 	{
+		// Positions from the start, so that skipping lands on the same samples
+		pos = start + rayDir * (g_stepScale * i);
 		if (any(abs(pos) > 1.0)) break;
 		float3 tex = float3(0.5, -0.5, 0.5) * pos + 0.5;
 
-		// Get a sample
-		const min16float4 color = GetSample(tex);
+		// Skip the empty macro-cells as a whole; the trilinear samples within cannot exceed
+		// their maximum densities
+		const uint3 macroCell = min(uint3(tex * gridSize) / MACRO_CELL_SIZE, occupancySize - 1.0);
+		if (g_txOccupancy[macroCell] * 24.0 <= ZERO_THRESHOLD)
+		{
+			i = GetNextSample(texStart, texDir, macroCell, gridSize, i);
+			continue;
+		}
+
+		// Mip level of the pixel footprint at the distance, striding over the samples finer than it
+		float sampleDist = startDist + g_stepScale * i;
+		const float footprintTexels = sampleDist * footprint;
+		const float lod = min(log2(max(footprintTexels, 1.0)), maxLod);
+		uint stride = clamp(uint(footprintTexels / stepTexels), 1, MAX_STRIDE);
+
+		// Get a sample; the span ahead is probed at the level of its extent, and taken as a whole if thin
+		min16float4 color = 0.0;
+		if (isSparse)
+		{
+			const float offset = g_stepScale * (MAX_STRIDE - 1) * 0.5;
+			const float3 spanPos = pos + rayDir * offset;
+			isSparse = all(abs(spanPos) <= 1.0);
+			if (isSparse)
+			{
+				const float3 spanTex = float3(0.5, -0.5, 0.5) * spanPos + 0.5;
+				color = GetSample(spanTex, min(max(lod, log2(MAX_STRIDE * stepTexels)), maxLod));
+				isSparse = color.w * g_stepScale * MAX_STRIDE * ABSORPTION < SPARSE_OPACITY;
+				if (isSparse)
+				{
+					stride = MAX_STRIDE;
+					pos = spanPos;
+					tex = spanTex;
+					sampleDist += offset;
+				}
+			}
+		}
+
+		if (!isSparse)
+		{
+			// At the middle of the stride
+			const float offset = g_stepScale * (stride - 1) * 0.5;
+			const float3 midPos = pos + rayDir * offset;
+			if (all(abs(midPos) <= 1.0))
+			{
+				pos = midPos;
+				tex = float3(0.5, -0.5, 0.5) * pos + 0.5;
+				sampleDist += offset;
+			}
+			else stride = 1;
+			color = GetSample(tex, lod);
+			isSparse = color.w * g_stepScale * MAX_STRIDE * ABSORPTION < SPARSE_OPACITY;
+		}
+		i += stride;
 
 		// Skip empty space
 		if (color.w > ZERO_THRESHOLD)
 		{
 			// Attenuate ray-throughput
-			const min16float4 scaledColor = color * g_stepScale;
+			const min16float4 scaledColor = color * (g_stepScale * stride);
+			const min16float prevTransmit = transmit;
 			transmit *= saturate(1.0 - scaledColor.w * ABSORPTION);
+			depthSum += (prevTransmit - transmit) * sampleDist;
 			if (transmit < ZERO_THRESHOLD) break;
 
-			// Point light direction in texture space
 #ifdef _POINT_LIGHT_
+			// Point light direction in texture space
 			const float3 lightStep = normalize(g_localSpaceLightPt - pos) * g_lightStepScale;
-#endif
 
 			// Sample light
 			min16float lightTrans = 1.0;	// Transmittance along light ray
@@ -154,12 +290,14 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 				// Update position along light ray
 				lightPos += lightStep;
 			}
+#else
+			// Transmittance along light ray, swept from the directional light in advance
+			const min16float lightTrans = min16float(g_txLightTrans.SampleLevel(g_smpLinear, tex, 0.0));
+#endif
 
 			scatter += lightTrans * transmit * scaledColor.xyz;
 			ambient += transmit * scaledColor.xyz;
 		}
-
-		pos += step;
 	}
 
 	//clip(ONE_THRESHOLD - transmit);
@@ -167,5 +305,9 @@ min16float4 main(float4 sspos : SV_POSITION) : SV_TARGET
 	min16float3 result = scatter + lerp(ambient, 1.0, 0.75) * 0.16;
 	//result = lerp(result, g_clearColor * g_clearColor, transmit);
 
-	return min16float4(sqrt(result), saturate(1.0 - transmit));
+	PSOut output;
+	output.Color = min16float4(sqrt(result), saturate(1.0 - transmit));
+	output.Depth = transmit < 1.0 ? depthSum / (1.0 - transmit) : 0.0;
+
+	return output;
 }
@@ -0,0 +1,117 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define DEPTH_SIGMA	0.05
+
+//--------------------------------------------------------------------------------------
+// Structure
+//--------------------------------------------------------------------------------------
+struct PSIn
+{
+	float4 Pos : SV_POSITION;
+	float2 Tex : TEXCOORD;
+};
+
+//--------------------------------------------------------------------------------------
+// Constant buffer, shared with PSRayCast
+//--------------------------------------------------------------------------------------
+cbuffer cbPerObject
+{
+	float3	g_localSpaceLightPt;
+	float3	g_localSpaceEyePt;
+	matrix	g_screenToLocal;
+	matrix	g_worldViewProj;
+	matrix	g_prevWorldViewProj;
+	matrix	g_resolveToLocal;	// From the pixels of the back buffer
+	float2	g_jitter;
+	float	g_renderScale;
+	float	g_historyBlend;		// Weight of the current frame, 1 without history
+	float2	g_renderViewport;
+};
+
+//--------------------------------------------------------------------------------------
+// Textures
+//--------------------------------------------------------------------------------------
+Texture2D<float4>	g_txColor;		// Reduced-resolution ray casting
+Texture2D<float>	g_txDepth;		// Opacity-weighted view distances, 0 if empty
+Texture2D<float4>	g_txHistory;	// Resolved image of the previous frame, premultiplied
+
+//--------------------------------------------------------------------------------------
+// Unordered access texture
+//--------------------------------------------------------------------------------------
+RWTexture2D<float4>	g_rwHistory;
+
+//--------------------------------------------------------------------------------------
+// Texture sampler
+//--------------------------------------------------------------------------------------
+SamplerState		g_smpLinear;
+
+//--------------------------------------------------------------------------------------
+// Pixel shader of the edge-aware upsampling with the temporal accumulation
+//--------------------------------------------------------------------------------------
+float4 main(PSIn input) : SV_TARGET
+{
+	// The reduced resolution occupies the top-left of the full-size targets
+	float2 viewport;
+	g_txHistory.GetDimensions(viewport.x, viewport.y);
+	const uint2 renderSize = uint2(ceil(viewport * g_renderScale));
+
+	// Render pixel position, with the jittered samples at the integers
+	const float2 pos = input.Pos.xy * g_renderScale - 0.5 - g_jitter;
+	const float2 base = floor(pos);
+	const float2 w = pos - base;
+
+	uint2 indices[4];
+	float weights[4], depths[4];
+	float depth = 0.0, nearestWeight = 0.0;
+	[unroll]
+	for (uint i = 0; i < 4; ++i)
+	{
+		const int2 offset = int2(i & 1, i >> 1);
+		indices[i] = uint2(clamp(int2(base) + offset, 0, int2(renderSize) - 1));
+		weights[i] = (offset.x ? w.x : 1.0 - w.x) * (offset.y ? w.y : 1.0 - w.y);
+
+		// View distance of the nearest sample hitting the volume
+		depths[i] = g_txDepth[indices[i]];
+		const bool isNearest = depths[i] > 0.0 && weights[i] > nearestWeight;
+		depth = isNearest ? depths[i] : depth;
+		nearestWeight = isNearest ? weights[i] : nearestWeight;
+	}
+
+	// Edge-aware upsampling in premultiplied colors: the samples off the view distance of the
+	// nearest hit fall off, while the empty samples are transparent and keep their weights
+	float4 current = 0.0, minColor = 65504.0, maxColor = -65504.0;
+	float weightSum = 0.0;
+	[unroll]
+	for (uint j = 0; j < 4; ++j)
+	{
+		const float4 color = g_txColor[indices[j]];
+		const float4 premul = float4(color.xyz * color.w, color.w);
+		const float deltaDepth = depths[j] > 0.0 ? (depths[j] - depth) / DEPTH_SIGMA : 0.0;
+		const float weight = weights[j] * exp(-deltaDepth * deltaDepth);
+		current += weight * premul;
+		minColor = min(minColor, premul);
+		maxColor = max(maxColor, premul);
+		weightSum += weight;
+	}
+	current /= weightSum;
+
+	// Reproject at the view distance, or at that of the volume center if empty
+	const float4 nearPt = mul(float4(input.Pos.xy, 0.0, 1.0), g_resolveToLocal);
+	const float3 rayDir = normalize(nearPt.xyz / nearPt.w - g_localSpaceEyePt);
+	const float3 pt = g_localSpaceEyePt + rayDir * (depth > 0.0 ? depth : length(g_localSpaceEyePt));
+	const float4 prevPos = mul(float4(pt, 1.0), g_prevWorldViewProj);
+	const float2 prevTex = prevPos.xy / prevPos.w * float2(0.5, -0.5) + 0.5;
+
+	// Blend over the history clamped to the neighborhood, then over the back buffer as premultiplied
+	float4 result = current;
+	if (g_historyBlend < 1.0 && all(prevTex >= 0.0 && prevTex <= 1.0))
+	{
+		const float4 prev = clamp(g_txHistory.SampleLevel(g_smpLinear, prevTex, 0.0), minColor, maxColor);
+		result = lerp(prev, current, g_historyBlend);
+	}
+	g_rwHistory[input.Pos.xy] = result;
+
+	return result;
+}
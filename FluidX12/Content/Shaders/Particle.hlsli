@@ -0,0 +1,77 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Structure
+//--------------------------------------------------------------------------------------
+struct Particle
+{
+	float3 Pos;
+	float3 Velocity;
+	float LifeTime;
+};
+
+//--------------------------------------------------------------------------------------
+// Quantization of the packed particle
+//--------------------------------------------------------------------------------------
+#define POS_QUANT			2097151.0	// 21-bit UNORM over the unit simulation cube
+#define LIFE_QUANT			65535.0		// 16-bit UNORM over [0, MAX_LIFE_TIME]
+#define MAX_LIFE_TIME		4.0
+
+//--------------------------------------------------------------------------------------
+// Byte offsets of the particle list counters
+//--------------------------------------------------------------------------------------
+#define DEAD_COUNT			0
+#define ALIVE_COUNT(i)		(4 * ((i) + 1))
+#define VISIBLE_COUNT		12
+
+#define PARTICLE_RADIUS		0.4		// Billboard half-size in view space
+
+#define INTEGRATOR_EULER	0
+#define INTEGRATOR_RK2		1		// Midpoint
+#define INTEGRATOR_RK3		2		// Ralston's third order
+
+#define PARTICLE_GROUP_SIZE	64
+#define MAX_PARTICLE_GROUPS	4096
+
+//--------------------------------------------------------------------------------------
+// Pack a particle into 16 bytes: the high 16 bits of each position component and the
+// lifetime in x and y, the half-precision velocity in z and w, and the low 5 bits of
+// each position component in the top half of w
+//--------------------------------------------------------------------------------------
+uint4 PackParticle(Particle particle)
+{
+	const uint3 pos = uint3(saturate(particle.Pos) * POS_QUANT + 0.5);
+	const uint3 velocity = f32tof16(particle.Velocity);
+
+	// A particle still alive never rounds down to a zero lifetime
+	uint life = uint(saturate(particle.LifeTime / MAX_LIFE_TIME) * LIFE_QUANT + 0.5);
+	life = particle.LifeTime > 0.0 ? max(life, 1) : 0;
+
+	uint4 packed;
+	packed.x = (pos.x >> 5) | ((pos.y >> 5) << 16);
+	packed.y = (pos.z >> 5) | (life << 16);
+	packed.z = velocity.x | (velocity.y << 16);
+	packed.w = velocity.z | (((pos.x & 0x1f) | ((pos.y & 0x1f) << 5) | ((pos.z & 0x1f) << 10)) << 16);
+
+	return packed;
+}
+
+//--------------------------------------------------------------------------------------
+// Unpack a particle from 16 bytes
+//--------------------------------------------------------------------------------------
+Particle UnpackParticle(uint4 packed)
+{
+	uint3 pos;
+	pos.x = ((packed.x & 0xffff) << 5) | ((packed.w >> 16) & 0x1f);
+	pos.y = ((packed.x >> 16) << 5) | ((packed.w >> 21) & 0x1f);
+	pos.z = ((packed.y & 0xffff) << 5) | ((packed.w >> 26) & 0x1f);
+
+	Particle particle;
+	particle.Pos = pos * (1.0 / POS_QUANT);
+	particle.Velocity = f16tof32(uint3(packed.z & 0xffff, packed.z >> 16, packed.w & 0xffff));
+	particle.LifeTime = (packed.y >> 16) * (MAX_LIFE_TIME / LIFE_QUANT);
+
+	return particle;
+}
@@ -0,0 +1,62 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Philox4x32-10 counter-based random number generator, bit-exact with Philox.h
+//--------------------------------------------------------------------------------------
+#define PHILOX_M0			0xd2511f53
+#define PHILOX_M1			0xcd9e8d57
+#define PHILOX_W0			0x9e3779b9
+#define PHILOX_W1			0xbb67ae85
+#define PHILOX_ROUNDS		10
+
+#define STREAM_EMISSION			0
+
+//--------------------------------------------------------------------------------------
+// 32x32-bit multiplication into the high and low words, from 16-bit halves
+//--------------------------------------------------------------------------------------
+uint2 MulHiLo(uint a, uint b)
+{
+	const uint2 a16 = { a & 0xffff, a >> 16 };
+	const uint2 b16 = { b & 0xffff, b >> 16 };
+	const uint lolo = a16.x * b16.x;
+	const uint lohi = a16.x * b16.y;
+	const uint hilo = a16.y * b16.x;
+	const uint carry = ((lolo >> 16) + (lohi & 0xffff) + (hilo & 0xffff)) >> 16;
+
+	return uint2(a16.y * b16.y + (lohi >> 16) + (hilo >> 16) + carry, a * b);
+}
+
+//--------------------------------------------------------------------------------------
+// One block of four random numbers for the counter under the key
+//--------------------------------------------------------------------------------------
+uint4 Philox(uint4 counter, uint2 key)
+{
+	[unroll]
+	for (uint i = 0; i < PHILOX_ROUNDS; ++i)
+	{
+		const uint2 product0 = MulHiLo(PHILOX_M0, counter.x);
+		const uint2 product1 = MulHiLo(PHILOX_M1, counter.z);
+		counter = uint4(product1.x ^ counter.y ^ key.x, product1.y, product0.x ^ counter.w ^ key.y, product0.y);
+		key += uint2(PHILOX_W0, PHILOX_W1);
+	}
+
+	return counter;
+}
+
+//--------------------------------------------------------------------------------------
+// Uniform float in [0, 1) from the top 24 bits
+//--------------------------------------------------------------------------------------
+float RandToFloat(uint r)
+{
+	return (r >> 8) * (1.0 / 16777216.0);
+}
+
+//--------------------------------------------------------------------------------------
+// Uniform float in [0, 1) from the low bytes of three numbers, unused by RandToFloat
+//--------------------------------------------------------------------------------------
+float RandLowBytesToFloat(uint3 r)
+{
+	return ((r.x & 0xff) << 16 | (r.y & 0xff) << 8 | (r.z & 0xff)) * (1.0 / 16777216.0);
+}
@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#define SORT_GROUP_SIZE		1024
+#define SORT_CHUNK_SIZE		(SORT_GROUP_SIZE * 2)
+#define DEAD_KEY			0xffffffff
+
+//--------------------------------------------------------------------------------------
+// Buffers
+//--------------------------------------------------------------------------------------
+RWStructuredBuffer<uint2>	g_rwSortBuffer	: register (u4);	// (Morton code, particle ID)
+
+//--------------------------------------------------------------------------------------
+// Shared memory of a chunk being sorted
+//--------------------------------------------------------------------------------------
+groupshared uint2 g_elements[SORT_CHUNK_SIZE];
+
+//--------------------------------------------------------------------------------------
+// Spread the lower 10 bits to every third bit
+//--------------------------------------------------------------------------------------
+uint SpreadBits(uint x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x << 8)) & 0x0300f00f;
+	x = (x | (x << 4)) & 0x030c30c3;
+	x = (x | (x << 2)) & 0x09249249;
+
+	return x;
+}
+
+//--------------------------------------------------------------------------------------
+// Morton code of a cell, for grids of up to 1024 cells per axis
+//--------------------------------------------------------------------------------------
+uint MortonCode(uint3 cell)
+{
+	return SpreadBits(cell.x) | (SpreadBits(cell.y) << 1) | (SpreadBits(cell.z) << 2);
+}
+
+//--------------------------------------------------------------------------------------
+// Index of the lower element of the pair compared by the thread in the bitonic step j
+//--------------------------------------------------------------------------------------
+uint BitonicPairIndex(uint threadId, uint j)
+{
+	return ((threadId & ~(j - 1)) << 1) | (threadId & (j - 1));
+}
+
+//--------------------------------------------------------------------------------------
+// Bitonic merge steps from j down to 1 of the stage k, in shared memory
+//--------------------------------------------------------------------------------------
+void BitonicMergeShared(uint GTid, uint chunkBase, uint k, uint j)
+{
+	for (; j > 0; j >>= 1)
+	{
+		const uint i = BitonicPairIndex(GTid, j);
+		const uint2 a = g_elements[i];
+		const uint2 b = g_elements[i | j];
+
+		// Sort direction alternates between the blocks of size k
+		const bool ascending = ((chunkBase + i) & k) == 0;
+		if ((a.x > b.x) == ascending)
+		{
+			g_elements[i] = b;
+			g_elements[i | j] = a;
+		}
+		GroupMemoryBarrierWithGroupSync();
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Load the sort buffer chunk into shared memory
+//--------------------------------------------------------------------------------------
+void LoadChunk(uint GTid, uint chunkBase)
+{
+	g_elements[GTid] = g_rwSortBuffer[chunkBase + GTid];
+	g_elements[GTid + SORT_GROUP_SIZE] = g_rwSortBuffer[chunkBase + GTid + SORT_GROUP_SIZE];
+	GroupMemoryBarrierWithGroupSync();
+}
+
+//--------------------------------------------------------------------------------------
+// Store the chunk in shared memory back to the sort buffer
+//--------------------------------------------------------------------------------------
+void StoreChunk(uint GTid, uint chunkBase)
+{
+	g_rwSortBuffer[chunkBase + GTid] = g_elements[GTid];
+	g_rwSortBuffer[chunkBase + GTid + SORT_GROUP_SIZE] = g_elements[GTid + SORT_GROUP_SIZE];
+}
@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Particle.hlsli"
+
+#define TRANSFER_BRICK_SIZE		8		// The same bricks as the emitter bins
+#define TRANSFER_BRICK_CELLS	(TRANSFER_BRICK_SIZE * TRANSFER_BRICK_SIZE * TRANSFER_BRICK_SIZE)
+#define TRANSFER_QUANT			4096.0	// Fixed-point scale of the per-brick sums
+#define TRANSFER_MAX_SPEED		256.0	// Velocity clamp of the transfer, in domain units per second
+
+// Each clamped contribution stays within 256 * 4096 = 2^20 per unit weight, so the int32 sums
+// of a cell hold up to 2^11 = 2048 unit weights, i.e. that many particles in the 2^3 cells
+// around it; the weight sums alone would hold 2^19
+#define SCAN_GROUP_SIZE			1024
+
+//--------------------------------------------------------------------------------------
+// Constants
+//--------------------------------------------------------------------------------------
+cbuffer cbTransfer
+{
+	uint3	g_gridSize;
+	uint	g_parity;	// Index of the latest alive list
+};
+
+//--------------------------------------------------------------------------------------
+// Buffers and texture, all passes sharing the same tables
+//--------------------------------------------------------------------------------------
+StructuredBuffer<uint>		g_roAliveList	: register (t0);
+StructuredBuffer<uint4>		g_roParticles	: register (t1);
+
+RWByteAddressBuffer			g_rwBins		: register (u0);	// Counts per brick, then the offsets with the total
+RWStructuredBuffer<uint>	g_rwBinned		: register (u1);	// Particle IDs sorted by brick
+RWByteAddressBuffer			g_rwCounters	: register (u2);
+RWTexture3D<float4>			g_rwTransfer	: register (u3);
+
+//--------------------------------------------------------------------------------------
+// Trilinear support of a particle
+//--------------------------------------------------------------------------------------
+struct Support
+{
+	uint3 Cell0;	// Lower cells, with the cell centers at integers
+	uint3 Cell1;	// Upper cells
+	float3 Weight1;
+};
+
+Support GetSupport(float3 pos)
+{
+	pos = pos * g_gridSize - 0.5;
+	const float3 base = floor(pos);
+
+	Support support;
+	support.Cell0 = uint3(clamp(int3(base), 0, int3(g_gridSize) - 1));
+	support.Cell1 = uint3(clamp(int3(base) + 1, 0, int3(g_gridSize) - 1));
+	support.Weight1 = pos - base;
+
+	return support;
+}
+
+//--------------------------------------------------------------------------------------
+// Brick layout
+//--------------------------------------------------------------------------------------
+uint3 GetBrickGridSize()
+{
+	return (g_gridSize - 1) / TRANSFER_BRICK_SIZE + 1;
+}
+
+uint GetNumBricks()
+{
+	const uint3 brickGridSize = GetBrickGridSize();
+
+	return brickGridSize.x * brickGridSize.y * brickGridSize.z;
+}
+
+uint GetBrickIndex(uint3 brick)
+{
+	const uint3 brickGridSize = GetBrickGridSize();
+
+	return (brick.z * brickGridSize.y + brick.y) * brickGridSize.x + brick.x;
+}
+
+//--------------------------------------------------------------------------------------
+// Number of the alive particles, also bounding the indirect dispatch in CSPrepareArgs
+//--------------------------------------------------------------------------------------
+uint GetNumAliveThreads(out uint numAlive)
+{
+	numAlive = g_rwCounters.Load(ALIVE_COUNT(g_parity));
+	const uint numGroups = min((numAlive + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, MAX_PARTICLE_GROUPS);
+
+	return numGroups * PARTICLE_GROUP_SIZE;
+}
+
+//--------------------------------------------------------------------------------------
+// Freshly emitted particles carry no velocity yet, and take the grid velocity instead
+//--------------------------------------------------------------------------------------
+bool IsFresh(Particle particle)
+{
+	return all(particle.Velocity == 0.0);
+}
@@ -0,0 +1,59 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "Occupancy.hlsli"
+
+//--------------------------------------------------------------------------------------
+// Constant buffer, shared with PSRayCast
+//--------------------------------------------------------------------------------------
+cbuffer cbPerObject
+{
+	float3	g_localSpaceLightPt;
+	float3	g_localSpaceEyePt;
+	matrix	g_screenToLocal;
+	matrix	g_worldViewProj;
+	matrix	g_prevWorldViewProj;
+	matrix	g_resolveToLocal;
+	float2	g_jitter;
+	float	g_renderScale;
+	float	g_historyBlend;
+	float2	g_renderViewport;	// Width and height of the reduced-resolution viewport
+};
+
+//--------------------------------------------------------------------------------------
+// Buffer
+//--------------------------------------------------------------------------------------
+ByteAddressBuffer	g_roBound	: register (t3);	// Visible to all the stages, unlike t0-t2
+
+//--------------------------------------------------------------------------------------
+// Vertex shader of the screen rectangle of the bound of the occupied macro-cells,
+// as a triangle strip, so that only the pixels covered cast rays
+//--------------------------------------------------------------------------------------
+float4 main(uint vid : SV_VertexID) : SV_POSITION
+{
+	const float3 boundMin = asfloat(g_roBound.Load3(BOUND_MIN));
+	const float3 boundMax = asfloat(g_roBound.Load3(BOUND_MAX));
+
+	// Projected corners; the full screen if any is behind the eye
+	float2 rectMin = 3.402823466e+38, rectMax = -3.402823466e+38;
+	bool isBehind = false;
+	[unroll]
+	for (uint i = 0; i < 8; ++i)
+	{
+		const float3 corner = float3(i & 1 ? boundMax.x : boundMin.x, i & 2 ? boundMax.y : boundMin.y,
+			i & 4 ? boundMax.z : boundMin.z);
+		const float4 pos = mul(float4(corner, 1.0), g_worldViewProj);
+		isBehind = isBehind || pos.w <= 0.0;
+		rectMin = min(rectMin, pos.xy / pos.w);
+		rectMax = max(rectMax, pos.xy / pos.w);
+	}
+
+	// Padded by a pixel for the jitter, and degenerate if the bound is empty
+	const float2 padding = 2.0 / g_renderViewport;
+	rectMin = isBehind ? -1.0 : clamp(rectMin - padding, -1.0, 1.0);
+	rectMax = isBehind ? 1.0 : clamp(rectMax + padding, -1.0, 1.0);
+	if (boundMin.x > boundMax.x) rectMax = rectMin;
+
+	return float4(vid & 1 ? rectMax.x : rectMin.x, vid & 2 ? rectMin.y : rectMax.y, 1.0.xx);
+}
@@ -3,116 +3,46 @@
 //--------------------------------------------------------------------------------------
 
 #include "Impulse.hlsli"
-
-#define RAND_MAX 0xffff
-#define PI 3.1415926535897
+#include "Particle.hlsli"
 
 //--------------------------------------------------------------------------------------
 // Structure
 //--------------------------------------------------------------------------------------
-struct Particle
+struct VSOut
 {
-	float3 Pos;
-	float3 Velocity;
-	float LifeTime;
+	float4 Pos		: SV_POSITION;
+	float4 Color	: COLOR;
+	float3 Nrm		: NORMAL;
+	float2 Tex		: TEXCOORD;
 };
 
 //--------------------------------------------------------------------------------------
 // Constants
 //--------------------------------------------------------------------------------------
-cbuffer cbPerObject
+cbuffer cbPerObject : register (b1)
 {
 	float4x3 g_worldView;
+	float4x3 g_worldViewI;
+	matrix g_proj;
 };
 
-static const float g_fullLife = 3.0;
-
 //--------------------------------------------------------------------------------------
-// Buffer and textures
+// Buffers and textures
 //--------------------------------------------------------------------------------------
-RWStructuredBuffer<Particle> g_rwParticles;
-Texture3D<float3>	g_txVelocity;
+StructuredBuffer<uint2>		g_roVisibleList	: register (t0);	// Particle ID and radius scale from CSCullParticles
+StructuredBuffer<uint4>		g_roParticles	: register (t1);
+Texture3D					g_txColor		: register (t5);	// After the emitter buffers of Impulse.hlsli
+Texture3D					g_txNormal		: register (t6);	// Packed by CSGradient from g_txColor per frame
 
 //--------------------------------------------------------------------------------------
 // Sampler
 //--------------------------------------------------------------------------------------
 SamplerState g_smpLinear;
 
-//--------------------------------------------------------------------------------------
-// Random number generator
-//--------------------------------------------------------------------------------------
-uint rand(inout uint seed)
-{
-	// The same implementation of current Windows rand()
-	// msvcrt.dll: 77C271D8 mov     ecx, [eax + 14h]
-	// msvcrt.dll: 77C271DB imul    ecx, 343FDh
-	// msvcrt.dll: 77C271E1 add     ecx, 269EC3h
-	// msvcrt.dll: 77C271E7 mov     [eax + 14h], ecx
-	// msvcrt.dll: 77C271EA mov     eax, ecx
-	// msvcrt.dll: 77C271EC shr     eax, 10h
-	// msvcrt.dll: 77C271EF and     eax, 7FFFh
-	seed = seed * 0x343fd + 0x269ec3;   // a = 214013, b = 2531011
-
-	return (seed >> 0x10) & RAND_MAX;
-}
-
-//--------------------------------------------------------------------------------------
-// Random number generator with a range
-//--------------------------------------------------------------------------------------
-uint rand(inout uint2 seed, uint range)
-{
-	return (rand(seed.x) | (rand(seed.y) << 16)) % range;
-}
-
-//--------------------------------------------------------------------------------------
-// Common particle emission
-//--------------------------------------------------------------------------------------
-void Emit(uint particleId, inout Particle particle, bool is3D)
-{
-	// Load emitter with a random index
-	uint2 seed = { particleId, g_baseSeed };
-	const float r = g_impulseR * rand(seed, 1000) / 1000.0;
-	const float t = rand(seed, 1000) / 1000.0;
-	const float theta = t * 2.0 * PI;
-	float3 sphere;
-	sphere.x = r * cos(theta);
-	sphere.y = r * sin(theta);
-	sphere.z = 0.0;
-
-	if (is3D)
-	{
-		const float s = rand(seed, 1000) / 1000.0;
-		const float phi = s * PI;
-		sphere.xy *= sin(phi);
-		sphere.z = r * cos(phi);
-	}
-
-	// Particle emission
-	particle.Pos = g_impulsePos + sphere;
-	particle.LifeTime = g_fullLife + rand(seed, 1000) / 1000.0;
-}
-
-//--------------------------------------------------------------------------------------
-// Particle integration or emission
-//--------------------------------------------------------------------------------------
-void UpdateParticle(uint particleId, inout Particle particle, float3 tex, bool is3D)
-{
-	if (particle.LifeTime > 0.0)
-	{
-		// Integrate and update particle
-		particle.Velocity = g_txVelocity.SampleLevel(g_smpLinear, tex, 0.0);
-		particle.Pos += particle.Velocity * g_timeStep;
-		particle.LifeTime -= g_timeStep;
-	}
-	else Emit(particleId, particle, is3D);
-
-	g_rwParticles[particleId] = particle;
-}
-
 //--------------------------------------------------------------------------------------
 // Simulation space to object space
 //--------------------------------------------------------------------------------------
-float3 SimulationToObjectSpace(float3 pos, bool is3D)
+float3 SimulationToObjectSpace(float3 pos)
 {
 	pos = pos * 2.0 - 1.0;
 	pos.y = -pos.y;
@@ -121,24 +51,38 @@ float3 SimulationToObjectSpace(float3 pos, bool is3D)
 }
 
 //--------------------------------------------------------------------------------------
-// Vertex shader of particle integration or emission
+// Vertex shader of particle rendering, pulling the 4 corners of a quad per particle
+// instance from the visible list; read-only so that it can be drawn in any number of passes
 //--------------------------------------------------------------------------------------
-float3 main(uint ParticleId : SV_VERTEXID) : POSITION
+VSOut main(uint VertexId : SV_VERTEXID, uint InstanceId : SV_INSTANCEID)
 {
-	// Get grid size
-	float3 gridSize;
-	g_txVelocity.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+	VSOut output;
 
-	// Load particle
-	Particle particle = g_rwParticles[ParticleId];
-	const float3 tex = SimulationToTextureSpace(particle.Pos, gridSize);
+	// Simulation position at the rendered time between simulation steps
+	const uint2 visible = g_roVisibleList[InstanceId];
+	const Particle particle = UnpackParticle(g_roParticles[visible.x]);
+	const float3 sPos = particle.Pos + particle.Velocity * g_renderTimeOffset;
 
-	// Update particle
-	const bool is3D = gridSize.z > 1.0;
-	UpdateParticle(ParticleId, particle, tex, is3D);
-
-	// Calculate object position
-	const float3 pos = SimulationToObjectSpace(particle.Pos, is3D);
-
-	return mul(float4(pos, 1.0), g_worldView);
+	// Color and normal at the particle center, shared by the whole quad
+	float3 gridSize;
+	g_txColor.GetDimensions(gridSize.x, gridSize.y, gridSize.z);
+	const float3 tex = SimulationToTextureSpace(sPos, gridSize);
+	const float3 normal = g_txNormal.SampleLevel(g_smpLinear, tex, 0.0).xyz;
+	output.Color = g_txColor.SampleLevel(g_smpLinear, tex, 0.0);
+	output.Nrm = any(normal != 0.0) ? normalize(normal) : 0.0;
+
+	// Corner of the quad in the triangle-strip order
+	const float2 domain = float2(VertexId & 1, VertexId >> 1);
+	float2 offset = domain * 2.0 - 1.0;
+	offset.y = -offset.y;
+	offset *= PARTICLE_RADIUS * asfloat(visible.y);
+
+	// View-space billboard
+	float3 pos = mul(float4(SimulationToObjectSpace(sPos), 1.0), g_worldView);
+	pos.xy += offset;
+
+	output.Pos = mul(float4(pos, 1.0), g_proj);
+	output.Tex = domain;
+
+	return output;
 }
@@ -0,0 +1,90 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <DirectXPackedVector.h>
+
+// CPU counterpart of SampleLevel(g_smpLinear, tex, 0.0) on 3D textures
+class VolumeSampler
+{
+public:
+	enum AddressMode : uint8_t
+	{
+		CLAMP,
+		MIRROR,
+		WRAP
+	};
+
+	static int32_t Address(int32_t i, int32_t size, AddressMode address)
+	{
+		if (address == MIRROR)
+		{
+			// Reflect at the texel boundaries, as D3D12_TEXTURE_ADDRESS_MODE_MIRROR does
+			const auto period = size * 2;
+			i %= period;
+			i = i < 0 ? i + period : i;
+
+			return i < size ? i : period - i - 1;
+		}
+
+		if (address == WRAP)
+		{
+			i %= size;
+
+			return i < 0 ? i + size : i;
+		}
+
+		return i < 0 ? 0 : (i < size ? i : size - 1);
+	}
+
+	static uint32_t Index(uint32_t x, uint32_t y, uint32_t z, const DirectX::XMUINT3& size)
+	{
+		return (z * size.y + y) * size.x + x;
+	}
+
+	template<typename T>
+	static DirectX::XMVECTOR XM_CALLCONV SampleLinear(const T* pVolume, const DirectX::XMUINT3& size,
+		DirectX::FXMVECTOR tex, AddressMode address)
+	{
+		using namespace DirectX;
+
+		// Texel space with the texel centers at integers
+		XMFLOAT3 t;
+		XMStoreFloat3(&t, tex);
+		const float pos[] =
+		{
+			t.x * size.x - 0.5f,
+			t.y * size.y - 0.5f,
+			t.z * size.z - 0.5f
+		};
+		const int32_t dims[] = { static_cast<int32_t>(size.x), static_cast<int32_t>(size.y), static_cast<int32_t>(size.z) };
+
+		int32_t i0[3], i1[3];
+		float w[3];
+		for (uint8_t i = 0; i < 3; ++i)
+		{
+			const auto base = floor(pos[i]);
+			w[i] = pos[i] - base;
+			i0[i] = Address(static_cast<int32_t>(base), dims[i], address);
+			i1[i] = Address(static_cast<int32_t>(base) + 1, dims[i], address);
+		}
+
+		const auto fetch = [&](int32_t x, int32_t y, int32_t z) { return load(pVolume[Index(x, y, z, size)]); };
+		const auto c00 = XMVectorLerp(fetch(i0[0], i0[1], i0[2]), fetch(i1[0], i0[1], i0[2]), w[0]);
+		const auto c10 = XMVectorLerp(fetch(i0[0], i1[1], i0[2]), fetch(i1[0], i1[1], i0[2]), w[0]);
+		const auto c01 = XMVectorLerp(fetch(i0[0], i0[1], i1[2]), fetch(i1[0], i0[1], i1[2]), w[0]);
+		const auto c11 = XMVectorLerp(fetch(i0[0], i1[1], i1[2]), fetch(i1[0], i1[1], i1[2]), w[0]);
+
+		return XMVectorLerp(XMVectorLerp(c00, c10, w[1]), XMVectorLerp(c01, c11, w[1]), w[2]);
+	}
+
+protected:
+	static DirectX::XMVECTOR XM_CALLCONV load(const DirectX::XMFLOAT4& value) { return DirectX::XMLoadFloat4(&value); }
+	static DirectX::XMVECTOR XM_CALLCONV load(float value) { return DirectX::XMVectorReplicate(value); }
+	static DirectX::XMVECTOR XM_CALLCONV load(const DirectX::PackedVector::XMBYTEN4& value)
+	{
+		return DirectX::PackedVector::XMLoadByteN4(&value);
+	}
+};
@@ -0,0 +1,230 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#include "WaveletTurbulence.h"
+#include "VolumeSampler.h"
+
+using namespace std;
+using namespace concurrency;
+using namespace DirectX;
+
+// Displacement per unit of local turbulent velocity (one 60-Hz simulation step)
+const float WaveletTurbulence::DisplacementScale = 1.0f / 60.0f;
+// Scrolling speed of the noise in tiles per second, which keeps the detail evolving
+const float WaveletTurbulence::NoiseDrift = 0.05f;
+
+// Wavelet analysis/refinement coefficients (Cook and DeRose, "Wavelet Noise")
+static const int32_t g_aRadius = 16;
+static const float g_aCoeffs[g_aRadius * 2] =
+{
+	0.000334f, -0.001528f, 0.000410f, 0.003545f, -0.000938f, -0.008233f, 0.002172f, 0.019120f,
+	-0.005040f, -0.044412f, 0.011655f, 0.103311f, -0.025936f, -0.243780f, 0.033979f, 0.655340f,
+	0.655340f, 0.033979f, -0.243780f, -0.025936f, 0.103311f, 0.011655f, -0.044412f, -0.005040f,
+	0.019120f, 0.002172f, -0.008233f, -0.000938f, 0.003546f, 0.000410f, -0.001528f, 0.000334f
+};
+static const float g_pCoeffs[] = { 0.25f, 0.75f, 0.75f, 0.25f };
+
+WaveletTurbulence::WaveletTurbulence() :
+	m_gridSize(0, 0, 0),
+	m_hiResGridSize(0, 0, 0),
+	m_numOctaves(1)
+{
+}
+
+WaveletTurbulence::~WaveletTurbulence()
+{
+}
+
+void WaveletTurbulence::Init(const XMUINT3& gridSize, uint32_t upsample)
+{
+	m_gridSize = gridSize;
+	m_hiResGridSize.x = gridSize.x * upsample;
+	m_hiResGridSize.y = gridSize.y * upsample;
+	m_hiResGridSize.z = gridSize.z > 1 ? gridSize.z * upsample : 1;
+	m_numOctaves = GetNumOctaves(upsample);
+
+	GenerateNoiseTile(m_noise);
+	m_color.assign(m_hiResGridSize.x * m_hiResGridSize.y * m_hiResGridSize.z, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+}
+
+void WaveletTurbulence::Synthesize(const XMFLOAT4* pVelocity, const XMFLOAT4* pColor, float time)
+{
+	const auto& gridSize = m_gridSize;
+	const auto& hiResGridSize = m_hiResGridSize;
+	const XMUINT3 noiseSize(NoiseTileSize, NoiseTileSize, NoiseTileSize);
+	const XMUINT3 numTiles
+	(
+		(hiResGridSize.x - 1) / TileSize + 1,
+		(hiResGridSize.y - 1) / TileSize + 1,
+		(hiResGridSize.z - 1) / TileSize + 1
+	);
+
+	const auto hiResGridSizeV = XMVectorSet(static_cast<float>(hiResGridSize.x),
+		static_cast<float>(hiResGridSize.y), static_cast<float>(hiResGridSize.z), 1.0f);
+
+	// The first octave places two noise texels in a simulation cell, so that
+	// the synthesized band starts right above the Nyquist limit of the simulation
+	const auto noiseScale = XMVectorSet(2.0f * gridSize.x / NoiseTileSize,
+		2.0f * gridSize.y / NoiseTileSize, 2.0f * gridSize.z / NoiseTileSize, 0.0f);
+
+	// Tiles of TileSize^3 render cells keep the footprints in the simulation grid and
+	// the noise tile cache-resident; the cells are looped over one by one, with only
+	// the channels of each in a 4-wide vector
+	parallel_for(0u, numTiles.x * numTiles.y * numTiles.z, [&](uint32_t tile)
+	{
+		const auto tileX = tile % numTiles.x;
+		const auto tileY = tile / numTiles.x % numTiles.y;
+		const auto tileZ = tile / (numTiles.x * numTiles.y);
+		const auto xEnd = min((tileX + 1) * TileSize, hiResGridSize.x);
+		const auto yEnd = min((tileY + 1) * TileSize, hiResGridSize.y);
+		const auto zEnd = min((tileZ + 1) * TileSize, hiResGridSize.z);
+
+		for (auto z = tileZ * TileSize; z < zEnd; ++z)
+			for (auto y = tileY * TileSize; y < yEnd; ++y)
+				for (auto x = tileX * TileSize; x < xEnd; ++x)
+				{
+					const auto tex = XMVectorDivide(XMVectorSet(x + 0.5f, y + 0.5f, z + 0.5f, 0.0f), hiResGridSizeV);
+
+					// Local energy of the simulated velocity, amplitude = sqrt(2E) = |u|
+					const auto u = VolumeSampler::SampleLinear(pVelocity, gridSize, tex, VolumeSampler::CLAMP);
+					const auto amplitude = XMVector3Length(u);
+
+					// Band-limited octaves with a Kolmogorov falloff of 2^(-5/6)
+					auto disp = XMVectorZero();
+					auto freq = 1.0f, weight = 1.0f;
+					for (auto i = 0u; i < m_numOctaves; ++i)
+					{
+						const auto p = XMVectorAdd(XMVectorScale(XMVectorMultiply(tex, noiseScale), freq),
+							XMVectorReplicate(time * NoiseDrift * freq));
+						const auto noise = VolumeSampler::SampleLinear(m_noise.data(), noiseSize, p, VolumeSampler::WRAP);
+						disp = XMVectorMultiplyAdd(noise, XMVectorReplicate(weight), disp);
+						freq *= 2.0f;
+						weight *= 0.561231f;
+					}
+
+					// Displace the lookup into the simulated color
+					disp = XMVectorMultiply(disp, XMVectorScale(amplitude, DisplacementScale));
+					disp = hiResGridSize.z > 1 ? disp : XMVectorSetZ(disp, 0.0f);
+					const auto color = VolumeSampler::SampleLinear(pColor, gridSize, XMVectorAdd(tex, disp), VolumeSampler::CLAMP);
+					XMStoreFloat4(&m_color[VolumeSampler::Index(x, y, z, hiResGridSize)], color);
+				}
+	});
+}
+
+const XMUINT3& WaveletTurbulence::GetGridSize() const
+{
+	return m_hiResGridSize;
+}
+
+const XMFLOAT4* WaveletTurbulence::GetColor() const
+{
+	return m_color.data();
+}
+
+void WaveletTurbulence::GenerateNoiseTile(vector<XMFLOAT4>& noise, uint32_t seed)
+{
+	const auto numTexels = NoiseTileSize * NoiseTileSize * NoiseTileSize;
+
+	// Three independent channels for the displacement vector
+	vector<float> channels[3];
+	parallel_for(0u, 3u, [&](uint32_t i)
+	{
+		mt19937 rng(seed * 3 + i);
+		channels[i].resize(numTexels);
+		generateNoiseChannel(channels[i].data(), rng);
+
+		// Normalize to unit variance
+		auto variance = 0.0;
+		for (const auto& value : channels[i]) variance += value * value;
+		const auto scale = static_cast<float>(1.0 / sqrt(variance / numTexels));
+		for (auto& value : channels[i]) value *= scale;
+	});
+
+	noise.resize(numTexels);
+	for (auto i = 0u; i < numTexels; ++i)
+		noise[i] = XMFLOAT4(channels[0][i], channels[1][i], channels[2][i], 0.0f);
+}
+
+uint32_t WaveletTurbulence::GetNumOctaves(uint32_t upsample)
+{
+	auto numOctaves = 0u;
+	while (upsample >>= 1) ++numOctaves;
+
+	return max(numOctaves, 1u);
+}
+
+void WaveletTurbulence::generateNoiseChannel(float* pNoise, mt19937& rng)
+{
+	const auto n = NoiseTileSize;
+	const auto numTexels = n * n * n;
+	vector<float> temp1(numTexels), temp2(numTexels);
+
+	// Random noise
+	normal_distribution<float> gaussian;
+	for (auto i = 0u; i < numTexels; ++i) pNoise[i] = gaussian(rng);
+
+	// Downsample and upsample the tile along each axis
+	for (auto z = 0u; z < n; ++z)
+		for (auto y = 0u; y < n; ++y)
+		{
+			const auto i = (z * n + y) * n;
+			downsample(&pNoise[i], &temp1[i], n, 1);
+			upsample(&temp1[i], &temp2[i], n, 1);
+		}
+
+	for (auto z = 0u; z < n; ++z)
+		for (auto x = 0u; x < n; ++x)
+		{
+			const auto i = z * n * n + x;
+			downsample(&temp2[i], &temp1[i], n, n);
+			upsample(&temp1[i], &temp2[i], n, n);
+		}
+
+	for (auto y = 0u; y < n; ++y)
+		for (auto x = 0u; x < n; ++x)
+		{
+			const auto i = y * n + x;
+			downsample(&temp2[i], &temp1[i], n, n * n);
+			upsample(&temp1[i], &temp2[i], n, n * n);
+		}
+
+	// Subtract out the coarse-scale contribution
+	for (auto i = 0u; i < numTexels; ++i) pNoise[i] -= temp2[i];
+
+	// Avoid the even/odd variance difference by adding an odd-offset version of the noise
+	const auto offset = n / 2 + (n / 2 + 1) % 2;
+	const XMUINT3 size(n, n, n);
+	for (auto z = 0u; z < n; ++z)
+		for (auto y = 0u; y < n; ++y)
+			for (auto x = 0u; x < n; ++x)
+				temp1[VolumeSampler::Index(x, y, z, size)] =
+				pNoise[VolumeSampler::Index((x + offset) % n, (y + offset) % n, (z + offset) % n, size)];
+	for (auto i = 0u; i < numTexels; ++i) pNoise[i] += temp1[i];
+}
+
+void WaveletTurbulence::downsample(const float* pFrom, float* pTo, uint32_t n, uint32_t stride)
+{
+	const auto a = &g_aCoeffs[g_aRadius];
+	const auto size = static_cast<int32_t>(n);
+	for (auto i = 0; i < size / 2; ++i)
+	{
+		auto sum = 0.0f;
+		for (auto k = 2 * i - g_aRadius; k < 2 * i + g_aRadius; ++k)
+			sum += a[k - 2 * i] * pFrom[VolumeSampler::Address(k, size, VolumeSampler::WRAP) * stride];
+		pTo[i * stride] = sum;
+	}
+}
+
+void WaveletTurbulence::upsample(const float* pFrom, float* pTo, uint32_t n, uint32_t stride)
+{
+	const auto p = &g_pCoeffs[2];
+	const auto size = static_cast<int32_t>(n);
+	for (auto i = 0; i < size; ++i)
+	{
+		auto sum = 0.0f;
+		for (auto k = i / 2; k <= i / 2 + 1; ++k)
+			sum += p[i - 2 * k] * pFrom[VolumeSampler::Address(k, size / 2, VolumeSampler::WRAP) * stride];
+		pTo[i * stride] = sum;
+	}
+}
@@ -0,0 +1,41 @@
+//--------------------------------------------------------------------------------------
+// Copyright (c) XU, Tianchen. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+// Upsamples the simulated color volume with band-limited turbulence (wavelet noise),
+// CPU counterpart of CSTurbulence
+class WaveletTurbulence
+{
+public:
+	WaveletTurbulence();
+	virtual ~WaveletTurbulence();
+
+	void Init(const DirectX::XMUINT3& gridSize, uint32_t upsample);
+	void Synthesize(const DirectX::XMFLOAT4* pVelocity, const DirectX::XMFLOAT4* pColor, float time);
+
+	const DirectX::XMUINT3& GetGridSize() const;
+	const DirectX::XMFLOAT4* GetColor() const;
+
+	static void GenerateNoiseTile(std::vector<DirectX::XMFLOAT4>& noise, uint32_t seed = 0);
+	static uint32_t GetNumOctaves(uint32_t upsample);
+
+	static const uint32_t NoiseTileSize = 64;
+	static const uint32_t TileSize = 8;
+	static const float DisplacementScale;
+	static const float NoiseDrift;
+
+protected:
+	static void generateNoiseChannel(float* pNoise, std::mt19937& rng);
+	static void downsample(const float* pFrom, float* pTo, uint32_t n, uint32_t stride);
+	static void upsample(const float* pFrom, float* pTo, uint32_t n, uint32_t stride);
+
+	DirectX::XMUINT3 m_gridSize;		// Simulation grid
+	DirectX::XMUINT3 m_hiResGridSize;	// Render grid
+
+	std::vector<DirectX::XMFLOAT4> m_noise;
+	std::vector<DirectX::XMFLOAT4> m_color;
+
+	uint32_t m_numOctaves;
+};
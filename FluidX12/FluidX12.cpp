@@ -10,6 +10,9 @@
 //*********************************************************
 
 #include "FluidX12.h"
+#include "Benchmark.h"
+#include "FluidCPU.h"
+#include <psapi.h>
 
 using namespace std;
 using namespace XUSG;
@@ -21,11 +24,24 @@ const float g_zFar = 1000.0f;
 FluidX::FluidX(uint32_t width, uint32_t height, std::wstring name) :
 	DXFramework(width, height, name),
 	m_frameIndex(0),
+	m_timestampPeriod(0.0),
+	m_gpuTime(0.0),
+	m_numGpuFrames(0),
 	m_showFPS(true),
 	m_isPaused(false),
 	m_tracking(false),
 	m_gridSize(128, 128, 128),
-	m_numParticles(0)
+	m_numParticles(0),
+	m_upsample(1),
+	m_simRate(0.0f),
+	m_seed(0),
+	m_reorderInterval(0),
+	m_flipRatio(-1.0f),
+	m_integrator(ParticleCPU::EULER),
+	m_frameBudget(1000.0f / 60.0f),
+	m_blockCompression(false),
+	m_numHeadlessFrames(0),
+	m_benchmark(false)
 {
 #if defined (_DEBUG)
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
@@ -45,6 +61,23 @@ FluidX::~FluidX()
 
 void FluidX::OnInit()
 {
+	// Quitting with a failure code if any check of the CPU paths fails
+	if (m_benchmark && !RunBenchmarks())
+	{
+		PostQuitMessage(EXIT_FAILURE);
+
+		return;
+	}
+
+	// Without a device, quitting once the frames are written
+	if (m_numHeadlessFrames > 0)
+	{
+		RenderHeadless();
+		PostQuitMessage(0);
+
+		return;
+	}
+
 	LoadPipeline();
 	LoadAssets();
 }
@@ -95,6 +128,21 @@ void FluidX::LoadPipeline()
 	N_RETURN(m_commandQueue->Create(m_device.get(), CommandListType::DIRECT, CommandQueueFlag::NONE,
 		0, 0, L"CommandQueue"), ThrowIfFailed(E_FAIL));
 
+	// Create the timestamp queries of the GPU frame time, a pair per frame, and their readback
+	D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+	queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryHeapDesc.Count = 2 * FrameCount;
+	ThrowIfFailed(static_cast<ID3D12Device*>(m_device->GetHandle())->CreateQueryHeap(&queryHeapDesc,
+		IID_PPV_ARGS(&m_queryHeap)));
+
+	m_timestamps = RawBuffer::MakeUnique();
+	N_RETURN(m_timestamps->Create(m_device.get(), sizeof(uint64_t) * queryHeapDesc.Count, ResourceFlag::NONE,
+		MemoryType::READBACK, 0, nullptr, 0, nullptr, L"Timestamps"), ThrowIfFailed(E_FAIL));
+
+	uint64_t timestampFreq;
+	ThrowIfFailed(static_cast<ID3D12CommandQueue*>(m_commandQueue->GetHandle())->GetTimestampFrequency(&timestampFreq));
+	m_timestampPeriod = 1000.0 / timestampFreq;
+
 	// Describe and create the swap chain.
 	m_swapChain = SwapChain::MakeUnique();
 	N_RETURN(m_swapChain->Create(factory.Get(), Win32Application::GetHwnd(), m_commandQueue.get(),
@@ -128,6 +176,8 @@ void FluidX::LoadPipeline()
 // Load the sample assets.
 void FluidX::LoadAssets()
 {
+	const auto startTime = chrono::high_resolution_clock::now();
+
 	// Create the command list.
 	m_commandList = CommandList::MakeUnique();
 	const auto pCommandList = m_commandList.get();
@@ -138,8 +188,15 @@ void FluidX::LoadAssets()
 	// Create fast hybrid fluid simulator
 	m_fluid = make_unique<Fluid>(m_device);
 	if (!m_fluid) ThrowIfFailed(E_FAIL);
+	m_fluid->SetSimulationRate(m_simRate);
+	m_fluid->SetSeed(m_seed);
+	m_fluid->SetReorderInterval(m_reorderInterval);
+	m_fluid->SetFlipRatio(m_flipRatio);
+	m_fluid->SetIntegrator(m_integrator);
+	m_fluid->SetFrameBudget(m_frameBudget / 1000.0f);
+	m_fluid->SetBlockCompression(m_blockCompression);
 	if (!m_fluid->Init(pCommandList, m_width, m_height, m_descriptorTableCache, uploaders,
-		Format::B8G8R8A8_UNORM, Format::D24_UNORM_S8_UINT, m_gridSize, m_numParticles))
+		Format::B8G8R8A8_UNORM, Format::D24_UNORM_S8_UINT, m_gridSize, m_numParticles, m_upsample))
 		ThrowIfFailed(E_FAIL);
 
 	// Close the command list and execute it to begin the initial GPU setup.
@@ -164,6 +221,26 @@ void FluidX::LoadAssets()
 		WaitForGpu();
 	}
 
+	// Report the startup time and the peak host memory to the debugger output, which every build
+	// has, and to the console, which only the debug builds open in the windowed mode
+	{
+		const auto endTime = chrono::high_resolution_clock::now();
+		PROCESS_MEMORY_COUNTERS memoryCounters = {};
+		GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters));
+		stringstream report;
+		report << "Startup: " << setprecision(1) << fixed
+			<< chrono::duration<double, milli>(endTime - startTime).count() << " ms, peak memory: "
+			<< memoryCounters.PeakWorkingSetSize / (1024.0 * 1024.0) << " MB" << endl;
+		OutputDebugStringA(report.str().c_str());
+		cout << report.str();
+	}
+
+	InitView();
+}
+
+// Initialize the projection and the view.
+void FluidX::InitView()
+{
 	// Projection
 	const auto aspectRatio = m_width / static_cast<float>(m_height);
 	const auto proj = XMMatrixPerspectiveFovLH(g_FOVAngleY, aspectRatio, g_zNear, g_zFar);
@@ -178,6 +255,87 @@ void FluidX::LoadAssets()
 	XMStoreFloat4x4(&m_view, view);
 }
 
+// Time and check the CPU paths and print the results to the console.
+bool FluidX::RunBenchmarks()
+{
+#if !defined (_DEBUG)
+	AllocConsole();
+	FILE* stream;
+	freopen_s(&stream, "CONOUT$", "w+t", stdout);
+#endif
+
+	Benchmark benchmark(cout);
+	benchmark.Emitters(m_gridSize, 1024);
+	benchmark.Vorticity(m_gridSize);
+	benchmark.Turbulence(m_gridSize, max(m_upsample, 2u));
+	benchmark.Particles(m_gridSize, max(m_numParticles, 1u << 22));
+	benchmark.Checkpoint(m_gridSize, max(m_numParticles, 1u << 20));
+	benchmark.ParticlesSoA(m_gridSize, max(m_numParticles, 1u << 22));
+	benchmark.Random(1u << 24);
+	benchmark.ParticleQuads(m_gridSize, max(m_numParticles, 1u << 20));
+	benchmark.Normals(m_gridSize, max(m_numParticles, 1u << 20));
+	benchmark.ParticleCulling(m_gridSize, max(m_numParticles, 1u << 20));
+	benchmark.HybridSolver(m_gridSize, max(m_numParticles, 1u << 20));
+	benchmark.ParticleIntegration(m_gridSize, max(m_numParticles, 1u << 20));
+	benchmark.RayCasting(m_gridSize, m_width, m_height);
+	benchmark.ReducedResolution(m_gridSize, m_width, m_height);
+	benchmark.RayPackets(XMUINT3(128, 128, 128), 1920, 1080);
+	benchmark.RayPackets(XMUINT3(256, 256, 256), 1920, 1080);
+	benchmark.Compression(m_gridSize, m_width, m_height);
+
+	const auto numFailures = benchmark.GetNumFailures();
+	if (numFailures > 0) cout << numFailures << " check(s) failed" << endl;
+
+	return numFailures == 0;
+}
+
+// Simulate and ray cast on the CPU only, writing each frame to an image.
+void FluidX::RenderHeadless()
+{
+#if !defined (_DEBUG)
+	AllocConsole();
+	FILE* stream;
+	freopen_s(&stream, "CONOUT$", "w+t", stdout);
+#endif
+
+	if (m_gridSize.z <= 1)
+	{
+		cout << "Headless rendering needs a 3D grid" << endl;
+
+		return;
+	}
+
+	InitView();
+
+	FluidCPU fluid;
+	fluid.Init(m_gridSize);
+	RayCasterCPU rayCaster;
+	rayCaster.Init(m_width, m_height);
+	rayCaster.UpdateFrame(m_view, m_proj, m_eyePt);
+
+	// One simulation step per frame, rendered as PSRayCast over the clear color
+	auto renderTime = 0.0;
+	for (auto i = 0u; i < m_numHeadlessFrames; ++i)
+	{
+		fluid.Simulate(1.0f / 60.0f);
+
+		const auto startTime = chrono::high_resolution_clock::now();
+		rayCaster.UpdateOccupancy(fluid.GetColor(), m_gridSize);
+		rayCaster.UpdateLightTrans(fluid.GetColor(), m_gridSize);
+		rayCaster.UpdateMips(fluid.GetColor(), m_gridSize);
+		rayCaster.Render(fluid.GetColor(), m_gridSize, true, true, true, true);
+		renderTime += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - startTime).count();
+
+		stringstream fileName;
+		fileName << "Frame" << setw(4) << setfill('0') << i << ".ppm";
+		if (!rayCaster.SaveImage(fileName.str().c_str(), XMFLOAT3(0.2f, 0.2f, 0.2f)))
+			cout << "Failed to write " << fileName.str() << endl;
+	}
+
+	cout << "Headless: " << m_numHeadlessFrames << " frames of " << m_width << "x" << m_height << ", rendering at "
+		<< setprecision(2) << fixed << 1000.0 * m_numHeadlessFrames / renderTime << " frames/s" << endl;
+}
+
 // Update frame-based values.
 void FluidX::OnUpdate()
 {
@@ -216,6 +374,9 @@ void FluidX::OnRender()
 
 void FluidX::OnDestroy()
 {
+	// No device was created in headless mode, or after a failed check
+	if (!m_device) return;
+
 	// Ensure that the GPU is no longer referencing resources that are about to be
 	// cleaned up by the destructor.
 	WaitForGpu();
@@ -234,9 +395,34 @@ void FluidX::OnKeyUp(uint8_t key)
 	case VK_F1:
 		m_showFPS = !m_showFPS;
 		break;
+	case VK_PRIOR:
+		ResizeGrid(1.25f);
+		break;
+	case VK_NEXT:
+		ResizeGrid(0.8f);
+		break;
 	}
 }
 
+// Scales the simulation grid, keeping the extents in multiples of 8 cells
+void FluidX::ResizeGrid(float scale)
+{
+	const auto resize = [scale](uint32_t size)
+	{
+		const auto newSize = (static_cast<uint32_t>(size * scale + 4.0f) / 8) * 8;
+		return min(max(newSize, 16u), 512u);
+	};
+
+	const auto gridSize = m_gridSize;
+	m_gridSize.x = resize(gridSize.x);
+	m_gridSize.y = resize(gridSize.y);
+	m_gridSize.z = gridSize.z > 1 ? resize(gridSize.z) : 1;
+
+	// The pool may evict the grids that the frames in flight still reference
+	WaitForGpu();
+	if (!m_fluid->Resize(m_gridSize)) m_gridSize = gridSize;
+}
+
 // User camera interactions.
 void FluidX::OnLButtonDown(float posX, float posY)
 {
@@ -317,6 +503,61 @@ void FluidX::ParseCommandLineArgs(wchar_t* argv[], int argc)
 		{
 			m_numParticles = ++i < argc ? static_cast<uint32_t>(_wtof(argv[i])) : m_numParticles;
 		}
+		else if (_wcsnicmp(argv[i], L"-upsample", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/upsample", wcslen(argv[i])) == 0)
+		{
+			m_upsample = ++i < argc ? static_cast<uint32_t>(_wtof(argv[i])) : m_upsample;
+		}
+		else if (_wcsnicmp(argv[i], L"-simRate", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/simRate", wcslen(argv[i])) == 0)
+		{
+			m_simRate = ++i < argc ? static_cast<float>(_wtof(argv[i])) : m_simRate;
+		}
+		else if (_wcsnicmp(argv[i], L"-seed", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/seed", wcslen(argv[i])) == 0)
+		{
+			m_seed = ++i < argc ? static_cast<uint32_t>(_wtof(argv[i])) : m_seed;
+		}
+		else if (_wcsnicmp(argv[i], L"-reorder", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/reorder", wcslen(argv[i])) == 0)
+		{
+			m_reorderInterval = ++i < argc ? static_cast<uint32_t>(_wtof(argv[i])) : m_reorderInterval;
+		}
+		else if (_wcsnicmp(argv[i], L"-flip", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/flip", wcslen(argv[i])) == 0)
+		{
+			m_flipRatio = ++i < argc ? static_cast<float>(_wtof(argv[i])) : m_flipRatio;
+		}
+		else if (_wcsnicmp(argv[i], L"-integrator", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/integrator", wcslen(argv[i])) == 0)
+		{
+			// Order of the particle integration, from 1 for the forward Euler to 3
+			const auto order = ++i < argc ? static_cast<uint32_t>(_wtof(argv[i])) : m_integrator + 1u;
+			m_integrator = static_cast<ParticleCPU::Integrator>(min(max(order, 1u), 3u) - 1);
+		}
+		else if (_wcsnicmp(argv[i], L"-budget", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/budget", wcslen(argv[i])) == 0)
+		{
+			// Frame time in milliseconds for the ray casting resolution, 0 for full resolution
+			m_frameBudget = ++i < argc ? static_cast<float>(_wtof(argv[i])) : m_frameBudget;
+		}
+		else if (_wcsnicmp(argv[i], L"-compress", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/compress", wcslen(argv[i])) == 0)
+		{
+			// Block-compressed rendered volume for the ray casting, which needs whole 4x4 blocks per slice
+			m_blockCompression = true;
+		}
+		else if (_wcsnicmp(argv[i], L"-headless", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/headless", wcslen(argv[i])) == 0)
+		{
+			// Frames to render on the CPU into images, without a device
+			m_numHeadlessFrames = ++i < argc ? static_cast<uint32_t>(_wtof(argv[i])) : 1;
+		}
+		else if (_wcsnicmp(argv[i], L"-benchmark", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/benchmark", wcslen(argv[i])) == 0)
+		{
+			m_benchmark = true;
+		}
 	}
 }
 
@@ -334,6 +575,21 @@ void FluidX::PopulateCommandList()
 	const auto pCommandList = m_commandList.get();
 	N_RETURN(pCommandList->Reset(pCommandAllocator, nullptr), ThrowIfFailed(E_FAIL));
 
+	// GPU time of the last frame on this back buffer, which has completed, including every pass
+	// of the simulation and the rendering, such as the block compression
+	const auto pTimestamps = static_cast<const uint64_t*>(m_timestamps->Map(nullptr));
+	if (pTimestamps)
+	{
+		const auto startTime = pTimestamps[2 * m_frameIndex], endTime = pTimestamps[2 * m_frameIndex + 1];
+		if (endTime > startTime)
+		{
+			m_gpuTime += (endTime - startTime) * m_timestampPeriod;
+			++m_numGpuFrames;
+		}
+		m_timestamps->Unmap();
+	}
+	pCommandList->EndQuery(m_queryHeap.get(), QueryType::TIMESTAMP, 2 * m_frameIndex);
+
 	// Record commands.
 	const DescriptorPool descriptorPools[] =
 	{
@@ -362,12 +618,16 @@ void FluidX::PopulateCommandList()
 	pCommandList->RSSetViewports(1, &viewport);
 	pCommandList->RSSetScissorRects(1, &scissorRect);
 
-	m_fluid->Render(pCommandList, m_frameIndex);
+	m_fluid->Render(pCommandList, m_frameIndex, m_renderTargets[m_frameIndex]->GetRTV());
 	
 	// Indicate that the back buffer will now be used to present.
 	numBarriers = m_renderTargets[m_frameIndex]->SetBarrier(barriers, ResourceState::PRESENT);
 	pCommandList->Barrier(numBarriers, barriers);
 
+	pCommandList->EndQuery(m_queryHeap.get(), QueryType::TIMESTAMP, 2 * m_frameIndex + 1);
+	pCommandList->ResolveQueryData(m_queryHeap.get(), QueryType::TIMESTAMP, 2 * m_frameIndex, 2,
+		m_timestamps.get(), sizeof(uint64_t) * 2 * m_frameIndex);
+
 	N_RETURN(pCommandList->Close(), ThrowIfFailed(E_FAIL));
 }
 
@@ -426,8 +686,17 @@ double FluidX::CalculateFrameStats(float* pTimeStep)
 
 		wstringstream windowText;
 		windowText << L"    fps: ";
-		if (m_showFPS) windowText << setprecision(2) << fixed << fps;
+		if (m_showFPS)
+		{
+			windowText << setprecision(2) << fixed << fps;
+			if (m_numGpuFrames > 0) windowText << L"    gpu: " << m_gpuTime / m_numGpuFrames << L" ms";
+		}
 		else windowText << L"[F1]";
+		m_gpuTime = 0.0;
+		m_numGpuFrames = 0;
+		windowText << L"    grid: " << m_gridSize.x << L"x" << m_gridSize.y;
+		if (m_gridSize.z > 1) windowText << L"x" << m_gridSize.z;
+		windowText << L" [PgUp/PgDn]";
 		SetCustomWindowText(windowText.str().c_str());
 	}
 
@@ -63,6 +63,13 @@ private:
 	XMFLOAT3	m_focusPt;
 	XMFLOAT3	m_eyePt;
 
+	// GPU frame time, from the timestamps at the start and the end of each frame
+	XUSG::com_ptr<ID3D12QueryHeap> m_queryHeap;
+	XUSG::RawBuffer::uptr	m_timestamps;	// Read back per frame
+	double		m_timestampPeriod;	// Milliseconds per tick
+	double		m_gpuTime;		// Milliseconds summed over the frames of the stats period
+	uint32_t	m_numGpuFrames;
+
 	// Synchronization objects.
 	uint32_t	m_frameIndex;
 	HANDLE		m_fenceEvent;
@@ -81,9 +88,23 @@ private:
 	// User external settings
 	XMUINT3 m_gridSize;
 	uint32_t m_numParticles;
+	uint32_t m_upsample;
+	float m_simRate;
+	uint32_t m_seed;
+	uint32_t m_reorderInterval;
+	float m_flipRatio;
+	ParticleCPU::Integrator m_integrator;
+	float m_frameBudget;	// Milliseconds
+	bool m_blockCompression;
+	uint32_t m_numHeadlessFrames;
+	bool m_benchmark;
 
 	void LoadPipeline();
 	void LoadAssets();
+	void InitView();
+	bool RunBenchmarks();
+	void RenderHeadless();
+	void ResizeGrid(float scale);
 
 	void PopulateCommandList();
 	void WaitForGpu();
@@ -42,6 +42,9 @@
 #include <unordered_map>
 #endif
 #include <functional>
+#include <chrono>
+#include <random>
+#include <ppl.h>
 #include <wrl.h>
 #include <shellapi.h>
 